@@ -31,6 +31,7 @@
 #include "parsebgp_bgp_update_impl.h"
 #include "parsebgp_bgp_notification_impl.h"
 #include "parsebgp_bgp_route_refresh_impl.h"
+#include "parsebgp_filter_impl.h"
 #include <arpa/inet.h>
 #include <assert.h>
 #include <stdio.h>
@@ -44,11 +45,13 @@ static parsebgp_error_t parse_common_hdr(parsebgp_opts_t *opts,
 {
   size_t len = *lenp, nread = 0;
 
+  // check the whole (fixed-size) header is present
+  PARSEBGP_DESERIALIZE_CHECK(len, nread,
+                             (opts->bgp.marker_omitted ? 0 : sizeof(msg->marker))
+                             + sizeof(msg->len) + sizeof(msg->type));
+
   // Marker
   if (opts->bgp.marker_omitted == 0) {
-    if ((len - nread) < sizeof(msg->marker)) {
-      return PARSEBGP_PARTIAL_MSG;
-    }
     if (opts->bgp.marker_copy != 0) {
       memcpy(&msg->marker, buf, sizeof(msg->marker));
     }
@@ -57,15 +60,25 @@ static parsebgp_error_t parse_common_hdr(parsebgp_opts_t *opts,
   }
 
   // Length
-  PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->len);
+  PARSEBGP_DESERIALIZE_UINT16_UNCHECKED(buf, len, nread, msg->len);
 
   // Type
-  PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, msg->type);
+  PARSEBGP_DESERIALIZE_UINT8_UNCHECKED(buf, len, nread, msg->type);
 
   *lenp = nread;
   return PARSEBGP_OK;
 }
 
+// filter kinds, indexed by BGP message type
+static const parsebgp_filter_kind_t filter_kinds[] = {
+  0,                                    // (unused)
+  PARSEBGP_FILTER_KIND_OPEN,            // PARSEBGP_BGP_TYPE_OPEN
+  PARSEBGP_FILTER_KIND_UPDATE,          // PARSEBGP_BGP_TYPE_UPDATE
+  PARSEBGP_FILTER_KIND_NOTIFICATION,    // PARSEBGP_BGP_TYPE_NOTIFICATION
+  PARSEBGP_FILTER_KIND_KEEPALIVE,       // PARSEBGP_BGP_TYPE_KEEPALIVE
+  PARSEBGP_FILTER_KIND_ROUTE_REFRESH,   // PARSEBGP_BGP_TYPE_ROUTE_REFRESH
+};
+
 parsebgp_error_t parsebgp_bgp_decode_ext(parsebgp_opts_t *opts,
                                          parsebgp_bgp_msg_t *msg,
                                          const uint8_t *buf,
@@ -91,6 +104,15 @@ parsebgp_error_t parsebgp_bgp_decode_ext(parsebgp_opts_t *opts,
     return PARSEBGP_PARTIAL_MSG;
   }
 
+  if (opts->filter != NULL && msg->type >= PARSEBGP_BGP_TYPE_OPEN &&
+      msg->type <= PARSEBGP_BGP_TYPE_ROUTE_REFRESH) {
+    parsebgp_filter_set_kind(opts, filter_kinds[msg->type]);
+    if (parsebgp_filter_eval(opts) == PARSEBGP_FILTER_FALSE) {
+      *len = nread + remain;
+      return PARSEBGP_FILTERED_OUT;
+    }
+  }
+
   switch (msg->type) {
   case PARSEBGP_BGP_TYPE_OPEN:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.open);
@@ -128,6 +150,11 @@ parsebgp_error_t parsebgp_bgp_decode_ext(parsebgp_opts_t *opts,
   default:
     PARSEBGP_RETURN_INVALID_MSG_ERR;
   }
+  if (err == PARSEBGP_FILTERED_OUT) {
+    // skip the rest of the message
+    *len = nread + remain;
+    return err;
+  }
   if (err != PARSEBGP_OK) {
     // parser failed
     return err;
@@ -149,6 +176,67 @@ parsebgp_error_t parsebgp_bgp_decode(parsebgp_opts_t *opts,
   return parsebgp_bgp_decode_ext(opts, msg, buf, len, 0);
 }
 
+parsebgp_error_t parsebgp_bgp_validate(parsebgp_opts_t *opts,
+                                       const uint8_t *buf, size_t *len,
+                                       const uint8_t **errp)
+{
+  size_t hdr_len = BGP_HDR_LEN, body_len;
+  uint16_t msg_len;
+  const uint8_t *body;
+  parsebgp_error_t err = PARSEBGP_OK;
+
+  if (opts->bgp.marker_omitted) {
+    hdr_len -= sizeof(((parsebgp_bgp_msg_t *)NULL)->marker);
+  }
+  if (*len < hdr_len) {
+    PARSEBGP_VALIDATE_ERR(errp, buf + *len, PARSEBGP_PARTIAL_MSG);
+  }
+
+  // Length
+  msg_len = nptohs(buf + hdr_len - 3);
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + hdr_len - 3, msg_len >= hdr_len);
+  if (msg_len > *len) {
+    PARSEBGP_VALIDATE_ERR(errp, buf + *len, PARSEBGP_PARTIAL_MSG);
+  }
+  body = buf + hdr_len;
+  body_len = msg_len - hdr_len;
+
+  // Type
+  switch (buf[hdr_len - 1]) {
+  case PARSEBGP_BGP_TYPE_OPEN:
+    err = parsebgp_bgp_open_validate(opts, body, body_len, errp);
+    break;
+
+  case PARSEBGP_BGP_TYPE_UPDATE:
+    err = parsebgp_bgp_update_validate(opts, body, body_len, errp);
+    break;
+
+  case PARSEBGP_BGP_TYPE_NOTIFICATION:
+    // Error Code, Error Subcode
+    PARSEBGP_VALIDATE_ASSERT(errp, body, body_len >= 2);
+    break;
+
+  case PARSEBGP_BGP_TYPE_KEEPALIVE:
+    // no data
+    PARSEBGP_VALIDATE_ASSERT(errp, body, body_len == 0);
+    break;
+
+  case PARSEBGP_BGP_TYPE_ROUTE_REFRESH:
+    // AFI, Subtype, SAFI
+    PARSEBGP_VALIDATE_ASSERT(errp, body, body_len >= 4);
+    break;
+
+  default:
+    PARSEBGP_VALIDATE_ERR(errp, buf + hdr_len - 1, PARSEBGP_INVALID_MSG);
+  }
+  if (err != PARSEBGP_OK) {
+    return err;
+  }
+
+  *len = msg_len;
+  return PARSEBGP_OK;
+}
+
 void parsebgp_bgp_destroy_msg(parsebgp_bgp_msg_t *msg)
 {
   if (msg == NULL) {
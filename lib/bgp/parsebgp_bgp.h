@@ -139,6 +139,21 @@ parsebgp_error_t parsebgp_bgp_decode_ext(parsebgp_opts_t *opts,
  *
  * @param msg           Pointer to message structure to destroy
  */
+/**
+ * Validate the structure of a BGP message without decoding it
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] buffer   Buffer containing the raw BGP message
+ * @param [in,out] len  Number of bytes in buffer. Updated with the length of
+ *                      the message if it is valid
+ * @param [out] errp    Set to the position of the first error on failure
+ * @return PARSEBGP_OK (0) if the message is well-formed, or an error code
+ * otherwise
+ */
+parsebgp_error_t parsebgp_bgp_validate(parsebgp_opts_t *opts,
+                                       const uint8_t *buffer, size_t *len,
+                                       const uint8_t **errp);
+
 void parsebgp_bgp_destroy_msg(parsebgp_bgp_msg_t *msg);
 
 /** Clear the given BGP message structure ready for reuse
@@ -41,5 +41,8 @@ void parsebgp_bgp_prefixes_dump(parsebgp_bgp_prefix_t *prefixes,
     PARSEBGP_DUMP_INT(depth, "AFI", tuple->afi);
     PARSEBGP_DUMP_INT(depth, "SAFI", tuple->safi);
     PARSEBGP_DUMP_PFX(depth, "Prefix", tuple->afi, tuple->addr, tuple->len);
+    if (tuple->path_id_valid) {
+      PARSEBGP_DUMP_INT(depth, "Path ID", tuple->path_id);
+    }
   }
 }
@@ -106,6 +106,12 @@ typedef struct parsebgp_bgp_prefix {
   /** Prefix Address */
   uint8_t addr[16];
 
+  /** Is the Path Identifier set? (i.e., was the NLRI ADD-PATH encoded) */
+  uint8_t path_id_valid;
+
+  /** ADD-PATH Path Identifier (RFC 7911) */
+  uint32_t path_id;
+
 } parsebgp_bgp_prefix_t;
 
 #ifdef __cplusplus
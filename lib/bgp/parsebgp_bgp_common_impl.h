@@ -28,6 +28,25 @@
 #define __PARSEBGP_BGP_COMMON_IMPL_H
 
 #include "parsebgp_bgp_common.h"
+#include "parsebgp_bgp_opts.h"
+
+/**
+ * The ADD-PATH flag (parsebgp_bgp_add_path_flags_t) for the given AFI/SAFI, or
+ * 0 if ADD-PATH is not supported for them
+ */
+#define PARSEBGP_BGP_ADD_PATH_FLAG(afi, safi)                                  \
+  ((((afi) == PARSEBGP_BGP_AFI_IPV4 || (afi) == PARSEBGP_BGP_AFI_IPV6) &&      \
+    ((safi) == PARSEBGP_BGP_SAFI_UNICAST ||                                    \
+     (safi) == PARSEBGP_BGP_SAFI_MULTICAST))                                   \
+     ? (1 << (((afi)-1) * 2 + ((safi)-1)))                                     \
+     : 0)
+
+/**
+ * Are NLRI of the given AFI/SAFI ADD-PATH encoded?
+ */
+#define PARSEBGP_BGP_ADD_PATH(opts, afi, safi)                                 \
+  ((opts)->bgp.add_path != 0 &&                                                \
+   ((opts)->bgp.add_path & PARSEBGP_BGP_ADD_PATH_FLAG(afi, safi)) != 0)
 
 /**
  * Dump a human-readable version of the given array of prefixes to stdout
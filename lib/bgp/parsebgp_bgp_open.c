@@ -38,9 +38,23 @@ static parsebgp_error_t parse_capabilities(parsebgp_opts_t *opts,
 {
   size_t len = *lenp, nread = 0;
   parsebgp_bgp_open_capability_t *cap;
+  uint8_t cap_len;
 
   while ((remain - nread) > 0) {
 
+    // has the user enabled the filter, and have they (implicitly) filtered out
+    // this capability
+    if (opts->bgp.capability_filter_enabled) {
+      PARSEBGP_DESERIALIZE_CHECK(len, nread, 2);
+      if (opts->bgp.capability_filter[buf[0]] == 0) {
+        cap_len = buf[1];
+        nread += 2;
+        buf += 2;
+        PARSEBGP_SKIP_SECTION(buf, len, nread, cap_len);
+        continue;
+      }
+    }
+
     PARSEBGP_MAYBE_REALLOC(msg->capabilities,
       msg->_capabilities_alloc_cnt, msg->capabilities_cnt + 1);
     cap = &msg->capabilities[msg->capabilities_cnt++];
@@ -102,6 +116,7 @@ static parsebgp_error_t parse_capabilities(parsebgp_opts_t *opts,
     case PARSEBGP_BGP_OPEN_CAPABILITY_OUTBOUND_FILTER:
     case PARSEBGP_BGP_OPEN_CAPABILITY_GRACEFUL_RESTART:
     case PARSEBGP_BGP_OPEN_CAPABILITY_MULTI_SESSION:
+    case PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH:
     case PARSEBGP_BGP_OPEN_CAPABILITY_LLGR:
     default:
       if (cap->len == 0) {
@@ -190,13 +205,18 @@ parsebgp_error_t parsebgp_bgp_open_decode(parsebgp_opts_t *opts,
   }
 
   // Parse the capabilities
-  slen = len - nread;
-  if ((err = parse_params(opts, msg, buf, &slen, (remain - nread))) !=
-      PARSEBGP_OK) {
-    return err;
+  if (PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BGP_OPEN_CAPS)) {
+    slen = len - nread;
+    if ((err = parse_params(opts, msg, buf, &slen, (remain - nread))) !=
+        PARSEBGP_OK) {
+      return err;
+    }
+    nread += slen;
+    buf += slen;
+  } else {
+    msg->capabilities_cnt = 0;
+    PARSEBGP_SKIP_SECTION(buf, len, nread, msg->param_len);
   }
-  nread += slen;
-  buf += slen;
 
   if (nread != remain) {
     fprintf(stderr, "ERROR: Trailing data after OPEN Capabilities.\n");
@@ -207,6 +227,77 @@ parsebgp_error_t parsebgp_bgp_open_decode(parsebgp_opts_t *opts,
   return PARSEBGP_OK;
 }
 
+static parsebgp_error_t validate_capabilities(const uint8_t *buf, size_t len,
+                                              const uint8_t **errp)
+{
+  size_t nread = 0;
+  uint8_t code, cap_len;
+
+  while (nread < len) {
+    // Code, Length
+    PARSEBGP_VALIDATE_ASSERT(errp, buf, len - nread >= 2);
+    code = buf[0];
+    cap_len = buf[1];
+    PARSEBGP_VALIDATE_ASSERT(errp, buf, cap_len <= len - nread - 2);
+
+    switch (code) {
+    case PARSEBGP_BGP_OPEN_CAPABILITY_MPBGP:
+    case PARSEBGP_BGP_OPEN_CAPABILITY_AS4:
+      PARSEBGP_VALIDATE_ASSERT(errp, buf, cap_len == 4);
+      break;
+
+    case PARSEBGP_BGP_OPEN_CAPABILITY_ROUTE_REFRESH:
+    case PARSEBGP_BGP_OPEN_CAPABILITY_ROUTE_REFRESH_ENHANCED:
+    case PARSEBGP_BGP_OPEN_CAPABILITY_ROUTE_REFRESH_OLD:
+      PARSEBGP_VALIDATE_ASSERT(errp, buf, cap_len == 0);
+      break;
+
+    default:
+      break;
+    }
+
+    nread += 2 + cap_len;
+    buf += 2 + cap_len;
+  }
+
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_bgp_open_validate(parsebgp_opts_t *opts,
+                                            const uint8_t *buf, size_t len,
+                                            const uint8_t **errp)
+{
+  size_t nread = 0;
+  uint8_t param_len, type;
+  parsebgp_error_t err;
+
+  // Version, ASN, Hold Time, BGP ID, Parameters Length
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= 10);
+  param_len = buf[9];
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + 9, param_len == len - 10);
+  nread += 10;
+  buf += 10;
+
+  while (nread < len) {
+    // Parameter Type, Length
+    PARSEBGP_VALIDATE_ASSERT(errp, buf, len - nread >= 2);
+    type = buf[0];
+    param_len = buf[1];
+    PARSEBGP_VALIDATE_ASSERT(errp, buf, param_len <= len - nread - 2);
+
+    if (type == 2 &&
+        (err = validate_capabilities(buf + 2, param_len, errp)) !=
+          PARSEBGP_OK) {
+      return err;
+    }
+
+    nread += 2 + param_len;
+    buf += 2 + param_len;
+  }
+
+  return PARSEBGP_OK;
+}
+
 void parsebgp_bgp_open_destroy(parsebgp_bgp_open_t *msg)
 {
   if (msg == NULL) {
@@ -57,7 +57,8 @@ typedef enum {
   /** Multisession BGP Capability */
   PARSEBGP_BGP_OPEN_CAPABILITY_MULTI_SESSION = 68,
 
-  // TODO: add ADD-PATH capability
+  /** ADD-PATH Capability (raw data: AFI/SAFI/Send-Receive tuples) */
+  PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH = 69,
 
   /** Enhanced Route Refresh Capability */
   PARSEBGP_BGP_OPEN_CAPABILITY_ROUTE_REFRESH_ENHANCED = 70,
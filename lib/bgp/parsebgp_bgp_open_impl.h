@@ -38,6 +38,20 @@ parsebgp_error_t parsebgp_bgp_open_decode(parsebgp_opts_t *opts,
                                           const uint8_t *buf, size_t *lenp,
                                           size_t remain);
 
+/**
+ * Validate the structure of an OPEN message without decoding it
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] buf      Pointer to the start of the OPEN message body
+ * @param [in] len      Length of the OPEN message body
+ * @param [out] errp    Set to the position of the first error on failure
+ * @return PARSEBGP_OK (0) if the message is well-formed, or an error code
+ * otherwise
+ */
+parsebgp_error_t parsebgp_bgp_open_validate(parsebgp_opts_t *opts,
+                                            const uint8_t *buf, size_t len,
+                                            const uint8_t **errp);
+
 /** Destroy an OPEN message */
 void parsebgp_bgp_open_destroy(parsebgp_bgp_open_t *msg);
 
@@ -33,6 +33,28 @@
 extern "C" {
 #endif
 
+/**
+ * ADD-PATH AFI/SAFI flags (see the add_path option)
+ */
+typedef enum {
+
+  /** IPv4 Unicast NLRI carry Path Identifiers */
+  PARSEBGP_BGP_ADD_PATH_IPV4_UNICAST = 0x01,
+
+  /** IPv4 Multicast NLRI carry Path Identifiers */
+  PARSEBGP_BGP_ADD_PATH_IPV4_MULTICAST = 0x02,
+
+  /** IPv6 Unicast NLRI carry Path Identifiers */
+  PARSEBGP_BGP_ADD_PATH_IPV6_UNICAST = 0x04,
+
+  /** IPv6 Multicast NLRI carry Path Identifiers */
+  PARSEBGP_BGP_ADD_PATH_IPV6_MULTICAST = 0x08,
+
+  /** All supported NLRI carry Path Identifiers */
+  PARSEBGP_BGP_ADD_PATH_ALL = 0x0F,
+
+} parsebgp_bgp_add_path_flags_t;
+
 /**
  * BGP Parsing Options
  */
@@ -66,6 +88,16 @@ typedef struct parsebgp_bgp_opts {
    */
   int asn_4_byte;
 
+  /**
+   * Has asn_4_byte been set from the capabilities negotiated for the session?
+   *
+   * Unless this is set, an AS_PATH that cannot be decoded using 4-byte AS
+   * numbers is decoded again using 2-byte AS numbers (in case asn_4_byte was
+   * set incorrectly). This is set by the parser when it knows the session (see
+   * the sessions option).
+   */
+  int asn_4_byte_negotiated;
+
   /**
    * Has the AFI and SAFI been omitted from the MP_REACH attribute?
    *
@@ -85,6 +117,40 @@ typedef struct parsebgp_bgp_opts {
    */
   uint8_t safi;
 
+  /**
+   * Merge the AS4_PATH attribute into the AS_PATH attribute?
+   *
+   * If set, the effective AS path (RFC6793 section 4.2.3), along with its
+   * origin ASN, first hop ASN and length, is computed while decoding the Path
+   * Attributes, and stored in the as_path_merged field of
+   * parsebgp_bgp_update_path_attrs_t. The AS_PATH and AS4_PATH attributes
+   * themselves are left as they were decoded.
+   */
+  int as_path_merge;
+
+  /**
+   * Compute fingerprints of the Path Attributes?
+   *
+   * If set, 64-bit hashes of each Path Attribute, the whole Path Attributes
+   * data, the AS path and the community attributes are computed while the
+   * Path Attributes are being decoded (see the fingerprint field of
+   * parsebgp_bgp_update_path_attr_t and the fingerprints field of
+   * parsebgp_bgp_update_path_attrs_t).
+   */
+  int fingerprint;
+
+  /**
+   * Which NLRI are encoded with ADD-PATH Path Identifiers (RFC 7911)?
+   *
+   * This is a bitmask of parsebgp_bgp_add_path_flags_t flags, one per
+   * AFI/SAFI. Since the encoding cannot be reliably detected from the NLRI
+   * themselves, it must be known up front: the MRT parser sets this for the
+   * *_ADDPATH subtypes (RFC 8050), and the BMP and MRT parsers set it from the
+   * capabilities negotiated for the session (see the sessions option). Users
+   * decoding raw BGP messages must set it themselves.
+   */
+  uint8_t add_path;
+
   /**
    * Should only some UPDATE Path Attributes be parsed?
    *
@@ -132,6 +198,37 @@ typedef struct parsebgp_bgp_opts {
    */
   uint8_t path_attr_raw[UINT8_MAX];
 
+  /**
+   * Should only some OPEN Capabilities be parsed?
+   *
+   * If this is set, the capability_filter array is checked for each OPEN
+   * Capability code (CODE) found. If capability_filter[CODE] is set, then the
+   * Capability is parsed, otherwise it is skipped (and does not appear in the
+   * parsed capabilities array).
+   */
+  int capability_filter_enabled;
+
+  /**
+   * OPEN Capability Filter array.
+   *
+   * There is one flag per Capability Code, indicating whether the given
+   * Capability should be parsed (see documentation for
+   * capability_filter_enabled for more information).
+   */
+  uint8_t capability_filter[UINT8_MAX + 1];
+
+  /**
+   * Path Attribute handler registry
+   *
+   * If this is NULL (the default), the built-in handlers are used to decode
+   * UPDATE Path Attributes. Otherwise, attributes are decoded using the
+   * handlers in the given registry (see
+   * parsebgp_bgp_update_path_attr_registry_create), which allows applications
+   * to add decoders for attribute types that the library does not support, or
+   * to replace the built-in decoders.
+   */
+  const struct parsebgp_bgp_update_path_attr_registry *path_attr_registry;
+
 } parsebgp_bgp_opts_t;
 
 /**
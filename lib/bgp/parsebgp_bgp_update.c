@@ -24,22 +24,28 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "parsebgp_attr_cache_impl.h"
 #include "parsebgp_bgp_common_impl.h"
 #include "parsebgp_bgp_update_impl.h"
 #include "parsebgp_error.h"
 #include "parsebgp_utils.h"
+#include "parsebgp_filter_impl.h"
 #include "parsebgp_bgp_update_ext_communities_impl.h"
 #include "parsebgp_bgp_update_mp_reach_impl.h"
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-static parsebgp_error_t parse_nlris(parsebgp_bgp_update_nlris_t *nlris,
+static parsebgp_error_t parse_nlris(parsebgp_opts_t *opts,
+                                    parsebgp_bgp_update_nlris_t *nlris,
                                     const uint8_t *buf, size_t *lenp, size_t remain)
 {
   size_t len = *lenp, nread = 0, slen, parsable;
   parsebgp_bgp_prefix_t *tuple;
   parsebgp_error_t err;
+  int add_path =
+    PARSEBGP_BGP_ADD_PATH(opts, PARSEBGP_BGP_AFI_IPV4, PARSEBGP_BGP_SAFI_UNICAST);
 
   nlris->prefixes_cnt = 0;
 
@@ -64,8 +70,22 @@ static parsebgp_error_t parse_nlris(parsebgp_bgp_update_nlris_t *nlris,
     tuple->safi = PARSEBGP_BGP_SAFI_UNICAST;
     size_t max_pfx = 32;
 
-    // Read the prefix length
-    PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, tuple->len);
+    // Path Identifier (RFC 7911)
+    tuple->path_id_valid = add_path;
+    if (add_path) {
+      if ((parsable - nread) <= sizeof(tuple->path_id)) {
+        if (nlris->len <= len) {
+          // the path identifier runs past the end of the nlris
+          PARSEBGP_RETURN_INVALID_MSG_ERR;
+        }
+        return PARSEBGP_PARTIAL_MSG;
+      }
+      PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, parsable, nread,
+                                            tuple->path_id);
+    }
+
+    // Read the prefix length (nread < parsable <= len, so it is present)
+    PARSEBGP_DESERIALIZE_UINT8_UNCHECKED(buf, parsable, nread, tuple->len);
 
     // Prefix
     slen = parsable - nread;
@@ -77,9 +97,12 @@ static parsebgp_error_t parse_nlris(parsebgp_bgp_update_nlris_t *nlris,
       }
       return err;
     }
-    nlris->prefixes_cnt++; // increment now that we have a complete valid nlri
     nread += slen;
     buf += slen;
+    // increment now that we have a complete valid nlri (that we want to keep)
+    if (PARSEBGP_PREFIX_SELECTED(opts, tuple->afi, tuple->addr, tuple->len)) {
+      nlris->prefixes_cnt++;
+    }
   }
 
   if (nread < nlris->len) {
@@ -147,6 +170,7 @@ parse_path_attr_as_path(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
     if ((len - nread) < 2) {
       return PARSEBGP_PARTIAL_MSG;
     }
+    PARSEBGP_ASSERT((remain - nread) >= 2);
 
     // Segment Type
     seg->type = *(buf++);
@@ -160,6 +184,9 @@ parse_path_attr_as_path(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
     if ((len - nread) < (asn_size * seg->asns_cnt)) {
       return PARSEBGP_PARTIAL_MSG;
     }
+    // and don't let a segment run past the end of the attribute (e.g., if we
+    // were given the wrong ASN size)
+    PARSEBGP_ASSERT((remain - nread) >= (asn_size * seg->asns_cnt));
 
     if (seg->type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ) {
       msg->asns_cnt += seg->asns_cnt;
@@ -190,14 +217,15 @@ parse_path_attr_as_path(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
 }
 
 static parsebgp_error_t
-parse_path_attr_as_path_safe(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
+parse_path_attr_as_path_safe(int asn_4_byte, int negotiated,
+                             parsebgp_bgp_update_as_path_t *msg,
                              const uint8_t *buf, size_t *lenp, size_t remain, int raw)
 {
   parsebgp_error_t err;
   // first we try just parsing as-is
   if ((err = parse_path_attr_as_path(asn_4_byte, msg, buf, lenp, remain,
                                      raw)) != PARSEBGP_OK &&
-      asn_4_byte != 0) {
+      asn_4_byte != 0 && !negotiated) {
     // if we've been asked to do 4-byte parsing, then maybe the caller made a
     // mistake
     return parse_path_attr_as_path(0, msg, buf, lenp, remain, raw);
@@ -266,7 +294,7 @@ parse_path_attr_aggregator(int asn_4_byte,
                            parsebgp_bgp_update_aggregator_t *aggregator,
                            const uint8_t *buf, size_t *lenp, size_t remain)
 {
-  size_t len = *lenp, nread = 0;
+  size_t nread = 0;
 
   // infer whether there is a 4-byte or 2-byte ASN in the aggregator attribute
   if (remain == 8) {
@@ -279,13 +307,13 @@ parse_path_attr_aggregator(int asn_4_byte,
 
   // Aggregator ASN
   if (asn_4_byte) {
-    PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, aggregator->asn);
+    PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, remain, nread, aggregator->asn);
   } else {
-    PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, aggregator->asn);
+    PARSEBGP_DESERIALIZE_UINT16_UNCHECKED(buf, remain, nread, aggregator->asn);
   }
 
   // Aggregator IP Address (IPv4-only)
-  PARSEBGP_DESERIALIZE_VAL(buf, len, nread, aggregator->addr);
+  PARSEBGP_DESERIALIZE_VAL_UNCHECKED(buf, remain, nread, aggregator->addr);
 
   *lenp = nread;
   return PARSEBGP_OK;
@@ -295,7 +323,7 @@ static parsebgp_error_t
 parse_path_attr_communities(parsebgp_bgp_update_communities_t *msg,
                             const uint8_t *buf, size_t *lenp, size_t remain, int raw)
 {
-  size_t len = *lenp, nread = 0;
+  size_t nread = 0;
   int i;
 
   msg->communities_cnt = remain / sizeof(uint32_t);
@@ -311,7 +339,8 @@ parse_path_attr_communities(parsebgp_bgp_update_communities_t *msg,
   PARSEBGP_MAYBE_REALLOC(msg->communities,
                          msg->_communities_alloc_cnt, msg->communities_cnt);
   for (i = 0; i < msg->communities_cnt; i++) {
-    PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, msg->communities[i]);
+    PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, remain, nread,
+                                          msg->communities[i]);
   }
 
   *lenp = nread;
@@ -356,7 +385,7 @@ static parsebgp_error_t
 parse_path_attr_cluster_list(parsebgp_bgp_update_cluster_list_t *msg,
                              const uint8_t *buf, size_t *lenp, size_t remain)
 {
-  size_t len = *lenp, nread = 0;
+  size_t nread = 0;
   int i;
 
   msg->cluster_ids_cnt = remain / sizeof(uint32_t);
@@ -366,7 +395,8 @@ parse_path_attr_cluster_list(parsebgp_bgp_update_cluster_list_t *msg,
 
   for (i = 0; i < msg->cluster_ids_cnt; i++) {
     PARSEBGP_ASSERT((remain - nread) >= sizeof(uint32_t));
-    PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, msg->cluster_ids[i]);
+    PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, remain, nread,
+                                          msg->cluster_ids[i]);
   }
 
   *lenp = nread;
@@ -425,7 +455,7 @@ static parsebgp_error_t
 parse_path_attr_large_communities(parsebgp_bgp_update_large_communities_t *msg,
                                   const uint8_t *buf, size_t *lenp, size_t remain)
 {
-  size_t len = *lenp, nread = 0;
+  size_t nread = 0;
   int i;
   parsebgp_bgp_update_large_community_t *comm;
 #define LARGE_COMM_LEN 12
@@ -441,13 +471,14 @@ parse_path_attr_large_communities(parsebgp_bgp_update_large_communities_t *msg,
     comm = &msg->communities[i];
 
     // Global Admin
-    PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, comm->global_admin);
+    PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, remain, nread,
+                                          comm->global_admin);
 
     // Local Data Part 1
-    PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, comm->local_1);
+    PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, remain, nread, comm->local_1);
 
     // Local Data Part 2
-    PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, comm->local_2);
+    PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, remain, nread, comm->local_2);
   }
 
   *lenp = nread;
@@ -492,481 +523,1453 @@ dump_attr_large_communities(const parsebgp_bgp_update_large_communities_t *msg,
   fputs("\n", stdout);
 }
 
-parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
-  parsebgp_opts_t *opts, parsebgp_bgp_update_path_attrs_t *path_attrs,
-  const uint8_t *buf, size_t *lenp, size_t remain)
-{
-  size_t len = *lenp, nread = 0, slen = 0;
-  parsebgp_bgp_update_path_attr_t *attr;
-  uint8_t flags_tmp, type_tmp;
-  uint16_t len_tmp;
-  parsebgp_error_t err = PARSEBGP_OK;
+#define RAW(opts, attr) \
+    (opts->bgp.path_attr_raw_enabled && opts->bgp.path_attr_raw[attr->type])
 
-  path_attrs->attrs_cnt = 0;
+// Path Attribute handlers. Each decode function is given exactly the attribute
+// data (remain == attr->len), and must set *lenp to the number of bytes read.
+// The attribute data is known to be entirely within the buffer (the path
+// attributes decoder has already checked this), so fields bounded by remain
+// may be read using the unchecked deserialization macros.
+
+// Type 1:
+static parsebgp_error_t decode_attr_origin(parsebgp_opts_t *opts,
+                                           parsebgp_bgp_update_path_attr_t *attr,
+                                           const uint8_t *buf, size_t *lenp,
+                                           size_t remain)
+{
+  size_t nread = 0;
+  PARSEBGP_ASSERT(remain == sizeof(attr->data.origin));
+  PARSEBGP_DESERIALIZE_UINT8_UNCHECKED(buf, remain, nread, attr->data.origin);
+  *lenp = nread;
+  return PARSEBGP_OK;
+}
 
-  // Path Attributes Length
-  PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, path_attrs->len);
+static void dump_attr_origin(const parsebgp_bgp_update_path_attr_t *attr,
+                             int depth)
+{
+  PARSEBGP_DUMP_INT(depth, "ORIGIN", attr->data.origin);
+}
 
-  if (nread + path_attrs->len > len) {
-    // TODO: parse what we can, so that the caller can return
-    // PARSEBGP_TRUNCATED_MSG with as much data as possible?  (OTOH, if the
-    // caller can't return PARSEBGP_TRUNCATED_MSG, then we will have done all
-    // that parsing for nothing, when we maybe just needed a buffer refill.)
-    return PARSEBGP_PARTIAL_MSG;
-  }
-  PARSEBGP_ASSERT(nread + path_attrs->len <= remain);
-  remain = nread + path_attrs->len; // remaining within path attributes
+// Type 2:
+static parsebgp_error_t
+decode_attr_as_path(parsebgp_opts_t *opts,
+                    parsebgp_bgp_update_path_attr_t *attr, const uint8_t *buf,
+                    size_t *lenp, size_t remain)
+{
+  PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.as_path);
+  return parse_path_attr_as_path_safe(
+    opts->bgp.asn_4_byte, opts->bgp.asn_4_byte_negotiated, attr->data.as_path,
+    buf, lenp, remain, RAW(opts, attr));
+}
 
-  // read until we run out of attributes
-  while (nread < remain) {
+// Types 2 and 17:
+static void
+handler_destroy_attr_as_path(parsebgp_bgp_update_path_attr_t *attr)
+{
+  destroy_attr_as_path(attr->data.as_path);
+}
 
-    /* Optimization: the vast majority of cases will short-circuit after the
-     * <4 condition. */
-    if ((remain - nread < 4) &&
-      ((*buf & PARSEBGP_BGP_PATH_ATTR_FLAG_EXTENDED) || remain - nread < 3))
-    {
-      /* The remaining data in Path Attributes is insufficient to encode a
-         single minimum-sized path attribute, and should be considered as
-         "treat-as-withdraw" (https://tools.ietf.org/html/rfc7606#section-4).
-       */
-      PARSEBGP_SKIP_INVALID_MSG(opts, buf, nread, 0,
-        "Path attribute requires at least 3-4 bytes, but only %d bytes remain.",
-        (int)(remain - nread));
-      // If we pass the above macro, the user wants us to struggle on.
-      *lenp = remain;
-      return PARSEBGP_OK;
-    }
+static void handler_clear_attr_as_path(parsebgp_bgp_update_path_attr_t *attr)
+{
+  clear_attr_as_path(attr->data.as_path);
+}
 
-    /* Optimization: since the length was already checked above, we can skip
-     * the PARSEBGP_DESERIALIZE_* calls and read the buf directly. */
-    flags_tmp = *(buf++); // Attribute Flags
-    type_tmp = *(buf++);  // Attribute Type
-    if (flags_tmp & PARSEBGP_BGP_PATH_ATTR_FLAG_EXTENDED) {
-      len_tmp = nptohs(buf); // Attribute Length
-      buf += 2;
-      nread += 4;
-    } else {
-      len_tmp = *buf; // Attribute Length
-      buf += 1;
-      nread += 3;
-    }
+static void
+handler_dump_attr_as_path(const parsebgp_bgp_update_path_attr_t *attr,
+                          int depth)
+{
+  dump_attr_as_path(attr->data.as_path, depth);
+}
 
-    if (len_tmp > (remain - nread)) {
-      /* The length of the path attribute would cause the Total Attribute
-         Length to be exceeded, and should be considered as
-         "treat-as-withdraw" (https://tools.ietf.org/html/rfc7606#section-4).
-       */
-      PARSEBGP_SKIP_INVALID_MSG(
-        opts, buf, nread, 0,
-        "Path attribute (type %d) has length %d, but only %d bytes remain.",
-        type_tmp, len_tmp, (int)(remain - nread));
-      // If we pass the above macro, the user wants us to struggle on.
-      *lenp = remain;
-      return PARSEBGP_OK;
-    }
+// Type 3:
+static parsebgp_error_t
+decode_attr_next_hop(parsebgp_opts_t *opts,
+                     parsebgp_bgp_update_path_attr_t *attr, const uint8_t *buf,
+                     size_t *lenp, size_t remain)
+{
+  size_t nread = 0;
+  PARSEBGP_ASSERT(remain == sizeof(attr->data.next_hop));
+  PARSEBGP_DESERIALIZE_VAL_UNCHECKED(buf, remain, nread, attr->data.next_hop);
+  *lenp = nread;
+  return PARSEBGP_OK;
+}
 
-    // if this type is beyond the max type that we understand, skip it now
-    if (type_tmp >= PARSEBGP_BGP_PATH_ATTRS_LEN) {
-      PARSEBGP_SKIP_NOT_IMPLEMENTED(
-        opts, buf, nread, len_tmp,
-        "BGP UPDATE Path Attribute %d is not yet implemented", type_tmp);
-      continue;
-    }
+static void dump_attr_next_hop(const parsebgp_bgp_update_path_attr_t *attr,
+                               int depth)
+{
+  PARSEBGP_DUMP_IP(depth, "Next Hop", PARSEBGP_BGP_AFI_IPV4,
+                   attr->data.next_hop);
+}
 
-    // has the user enabled the filter, and have they (implicitly) filtered out
-    // this type of attribute
-    if (opts->bgp.path_attr_filter_enabled &&
-        opts->bgp.path_attr_filter[type_tmp] == 0) {
-      // they don't want it. skip over the rest of the attribute
-      nread += len_tmp;
-      buf += len_tmp;
-      continue;
-    }
+// Type 4:
+static parsebgp_error_t decode_attr_med(parsebgp_opts_t *opts,
+                                        parsebgp_bgp_update_path_attr_t *attr,
+                                        const uint8_t *buf, size_t *lenp,
+                                        size_t remain)
+{
+  size_t nread = 0;
+  PARSEBGP_ASSERT(remain == sizeof(attr->data.med));
+  PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, remain, nread, attr->data.med);
+  *lenp = nread;
+  return PARSEBGP_OK;
+}
 
-    attr = &path_attrs->attrs[type_tmp];
-    if (attr->type != 0) {
-      assert(attr->type == type_tmp);
+static void dump_attr_med(const parsebgp_bgp_update_path_attr_t *attr,
+                          int depth)
+{
+  PARSEBGP_DUMP_INT(depth, "MED", attr->data.med);
+}
 
-      fprintf(stderr, "WARN: Duplicate Path Attribute (%d) found. Skipping\n",
-              type_tmp);
-      nread += len_tmp;
-      buf += len_tmp;
-      continue;
-    }
+// Type 5:
+static parsebgp_error_t
+decode_attr_local_pref(parsebgp_opts_t *opts,
+                       parsebgp_bgp_update_path_attr_t *attr,
+                       const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  size_t nread = 0;
+  PARSEBGP_ASSERT(remain == sizeof(attr->data.local_pref));
+  PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, remain, nread,
+                                        attr->data.local_pref);
+  *lenp = nread;
+  return PARSEBGP_OK;
+}
 
-    PARSEBGP_MAYBE_REALLOC(path_attrs->attrs_used,
-                           path_attrs->_attrs_used_alloc_cnt,
-                           path_attrs->attrs_cnt + 1);
-    path_attrs->attrs_used[path_attrs->attrs_cnt] = type_tmp;
-    path_attrs->attrs_cnt++;
+static void dump_attr_local_pref(const parsebgp_bgp_update_path_attr_t *attr,
+                                 int depth)
+{
+  PARSEBGP_DUMP_INT(depth, "LOCAL_PREF", attr->data.local_pref);
+}
 
-    // Attribute Flags
-    attr->flags = flags_tmp;
+// Type 6:
+static parsebgp_error_t
+decode_attr_atomic_aggregate(parsebgp_opts_t *opts,
+                             parsebgp_bgp_update_path_attr_t *attr,
+                             const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  // zero-length attr
+  *lenp = 0;
+  return PARSEBGP_OK;
+}
 
-    // Attribute Type
-    attr->type = type_tmp;
+static void
+dump_attr_atomic_aggregate(const parsebgp_bgp_update_path_attr_t *attr,
+                           int depth)
+{
+  PARSEBGP_DUMP_INFO(depth, "ATOMIC_AGGREGATE\n");
+}
 
-    // Attribute Length
-    attr->len = len_tmp;
+// Type 7:
+static parsebgp_error_t
+decode_attr_aggregator(parsebgp_opts_t *opts,
+                       parsebgp_bgp_update_path_attr_t *attr,
+                       const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  return parse_path_attr_aggregator(opts->bgp.asn_4_byte,
+                                    &attr->data.aggregator, buf, lenp, remain);
+}
 
-#define RAW(opts, attr) \
-    (opts->bgp.path_attr_raw_enabled && opts->bgp.path_attr_raw[attr->type])
+// Types 7 and 18:
+static void dump_attr_aggregator(const parsebgp_bgp_update_path_attr_t *attr,
+                                 int depth)
+{
+  PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_update_aggregator_t, depth);
+  PARSEBGP_DUMP_INT(depth, "ASN", attr->data.aggregator.asn);
+  PARSEBGP_DUMP_IP(depth, "IP", PARSEBGP_BGP_AFI_IPV4,
+                   attr->data.aggregator.addr);
+}
 
-    slen = len - nread;
-    switch (attr->type) {
+// Type 8:
+static parsebgp_error_t
+decode_attr_communities(parsebgp_opts_t *opts,
+                        parsebgp_bgp_update_path_attr_t *attr,
+                        const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.communities);
+  return parse_path_attr_communities(attr->data.communities, buf, lenp, remain,
+                                     RAW(opts, attr));
+}
 
-    // NOTE: when adding new types, ensure slen is set to the number of bytes
-    // read so that assert at the bottom is useful
+static void
+handler_destroy_attr_communities(parsebgp_bgp_update_path_attr_t *attr)
+{
+  destroy_attr_communities(attr->data.communities);
+}
 
-    // Type 1:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN:
-      PARSEBGP_ASSERT(attr->len == sizeof(attr->data.origin));
-      PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, attr->data.origin);
-      slen = sizeof(attr->data.origin);
-      break;
+static void
+handler_clear_attr_communities(parsebgp_bgp_update_path_attr_t *attr)
+{
+  clear_attr_communities(attr->data.communities);
+}
 
-    // Type 2:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
-      PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.as_path);
-      if ((err = parse_path_attr_as_path_safe(opts->bgp.asn_4_byte,
-                                              attr->data.as_path, buf, &slen,
-                                              attr->len, RAW(opts, attr)))
-                                              != PARSEBGP_OK) {
-        return err;
-      }
-      nread += slen;
-      buf += slen;
-      break;
+static void
+handler_dump_attr_communities(const parsebgp_bgp_update_path_attr_t *attr,
+                              int depth)
+{
+  dump_attr_communities(attr->data.communities, depth);
+}
 
-    // Type 3:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_NEXT_HOP:
-      PARSEBGP_ASSERT(attr->len == sizeof(attr->data.next_hop));
-      PARSEBGP_DESERIALIZE_VAL(buf, len, nread, attr->data.next_hop);
-      slen = sizeof(attr->data.next_hop);
-      break;
+// Type 9:
+static parsebgp_error_t
+decode_attr_originator_id(parsebgp_opts_t *opts,
+                          parsebgp_bgp_update_path_attr_t *attr,
+                          const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  size_t nread = 0;
+  PARSEBGP_ASSERT(remain == sizeof(attr->data.originator_id));
+  PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, remain, nread,
+                                        attr->data.originator_id);
+  *lenp = nread;
+  return PARSEBGP_OK;
+}
 
-    // Type 4:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MED:
-      PARSEBGP_ASSERT(attr->len == sizeof(attr->data.med));
-      PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, attr->data.med);
-      slen = sizeof(attr->data.med);
-      break;
+static void
+dump_attr_originator_id(const parsebgp_bgp_update_path_attr_t *attr, int depth)
+{
+  PARSEBGP_DUMP_INT(depth, "ORIGINATOR_ID", attr->data.originator_id);
+}
 
-    // Type 5:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_LOCAL_PREF:
-      PARSEBGP_ASSERT(attr->len == sizeof(attr->data.local_pref));
-      PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, attr->data.local_pref);
-      slen = sizeof(attr->data.local_pref);
-      break;
+// Type 10:
+static parsebgp_error_t
+decode_attr_cluster_list(parsebgp_opts_t *opts,
+                         parsebgp_bgp_update_path_attr_t *attr,
+                         const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.cluster_list);
+  return parse_path_attr_cluster_list(attr->data.cluster_list, buf, lenp,
+                                      remain);
+}
 
-    // Type 6:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ATOMIC_AGGREGATE:
-      // zero-length attr
-      slen = 0;
-      break;
+static void
+handler_destroy_attr_cluster_list(parsebgp_bgp_update_path_attr_t *attr)
+{
+  destroy_attr_cluster_list(attr->data.cluster_list);
+}
 
-    // Type 7
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR:
-      if ((err = parse_path_attr_aggregator(opts->bgp.asn_4_byte,
-                                            &attr->data.aggregator, buf, &slen,
-                                            attr->len)) != PARSEBGP_OK) {
-        return err;
-      }
-      nread += slen;
-      buf += slen;
-      break;
+static void
+handler_clear_attr_cluster_list(parsebgp_bgp_update_path_attr_t *attr)
+{
+  clear_attr_cluster_list(attr->data.cluster_list);
+}
 
-    // Type 8
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES:
-      PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.communities);
-      if ((err = parse_path_attr_communities(attr->data.communities, buf, &slen,
-                                             attr->len, RAW(opts, attr)))
-                                             != PARSEBGP_OK) {
-        return err;
-      }
-      nread += slen;
-      buf += slen;
-      break;
+static void
+handler_dump_attr_cluster_list(const parsebgp_bgp_update_path_attr_t *attr,
+                               int depth)
+{
+  dump_attr_cluster_list(attr->data.cluster_list, depth);
+}
 
-    // Type 9
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGINATOR_ID:
-      PARSEBGP_ASSERT(attr->len == sizeof(attr->data.originator_id));
-      PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, attr->data.originator_id);
-      slen = sizeof(attr->data.originator_id);
-      break;
+// Type 14:
+static parsebgp_error_t
+decode_attr_mp_reach(parsebgp_opts_t *opts,
+                     parsebgp_bgp_update_path_attr_t *attr, const uint8_t *buf,
+                     size_t *lenp, size_t remain)
+{
+  PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.mp_reach);
+  return parsebgp_bgp_update_mp_reach_decode(opts, attr->data.mp_reach, buf,
+                                             lenp, remain);
+}
 
-    // Type 10
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST:
-      PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.cluster_list);
-      if ((err = parse_path_attr_cluster_list(
-             attr->data.cluster_list, buf, &slen, attr->len)) != PARSEBGP_OK) {
-        return err;
-      }
-      nread += slen;
-      buf += slen;
-      break;
+static void destroy_attr_mp_reach(parsebgp_bgp_update_path_attr_t *attr)
+{
+  parsebgp_bgp_update_mp_reach_destroy(attr->data.mp_reach);
+}
 
-    //...
+static void clear_attr_mp_reach(parsebgp_bgp_update_path_attr_t *attr)
+{
+  parsebgp_bgp_update_mp_reach_clear(attr->data.mp_reach);
+}
 
-    // Type 14
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI:
-      PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.mp_reach);
-      if ((err = parsebgp_bgp_update_mp_reach_decode(opts, attr->data.mp_reach,
-                                                     buf, &slen, attr->len)) !=
-          PARSEBGP_OK) {
-        return err;
-      }
-      nread += slen;
-      buf += slen;
-      break;
+static void dump_attr_mp_reach(const parsebgp_bgp_update_path_attr_t *attr,
+                               int depth)
+{
+  parsebgp_bgp_update_mp_reach_dump(attr->data.mp_reach, depth);
+}
 
-    // Type 15
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI:
-      PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.mp_unreach);
-      if ((err = parsebgp_bgp_update_mp_unreach_decode(
-             opts, attr->data.mp_unreach, buf, &slen, attr->len)) !=
-          PARSEBGP_OK) {
-        return err;
-      }
-      nread += slen;
-      buf += slen;
-      break;
+// Type 15:
+static parsebgp_error_t
+decode_attr_mp_unreach(parsebgp_opts_t *opts,
+                       parsebgp_bgp_update_path_attr_t *attr,
+                       const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.mp_unreach);
+  return parsebgp_bgp_update_mp_unreach_decode(opts, attr->data.mp_unreach,
+                                               buf, lenp, remain);
+}
 
-    // Type 16
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES:
-      PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.ext_communities);
-      if ((err = parsebgp_bgp_update_ext_communities_decode(
-             opts, attr->data.ext_communities, buf, &slen, attr->len)) !=
-          PARSEBGP_OK) {
-        return err;
-      }
-      nread += slen;
-      buf += slen;
-      break;
+static void destroy_attr_mp_unreach(parsebgp_bgp_update_path_attr_t *attr)
+{
+  parsebgp_bgp_update_mp_unreach_destroy(attr->data.mp_unreach);
+}
 
-    // Type 17
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
-      // same as AS_PATH, but force 4-byte AS parsing
-      PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.as_path);
-      if ((err = parse_path_attr_as_path(1, attr->data.as_path, buf, &slen,
-                                         attr->len, RAW(opts, attr)))
-                                         != PARSEBGP_OK) {
-        return err;
-      }
-      nread += slen;
-      buf += slen;
-      break;
+static void clear_attr_mp_unreach(parsebgp_bgp_update_path_attr_t *attr)
+{
+  parsebgp_bgp_update_mp_unreach_clear(attr->data.mp_unreach);
+}
 
-    // Type 18
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_AGGREGATOR:
-      // same as AGGREGATOR, but force 4-byte AS parsing
-      if ((err = parse_path_attr_aggregator(1, &attr->data.aggregator, buf,
-                                            &slen, attr->len)) != PARSEBGP_OK) {
-        return err;
+static void dump_attr_mp_unreach(const parsebgp_bgp_update_path_attr_t *attr,
+                                 int depth)
+{
+  parsebgp_bgp_update_mp_unreach_dump(attr->data.mp_unreach, depth);
+}
+
+// Type 16:
+static parsebgp_error_t
+decode_attr_ext_communities(parsebgp_opts_t *opts,
+                            parsebgp_bgp_update_path_attr_t *attr,
+                            const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.ext_communities);
+  return parsebgp_bgp_update_ext_communities_decode(
+    opts, attr->data.ext_communities, buf, lenp, remain);
+}
+
+// Types 16 and 25:
+static void
+destroy_attr_ext_communities(parsebgp_bgp_update_path_attr_t *attr)
+{
+  parsebgp_bgp_update_ext_communities_destroy(attr->data.ext_communities);
+}
+
+static void clear_attr_ext_communities(parsebgp_bgp_update_path_attr_t *attr)
+{
+  parsebgp_bgp_update_ext_communities_clear(attr->data.ext_communities);
+}
+
+static void
+dump_attr_ext_communities(const parsebgp_bgp_update_path_attr_t *attr,
+                          int depth)
+{
+  parsebgp_bgp_update_ext_communities_dump(attr->data.ext_communities, depth);
+}
+
+// Type 17:
+static parsebgp_error_t
+decode_attr_as4_path(parsebgp_opts_t *opts,
+                     parsebgp_bgp_update_path_attr_t *attr, const uint8_t *buf,
+                     size_t *lenp, size_t remain)
+{
+  // same as AS_PATH, but force 4-byte AS parsing
+  PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.as_path);
+  return parse_path_attr_as_path(1, attr->data.as_path, buf, lenp, remain,
+                                 RAW(opts, attr));
+}
+
+// Type 18:
+static parsebgp_error_t
+decode_attr_as4_aggregator(parsebgp_opts_t *opts,
+                           parsebgp_bgp_update_path_attr_t *attr,
+                           const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  // same as AGGREGATOR, but force 4-byte AS parsing
+  return parse_path_attr_aggregator(1, &attr->data.aggregator, buf, lenp,
+                                    remain);
+}
+
+// Type 21:
+static parsebgp_error_t
+decode_attr_as_pathlimit(parsebgp_opts_t *opts,
+                         parsebgp_bgp_update_path_attr_t *attr,
+                         const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  return parse_path_attr_as_pathlimit(&attr->data.as_pathlimit, buf, lenp,
+                                      remain);
+}
+
+static void dump_attr_as_pathlimit(const parsebgp_bgp_update_path_attr_t *attr,
+                                   int depth)
+{
+  PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_update_as_pathlimit_t, depth);
+  PARSEBGP_DUMP_INT(depth, "Max # ASNs", attr->data.as_pathlimit.max_asns);
+  PARSEBGP_DUMP_INT(depth, "ASN", attr->data.as_pathlimit.asn);
+}
+
+// Type 25:
+static parsebgp_error_t
+decode_attr_ipv6_ext_communities(parsebgp_opts_t *opts,
+                                 parsebgp_bgp_update_path_attr_t *attr,
+                                 const uint8_t *buf, size_t *lenp,
+                                 size_t remain)
+{
+  PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.ext_communities);
+  return parsebgp_bgp_update_ext_communities_ipv6_decode(
+    opts, attr->data.ext_communities, buf, lenp, remain);
+}
+
+// Type 29:
+static void dump_attr_bgp_ls(const parsebgp_bgp_update_path_attr_t *attr,
+                             int depth)
+{
+  // TODO: add support for BGP-LS
+  PARSEBGP_DUMP_INFO(depth, "BGP-LS Support Not Implemented\n");
+}
+
+// Type 32:
+static parsebgp_error_t
+decode_attr_large_communities(parsebgp_opts_t *opts,
+                              parsebgp_bgp_update_path_attr_t *attr,
+                              const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.large_communities);
+  return parse_path_attr_large_communities(attr->data.large_communities, buf,
+                                           lenp, remain);
+}
+
+static void
+handler_destroy_attr_large_communities(parsebgp_bgp_update_path_attr_t *attr)
+{
+  destroy_attr_large_communities(attr->data.large_communities);
+}
+
+static void
+handler_clear_attr_large_communities(parsebgp_bgp_update_path_attr_t *attr)
+{
+  clear_attr_large_communities(attr->data.large_communities);
+}
+
+static void handler_dump_attr_large_communities(
+  const parsebgp_bgp_update_path_attr_t *attr, int depth)
+{
+  dump_attr_large_communities(attr->data.large_communities, depth);
+}
+
+struct parsebgp_bgp_update_path_attr_registry {
+
+  /** Handlers, indexed by Path Attribute type */
+  parsebgp_bgp_update_path_attr_handler_t handlers[UINT8_MAX + 1];
+
+};
+
+// NOTE: when adding new built-in types, add a handler here. Types without a
+// decode function are skipped as "not implemented".
+static const parsebgp_bgp_update_path_attr_registry_t builtin_registry = {
+  .handlers = {
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN] = {
+      decode_attr_origin, NULL, NULL, dump_attr_origin,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH] = {
+      decode_attr_as_path, handler_clear_attr_as_path,
+      handler_destroy_attr_as_path, handler_dump_attr_as_path,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_NEXT_HOP] = {
+      decode_attr_next_hop, NULL, NULL, dump_attr_next_hop,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_MED] = {
+      decode_attr_med, NULL, NULL, dump_attr_med,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_LOCAL_PREF] = {
+      decode_attr_local_pref, NULL, NULL, dump_attr_local_pref,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_ATOMIC_AGGREGATE] = {
+      decode_attr_atomic_aggregate, NULL, NULL, dump_attr_atomic_aggregate,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR] = {
+      decode_attr_aggregator, NULL, NULL, dump_attr_aggregator,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES] = {
+      decode_attr_communities, handler_clear_attr_communities,
+      handler_destroy_attr_communities, handler_dump_attr_communities,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGINATOR_ID] = {
+      decode_attr_originator_id, NULL, NULL, dump_attr_originator_id,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST] = {
+      decode_attr_cluster_list, handler_clear_attr_cluster_list,
+      handler_destroy_attr_cluster_list, handler_dump_attr_cluster_list,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI] = {
+      decode_attr_mp_reach, clear_attr_mp_reach, destroy_attr_mp_reach,
+      dump_attr_mp_reach,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI] = {
+      decode_attr_mp_unreach, clear_attr_mp_unreach, destroy_attr_mp_unreach,
+      dump_attr_mp_unreach,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES] = {
+      decode_attr_ext_communities, clear_attr_ext_communities,
+      destroy_attr_ext_communities, dump_attr_ext_communities,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH] = {
+      decode_attr_as4_path, handler_clear_attr_as_path,
+      handler_destroy_attr_as_path, handler_dump_attr_as_path,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_AGGREGATOR] = {
+      decode_attr_as4_aggregator, NULL, NULL, dump_attr_aggregator,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATHLIMIT] = {
+      decode_attr_as_pathlimit, NULL, NULL, dump_attr_as_pathlimit,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES] = {
+      decode_attr_ipv6_ext_communities, clear_attr_ext_communities,
+      destroy_attr_ext_communities, dump_attr_ext_communities,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_BGP_LS] = {
+      NULL, NULL, NULL, dump_attr_bgp_ls,
+    },
+    [PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES] = {
+      decode_attr_large_communities, handler_clear_attr_large_communities,
+      handler_destroy_attr_large_communities,
+      handler_dump_attr_large_communities,
+    },
+  },
+};
+
+#define REGISTRY(registry) ((registry) != NULL ? (registry) : &builtin_registry)
+
+parsebgp_bgp_update_path_attr_registry_t *
+parsebgp_bgp_update_path_attr_registry_create(void)
+{
+  parsebgp_bgp_update_path_attr_registry_t *registry;
+
+  if ((registry = malloc(sizeof(*registry))) == NULL) {
+    return NULL;
+  }
+  memcpy(registry, &builtin_registry, sizeof(*registry));
+
+  return registry;
+}
+
+void parsebgp_bgp_update_path_attr_registry_destroy(
+  parsebgp_bgp_update_path_attr_registry_t *registry)
+{
+  free(registry);
+}
+
+void parsebgp_bgp_update_path_attr_register(
+  parsebgp_bgp_update_path_attr_registry_t *registry, uint8_t type,
+  const parsebgp_bgp_update_path_attr_handler_t *handler)
+{
+  if (handler == NULL) {
+    memset(&registry->handlers[type], 0, sizeof(registry->handlers[type]));
+  } else {
+    registry->handlers[type] = *handler;
+  }
+}
+
+const parsebgp_bgp_update_path_attr_handler_t *
+parsebgp_bgp_update_path_attr_handler_get(
+  const parsebgp_bgp_update_path_attr_registry_t *registry, uint8_t type)
+{
+  return &REGISTRY(registry)->handlers[type];
+}
+
+// find the slot in attrs_ext that belongs to the given type
+static int find_attr_ext(const parsebgp_bgp_update_path_attrs_t *path_attrs,
+                         uint8_t type)
+{
+  int i;
+  for (i = 0; i < path_attrs->_attrs_ext_alloc_cnt; i++) {
+    if (path_attrs->_attrs_ext_types[i] == type) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const parsebgp_bgp_update_path_attr_t *
+parsebgp_bgp_update_path_attr_get(const parsebgp_bgp_update_path_attrs_t *path_attrs,
+                                  uint8_t type)
+{
+  const parsebgp_bgp_update_path_attr_t *attr;
+  int idx;
+
+  if (type < PARSEBGP_BGP_PATH_ATTRS_LEN) {
+    attr = &path_attrs->attrs[type];
+  } else if ((idx = find_attr_ext(path_attrs, type)) >= 0) {
+    attr = &path_attrs->attrs_ext[idx];
+  } else {
+    return NULL;
+  }
+
+  return (attr->type != 0) ? attr : NULL;
+}
+
+// get (creating if needed) the slot that will hold an attribute of the given
+// type
+static parsebgp_error_t
+get_attr_slot(parsebgp_bgp_update_path_attrs_t *path_attrs, uint8_t type,
+              parsebgp_bgp_update_path_attr_t **attrp)
+{
+  int idx, types_alloc_cnt;
+
+  if (type < PARSEBGP_BGP_PATH_ATTRS_LEN) {
+    *attrp = &path_attrs->attrs[type];
+    return PARSEBGP_OK;
+  }
+
+  if ((idx = find_attr_ext(path_attrs, type)) < 0) {
+    idx = path_attrs->_attrs_ext_alloc_cnt;
+    types_alloc_cnt = idx;
+    PARSEBGP_MAYBE_REALLOC(path_attrs->_attrs_ext_types, types_alloc_cnt,
+                           idx + 1);
+    PARSEBGP_MAYBE_REALLOC(path_attrs->attrs_ext,
+                           path_attrs->_attrs_ext_alloc_cnt, idx + 1);
+    path_attrs->_attrs_ext_types[idx] = type;
+  }
+
+  *attrp = &path_attrs->attrs_ext[idx];
+  return PARSEBGP_OK;
+}
+
+/* -------------------- AS_PATH/AS4_PATH Merging -------------------- */
+
+// the 2-byte placeholder for 4-byte ASNs (RFC 6793)
+#define AS_TRANS 23456
+
+// the AS Path Segment types that count towards the path length
+#define SEG_COUNTED(type)                                                      \
+  ((type) == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ ||                         \
+   (type) == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SET)
+
+// add cnt ASNs of the given segment type to the end of the merged path
+static parsebgp_error_t merged_append(parsebgp_bgp_update_as_path_t *path,
+                                      uint8_t type, const uint32_t *asns,
+                                      int cnt)
+{
+  parsebgp_bgp_update_as_path_seg_t *seg = NULL;
+
+  // extend the last segment if it is also an AS_SEQUENCE
+  if (path->segs_cnt > 0) {
+    seg = &path->segs[path->segs_cnt - 1];
+    if (type != PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ || seg->type != type ||
+        seg->asns_cnt + cnt > UINT8_MAX) {
+      seg = NULL;
+    }
+  }
+  if (seg == NULL) {
+    PARSEBGP_ASSERT(path->segs_cnt < UINT8_MAX);
+    PARSEBGP_MAYBE_REALLOC(path->segs, path->_segs_alloc_cnt,
+                           path->segs_cnt + 1);
+    seg = &path->segs[path->segs_cnt++];
+    seg->type = type;
+    seg->asns_cnt = 0;
+  }
+
+  PARSEBGP_MAYBE_REALLOC(seg->asns, seg->_asns_alloc_cnt, seg->asns_cnt + cnt);
+  memcpy(seg->asns + seg->asns_cnt, asns, sizeof(*asns) * cnt);
+  seg->asns_cnt += cnt;
+  return PARSEBGP_OK;
+}
+
+// number of ASNs in the path, as defined in RFC 4271 section 9.1.2.2
+static int as_path_len(const parsebgp_bgp_update_as_path_t *path)
+{
+  int i, cnt = 0;
+
+  for (i = 0; i < path->segs_cnt; i++) {
+    if (path->segs[i].type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ) {
+      cnt += path->segs[i].asns_cnt;
+    } else if (path->segs[i].type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SET) {
+      cnt++;
+    }
+  }
+  return cnt;
+}
+
+// the given attribute, if it is present and was decoded by the built-in
+// handler
+static const parsebgp_bgp_update_path_attr_t *
+builtin_attr(const parsebgp_opts_t *opts,
+             const parsebgp_bgp_update_path_attrs_t *path_attrs, uint8_t type)
+{
+  const parsebgp_bgp_update_path_attr_t *attr = &path_attrs->attrs[type];
+
+  if (attr->type == 0 || RAW(opts, attr) ||
+      REGISTRY(path_attrs->_registry)->handlers[type].decode !=
+        builtin_registry.handlers[type].decode) {
+    return NULL;
+  }
+  return attr;
+}
+
+// compute the effective AS path (RFC 6793 section 4.2.3)
+static parsebgp_error_t
+merge_as_path(const parsebgp_opts_t *opts,
+              parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  parsebgp_bgp_update_as_path_merged_t *merged = &path_attrs->as_path_merged;
+  const parsebgp_bgp_update_path_attr_t *attr;
+  const parsebgp_bgp_update_as_path_t *as_path, *as4_path = NULL;
+  const parsebgp_bgp_update_as_path_seg_t *seg;
+  int i, keep, cnt;
+  parsebgp_error_t err;
+
+  if ((attr = builtin_attr(opts, path_attrs,
+                           PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH)) == NULL) {
+    return PARSEBGP_OK;
+  }
+  as_path = attr->data.as_path;
+
+  // AS4_PATH is only sent to an OLD (2-byte) speaker, and must be ignored if
+  // the AGGREGATOR shows that a NEW speaker aggregated the route
+  if (!as_path->asn_4_byte &&
+      (attr = builtin_attr(opts, path_attrs,
+                           PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH)) != NULL) {
+    as4_path = attr->data.as_path;
+    attr =
+      builtin_attr(opts, path_attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR);
+    if (attr != NULL && attr->data.aggregator.asn != AS_TRANS &&
+        path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_AGGREGATOR].type !=
+          0) {
+      as4_path = NULL;
+    }
+  }
+
+  // the number of leading ASNs of the AS_PATH that are kept (all of them,
+  // unless there is a usable AS4_PATH)
+  keep = as_path_len(as_path);
+  if (as4_path != NULL) {
+    cnt = as_path_len(as4_path);
+    if (cnt > keep) {
+      // the AS4_PATH is longer than the AS_PATH, so it is ignored
+      as4_path = NULL;
+    } else {
+      keep -= cnt;
+    }
+  }
+
+  clear_attr_as_path(&merged->path);
+  merged->path.asn_4_byte = 1;
+  for (i = 0; i < as_path->segs_cnt && (as4_path == NULL || keep > 0); i++) {
+    seg = &as_path->segs[i];
+    if (seg->type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ) {
+      cnt = (as4_path == NULL || seg->asns_cnt < keep) ? seg->asns_cnt : keep;
+      keep -= cnt;
+    } else {
+      cnt = seg->asns_cnt;
+      keep -= (seg->type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SET);
+    }
+    if ((err = merged_append(&merged->path, seg->type, seg->asns, cnt)) !=
+        PARSEBGP_OK) {
+      return err;
+    }
+  }
+  for (i = 0; as4_path != NULL && i < as4_path->segs_cnt; i++) {
+    // confederation segments must not appear in AS4_PATH
+    seg = &as4_path->segs[i];
+    if (!SEG_COUNTED(seg->type)) {
+      continue;
+    }
+    if ((err = merged_append(&merged->path, seg->type, seg->asns,
+                             seg->asns_cnt)) != PARSEBGP_OK) {
+      return err;
+    }
+  }
+
+  merged->path_len = as_path_len(&merged->path);
+  merged->path.asns_cnt = merged->path_len > UINT8_MAX ? UINT8_MAX
+                                                        : merged->path_len;
+  merged->origin_asn = 0;
+  merged->first_hop_asn = 0;
+  for (i = 0; i < merged->path.segs_cnt; i++) {
+    seg = &merged->path.segs[i];
+    if (SEG_COUNTED(seg->type)) {
+      if (seg->type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ &&
+          seg->asns_cnt > 0) {
+        merged->first_hop_asn = seg->asns[0];
       }
-      nread += slen;
-      buf += slen;
       break;
+    }
+  }
+  if (merged->path.segs_cnt > 0) {
+    seg = &merged->path.segs[merged->path.segs_cnt - 1];
+    if (seg->type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ &&
+        seg->asns_cnt > 0) {
+      merged->origin_asn = seg->asns[seg->asns_cnt - 1];
+    }
+  }
+  merged->valid = 1;
+  return PARSEBGP_OK;
+}
 
-    // ...
+/* -------------------- Fingerprints -------------------- */
 
-    // Type 21
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATHLIMIT:
-      if ((err = parse_path_attr_as_pathlimit(
-             &attr->data.as_pathlimit, buf, &slen, attr->len)) != PARSEBGP_OK) {
-        return err;
+// the attributes that are covered by the communities fingerprint
+static const uint8_t community_attr_types[] = {
+  PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES,
+  PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES,
+  PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES,
+  PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES,
+};
+
+#define COMMUNITY_ATTR_TYPES_CNT                                               \
+  (sizeof(community_attr_types) / sizeof(community_attr_types[0]))
+
+// hash a (decoded) AS path, segment by segment
+static uint64_t fingerprint_as_path(const parsebgp_bgp_update_as_path_t *path)
+{
+  const parsebgp_bgp_update_as_path_seg_t *seg;
+  uint64_t hash = PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH;
+  int i;
+
+  for (i = 0; i < path->segs_cnt; i++) {
+    seg = &path->segs[i];
+    hash = parsebgp_hash64(seg->asns, sizeof(*seg->asns) * seg->asns_cnt,
+                           hash ^ ((uint64_t)seg->type << 8) ^ seg->asns_cnt);
+  }
+  return hash;
+}
+
+// compute the fingerprints that are derived from the decoded attributes (the
+// per-attribute and whole-block fingerprints are computed while decoding)
+static void fingerprint_path_attrs(const parsebgp_opts_t *opts,
+                                   parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  parsebgp_bgp_update_fingerprints_t *fps = &path_attrs->fingerprints;
+  const parsebgp_bgp_update_path_attr_t *attr;
+  uint64_t comms[COMMUNITY_ATTR_TYPES_CNT];
+  int found = 0;
+  size_t i;
+
+  attr = &path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH];
+  if (path_attrs->as_path_merged.valid) {
+    fps->as_path = fingerprint_as_path(&path_attrs->as_path_merged.path);
+  } else if (builtin_attr(opts, path_attrs,
+                          PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH) != NULL) {
+    fps->as_path = fingerprint_as_path(attr->data.as_path);
+  } else if (attr->type != 0) {
+    // not decoded by us, so all we have is the raw data
+    fps->as_path = attr->fingerprint;
+  } else {
+    fps->as_path = 0;
+  }
+
+  for (i = 0; i < COMMUNITY_ATTR_TYPES_CNT; i++) {
+    attr = &path_attrs->attrs[community_attr_types[i]];
+    if (attr->type != 0) {
+      comms[i] = attr->fingerprint;
+      found = 1;
+    } else {
+      comms[i] = 0;
+    }
+  }
+  fps->communities = found ? parsebgp_hash64(comms, sizeof(comms), 0) : 0;
+
+  fps->valid = 1;
+}
+
+/* -------------------- Interning -------------------- */
+
+// the size of one community in each of the community_attr_types attributes
+static const size_t community_sizes[] = {4, 8, 20, 12};
+
+#define DEFINE_MEMCMP(n)                                                       \
+  static int memcmp_##n(const void *a, const void *b)                          \
+  {                                                                            \
+    return memcmp(a, b, n);                                                    \
+  }
+DEFINE_MEMCMP(4)
+DEFINE_MEMCMP(8)
+DEFINE_MEMCMP(20)
+DEFINE_MEMCMP(12)
+
+// comparators for each of the community_attr_types attributes
+static int (*const community_cmps[])(const void *, const void *) = {
+  memcmp_4, memcmp_8, memcmp_20, memcmp_12};
+
+// find the raw value of the first attribute of the given type in a Path
+// Attributes block (that has already been decoded)
+static const uint8_t *find_raw_attr(const uint8_t *buf, size_t len,
+                                    uint8_t type, size_t *vlenp)
+{
+  size_t nread = 0, hlen, vlen;
+
+  while (len - nread >= 3) {
+    if (buf[nread] & PARSEBGP_BGP_PATH_ATTR_FLAG_EXTENDED) {
+      if (len - nread < 4) {
+        break;
       }
-      nread += slen;
-      buf += slen;
+      hlen = 4;
+      vlen = nptohs(buf + nread + 2);
+    } else {
+      hlen = 3;
+      vlen = buf[nread + 2];
+    }
+    if (vlen > len - nread - hlen) {
       break;
+    }
+    if (buf[nread + 1] == type) {
+      *vlenp = vlen;
+      return buf + nread + hlen;
+    }
+    nread += hlen + vlen;
+  }
+  return NULL;
+}
 
-    //...
+// serialize the AS path into the scratch buffer (see PARSEBGP_INTERN_AS_PATH)
+static parsebgp_error_t
+canonical_as_path(parsebgp_bgp_update_path_attrs_t *path_attrs,
+                  const parsebgp_bgp_update_as_path_t *path, size_t *lenp)
+{
+  const parsebgp_bgp_update_as_path_seg_t *seg;
+  size_t len = 0;
+  uint8_t *p;
+  int i, j;
 
-    // Type 25
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES:
-      PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.ext_communities);
-      if ((err = parsebgp_bgp_update_ext_communities_ipv6_decode(
-             opts, attr->data.ext_communities, buf, &slen, attr->len)) !=
-          PARSEBGP_OK) {
-        return err;
+  for (i = 0; i < path->segs_cnt; i++) {
+    len += 2 + 4 * path->segs[i].asns_cnt;
+  }
+  PARSEBGP_MAYBE_REALLOC(path_attrs->_scratch, path_attrs->_scratch_alloc_len,
+                         len);
+
+  p = path_attrs->_scratch;
+  for (i = 0; i < path->segs_cnt; i++) {
+    seg = &path->segs[i];
+    *(p++) = seg->type;
+    *(p++) = seg->asns_cnt;
+    for (j = 0; j < seg->asns_cnt; j++) {
+      *(p++) = seg->asns[j] >> 24;
+      *(p++) = seg->asns[j] >> 16;
+      *(p++) = seg->asns[j] >> 8;
+      *(p++) = seg->asns[j];
+    }
+  }
+  *lenp = len;
+  return PARSEBGP_OK;
+}
+
+// serialize the community attributes into the scratch buffer (see
+// PARSEBGP_INTERN_COMMUNITIES)
+static parsebgp_error_t
+canonical_communities(parsebgp_bgp_update_path_attrs_t *path_attrs,
+                      const uint8_t *buf, size_t *lenp)
+{
+  const uint8_t *raw[COMMUNITY_ATTR_TYPES_CNT];
+  size_t raw_cnt[COMMUNITY_ATTR_TYPES_CNT];
+  size_t i, j, vlen, cnt, size, len = 0;
+  uint8_t *p;
+
+  for (i = 0; i < COMMUNITY_ATTR_TYPES_CNT; i++) {
+    raw[i] = NULL;
+    if (path_attrs->attrs[community_attr_types[i]].type == 0 ||
+        (raw[i] = find_raw_attr(buf, path_attrs->len, community_attr_types[i],
+                                &vlen)) == NULL) {
+      continue;
+    }
+    raw_cnt[i] = vlen / community_sizes[i];
+    len += 3 + raw_cnt[i] * community_sizes[i];
+  }
+  if (len == 0) {
+    *lenp = 0;
+    return PARSEBGP_OK;
+  }
+  PARSEBGP_MAYBE_REALLOC(path_attrs->_scratch, path_attrs->_scratch_alloc_len,
+                         len);
+
+  p = path_attrs->_scratch;
+  for (i = 0; i < COMMUNITY_ATTR_TYPES_CNT; i++) {
+    if (raw[i] == NULL) {
+      continue;
+    }
+    size = community_sizes[i];
+    memcpy(p + 3, raw[i], raw_cnt[i] * size);
+    qsort(p + 3, raw_cnt[i], size, community_cmps[i]);
+    // drop duplicates
+    for (cnt = 0, j = 0; j < raw_cnt[i]; j++) {
+      if (cnt == 0 ||
+          memcmp(p + 3 + (cnt - 1) * size, p + 3 + j * size, size) != 0) {
+        memmove(p + 3 + cnt * size, p + 3 + j * size, size);
+        cnt++;
       }
-      nread += slen;
-      buf += slen;
-      break;
+    }
+    p[0] = community_attr_types[i];
+    p[1] = cnt >> 8;
+    p[2] = cnt;
+    p += 3 + cnt * size;
+  }
+  *lenp = p - path_attrs->_scratch;
+  return PARSEBGP_OK;
+}
+
+// map the (just decoded) Path Attributes to IDs
+static parsebgp_error_t
+intern_path_attrs(const parsebgp_opts_t *opts,
+                  parsebgp_bgp_update_path_attrs_t *path_attrs,
+                  const uint8_t *buf)
+{
+  parsebgp_bgp_update_intern_ids_t *ids = &path_attrs->intern_ids;
+  const parsebgp_bgp_update_as_path_t *path = NULL;
+  const parsebgp_bgp_update_path_attr_t *attr;
+  size_t len;
+  parsebgp_error_t err;
+
+  ids->as_path = 0;
+  ids->communities = 0;
+
+  if ((err = parsebgp_intern(opts->intern, PARSEBGP_INTERN_ATTRS, buf,
+                             path_attrs->len, &ids->attrs)) != PARSEBGP_OK) {
+    return err;
+  }
+
+  if (path_attrs->as_path_merged.valid) {
+    path = &path_attrs->as_path_merged.path;
+  } else if ((attr = builtin_attr(opts, path_attrs,
+                                  PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH)) !=
+             NULL) {
+    path = attr->data.as_path;
+  }
+  if (path != NULL &&
+      ((err = canonical_as_path(path_attrs, path, &len)) != PARSEBGP_OK ||
+       (err = parsebgp_intern(opts->intern, PARSEBGP_INTERN_AS_PATH,
+                              path_attrs->_scratch, len, &ids->as_path)) !=
+         PARSEBGP_OK)) {
+    return err;
+  }
+
+  if ((err = canonical_communities(path_attrs, buf, &len)) != PARSEBGP_OK) {
+    return err;
+  }
+  if (len > 0 &&
+      (err = parsebgp_intern(opts->intern, PARSEBGP_INTERN_COMMUNITIES,
+                             path_attrs->_scratch, len, &ids->communities)) !=
+        PARSEBGP_OK) {
+    return err;
+  }
+
+  ids->valid = 1;
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
+  parsebgp_opts_t *opts, parsebgp_bgp_update_path_attrs_t *path_attrs,
+  const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  size_t len = *lenp, nread = 0, slen = 0;
+  const uint8_t *attrs_buf;
+  parsebgp_bgp_update_path_attr_t *attr;
+  const parsebgp_bgp_update_path_attr_handler_t *handlers;
+  uint8_t flags_tmp, type_tmp;
+  uint16_t len_tmp;
+  parsebgp_error_t err = PARSEBGP_OK;
+
+  if (path_attrs->_cache_entry != NULL) {
+    parsebgp_attr_cache_release(path_attrs);
+  }
+
+  path_attrs->attrs_cnt = 0;
+  path_attrs->as_path_merged.valid = 0;
+  path_attrs->fingerprints.valid = 0;
+  path_attrs->intern_ids.valid = 0;
+  path_attrs->_registry = REGISTRY(opts->bgp.path_attr_registry);
+  handlers = path_attrs->_registry->handlers;
+
+  // Path Attributes Length
+  PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, path_attrs->len);
+
+  if (nread + path_attrs->len > len) {
+    // TODO: parse what we can, so that the caller can return
+    // PARSEBGP_TRUNCATED_MSG with as much data as possible?  (OTOH, if the
+    // caller can't return PARSEBGP_TRUNCATED_MSG, then we will have done all
+    // that parsing for nothing, when we maybe just needed a buffer refill.)
+    return PARSEBGP_PARTIAL_MSG;
+  }
+  PARSEBGP_ASSERT(nread + path_attrs->len <= remain);
+  remain = nread + path_attrs->len; // remaining within path attributes
+
+  if (!PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BGP_PATH_ATTRS)) {
+    // skip over all the attributes
+    *lenp = remain;
+    return PARSEBGP_OK;
+  }
+
+  // use the decoded copy of these attributes if we have one
+  if (opts->attr_cache != NULL &&
+      parsebgp_attr_cache_lookup(opts->attr_cache, opts, buf, path_attrs->len,
+                                 path_attrs)) {
+    *lenp = remain;
+    return PARSEBGP_OK;
+  }
+  attrs_buf = buf;
+
+  if (opts->bgp.fingerprint) {
+    // hash the whole block while it is (probably) still in cache
+    path_attrs->fingerprints.attrs =
+      parsebgp_hash64(buf, path_attrs->len, 0);
+  }
+
+  // read until we run out of attributes
+  while (nread < remain) {
+
+    /* Optimization: the vast majority of cases will short-circuit after the
+     * <4 condition. */
+    if ((remain - nread < 4) &&
+      ((*buf & PARSEBGP_BGP_PATH_ATTR_FLAG_EXTENDED) || remain - nread < 3))
+    {
+      /* The remaining data in Path Attributes is insufficient to encode a
+         single minimum-sized path attribute, and should be considered as
+         "treat-as-withdraw" (https://tools.ietf.org/html/rfc7606#section-4).
+       */
+      PARSEBGP_SKIP_INVALID_MSG(opts, buf, nread, 0,
+        "Path attribute requires at least 3-4 bytes, but only %d bytes remain.",
+        (int)(remain - nread));
+      // If we pass the above macro, the user wants us to struggle on.
+      *lenp = remain;
+      return PARSEBGP_OK;
+    }
 
-    // ...
+    /* Optimization: since the length was already checked above, we can skip
+     * the PARSEBGP_DESERIALIZE_* calls and read the buf directly. */
+    flags_tmp = *(buf++); // Attribute Flags
+    type_tmp = *(buf++);  // Attribute Type
+    if (flags_tmp & PARSEBGP_BGP_PATH_ATTR_FLAG_EXTENDED) {
+      len_tmp = nptohs(buf); // Attribute Length
+      buf += 2;
+      nread += 4;
+    } else {
+      len_tmp = *buf; // Attribute Length
+      buf += 1;
+      nread += 3;
+    }
 
-    // Type 29
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_BGP_LS:
-      // TODO: add support for BGP-LS
+    if (len_tmp > (remain - nread)) {
+      /* The length of the path attribute would cause the Total Attribute
+         Length to be exceeded, and should be considered as
+         "treat-as-withdraw" (https://tools.ietf.org/html/rfc7606#section-4).
+       */
+      PARSEBGP_SKIP_INVALID_MSG(
+        opts, buf, nread, 0,
+        "Path attribute (type %d) has length %d, but only %d bytes remain.",
+        type_tmp, len_tmp, (int)(remain - nread));
+      // If we pass the above macro, the user wants us to struggle on.
+      *lenp = remain;
+      return PARSEBGP_OK;
+    }
+
+    // if this type is beyond the max built-in type, and nobody has registered
+    // a handler for it, skip it now
+    if (type_tmp >= PARSEBGP_BGP_PATH_ATTRS_LEN &&
+        handlers[type_tmp].decode == NULL) {
       PARSEBGP_SKIP_NOT_IMPLEMENTED(
-        opts, buf, nread, attr->len,
-        "BGP UPDATE Path Attribute %d (BGP-LS) is not yet implemented",
-        attr->type);
-      slen = attr->len;
-      break;
+        opts, buf, nread, len_tmp,
+        "BGP UPDATE Path Attribute %d is not yet implemented", type_tmp);
+      continue;
+    }
 
-    // ...
+    // has the user enabled the filter, and have they (implicitly) filtered out
+    // this type of attribute
+    if (opts->bgp.path_attr_filter_enabled &&
+        opts->bgp.path_attr_filter[type_tmp] == 0) {
+      // they don't want it. skip over the rest of the attribute
+      nread += len_tmp;
+      buf += len_tmp;
+      continue;
+    }
 
-    // Type 32
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES:
-      PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.large_communities);
-      if ((err = parse_path_attr_large_communities(attr->data.large_communities,
-                                                   buf, &slen, attr->len)) !=
-          PARSEBGP_OK) {
-        return err;
-      }
-      nread += slen;
-      buf += slen;
-      break;
+    if ((err = get_attr_slot(path_attrs, type_tmp, &attr)) != PARSEBGP_OK) {
+      return err;
+    }
+    if (attr->type != 0) {
+      assert(attr->type == type_tmp);
 
-    default:
+      fprintf(stderr, "WARN: Duplicate Path Attribute (%d) found. Skipping\n",
+              type_tmp);
+      nread += len_tmp;
+      buf += len_tmp;
+      continue;
+    }
+
+    PARSEBGP_MAYBE_REALLOC(path_attrs->attrs_used,
+                           path_attrs->_attrs_used_alloc_cnt,
+                           path_attrs->attrs_cnt + 1);
+    path_attrs->attrs_used[path_attrs->attrs_cnt] = type_tmp;
+    path_attrs->attrs_cnt++;
+
+    // Attribute Flags
+    attr->flags = flags_tmp;
+
+    // Attribute Type
+    attr->type = type_tmp;
+
+    // Attribute Length
+    attr->len = len_tmp;
+
+    if (opts->bgp.fingerprint) {
+      attr->fingerprint = parsebgp_hash64(buf, attr->len, attr->type);
+    }
+
+    if (handlers[type_tmp].decode == NULL) {
       PARSEBGP_SKIP_NOT_IMPLEMENTED(
         opts, buf, nread, attr->len,
         "BGP UPDATE Path Attribute %d is not yet implemented", attr->type);
-      slen = attr->len;
-      break;
+      continue;
+    }
+
+    slen = len - nread;
+    if ((err = handlers[type_tmp].decode(opts, attr, buf, &slen, attr->len)) !=
+        PARSEBGP_OK) {
+      return err;
     }
     PARSEBGP_ASSERT(slen == attr->len);
+    nread += slen;
+    buf += slen;
+  }
+
+  if (opts->bgp.as_path_merge && (err = merge_as_path(opts, path_attrs)) !=
+      PARSEBGP_OK) {
+    return err;
+  }
+
+  if (opts->bgp.fingerprint) {
+    fingerprint_path_attrs(opts, path_attrs);
+  }
+
+  if (opts->intern != NULL &&
+      (err = intern_path_attrs(opts, path_attrs, attrs_buf)) != PARSEBGP_OK) {
+    return err;
+  }
+
+  if (opts->attr_cache != NULL &&
+      (err = parsebgp_attr_cache_insert(opts->attr_cache, opts, attrs_buf,
+                                        path_attrs->len, path_attrs)) !=
+        PARSEBGP_OK) {
+    return err;
   }
 
   *lenp = nread;
   return PARSEBGP_OK;
 }
 
-void parsebgp_bgp_update_path_attrs_destroy(
-  parsebgp_bgp_update_path_attrs_t *msg)
+// walk the segments of an AS_PATH to check that they exactly fill the
+// attribute
+static int validate_as_path(int asn_4_byte, const uint8_t *buf, size_t len)
 {
-  int i;
-  parsebgp_bgp_update_path_attr_t *attr;
+  size_t nread = 0, asn_size = asn_4_byte ? 4 : 2;
 
-  if (msg == NULL) {
-    return;
+  while (nread < len) {
+    if (len - nread < 2) {
+      return 0;
+    }
+    nread += 2 + asn_size * buf[nread + 1];
   }
+  return nread == len;
+}
 
-  for (i = 0; i < PARSEBGP_BGP_PATH_ATTRS_LEN; i++) {
-    attr = &msg->attrs[i];
+parsebgp_error_t parsebgp_bgp_update_path_attrs_validate(
+  parsebgp_opts_t *opts, const uint8_t *buf, size_t *lenp,
+  const uint8_t **errp)
+{
+  size_t len = *lenp, nread = 0, remain, slen;
+  const uint8_t *attr_start;
+  uint8_t flags, type;
+  uint16_t attr_len;
+  int ok;
+  parsebgp_error_t err;
+
+  // Path Attributes Length
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= sizeof(uint16_t));
+  remain = sizeof(uint16_t) + nptohs(buf);
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, remain <= len);
+  nread += sizeof(uint16_t);
+  buf += sizeof(uint16_t);
+
+  while (nread < remain) {
+    attr_start = buf;
+
+    // same "treat-as-withdraw" checks as the decoder
+    // (https://tools.ietf.org/html/rfc7606#section-4)
+    PARSEBGP_VALIDATE_ASSERT(errp, attr_start,
+                             (remain - nread >= 4) ||
+                               (!(*buf & PARSEBGP_BGP_PATH_ATTR_FLAG_EXTENDED) &&
+                                remain - nread >= 3));
+    flags = *(buf++);
+    type = *(buf++);
+    if (flags & PARSEBGP_BGP_PATH_ATTR_FLAG_EXTENDED) {
+      attr_len = nptohs(buf);
+      buf += 2;
+      nread += 4;
+    } else {
+      attr_len = *(buf++);
+      nread += 3;
+    }
+    PARSEBGP_VALIDATE_ASSERT(errp, attr_start, attr_len <= remain - nread);
 
-    switch (i) {
-    // Types with no dynamic memory:
+    // per-type length rules (these mirror the sanity checks in the decoders)
+    switch (type) {
     case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN:
+      ok = (attr_len == 1);
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
+      ok = validate_as_path(opts->bgp.asn_4_byte, buf, attr_len) ||
+           (opts->bgp.asn_4_byte && validate_as_path(0, buf, attr_len));
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
+      ok = validate_as_path(1, buf, attr_len);
+      break;
+
     case PARSEBGP_BGP_PATH_ATTR_TYPE_NEXT_HOP:
     case PARSEBGP_BGP_PATH_ATTR_TYPE_MED:
     case PARSEBGP_BGP_PATH_ATTR_TYPE_LOCAL_PREF:
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGINATOR_ID:
+      ok = (attr_len == 4);
+      break;
+
     case PARSEBGP_BGP_PATH_ATTR_TYPE_ATOMIC_AGGREGATE:
+      ok = (attr_len == 0);
+      break;
+
     case PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGINATOR_ID:
     case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_AGGREGATOR:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATHLIMIT:
+      ok = (attr_len == 6 || attr_len == 8);
       break;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
-      destroy_attr_as_path(attr->data.as_path);
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES:
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST:
+      ok = (attr_len % 4 == 0);
       break;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES:
-      destroy_attr_communities(attr->data.communities);
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES:
+      ok = (attr_len % 8 == 0);
       break;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST:
-      destroy_attr_cluster_list(attr->data.cluster_list);
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES:
+      ok = (attr_len % 20 == 0);
       break;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI:
-      parsebgp_bgp_update_mp_reach_destroy(attr->data.mp_reach);
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATHLIMIT:
+      ok = (attr_len == 5);
       break;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI:
-      parsebgp_bgp_update_mp_unreach_destroy(attr->data.mp_unreach);
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES:
+      ok = (attr_len % LARGE_COMM_LEN == 0);
       break;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES:
-      parsebgp_bgp_update_ext_communities_destroy(attr->data.ext_communities);
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI:
+      slen = attr_len;
+      if ((err = parsebgp_bgp_update_mp_reach_validate(opts, buf, &slen,
+                                                       errp)) != PARSEBGP_OK) {
+        return err;
+      }
+      ok = 1;
       break;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_BGP_LS:
-      // TODO: add support for BGP-LS
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI:
+      slen = attr_len;
+      if ((err = parsebgp_bgp_update_mp_unreach_validate(opts, buf, &slen,
+                                                         errp)) !=
+          PARSEBGP_OK) {
+        return err;
+      }
+      ok = 1;
       break;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES:
-      destroy_attr_large_communities(attr->data.large_communities);
+    default:
+      // we can't say anything about the contents of other attributes
+      ok = 1;
       break;
     }
+    PARSEBGP_VALIDATE_ASSERT(errp, attr_start, ok);
+
+    nread += attr_len;
+    buf += attr_len;
   }
 
-  free(msg->attrs_used);
+  *lenp = nread;
+  return PARSEBGP_OK;
 }
 
-void parsebgp_bgp_update_path_attrs_clear(parsebgp_bgp_update_path_attrs_t *msg)
+void parsebgp_bgp_update_path_attrs_destroy(
+  parsebgp_bgp_update_path_attrs_t *msg)
 {
   int i;
-  parsebgp_bgp_update_path_attr_t *attr;
+  const parsebgp_bgp_update_path_attr_handler_t *handlers;
 
   if (msg == NULL) {
     return;
   }
 
-  for (i = 0; i < msg->attrs_cnt; i++) {
-    attr = &msg->attrs[msg->attrs_used[i]];
+  if (msg->_cache_entry != NULL) {
+    parsebgp_attr_cache_release(msg);
+  }
+  free(msg->_stash);
+  free(msg->_scratch);
 
-    if (attr->type == 0) {
-      continue;
+  handlers = REGISTRY(msg->_registry)->handlers;
+
+  for (i = 0; i < PARSEBGP_BGP_PATH_ATTRS_LEN; i++) {
+    if (handlers[i].destroy != NULL) {
+      handlers[i].destroy(&msg->attrs[i]);
     }
+  }
 
-    switch (attr->type) {
-    // Types with no dynamic memory:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_NEXT_HOP:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MED:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_LOCAL_PREF:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ATOMIC_AGGREGATE:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGINATOR_ID:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_AGGREGATOR:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATHLIMIT:
-      break;
+  for (i = 0; i < msg->_attrs_ext_alloc_cnt; i++) {
+    if (handlers[msg->_attrs_ext_types[i]].destroy != NULL) {
+      handlers[msg->_attrs_ext_types[i]].destroy(&msg->attrs_ext[i]);
+    }
+  }
+  free(msg->attrs_ext);
+  free(msg->_attrs_ext_types);
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
-      clear_attr_as_path(attr->data.as_path);
-      break;
+  free(msg->attrs_used);
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES:
-      clear_attr_communities(attr->data.communities);
-      break;
+  for (i = 0; i < msg->as_path_merged.path._segs_alloc_cnt; i++) {
+    free(msg->as_path_merged.path.segs[i].asns);
+  }
+  free(msg->as_path_merged.path.segs);
+}
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST:
-      clear_attr_cluster_list(attr->data.cluster_list);
-      break;
+void parsebgp_bgp_update_path_attrs_clear(parsebgp_bgp_update_path_attrs_t *msg)
+{
+  int i;
+  parsebgp_bgp_update_path_attr_t *attr;
+  const parsebgp_bgp_update_path_attr_handler_t *handlers;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI:
-      parsebgp_bgp_update_mp_reach_clear(attr->data.mp_reach);
-      break;
+  if (msg == NULL) {
+    return;
+  }
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI:
-      parsebgp_bgp_update_mp_unreach_clear(attr->data.mp_unreach);
-      break;
+  if (msg->_cache_entry != NULL) {
+    parsebgp_attr_cache_release(msg);
+  }
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES:
-      parsebgp_bgp_update_ext_communities_clear(attr->data.ext_communities);
-      break;
+  handlers = REGISTRY(msg->_registry)->handlers;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_BGP_LS:
-      // TODO: add support for BGP-LS
-      break;
+  for (i = 0; i < msg->attrs_cnt; i++) {
+    if (msg->attrs_used[i] < PARSEBGP_BGP_PATH_ATTRS_LEN) {
+      attr = &msg->attrs[msg->attrs_used[i]];
+    } else {
+      attr = &msg->attrs_ext[find_attr_ext(msg, msg->attrs_used[i])];
+    }
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES:
-      clear_attr_large_communities(attr->data.large_communities);
-      break;
+    if (attr->type == 0) {
+      continue;
+    }
+
+    // the built-in decoders re-initialize the attribute data themselves, so
+    // only (application-registered) handlers that differ need to be called
+    if (handlers[attr->type].clear != NULL &&
+        handlers[attr->type].clear !=
+          builtin_registry.handlers[attr->type].clear) {
+      handlers[attr->type].clear(attr);
     }
 
     attr->type = 0;
   }
 
   msg->attrs_cnt = 0;
+  msg->as_path_merged.valid = 0;
+  msg->fingerprints.valid = 0;
+  msg->intern_ids.valid = 0;
+}
+
+static void dump_path_attr(const parsebgp_bgp_update_path_attr_handler_t *handlers,
+                           const parsebgp_bgp_update_path_attr_t *attr,
+                           int depth)
+{
+  PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_update_path_attr_t, depth);
+
+  PARSEBGP_DUMP_INT(depth, "Flags", attr->flags);
+  PARSEBGP_DUMP_INT(depth, "Type", attr->type);
+  PARSEBGP_DUMP_INT(depth, "Length", attr->len);
+
+  depth++;
+  if (handlers[attr->type].dump != NULL) {
+    handlers[attr->type].dump(attr, depth);
+  } else {
+    PARSEBGP_DUMP_INFO(depth, "Unsupported Attribute\n");
+  }
 }
 
 void parsebgp_bgp_update_path_attrs_dump(
@@ -979,103 +1982,65 @@ void parsebgp_bgp_update_path_attrs_dump(
 
   depth++;
   int i;
-  const parsebgp_bgp_update_path_attr_t *attr;
+  const parsebgp_bgp_update_path_attr_handler_t *handlers =
+    REGISTRY(msg->_registry)->handlers;
   for (i = 0; i < PARSEBGP_BGP_PATH_ATTRS_LEN; i++) {
-    attr = &msg->attrs[i];
-
-    if (attr->type == 0) {
-      continue;
+    if (msg->attrs[i].type != 0) {
+      dump_path_attr(handlers, &msg->attrs[i], depth);
     }
+  }
+  for (i = 0; i < msg->_attrs_ext_alloc_cnt; i++) {
+    if (msg->attrs_ext[i].type != 0) {
+      dump_path_attr(handlers, &msg->attrs_ext[i], depth);
+    }
+  }
 
-    PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_update_path_attr_t, depth);
-
-    PARSEBGP_DUMP_INT(depth, "Flags", attr->flags);
-    PARSEBGP_DUMP_INT(depth, "Type", attr->type);
-    PARSEBGP_DUMP_INT(depth, "Length", attr->len);
-
-    depth++;
-    switch (attr->type) {
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN:
-      PARSEBGP_DUMP_INT(depth, "ORIGIN", attr->data.origin);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
-      dump_attr_as_path(attr->data.as_path, depth);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_NEXT_HOP:
-      PARSEBGP_DUMP_IP(depth, "Next Hop", PARSEBGP_BGP_AFI_IPV4,
-                       attr->data.next_hop);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MED:
-      PARSEBGP_DUMP_INT(depth, "MED", attr->data.med);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_LOCAL_PREF:
-      PARSEBGP_DUMP_INT(depth, "LOCAL_PREF", attr->data.local_pref);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ATOMIC_AGGREGATE:
-      PARSEBGP_DUMP_INFO(depth, "ATOMIC_AGGREGATE\n");
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_AGGREGATOR:
-      PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_update_aggregator_t, depth);
-      PARSEBGP_DUMP_INT(depth, "ASN", attr->data.aggregator.asn);
-      PARSEBGP_DUMP_IP(depth, "IP", PARSEBGP_BGP_AFI_IPV4,
-                       attr->data.aggregator.addr);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES:
-      dump_attr_communities(attr->data.communities, depth);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGINATOR_ID:
-      PARSEBGP_DUMP_INT(depth, "ORIGINATOR_ID", attr->data.originator_id);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST:
-      dump_attr_cluster_list(attr->data.cluster_list, depth);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI:
-      parsebgp_bgp_update_mp_reach_dump(attr->data.mp_reach, depth);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI:
-      parsebgp_bgp_update_mp_unreach_dump(attr->data.mp_unreach, depth);
-      break;
-
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES:
-      parsebgp_bgp_update_ext_communities_dump(attr->data.ext_communities,
-                                               depth);
-      break;
+  if (msg->as_path_merged.valid) {
+    PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_update_as_path_merged_t, depth);
+    PARSEBGP_DUMP_INFO(depth, "Origin ASN: %*" PRIu32 "\n",
+                       20 - (int)sizeof("Origin ASN:"),
+                       msg->as_path_merged.origin_asn);
+    PARSEBGP_DUMP_INFO(depth, "First Hop ASN: %*" PRIu32 "\n",
+                       20 - (int)sizeof("First Hop ASN:"),
+                       msg->as_path_merged.first_hop_asn);
+    PARSEBGP_DUMP_INT(depth, "Path Length", msg->as_path_merged.path_len);
+    dump_attr_as_path(&msg->as_path_merged.path, depth + 1);
+  }
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATHLIMIT:
-      PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_update_as_pathlimit_t, depth);
-      PARSEBGP_DUMP_INT(depth, "Max # ASNs", attr->data.as_pathlimit.max_asns);
-      PARSEBGP_DUMP_INT(depth, "ASN", attr->data.as_pathlimit.asn);
-      break;
+  if (msg->fingerprints.valid) {
+    PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_update_fingerprints_t, depth);
+    PARSEBGP_DUMP_INFO(depth, "Attributes:  %016" PRIx64 "\n",
+                       msg->fingerprints.attrs);
+    PARSEBGP_DUMP_INFO(depth, "AS Path:     %016" PRIx64 "\n",
+                       msg->fingerprints.as_path);
+    PARSEBGP_DUMP_INFO(depth, "Communities: %016" PRIx64 "\n",
+                       msg->fingerprints.communities);
+  }
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_BGP_LS:
-      PARSEBGP_DUMP_INFO(depth, "BGP-LS Support Not Implemented\n");
-      break;
+  if (msg->intern_ids.valid) {
+    PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_update_intern_ids_t, depth);
+    PARSEBGP_DUMP_VAL(depth, "Attributes ID", PRIu32, msg->intern_ids.attrs);
+    PARSEBGP_DUMP_VAL(depth, "AS Path ID", PRIu32, msg->intern_ids.as_path);
+    PARSEBGP_DUMP_VAL(depth, "Communities ID", PRIu32,
+                      msg->intern_ids.communities);
+  }
+}
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES:
-      dump_attr_large_communities(attr->data.large_communities, depth);
-      break;
+// total number of (decoded) prefixes in an update
+static int update_prefixes_cnt(const parsebgp_bgp_update_t *msg)
+{
+  const parsebgp_bgp_update_path_attr_t *attr;
+  int cnt = msg->withdrawn_nlris.prefixes_cnt + msg->announced_nlris.prefixes_cnt;
 
-    default:
-      PARSEBGP_DUMP_INFO(depth, "Unsupported Attribute\n");
-      break;
-    }
-    depth--;
+  attr = &msg->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI];
+  if (attr->type != 0) {
+    cnt += attr->data.mp_reach->nlris_cnt;
   }
+  attr = &msg->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI];
+  if (attr->type != 0) {
+    cnt += attr->data.mp_unreach->withdrawn_nlris_cnt;
+  }
+  return cnt;
 }
 
 parsebgp_error_t parsebgp_bgp_update_decode(parsebgp_opts_t *opts,
@@ -1090,14 +2055,23 @@ parsebgp_error_t parsebgp_bgp_update_decode(parsebgp_opts_t *opts,
   PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->withdrawn_nlris.len);
 
   // Withdrawn Routes
-  slen = len - nread;
-  err = parse_nlris(&msg->withdrawn_nlris, buf, &slen, remain - nread);
-  if (err != PARSEBGP_OK) {
-    return err;
+  if (PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BGP_WITHDRAWN)) {
+    slen = len - nread;
+    err = parse_nlris(opts, &msg->withdrawn_nlris, buf, &slen, remain - nread);
+    if (err != PARSEBGP_OK) {
+      return err;
+    }
+    assert(slen == msg->withdrawn_nlris.len);
+    nread += slen;
+    buf += slen;
+    if (opts->filter != NULL) {
+      parsebgp_filter_match_prefixes(opts, msg->withdrawn_nlris.prefixes,
+                                     msg->withdrawn_nlris.prefixes_cnt);
+    }
+  } else {
+    msg->withdrawn_nlris.prefixes_cnt = 0;
+    PARSEBGP_SKIP_SECTION(buf, len, nread, msg->withdrawn_nlris.len);
   }
-  assert(slen == msg->withdrawn_nlris.len);
-  nread += slen;
-  buf += slen;
 
   // Path Attributes
   slen = len - nread;
@@ -1109,19 +2083,83 @@ parsebgp_error_t parsebgp_bgp_update_decode(parsebgp_opts_t *opts,
   nread += slen;
   buf += slen;
 
+  if (opts->filter != NULL) {
+    parsebgp_filter_set_path_attrs(opts, &msg->path_attrs);
+    PARSEBGP_FILTER_CHECK(opts);
+  }
+
   // NLRIs
-  slen = len - nread;
   msg->announced_nlris.len = remain - nread;
-  err = parse_nlris(&msg->announced_nlris, buf, &slen, msg->announced_nlris.len);
-  if (err != PARSEBGP_OK) {
+  if (PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BGP_ANNOUNCED)) {
+    slen = len - nread;
+    err = parse_nlris(opts, &msg->announced_nlris, buf, &slen,
+                      msg->announced_nlris.len);
+    if (err != PARSEBGP_OK) {
+      return err;
+    }
+    assert(slen == msg->announced_nlris.len);
+    nread += slen;
+    buf += slen;
+    if (opts->filter != NULL) {
+      parsebgp_filter_match_prefixes(opts, msg->announced_nlris.prefixes,
+                                     msg->announced_nlris.prefixes_cnt);
+    }
+  } else {
+    msg->announced_nlris.prefixes_cnt = 0;
+    PARSEBGP_SKIP_SECTION(buf, len, nread, msg->announced_nlris.len);
+  }
+
+  // skip updates that have no prefixes selected by the prefix set
+  if (opts->prefix_set != NULL && update_prefixes_cnt(msg) == 0) {
+    return PARSEBGP_FILTERED_OUT;
+  }
+
+  if (opts->filter != NULL) {
+    parsebgp_filter_prefixes_done(opts);
+    PARSEBGP_FILTER_CHECK(opts);
+  }
+
+  *lenp = nread;
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_bgp_update_validate(parsebgp_opts_t *opts,
+                                              const uint8_t *buf, size_t len,
+                                              const uint8_t **errp)
+{
+  size_t nread = 0, slen;
+  uint16_t withdrawn_len;
+  parsebgp_error_t err;
+  int add_path =
+    PARSEBGP_BGP_ADD_PATH(opts, PARSEBGP_BGP_AFI_IPV4, PARSEBGP_BGP_SAFI_UNICAST);
+
+  // Withdrawn Routes Length
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= sizeof(uint16_t));
+  withdrawn_len = nptohs(buf);
+  PARSEBGP_VALIDATE_ASSERT(errp, buf,
+                           withdrawn_len <= len - sizeof(uint16_t));
+  nread += sizeof(uint16_t);
+  buf += sizeof(uint16_t);
+
+  // Withdrawn Routes
+  if ((err = parsebgp_validate_prefixes(buf, withdrawn_len, 32, add_path,
+                                        errp)) != PARSEBGP_OK) {
+    return err;
+  }
+  nread += withdrawn_len;
+  buf += withdrawn_len;
+
+  // Path Attributes
+  slen = len - nread;
+  if ((err = parsebgp_bgp_update_path_attrs_validate(opts, buf, &slen, errp)) !=
+      PARSEBGP_OK) {
     return err;
   }
-  assert(slen == msg->announced_nlris.len);
   nread += slen;
   buf += slen;
 
-  *lenp = nread;
-  return PARSEBGP_OK;
+  // NLRIs
+  return parsebgp_validate_prefixes(buf, len - nread, 32, add_path, errp);
 }
 
 void parsebgp_bgp_update_destroy(parsebgp_bgp_update_t *msg)
@@ -30,7 +30,14 @@
 #include "parsebgp_bgp_common.h"
 #include "parsebgp_bgp_update_ext_communities.h"
 #include "parsebgp_bgp_update_mp_reach.h"
+#include "parsebgp_error.h"
+#include "parsebgp_opts.h"
 #include <inttypes.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /**
  * BGP ORIGIN Path Attribute values
@@ -123,6 +130,42 @@ typedef struct parsebgp_bgp_update_as_path {
 
 } __attribute__((packed)) parsebgp_bgp_update_as_path_t;
 
+/**
+ * Effective AS Path
+ *
+ * The AS_PATH attribute merged with the AS4_PATH attribute using the method
+ * outlined in RFC6793 section 4.2.3 (see the as_path_merge option).
+ */
+typedef struct parsebgp_bgp_update_as_path_merged {
+
+  /** Is the merged path set?
+   *
+   * This is only set if the as_path_merge option is enabled, and the UPDATE
+   * has a (fully decoded) AS_PATH attribute.
+   */
+  uint8_t valid;
+
+  /** Merged AS Path (always uses 4-byte ASNs) */
+  parsebgp_bgp_update_as_path_t path;
+
+  /** Origin ASN (the last ASN in the path), or 0 if the path is empty or ends
+      with an AS_SET */
+  uint32_t origin_asn;
+
+  /** First Hop ASN (the first ASN in the path, ignoring confederation
+      segments), or 0 if the path is empty or starts with an AS_SET */
+  uint32_t first_hop_asn;
+
+  /** Path Length
+   *
+   * This uses the definition in Section 9.1.2.2 of [RFC4271] and Section 5.3
+   * of [RFC5065] which treats AS_SETs as a single ASN, and does not count
+   * CONFED_* segments at all.
+   */
+  uint16_t path_len;
+
+} parsebgp_bgp_update_as_path_merged_t;
+
 /**
  * AGGREGATOR (supports both 2- and 4-byte ASNs)
  */
@@ -311,6 +354,10 @@ typedef enum {
 
 } parsebgp_bgp_update_path_attr_flag_t;
 
+/** Opaque table of Path Attribute handlers, indexed by attribute type */
+typedef struct parsebgp_bgp_update_path_attr_registry
+  parsebgp_bgp_update_path_attr_registry_t;
+
 /**
  * BGP UPDATE Path Attribute
  */
@@ -325,6 +372,10 @@ typedef struct parsebgp_bgp_update_path_attr {
   /** Attribute Length (in bytes) */
   uint16_t len;
 
+  /** 64-bit hash of the (raw) attribute data (only set if the fingerprint
+      option is enabled) */
+  uint64_t fingerprint;
+
   /** Union of all support Path Attribute data */
   union {
 
@@ -334,7 +385,9 @@ typedef struct parsebgp_bgp_update_path_attr {
     /** AS_PATH or AS4_PATH
      *
      * An AS4_PATH should be merged with the AS_PATH attribute using the method
-     * outlined in RFC6793 section 4.2.3.
+     * outlined in RFC6793 section 4.2.3. The parser can do this (see the
+     * as_path_merge option and the as_path_merged field of
+     * parsebgp_bgp_update_path_attrs_t).
      */
     parsebgp_bgp_update_as_path_t *as_path;
 
@@ -374,10 +427,69 @@ typedef struct parsebgp_bgp_update_path_attr {
     /** LARGE COMMUNITIES */
     parsebgp_bgp_update_large_communities_t *large_communities;
 
+    /** Data decoded by an application-registered handler (see
+        parsebgp_bgp_update_path_attr_register). The library never interprets
+        this field. */
+    void *user;
+
   } data;
 
 } parsebgp_bgp_update_path_attr_t;
 
+/**
+ * Path Attribute Fingerprints
+ *
+ * 64-bit hashes that may be used (e.g.) as hash table keys when grouping or
+ * de-duplicating routes. Equal data always gives equal fingerprints, but
+ * (rarely) different data may also give equal fingerprints.
+ */
+typedef struct parsebgp_bgp_update_fingerprints {
+
+  /** Are the fingerprints set? */
+  uint8_t valid;
+
+  /** Hash of the (raw) Path Attributes data */
+  uint64_t attrs;
+
+  /** Hash of the AS path (0 if there is no AS_PATH attribute)
+   *
+   * If the as_path_merge option is enabled, this covers the effective AS path,
+   * otherwise it covers the AS_PATH attribute. Either way, ASNs are hashed as
+   * 4-byte values, so the same path gives the same hash regardless of how it
+   * was encoded.
+   */
+  uint64_t as_path;
+
+  /** Hash of the COMMUNITIES, EXT_COMMUNITIES, IPV6_EXT_COMMUNITIES and
+      LARGE_COMMUNITIES attributes (0 if none are present) */
+  uint64_t communities;
+
+} parsebgp_bgp_update_fingerprints_t;
+
+/**
+ * Interned IDs of the Path Attributes (see the intern option)
+ */
+typedef struct parsebgp_bgp_update_intern_ids {
+
+  /** Are the IDs set? */
+  uint8_t valid;
+
+  /** ID of the Path Attributes block (PARSEBGP_INTERN_ATTRS) */
+  uint32_t attrs;
+
+  /** ID of the AS path (PARSEBGP_INTERN_AS_PATH), or 0 if there is no
+   * AS_PATH attribute (or it was not decoded by the library)
+   *
+   * If the as_path_merge option is enabled, this is the effective AS path.
+   */
+  uint32_t as_path;
+
+  /** ID of the community set (PARSEBGP_INTERN_COMMUNITIES), or 0 if there
+      are no community attributes */
+  uint32_t communities;
+
+} parsebgp_bgp_update_intern_ids_t;
+
 /**
  * BGP Path Attributes
  */
@@ -402,9 +514,53 @@ typedef struct parsebgp_bgp_update_path_attrs {
   /** Allocated length of the attrs_used array (INTERNAL) */
   int _attrs_used_alloc_cnt;
 
-  /** Number of populated Path Attributes in the attrs field */
+  /** Number of populated Path Attributes (in attrs and attrs_ext) */
   int attrs_cnt;
 
+  /** Array of Path Attributes with types >= PARSEBGP_BGP_PATH_ATTRS_LEN
+   *
+   * These are only populated for attribute types that have a handler
+   * registered (see parsebgp_bgp_update_path_attr_register). Each slot is
+   * permanently associated with one attribute type, and is only populated if
+   * attrs_ext[i].type is set. Use parsebgp_bgp_update_path_attr_get to look up
+   * an attribute of any type.
+   */
+  parsebgp_bgp_update_path_attr_t *attrs_ext;
+
+  /** Attribute type that each attrs_ext slot belongs to (INTERNAL) */
+  uint8_t *_attrs_ext_types;
+
+  /** Allocated length of the attrs_ext array (INTERNAL) */
+  int _attrs_ext_alloc_cnt;
+
+  /** Handler registry used to decode these attributes (INTERNAL) */
+  const parsebgp_bgp_update_path_attr_registry_t *_registry;
+
+  /** Effective AS Path (only set if the as_path_merge option is enabled) */
+  parsebgp_bgp_update_as_path_merged_t as_path_merged;
+
+  /** Fingerprints (only set if the fingerprint option is enabled) */
+  parsebgp_bgp_update_fingerprints_t fingerprints;
+
+  /** Interned IDs (only set if the intern option is enabled) */
+  parsebgp_bgp_update_intern_ids_t intern_ids;
+
+  /* All fields below are not shared with (copied from) the attribute cache */
+
+  /** Cached block that these attributes share (INTERNAL, see the attr_cache
+      option). If set, the fields above must not be modified. */
+  struct parsebgp_attr_cache_entry *_cache_entry;
+
+  /** Attributes owned by this structure while it shares a cached block
+      (INTERNAL) */
+  struct parsebgp_bgp_update_path_attrs *_stash;
+
+  /** Buffer used to build canonical values for interning (INTERNAL) */
+  uint8_t *_scratch;
+
+  /** Allocated length of the scratch buffer (INTERNAL) */
+  size_t _scratch_alloc_len;
+
 } parsebgp_bgp_update_path_attrs_t;
 
 /**
@@ -442,4 +598,119 @@ typedef struct parsebgp_bgp_update {
 
 } parsebgp_bgp_update_t;
 
+/**
+ * Decode the data of a single Path Attribute
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] attr     Attribute to fill. The flags, type and len fields have
+ *                      already been set, and the data field holds whatever this
+ *                      handler left there the last time the slot was used.
+ * @param [in] buf      Pointer to the start of the attribute data
+ * @param [in,out] lenp Number of bytes available in buf. Must be updated to the
+ *                      number of bytes read, which must equal remain.
+ * @param [in] remain   Length of the attribute data (i.e., attr->len)
+ * @return PARSEBGP_OK (0) if the attribute was decoded successfully, or an
+ * error code otherwise
+ */
+typedef parsebgp_error_t (*parsebgp_bgp_update_path_attr_decode_func_t)(
+  parsebgp_opts_t *opts, parsebgp_bgp_update_path_attr_t *attr,
+  const uint8_t *buf, size_t *lenp, size_t remain);
+
+/** Clear the data of a Path Attribute ready for reuse */
+typedef void (*parsebgp_bgp_update_path_attr_clear_func_t)(
+  parsebgp_bgp_update_path_attr_t *attr);
+
+/** Free any memory owned by the data of a Path Attribute */
+typedef void (*parsebgp_bgp_update_path_attr_destroy_func_t)(
+  parsebgp_bgp_update_path_attr_t *attr);
+
+/** Dump a human-readable version of the data of a Path Attribute to stdout */
+typedef void (*parsebgp_bgp_update_path_attr_dump_func_t)(
+  const parsebgp_bgp_update_path_attr_t *attr, int depth);
+
+/**
+ * Path Attribute Handler
+ *
+ * Any of the functions may be NULL. An attribute type without a decode function
+ * is treated as not implemented (see parsebgp_opts_t.ignore_not_implemented).
+ * NULL clear and destroy functions indicate that the attribute data holds no
+ * dynamic memory.
+ */
+typedef struct parsebgp_bgp_update_path_attr_handler {
+
+  /** Decode the attribute data */
+  parsebgp_bgp_update_path_attr_decode_func_t decode;
+
+  /** Clear the attribute data */
+  parsebgp_bgp_update_path_attr_clear_func_t clear;
+
+  /** Destroy the attribute data */
+  parsebgp_bgp_update_path_attr_destroy_func_t destroy;
+
+  /** Dump the attribute data */
+  parsebgp_bgp_update_path_attr_dump_func_t dump;
+
+} parsebgp_bgp_update_path_attr_handler_t;
+
+/**
+ * Create a Path Attribute handler registry
+ *
+ * @return pointer to a registry pre-populated with the built-in handlers, or
+ * NULL if memory allocation failed
+ *
+ * To use the registry, set the path_attr_registry field of the BGP parsing
+ * options. The registry must outlive every message decoded using it, and must
+ * not be modified while those messages are in use.
+ */
+parsebgp_bgp_update_path_attr_registry_t *
+parsebgp_bgp_update_path_attr_registry_create(void);
+
+/**
+ * Destroy a Path Attribute handler registry
+ *
+ * @param registry      Pointer to the registry to destroy
+ */
+void parsebgp_bgp_update_path_attr_registry_destroy(
+  parsebgp_bgp_update_path_attr_registry_t *registry);
+
+/**
+ * Register (or replace) the handler for the given Path Attribute type
+ *
+ * @param registry      Pointer to the registry to update
+ * @param type          Path Attribute type code (any value 0-255)
+ * @param handler       Pointer to the handler to copy into the registry, or
+ *                      NULL to remove any existing handler
+ */
+void parsebgp_bgp_update_path_attr_register(
+  parsebgp_bgp_update_path_attr_registry_t *registry, uint8_t type,
+  const parsebgp_bgp_update_path_attr_handler_t *handler);
+
+/**
+ * Get the handler currently registered for the given Path Attribute type
+ *
+ * @param registry      Pointer to the registry (NULL for the built-in handlers)
+ * @param type          Path Attribute type code
+ * @return borrowed pointer to the handler (never NULL)
+ *
+ * This allows an application handler to wrap a built-in handler.
+ */
+const parsebgp_bgp_update_path_attr_handler_t *
+parsebgp_bgp_update_path_attr_handler_get(
+  const parsebgp_bgp_update_path_attr_registry_t *registry, uint8_t type);
+
+/**
+ * Look up a populated Path Attribute of any type
+ *
+ * @param path_attrs    Pointer to the parsed Path Attributes
+ * @param type          Path Attribute type code
+ * @return borrowed pointer to the attribute, or NULL if it is not present
+ */
+const parsebgp_bgp_update_path_attr_t *
+parsebgp_bgp_update_path_attr_get(const parsebgp_bgp_update_path_attrs_t *path_attrs,
+                                  uint8_t type);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* __PARSEBGP_BGP_UPDATE_H */
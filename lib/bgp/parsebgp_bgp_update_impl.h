@@ -38,6 +38,20 @@ parsebgp_error_t parsebgp_bgp_update_decode(parsebgp_opts_t *opts,
                                             const uint8_t *buf, size_t *lenp,
                                             size_t remain);
 
+/**
+ * Validate the structure of an UPDATE message without decoding it
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] buf      Pointer to the start of the UPDATE message body
+ * @param [in] len      Length of the UPDATE message body
+ * @param [out] errp    Set to the position of the first error on failure
+ * @return PARSEBGP_OK (0) if the message is well-formed, or an error code
+ * otherwise
+ */
+parsebgp_error_t parsebgp_bgp_update_validate(parsebgp_opts_t *opts,
+                                              const uint8_t *buf, size_t len,
+                                              const uint8_t **errp);
+
 /** Destroy an UPDATE message */
 void parsebgp_bgp_update_destroy(parsebgp_bgp_update_t *msg);
 
@@ -62,6 +76,15 @@ parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
   parsebgp_opts_t *opts, parsebgp_bgp_update_path_attrs_t *msg, const uint8_t *buf,
   size_t *lenp, size_t remain);
 
+/**
+ * Validate the structure of PATH ATTRIBUTES (including the length field)
+ * without decoding them. lenp must initially be the number of bytes left in the
+ * enclosing message, and is updated to the number of bytes validated.
+ */
+parsebgp_error_t parsebgp_bgp_update_path_attrs_validate(
+  parsebgp_opts_t *opts, const uint8_t *buf, size_t *lenp,
+  const uint8_t **errp);
+
 /** Destroy a Path Attributes message */
 void parsebgp_bgp_update_path_attrs_destroy(
   parsebgp_bgp_update_path_attrs_t *msg);
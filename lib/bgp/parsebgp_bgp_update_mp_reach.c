@@ -42,6 +42,7 @@ static parsebgp_error_t parse_afi_ipv4_ipv6_nlri(
   uint8_t p_type = 0;
   parsebgp_bgp_prefix_t *tuple;
   parsebgp_error_t err;
+  int add_path = PARSEBGP_BGP_ADD_PATH(opts, afi, safi);
 
   switch (afi) {
   case PARSEBGP_BGP_AFI_IPV4:
@@ -94,6 +95,13 @@ static parsebgp_error_t parse_afi_ipv4_ipv6_nlri(
     tuple->afi = afi;
     tuple->safi = safi;
 
+    // Path Identifier (RFC 7911)
+    tuple->path_id_valid = add_path;
+    if (add_path) {
+      PARSEBGP_ASSERT((remain - nread) > sizeof(tuple->path_id));
+      PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, tuple->path_id);
+    }
+
     // Read the prefix length
     PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, tuple->len);
 
@@ -105,6 +113,11 @@ static parsebgp_error_t parse_afi_ipv4_ipv6_nlri(
     }
     nread += slen;
     buf += slen;
+
+    // drop the prefix if it is not selected by the prefix set
+    if (!PARSEBGP_PREFIX_SELECTED(opts, afi, tuple->addr, tuple->len)) {
+      (*nlris_cnt)--;
+    }
   }
 
   *lenp = nread;
@@ -193,6 +206,11 @@ parse_reach_afi_ipv4_ipv6(parsebgp_opts_t *opts,
     }
 
     // Parse the NLRIs
+    if (!PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BGP_ANNOUNCED)) {
+      msg->nlris_cnt = 0;
+      PARSEBGP_SKIP_SECTION(buf, len, nread, remain - nread);
+      break;
+    }
     slen = len - nread;
     if ((err = parse_afi_ipv4_ipv6_nlri(
            opts, msg->afi, msg->safi, &msg->nlris, &msg->_nlris_alloc_cnt,
@@ -206,6 +224,8 @@ parse_reach_afi_ipv4_ipv6(parsebgp_opts_t *opts,
   case PARSEBGP_BGP_SAFI_MPLS:
   // TODO: add support for MPLS SAFI
   default:
+    // the next hop is skipped along with the rest of the attribute
+    msg->next_hop_len = 0;
     PARSEBGP_SKIP_NOT_IMPLEMENTED(opts, buf, nread, remain - nread,
                                   "Unsupported SAFI (%d)", msg->safi);
   }
@@ -228,6 +248,11 @@ parse_unreach_afi_ipv4_ipv6(parsebgp_opts_t *opts,
   case PARSEBGP_BGP_SAFI_UNICAST:
   case PARSEBGP_BGP_SAFI_MULTICAST:
     // Parse the NLRIs
+    if (!PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BGP_WITHDRAWN)) {
+      msg->withdrawn_nlris_cnt = 0;
+      PARSEBGP_SKIP_SECTION(buf, len, nread, remain - nread);
+      break;
+    }
     if ((err = parse_afi_ipv4_ipv6_nlri(
            opts, msg->afi, msg->safi, &msg->withdrawn_nlris,
            &msg->_withdrawn_nlris_alloc_cnt, &msg->withdrawn_nlris_cnt, buf,
@@ -257,6 +282,12 @@ parsebgp_bgp_update_mp_reach_decode(parsebgp_opts_t *opts,
   size_t len = *lenp, nread = 0, slen;
   parsebgp_error_t err;
 
+  // the clear handler is not called between messages (see
+  // parsebgp_bgp_update_path_attrs_clear), and not every AFI/SAFI (nor an
+  // error) sets these
+  msg->next_hop_len = 0;
+  msg->nlris_cnt = 0;
+
   // MRT TABLE_DUMP_V2 is annoying and can "compress" the MP_REACH header to
   // remove AFI, SAFI, and (allegedly) reserved fields
   //
@@ -298,6 +329,7 @@ parsebgp_bgp_update_mp_reach_decode(parsebgp_opts_t *opts,
     break;
 
   default:
+    msg->next_hop_len = 0;
     PARSEBGP_SKIP_NOT_IMPLEMENTED(opts, buf, nread, remain - nread,
                                   "Unsupported AFI (%d)", msg->afi);
   }
@@ -306,6 +338,73 @@ parsebgp_bgp_update_mp_reach_decode(parsebgp_opts_t *opts,
   return PARSEBGP_OK;
 }
 
+// max prefix length for the AFI/SAFIs that we can look inside (0 otherwise)
+static size_t validate_max_pfx(uint16_t afi, uint8_t safi)
+{
+  if (safi != PARSEBGP_BGP_SAFI_UNICAST && safi != PARSEBGP_BGP_SAFI_MULTICAST) {
+    return 0;
+  }
+  switch (afi) {
+  case PARSEBGP_BGP_AFI_IPV4:
+    return 32;
+
+  case PARSEBGP_BGP_AFI_IPV6:
+    return 128;
+
+  default:
+    return 0;
+  }
+}
+
+parsebgp_error_t
+parsebgp_bgp_update_mp_reach_validate(parsebgp_opts_t *opts, const uint8_t *buf,
+                                      size_t *lenp, const uint8_t **errp)
+{
+  size_t len = *lenp, nread = 0, max_pfx;
+  uint16_t afi;
+  uint8_t safi, next_hop_len;
+  const uint8_t *start = buf;
+
+  // see parsebgp_bgp_update_mp_reach_decode for the TABLE_DUMP_V2 special case
+  if (opts->bgp.mp_reach_no_afi_safi_reserved && len > 0 && *buf != 0) {
+    afi = opts->bgp.afi;
+    safi = opts->bgp.safi;
+  } else {
+    opts->bgp.mp_reach_no_afi_safi_reserved = 0;
+    PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= 3);
+    afi = nptohs(buf);
+    safi = buf[2];
+    nread += 3;
+    buf += 3;
+  }
+
+  // Next-Hop Length
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, nread < len);
+  next_hop_len = *buf;
+
+  if ((max_pfx = validate_max_pfx(afi, safi)) == 0) {
+    // we can't look inside this AFI/SAFI
+    *lenp = len;
+    return PARSEBGP_OK;
+  }
+
+  // Next-Hop (and Reserved)
+  PARSEBGP_VALIDATE_ASSERT(
+    errp, buf, (afi == PARSEBGP_BGP_AFI_IPV4 && next_hop_len == 4) ||
+                 (afi == PARSEBGP_BGP_AFI_IPV6 &&
+                  (next_hop_len == 16 || next_hop_len == 32)));
+  nread += 1 + next_hop_len;
+  if (opts->bgp.mp_reach_no_afi_safi_reserved == 0) {
+    nread++;
+  }
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, nread <= len);
+
+  *lenp = len;
+  return parsebgp_validate_prefixes(start + nread, len - nread, max_pfx,
+                                    PARSEBGP_BGP_ADD_PATH(opts, afi, safi),
+                                    errp);
+}
+
 void parsebgp_bgp_update_mp_reach_destroy(parsebgp_bgp_update_mp_reach_t *msg)
 {
   if (msg == NULL) {
@@ -365,6 +464,9 @@ parsebgp_bgp_update_mp_unreach_decode(parsebgp_opts_t *opts,
   size_t len = *lenp, nread = 0, slen;
   parsebgp_error_t err;
 
+  // (see parsebgp_bgp_update_mp_reach_decode)
+  msg->withdrawn_nlris_cnt = 0;
+
   // AFI
   PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->afi);
 
@@ -394,6 +496,26 @@ parsebgp_bgp_update_mp_unreach_decode(parsebgp_opts_t *opts,
   return PARSEBGP_OK;
 }
 
+parsebgp_error_t
+parsebgp_bgp_update_mp_unreach_validate(parsebgp_opts_t *opts,
+                                        const uint8_t *buf, size_t *lenp,
+                                        const uint8_t **errp)
+{
+  size_t len = *lenp, max_pfx;
+
+  // AFI, SAFI
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= 3);
+
+  *lenp = len;
+  if ((max_pfx = validate_max_pfx(nptohs(buf), buf[2])) == 0) {
+    // we can't look inside this AFI/SAFI
+    return PARSEBGP_OK;
+  }
+  return parsebgp_validate_prefixes(
+    buf + 3, len - 3, max_pfx,
+    PARSEBGP_BGP_ADD_PATH(opts, nptohs(buf), buf[2]), errp);
+}
+
 void parsebgp_bgp_update_mp_unreach_destroy(
   parsebgp_bgp_update_mp_unreach_t *msg)
 {
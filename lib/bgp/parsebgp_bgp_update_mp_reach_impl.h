@@ -42,6 +42,15 @@ parsebgp_bgp_update_mp_reach_decode(parsebgp_opts_t *opts,
                                     parsebgp_bgp_update_mp_reach_t *msg,
                                     const uint8_t *buf, size_t *lenp, size_t remain);
 
+/**
+ * Validate the structure of an MP_REACH attribute without decoding it. lenp
+ * must be the attribute length, and is updated to the number of bytes
+ * validated.
+ */
+parsebgp_error_t
+parsebgp_bgp_update_mp_reach_validate(parsebgp_opts_t *opts, const uint8_t *buf,
+                                      size_t *lenp, const uint8_t **errp);
+
 /** Destroy an MP_REACH message */
 void parsebgp_bgp_update_mp_reach_destroy(parsebgp_bgp_update_mp_reach_t *msg);
 
@@ -67,6 +76,12 @@ parsebgp_error_t parsebgp_bgp_update_mp_unreach_decode(
   parsebgp_opts_t *opts, parsebgp_bgp_update_mp_unreach_t *msg, const uint8_t *buf,
   size_t *lenp, size_t remain);
 
+/** Validate the structure of an MP_UNREACH attribute without decoding it */
+parsebgp_error_t
+parsebgp_bgp_update_mp_unreach_validate(parsebgp_opts_t *opts,
+                                        const uint8_t *buf, size_t *lenp,
+                                        const uint8_t **errp);
+
 /** Destroy an MP_UNREACH message */
 void parsebgp_bgp_update_mp_unreach_destroy(
   parsebgp_bgp_update_mp_unreach_t *msg);
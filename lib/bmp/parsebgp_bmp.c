@@ -26,6 +26,8 @@
 
 #include "parsebgp_bmp.h"
 #include "parsebgp_utils.h"
+#include "parsebgp_filter_impl.h"
+#include "parsebgp_session_impl.h"
 #include <arpa/inet.h>
 #include <assert.h>
 #include <stdio.h>
@@ -779,11 +781,14 @@ static parsebgp_error_t parse_peer_hdr(parsebgp_opts_t *opts,
 {
   size_t len = *lenp, nread = 0;
 
+  // the peer header is fixed-size (even for IPv4 peers), so check it once
+  PARSEBGP_DESERIALIZE_CHECK(len, nread, BMP_PEER_HDR_LEN);
+
   // Type
-  PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, hdr->type);
+  PARSEBGP_DESERIALIZE_UINT8_UNCHECKED(buf, len, nread, hdr->type);
 
   // Flags
-  PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, hdr->flags);
+  PARSEBGP_DESERIALIZE_UINT8_UNCHECKED(buf, len, nread, hdr->flags);
 
   // pass some of our flags back in the options so other parts of the parser can
   // use them
@@ -795,7 +800,7 @@ static parsebgp_error_t parse_peer_hdr(parsebgp_opts_t *opts,
   opts->bmp.peer_ip_afi = hdr->afi;
 
   // Route distinguisher
-  PARSEBGP_DESERIALIZE_VAL(buf, len, nread, hdr->dist_id);
+  PARSEBGP_DESERIALIZE_VAL_UNCHECKED(buf, len, nread, hdr->dist_id);
 
   // IP Address
   //
@@ -803,9 +808,6 @@ static parsebgp_error_t parse_peer_hdr(parsebgp_opts_t *opts,
   // meaning that it is stuck at [12, 13, 14, 15] in the hdr->addr byte array.
   // we need to rescue it
   if (hdr->afi == PARSEBGP_BGP_AFI_IPV4) {
-    if ((len - nread) < 16) {
-      return PARSEBGP_PARTIAL_MSG;
-    }
     // skip over the empty bytes
     nread += 12;
     buf += 12;
@@ -818,20 +820,20 @@ static parsebgp_error_t parse_peer_hdr(parsebgp_opts_t *opts,
     // anyway, right?
   } else {
     // IPv6, copy the full 16-bytes as-is
-    PARSEBGP_DESERIALIZE_VAL(buf, len, nread, hdr->addr);
+    PARSEBGP_DESERIALIZE_VAL_UNCHECKED(buf, len, nread, hdr->addr);
   }
 
   // AS Number
-  PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, hdr->asn);
+  PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, len, nread, hdr->asn);
 
   // BGP ID
-  PARSEBGP_DESERIALIZE_VAL(buf, len, nread, hdr->bgp_id);
+  PARSEBGP_DESERIALIZE_VAL_UNCHECKED(buf, len, nread, hdr->bgp_id);
 
   // Timestamp (seconds component)
-  PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, hdr->ts_sec);
+  PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, len, nread, hdr->ts_sec);
 
   // Timestamp (microseconds component)
-  PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, hdr->ts_usec);
+  PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, len, nread, hdr->ts_usec);
 
   assert(nread == BMP_PEER_HDR_LEN);
   *lenp = nread;
@@ -935,11 +937,13 @@ static parsebgp_error_t parse_common_hdr_v3(parsebgp_opts_t *opts,
   // We know the version...
   assert(msg->version == 3);
 
+  PARSEBGP_DESERIALIZE_CHECK(len, nread, sizeof(msg->len) + sizeof(msg->type));
+
   // Get the message length (including headers)
-  PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, msg->len);
+  PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, len, nread, msg->len);
 
   // Get the message type
-  PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, msg->type);
+  PARSEBGP_DESERIALIZE_UINT8_UNCHECKED(buf, len, nread, msg->type);
 
   // do quick sanity check on the message length
   bmplen = msg->len - BMP_HDR_V3_LEN;
@@ -1028,33 +1032,141 @@ static void dump_common_hdr(const parsebgp_bmp_msg_t *msg, int depth)
 
 /* -------------------- Main BMP Parser ----------------------------- */
 
-parsebgp_error_t parsebgp_bmp_decode(parsebgp_opts_t *opts,
-                                     parsebgp_bmp_msg_t *msg, const uint8_t *buf,
-                                     size_t *len)
+// identify the session of the peer in the peer header
+static void session_key(parsebgp_session_key_t *key,
+                        const parsebgp_bmp_msg_t *msg)
 {
+  memset(key, 0, sizeof(*key));
+  key->src = PARSEBGP_SESSION_SRC_BMP;
+  key->peer_type = msg->peer_hdr.type;
+  key->dist_id = msg->peer_hdr.dist_id;
+  key->afi = msg->peer_hdr.afi;
+  // only the address bytes for the AFI are valid (messages are reused)
+  memcpy(key->peer_ip, msg->peer_hdr.addr,
+         msg->peer_hdr.afi == PARSEBGP_BGP_AFI_IPV4 ? 4 : sizeof(key->peer_ip));
+}
+
+// learn (or forget) sessions from a fully-parsed message
+static parsebgp_error_t update_sessions(parsebgp_opts_t *opts,
+                                        const parsebgp_bmp_msg_t *msg)
+{
+  parsebgp_session_key_t key;
+  const parsebgp_bmp_peer_up_t *peer_up;
   parsebgp_error_t err;
-  size_t slen = 0, nread = 0, remain = 0;
 
-  /* First, parse the message header */
-  slen = *len;
-  if ((err = parse_common_hdr(opts, msg, buf, &slen)) != PARSEBGP_OK) {
-    return err;
+  switch (msg->type) {
+  case PARSEBGP_BMP_TYPE_PEER_UP:
+    peer_up = msg->types.peer_up;
+    session_key(&key, msg);
+    if (peer_up->sent_open->type == PARSEBGP_BGP_TYPE_OPEN &&
+        (err = parsebgp_session_set_open(opts->sessions, opts, &key, 1,
+                                         peer_up->sent_open->types.open)) !=
+          PARSEBGP_OK) {
+      return err;
+    }
+    if (peer_up->recv_open->type == PARSEBGP_BGP_TYPE_OPEN &&
+        (err = parsebgp_session_set_open(opts->sessions, opts, &key, 0,
+                                         peer_up->recv_open->types.open)) !=
+          PARSEBGP_OK) {
+      return err;
+    }
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_DOWN:
+    session_key(&key, msg);
+    parsebgp_session_remove(opts->sessions, &key);
+    break;
+
+  case PARSEBGP_BMP_TYPE_TERM_MSG:
+    // the router is closing the BMP session
+    parsebgp_session_table_clear(opts->sessions);
+    break;
+
+  default:
+    break;
   }
-  nread += slen;
 
-  /* Continue to parse the message based on the type */
-  slen = *len - nread;       // number of bytes left in the buffer
-  remain = msg->len - nread; // number of bytes left in the message
+  return PARSEBGP_OK;
+}
+
+// record the fields known from the BMP headers for the filter
+static void set_filter_fields(parsebgp_opts_t *opts,
+                              const parsebgp_bmp_msg_t *msg)
+{
+  switch (msg->type) {
+  case PARSEBGP_BMP_TYPE_INIT_MSG:
+    parsebgp_filter_set_kind(opts, PARSEBGP_FILTER_KIND_INIT);
+    // no peer header
+    return;
+
+  case PARSEBGP_BMP_TYPE_TERM_MSG:
+    parsebgp_filter_set_kind(opts, PARSEBGP_FILTER_KIND_TERM);
+    // no peer header
+    return;
+
+  case PARSEBGP_BMP_TYPE_STATS_REPORT:
+    parsebgp_filter_set_kind(opts, PARSEBGP_FILTER_KIND_STATS);
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_DOWN:
+    parsebgp_filter_set_kind(opts, PARSEBGP_FILTER_KIND_PEER_DOWN);
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_UP:
+    parsebgp_filter_set_kind(opts, PARSEBGP_FILTER_KIND_PEER_UP);
+    break;
+
+  default:
+    // the kind of Route Monitoring messages is set by the BGP parser
+    break;
+  }
+
+  parsebgp_filter_set_peer(opts, msg->peer_hdr.afi, msg->peer_hdr.addr,
+                           msg->peer_hdr.asn);
+}
+
+// has the body of this type of message been selected by the projection?
+static int body_projected(parsebgp_opts_t *opts, uint8_t type)
+{
+  switch (type) {
+  case PARSEBGP_BMP_TYPE_ROUTE_MON:
+    return PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BMP_ROUTE_MON);
+
+  case PARSEBGP_BMP_TYPE_STATS_REPORT:
+    return PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BMP_STATS);
+
+  case PARSEBGP_BMP_TYPE_PEER_DOWN:
+  case PARSEBGP_BMP_TYPE_PEER_UP:
+    return PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BMP_PEER_EVENTS);
+
+  case PARSEBGP_BMP_TYPE_INIT_MSG:
+  case PARSEBGP_BMP_TYPE_TERM_MSG:
+    return PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BMP_INFO);
+
+  default:
+    // let the decoder deal with it
+    return 1;
+  }
+}
+
+// decode the body of a message whose headers have already been parsed. buf
+// points to the first byte after the headers.
+static parsebgp_error_t decode_body(parsebgp_opts_t *opts,
+                                    parsebgp_bmp_msg_t *msg, const uint8_t *buf,
+                                    size_t *lenp)
+{
+  parsebgp_error_t err = PARSEBGP_OK;
+  size_t slen = *lenp;                    // number of bytes left in the buffer
+  size_t remain = msg->len - msg->hdr_len; // number of bytes left in the message
+  size_t nread = 0;
 
   if (remain > slen) {
-    // we already know that the message will be longer than what we have in the
-    // buffer, give up now
     return PARSEBGP_PARTIAL_MSG;
   }
 
-  if (opts->bmp.parse_headers_only) {
+  if (!body_projected(opts, msg->type)) {
     msg->types_valid = 0;
-    *len = msg->len;
+    *lenp = remain;
     return PARSEBGP_OK;
   }
   msg->types_valid = 1;
@@ -1064,61 +1176,406 @@ parsebgp_error_t parsebgp_bmp_decode(parsebgp_opts_t *opts,
     // TODO: understand if it is sufficient to believe this flag
     opts->bgp.asn_4_byte =
       !(msg->peer_hdr.flags & PARSEBGP_BMP_PEER_FLAG_2_BYTE_AS_PATH);
+    // the OPEN messages from Peer Up tell us what the session actually
+    // negotiated (but the peer header flag is explicit, so it takes
+    // precedence)
+    if (opts->sessions != NULL) {
+      parsebgp_session_key_t key;
+      const parsebgp_session_t *session;
+      session_key(&key, msg);
+      if ((session = parsebgp_session_get(opts->sessions, &key)) != NULL) {
+        parsebgp_session_apply(
+          session, opts, 0,
+          msg->peer_hdr.flags & PARSEBGP_BMP_PEER_FLAG_2_BYTE_AS_PATH);
+      }
+    }
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.route_mon);
-    err = parsebgp_bgp_decode(opts, msg->types.route_mon, buf + nread, &slen);
+    err = parsebgp_bgp_decode(opts, msg->types.route_mon, buf, &slen);
     break;
 
   case PARSEBGP_BMP_TYPE_STATS_REPORT:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.stats_report);
-    err = parse_stats_report(opts, msg->types.stats_report, buf + nread, &slen,
-                             remain);
+    err = parse_stats_report(opts, msg->types.stats_report, buf, &slen, remain);
     break;
 
   case PARSEBGP_BMP_TYPE_PEER_DOWN:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.peer_down);
-    err =
-      parse_peer_down(opts, msg->types.peer_down, buf + nread, &slen, remain);
+    err = parse_peer_down(opts, msg->types.peer_down, buf, &slen, remain);
     break;
 
   case PARSEBGP_BMP_TYPE_PEER_UP:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.peer_up);
-    err = parse_peer_up(opts, msg->types.peer_up, buf + nread, &slen, remain);
+    err = parse_peer_up(opts, msg->types.peer_up, buf, &slen, remain);
     break;
 
   case PARSEBGP_BMP_TYPE_INIT_MSG:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.init_msg);
-    err = parse_init_msg(msg->types.init_msg, buf + nread, &slen, remain);
+    err = parse_init_msg(msg->types.init_msg, buf, &slen, remain);
     break;
 
   case PARSEBGP_BMP_TYPE_TERM_MSG:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.term_msg);
-    err = parse_term_msg(msg->types.term_msg, buf + nread, &slen, remain);
+    err = parse_term_msg(msg->types.term_msg, buf, &slen, remain);
     break;
 
   case PARSEBGP_BMP_TYPE_ROUTE_MIRROR_MSG:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.route_mirror);
-    err = parse_route_mirror_msg(opts, msg->types.route_mirror, buf + nread,
-                                 &slen, remain);
+    err = parse_route_mirror_msg(opts, msg->types.route_mirror, buf, &slen,
+                                 remain);
     break;
   }
+  if (err == PARSEBGP_FILTERED_OUT) {
+    // skip the rest of the message
+    *lenp = remain;
+    return err;
+  }
   if (err != PARSEBGP_OK) {
     // parser failed
     return err;
   }
   nread += slen;
 
-  if (nread != msg->len) {
+  if (opts->sessions != NULL &&
+      (err = update_sessions(opts, msg)) != PARSEBGP_OK) {
+    return err;
+  }
+
+  if (nread != remain) {
     // we didn't parse all the bytes in the BMP message (according to
     // the length in the header).
     // either we don't know how to parse this message fully, or there
     // is trailing content in the BMP message.
-    assert(nread < msg->len);
-    PARSEBGP_SKIP_INVALID_MSG(opts, buf, nread, msg->len - nread,
+    assert(nread < remain);
+    PARSEBGP_SKIP_INVALID_MSG(opts, buf, nread, remain - nread,
                               "Unparsed data at end of BMP message (%zu bytes)",
-                              msg->len - nread);
+                              remain - nread);
+  }
+
+  *lenp = nread;
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_bmp_decode(parsebgp_opts_t *opts,
+                                     parsebgp_bmp_msg_t *msg, const uint8_t *buf,
+                                     size_t *len)
+{
+  parsebgp_error_t err;
+  size_t slen = 0, nread = 0;
+
+  /* First, parse the message header */
+  slen = *len;
+  if ((err = parse_common_hdr(opts, msg, buf, &slen)) != PARSEBGP_OK) {
+    return err;
+  }
+  nread += slen;
+  msg->hdr_len = nread;
+
+  if (msg->len - nread > *len - nread) {
+    // we already know that the message will be longer than what we have in the
+    // buffer, give up now
+    return PARSEBGP_PARTIAL_MSG;
+  }
+
+  if (opts->filter != NULL) {
+    set_filter_fields(opts, msg);
+    if (parsebgp_filter_eval(opts) == PARSEBGP_FILTER_FALSE) {
+      msg->types_valid = 0;
+      *len = msg->len;
+      return PARSEBGP_FILTERED_OUT;
+    }
+  }
+
+  if (opts->bmp.parse_headers_only) {
+    msg->types_valid = 0;
+    *len = msg->len;
+    return PARSEBGP_OK;
+  }
+
+  /* Continue to parse the message based on the type */
+  slen = *len - nread;
+  err = decode_body(opts, msg, buf + nread, &slen);
+  if (err == PARSEBGP_FILTERED_OUT) {
+    *len = msg->len;
+    return err;
+  }
+  if (err != PARSEBGP_OK) {
+    return err;
+  }
+
+  *len = nread + slen;
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_bmp_decode_body(parsebgp_opts_t *opts,
+                                          parsebgp_bmp_msg_t *msg,
+                                          const uint8_t *buf, size_t *len)
+{
+  parsebgp_error_t err;
+
+  // only a message that was decoded with parse_headers_only can be resumed
+  if (msg->types_valid || msg->hdr_len == 0 || msg->len < msg->hdr_len) {
+    return PARSEBGP_INVALID_MSG;
+  }
+
+  // restore the state that parsing the headers left in the options
+  if (msg->type != PARSEBGP_BMP_TYPE_INIT_MSG &&
+      msg->type != PARSEBGP_BMP_TYPE_TERM_MSG) {
+    opts->bmp.peer_ip_afi = msg->peer_hdr.afi;
+  }
+  if (opts->filter != NULL) {
+    set_filter_fields(opts, msg);
+    if (parsebgp_filter_eval(opts) == PARSEBGP_FILTER_FALSE) {
+      *len = msg->len - msg->hdr_len;
+      return PARSEBGP_FILTERED_OUT;
+    }
+  }
+
+  if ((err = decode_body(opts, msg, buf, len)) == PARSEBGP_FILTERED_OUT) {
+    *len = msg->len - msg->hdr_len;
+  }
+  return err;
+}
+
+/* -------------------- Validation ---------------------------------- */
+
+// validate a sequence of (type, length, value) TLVs that exactly fill the
+// buffer. if term is set, only the Termination message TLV types are allowed.
+static parsebgp_error_t validate_tlvs(const uint8_t *buf, size_t len, int term,
+                                      const uint8_t **errp)
+{
+  size_t nread = 0;
+  uint16_t type, tlv_len;
+
+  while (nread < len) {
+    // Type, Length
+    PARSEBGP_VALIDATE_ASSERT(errp, buf, len - nread >= 4);
+    type = nptohs(buf);
+    tlv_len = nptohs(buf + 2);
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + 2, tlv_len <= len - nread - 4);
+    if (term) {
+      PARSEBGP_VALIDATE_ASSERT(
+        errp, buf, type == PARSEBGP_BMP_TERM_INFO_TYPE_STRING ||
+                     (type == PARSEBGP_BMP_TERM_INFO_TYPE_REASON &&
+                      tlv_len == 2));
+    }
+    nread += 4 + tlv_len;
+    buf += 4 + tlv_len;
+  }
+
+  return PARSEBGP_OK;
+}
+
+// validate a BGP message that must exactly fill the buffer
+static parsebgp_error_t validate_bgp_msg(parsebgp_opts_t *opts,
+                                         const uint8_t *buf, size_t len,
+                                         const uint8_t **errp)
+{
+  size_t slen = len;
+  parsebgp_error_t err;
+
+  if ((err = parsebgp_bgp_validate(opts, buf, &slen, errp)) ==
+      PARSEBGP_PARTIAL_MSG) {
+    // the BGP message is longer than the BMP message
+    PARSEBGP_VALIDATE_ERR(errp, buf, PARSEBGP_INVALID_MSG);
+  }
+  if (err != PARSEBGP_OK) {
+    return err;
+  }
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + slen, slen == len);
+  return PARSEBGP_OK;
+}
+
+static parsebgp_error_t validate_stats_report(const uint8_t *buf, size_t len,
+                                              const uint8_t **errp)
+{
+  size_t nread = 4;
+  uint32_t stats_count, i;
+  uint16_t type, stat_len;
+
+  // Stats Count
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= 4);
+  stats_count = nptohl(buf);
+
+  for (i = 0; i < stats_count; i++) {
+    // Type, Length
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, len - nread >= 4);
+    type = nptohs(buf + nread);
+    stat_len = nptohs(buf + nread + 2);
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, stat_len <= len - nread - 4);
+
+    switch (type) {
+    case PARSEBGP_BMP_STATS_ROUTES_ADJ_RIB_IN:
+    case PARSEBGP_BMP_STATS_ROUTES_LOC_RIB:
+      PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, stat_len == 8);
+      break;
+
+    case PARSEBGP_BMP_STATS_ROUTES_PER_AFI_SAFI_ADJ_RIB_IN:
+    case PARSEBGP_BMP_STATS_ROUTES_PER_AFI_SAFI_LOC_RIB:
+      PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, stat_len == 11);
+      break;
+
+    default:
+      if (type <= PARSEBGP_BMP_STATS_DUP_UPD) {
+        // 32-bit counter types
+        PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, stat_len == 4);
+      }
+      break;
+    }
+    nread += 4 + stat_len;
+  }
+
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, nread == len);
+  return PARSEBGP_OK;
+}
+
+static parsebgp_error_t validate_peer_down(parsebgp_opts_t *opts,
+                                           const uint8_t *buf, size_t len,
+                                           const uint8_t **errp)
+{
+  // Reason
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= 1);
+
+  switch (*buf) {
+  case PARSEBGP_BMP_PEER_DOWN_LOCAL_CLOSE_WITH_NOTIF:
+  case PARSEBGP_BMP_PEER_DOWN_REMOTE_CLOSE_WITH_NOTIF:
+    return validate_bgp_msg(opts, buf + 1, len - 1, errp);
+
+  case PARSEBGP_BMP_PEER_DOWN_LOCAL_CLOSE:
+    // FSM code
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + 1, len == 3);
+    return PARSEBGP_OK;
+
+  default:
+    // not parsed, so only the BMP framing can be checked
+    return PARSEBGP_OK;
+  }
+}
+
+static parsebgp_error_t validate_peer_up(parsebgp_opts_t *opts,
+                                         const uint8_t *buf, size_t len,
+                                         const uint8_t **errp)
+{
+  size_t nread = 20, slen;
+  parsebgp_error_t err;
+  int i;
+
+  // Local IP, Local Port, Remote Port
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= nread);
+
+  // Sent OPEN, Received OPEN
+  for (i = 0; i < 2; i++) {
+    slen = len - nread;
+    if ((err = parsebgp_bgp_validate(opts, buf + nread, &slen, errp)) ==
+        PARSEBGP_PARTIAL_MSG) {
+      PARSEBGP_VALIDATE_ERR(errp, buf + nread, PARSEBGP_INVALID_MSG);
+    }
+    if (err != PARSEBGP_OK) {
+      return err;
+    }
+    nread += slen;
+  }
+
+  // Information TLVs (optional)
+  return validate_tlvs(buf + nread, len - nread, 0, errp);
+}
+
+parsebgp_error_t parsebgp_bmp_validate(parsebgp_opts_t *opts,
+                                       const uint8_t *buf, size_t *len,
+                                       const uint8_t **errp)
+{
+  uint32_t msg_len;
+  size_t hdr_len;
+  uint8_t type, peer_flags = 0;
+  const uint8_t *body;
+  size_t body_len;
+  parsebgp_error_t err;
+
+  if (*len < 1) {
+    PARSEBGP_VALIDATE_ERR(errp, buf + *len, PARSEBGP_PARTIAL_MSG);
+  }
+
+  switch (buf[0]) {
+  case 1:
+  case 2:
+    // the length of v1/v2 messages can only be inferred by decoding them
+    PARSEBGP_VALIDATE_ERR(errp, buf, PARSEBGP_NOT_IMPLEMENTED);
+
+  case 3:
+    if (*len < BMP_HDR_V3_LEN) {
+      PARSEBGP_VALIDATE_ERR(errp, buf + *len, PARSEBGP_PARTIAL_MSG);
+    }
+    msg_len = nptohl(buf + 1);
+    type = buf[5];
+    hdr_len = BMP_HDR_V3_LEN;
+    switch (type) {
+    case PARSEBGP_BMP_TYPE_ROUTE_MON:
+    case PARSEBGP_BMP_TYPE_STATS_REPORT:
+    case PARSEBGP_BMP_TYPE_PEER_UP:
+    case PARSEBGP_BMP_TYPE_PEER_DOWN:
+      hdr_len += BMP_PEER_HDR_LEN;
+      if (*len >= hdr_len) {
+        peer_flags = buf[BMP_HDR_V3_LEN + 1];
+      }
+      break;
+
+    case PARSEBGP_BMP_TYPE_INIT_MSG:
+    case PARSEBGP_BMP_TYPE_TERM_MSG:
+      break;
+
+    default:
+      PARSEBGP_VALIDATE_ERR(errp, buf + 5, PARSEBGP_INVALID_MSG);
+    }
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + 1, msg_len >= hdr_len);
+    break;
+
+  default:
+    PARSEBGP_VALIDATE_ERR(errp, buf, PARSEBGP_INVALID_MSG);
+  }
+
+  if (msg_len > *len) {
+    PARSEBGP_VALIDATE_ERR(errp, buf + *len, PARSEBGP_PARTIAL_MSG);
+  }
+  body = buf + hdr_len;
+  body_len = msg_len - hdr_len;
+
+  switch (type) {
+  case PARSEBGP_BMP_TYPE_ROUTE_MON:
+    opts->bgp.asn_4_byte =
+      !(peer_flags & PARSEBGP_BMP_PEER_FLAG_2_BYTE_AS_PATH);
+    err = validate_bgp_msg(opts, body, body_len, errp);
+    break;
+
+  case PARSEBGP_BMP_TYPE_STATS_REPORT:
+    err = validate_stats_report(body, body_len, errp);
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_DOWN:
+    err = validate_peer_down(opts, body, body_len, errp);
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_UP:
+    err = validate_peer_up(opts, body, body_len, errp);
+    break;
+
+  case PARSEBGP_BMP_TYPE_INIT_MSG:
+    err = validate_tlvs(body, body_len, 0, errp);
+    break;
+
+  case PARSEBGP_BMP_TYPE_TERM_MSG:
+    err = validate_tlvs(body, body_len, 1, errp);
+    break;
+
+  default:
+    // unreachable; rejected when reading the header
+    err = PARSEBGP_INVALID_MSG;
+    *errp = buf;
+    break;
+  }
+  if (err != PARSEBGP_OK) {
+    return err;
   }
 
-  *len = nread;
+  *len = msg_len;
   return PARSEBGP_OK;
 }
 
@@ -544,6 +544,10 @@ typedef struct parsebgp_bmp_msg {
   /** Message Type (parsebgp_bmp_msg_type_t) */
   uint8_t type;
 
+  /** Length of the common header and peer header (i.e., the offset of the
+   * message body) */
+  uint32_t hdr_len;
+
   /** Peer header (Not filled for TYPE_INIT_MSG and TYPE_TERM_MSG) */
   parsebgp_bmp_peer_hdr_t peer_hdr;
 
@@ -597,6 +601,42 @@ parsebgp_error_t parsebgp_bmp_decode(parsebgp_opts_t *opts,
                                      parsebgp_bmp_msg_t *msg, const uint8_t *buffer,
                                      size_t *len);
 
+/**
+ * Finish decoding a BMP message that was decoded with parse_headers_only set
+ *
+ * The common and peer headers already in the message are reused, so this can
+ * be called later (e.g., from a worker thread) with only the message body. The
+ * options need not be the ones used to decode the headers, but they must not
+ * be in use by another thread; parse_headers_only is ignored.
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] msg      Pointer to the header-only BMP Message to complete
+ * @param [in] buffer   Pointer to the message body (i.e., the raw message plus
+ *                      msg->hdr_len)
+ * @param [in,out] len  Length of the data buffer (used to prevent overrun).
+ *                      Updated to the number of bytes read from the buffer.
+ * @return PARSEBGP_OK (0) if the body was parsed successfully, or an error code
+ * otherwise
+ */
+parsebgp_error_t parsebgp_bmp_decode_body(parsebgp_opts_t *opts,
+                                          parsebgp_bmp_msg_t *msg,
+                                          const uint8_t *buffer, size_t *len);
+
+/**
+ * Validate the structure of a single BMP message without decoding it
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] buffer   Pointer to the start of a raw BMP message
+ * @param [in,out] len  Length of the data buffer. Updated to the length of the
+ *                      BMP message if it is valid.
+ * @param [out] errp    Set to the position of the first error on failure
+ * @return PARSEBGP_OK (0) if the message is well-formed, or an error code
+ * otherwise
+ */
+parsebgp_error_t parsebgp_bmp_validate(parsebgp_opts_t *opts,
+                                       const uint8_t *buffer, size_t *len,
+                                       const uint8_t **errp);
+
 /** Destroy the given BMP message structure
  *
  * @param msg           Pointer to message structure to destroy
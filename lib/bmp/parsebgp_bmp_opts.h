@@ -53,7 +53,8 @@ typedef struct parsebgp_bmp_opts {
    * (or the common header in case there is no peer header).
    *
    * The parser will only fill the common header fields, and
-   * (possibly) the peer_hdr information.
+   * (possibly) the peer_hdr information. The body can be decoded later using
+   * parsebgp_bmp_decode_body.
    */
   int parse_headers_only;
 
@@ -27,6 +27,8 @@
 #include "parsebgp_mrt.h"
 #include "parsebgp_error.h"
 #include "parsebgp_utils.h"
+#include "parsebgp_filter_impl.h"
+#include "parsebgp_session_impl.h"
 #include "parsebgp_bgp_update_impl.h"
 #include "parsebgp_bgp_notification_impl.h"
 #include "parsebgp_bgp_open_impl.h"
@@ -56,6 +58,141 @@
     }                                                                          \
   } while (0)
 
+/* -------------------- Table Dump V2 Peer Filter ------------------- */
+
+/** Number of bytes in a bitmap of all possible peer indexes */
+#define PEER_BITMAP_LEN ((UINT16_MAX + 1) / 8)
+
+/** A peer IP address in a peer filter */
+typedef struct peer_filter_ip {
+  parsebgp_bgp_afi_t afi;
+  uint8_t ip[16];
+} peer_filter_ip_t;
+
+struct parsebgp_mrt_peer_filter {
+
+  /** Peers explicitly added by index */
+  uint8_t indexes[PEER_BITMAP_LEN];
+
+  /** ASNs of peers to resolve */
+  uint32_t *asns;
+  int asns_cnt;
+  int _asns_alloc_cnt;
+
+  /** IP addresses of peers to resolve */
+  peer_filter_ip_t *ips;
+  int ips_cnt;
+  int _ips_alloc_cnt;
+};
+
+#define PEER_BIT_SET(bitmap, idx) ((bitmap)[(idx) / 8] |= 1 << ((idx) % 8))
+#define PEER_BIT_ISSET(bitmap, idx) (((bitmap)[(idx) / 8] >> ((idx) % 8)) & 1)
+
+parsebgp_mrt_peer_filter_t *parsebgp_mrt_peer_filter_create(void)
+{
+  return calloc(1, sizeof(parsebgp_mrt_peer_filter_t));
+}
+
+void parsebgp_mrt_peer_filter_destroy(parsebgp_mrt_peer_filter_t *filter)
+{
+  if (filter == NULL) {
+    return;
+  }
+  free(filter->asns);
+  free(filter->ips);
+  free(filter);
+}
+
+void parsebgp_mrt_peer_filter_add_index(parsebgp_mrt_peer_filter_t *filter,
+                                        uint16_t peer_index)
+{
+  PEER_BIT_SET(filter->indexes, peer_index);
+}
+
+parsebgp_error_t
+parsebgp_mrt_peer_filter_add_asn(parsebgp_mrt_peer_filter_t *filter,
+                                 uint32_t asn)
+{
+  PARSEBGP_MAYBE_REALLOC(filter->asns, filter->_asns_alloc_cnt,
+                         filter->asns_cnt + 1);
+  filter->asns[filter->asns_cnt++] = asn;
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t
+parsebgp_mrt_peer_filter_add_ip(parsebgp_mrt_peer_filter_t *filter,
+                                parsebgp_bgp_afi_t afi, const uint8_t *ip)
+{
+  peer_filter_ip_t *fip;
+
+  PARSEBGP_MAYBE_REALLOC(filter->ips, filter->_ips_alloc_cnt,
+                         filter->ips_cnt + 1);
+  fip = &filter->ips[filter->ips_cnt++];
+  memset(fip, 0, sizeof(*fip));
+  fip->afi = afi;
+  memcpy(fip->ip, ip, afi == PARSEBGP_BGP_AFI_IPV4 ? 4 : 16);
+  return PARSEBGP_OK;
+}
+
+// is the given peer entry selected by ASN or IP?
+static int peer_filter_match_entry(const parsebgp_mrt_peer_filter_t *filter,
+                                   const parsebgp_mrt_table_dump_v2_peer_entry_t *pe)
+{
+  int i;
+
+  for (i = 0; i < filter->asns_cnt; i++) {
+    if (filter->asns[i] == pe->asn) {
+      return 1;
+    }
+  }
+  for (i = 0; i < filter->ips_cnt; i++) {
+    if (filter->ips[i].afi == pe->ip_afi &&
+        memcmp(filter->ips[i].ip, pe->ip,
+               pe->ip_afi == PARSEBGP_BGP_AFI_IPV4 ? 4 : 16) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int parsebgp_mrt_peer_filter_match(
+  const parsebgp_mrt_peer_filter_t *filter,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index, uint16_t idx)
+{
+  return PEER_BIT_ISSET(filter->indexes, idx) ||
+         (peer_index != NULL && idx < peer_index->peer_count &&
+          peer_filter_match_entry(filter, &peer_index->peer_entries[idx]));
+}
+
+// resolve the ASNs and IPs of the filter to the entries of the given table
+// (the filter itself is shared, so the result is kept in the table)
+static void
+peer_filter_resolve(const parsebgp_mrt_peer_filter_t *filter,
+                    parsebgp_mrt_table_dump_v2_peer_index_t *peer_index)
+{
+  int i;
+
+  if (filter->asns_cnt == 0 && filter->ips_cnt == 0) {
+    return;
+  }
+  for (i = 0; i < peer_index->peer_count; i++) {
+    peer_index->peer_entries[i]._filter_matched =
+      peer_filter_match_entry(filter, &peer_index->peer_entries[i]);
+  }
+}
+
+// is the peer with the given index selected by the filter? (the table must
+// have been resolved using peer_filter_resolve)
+static int
+peer_filter_selected(const parsebgp_mrt_peer_filter_t *filter,
+                     const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index,
+                     uint16_t idx)
+{
+  return PEER_BIT_ISSET(filter->indexes, idx) ||
+         (idx < peer_index->peer_count &&
+          peer_index->peer_entries[idx]._filter_matched);
+}
+
 static parsebgp_error_t parse_table_dump(parsebgp_opts_t *opts,
                                          parsebgp_bgp_afi_t afi,
                                          parsebgp_mrt_table_dump_t *msg,
@@ -77,6 +214,10 @@ static parsebgp_error_t parse_table_dump(parsebgp_opts_t *opts,
   // Prefix Length
   PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, msg->prefix_len);
 
+  if (!PARSEBGP_PREFIX_SELECTED(opts, afi, msg->prefix, msg->prefix_len)) {
+    return PARSEBGP_FILTERED_OUT;
+  }
+
   // Status (unused)
   PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, msg->status);
 
@@ -89,6 +230,13 @@ static parsebgp_error_t parse_table_dump(parsebgp_opts_t *opts,
   // Peer ASN (2-byte only)
   PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->peer_asn);
 
+  if (opts->filter != NULL) {
+    parsebgp_filter_set_peer(opts, afi, msg->peer_ip, msg->peer_asn);
+    parsebgp_filter_match_prefix(opts, afi, msg->prefix, msg->prefix_len);
+    parsebgp_filter_prefixes_done(opts);
+    PARSEBGP_FILTER_CHECK(opts);
+  }
+
   // Path Attributes
   slen = len - nread;
   if ((err = parsebgp_bgp_update_path_attrs_decode(
@@ -98,6 +246,10 @@ static parsebgp_error_t parse_table_dump(parsebgp_opts_t *opts,
   nread += slen;
   buf += slen;
 
+  if (opts->filter != NULL) {
+    parsebgp_filter_set_path_attrs(opts, &msg->path_attrs);
+  }
+
   *lenp = nread;
   return PARSEBGP_OK;
 }
@@ -140,7 +292,8 @@ static void dump_table_dump(parsebgp_bgp_afi_t afi,
 }
 
 static parsebgp_error_t
-parse_table_dump_v2_peer_index(parsebgp_mrt_table_dump_v2_peer_index_t *msg,
+parse_table_dump_v2_peer_index(parsebgp_opts_t *opts,
+                               parsebgp_mrt_table_dump_v2_peer_index_t *msg,
                                const uint8_t *buf, size_t *lenp, size_t remain)
 {
   size_t len = *lenp, nread = 0;
@@ -170,6 +323,14 @@ parse_table_dump_v2_peer_index(parsebgp_mrt_table_dump_v2_peer_index_t *msg,
   // Peer Count
   PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->peer_count);
 
+  if (!PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_MRT_PEER_INDEX)) {
+    // skip the peer entries
+    msg->peer_count = 0;
+    PARSEBGP_SKIP_SECTION(buf, len, nread, remain - nread);
+    *lenp = nread;
+    return PARSEBGP_OK;
+  }
+
   // allocate some space for the peer entries
   PARSEBGP_MAYBE_REALLOC(msg->peer_entries,
                          msg->_peer_entries_alloc_cnt, msg->peer_count);
@@ -208,6 +369,10 @@ parse_table_dump_v2_peer_index(parsebgp_mrt_table_dump_v2_peer_index_t *msg,
     }
   }
 
+  if (opts->mrt_peer_filter != NULL) {
+    peer_filter_resolve(opts->mrt_peer_filter, msg);
+  }
+
   *lenp = nread;
   return PARSEBGP_OK;
 }
@@ -227,12 +392,9 @@ destroy_table_dump_v2_peer_index(parsebgp_mrt_table_dump_v2_peer_index_t *msg)
 static void
 clear_table_dump_v2_peer_index(parsebgp_mrt_table_dump_v2_peer_index_t *msg)
 {
-  if (msg == NULL) {
-    return;
-  }
-
-  msg->view_name_len = 0;
-  msg->peer_count = 0;
+  // the table is kept for the RIB records that follow it, and is overwritten
+  // when the next PEER_INDEX_TABLE is decoded
+  (void)msg;
 }
 
 static void
@@ -260,53 +422,109 @@ dump_table_dump_v2_peer_index(
   }
 }
 
+// AFI of the prefixes in the given AFI/SAFI-specific RIB subtype
+static parsebgp_bgp_afi_t
+table_dump_v2_rib_afi(parsebgp_mrt_table_dump_v2_subtype_t subtype)
+{
+  switch (subtype) {
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+    return PARSEBGP_BGP_AFI_IPV4;
+
+  default:
+    return PARSEBGP_BGP_AFI_IPV6;
+  }
+}
+
+// SAFI of the prefixes in the given AFI/SAFI-specific RIB subtype
+static parsebgp_bgp_safi_t
+table_dump_v2_rib_safi(parsebgp_mrt_table_dump_v2_subtype_t subtype)
+{
+  switch (subtype) {
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+    return PARSEBGP_BGP_SAFI_UNICAST;
+
+  default:
+    return PARSEBGP_BGP_SAFI_MULTICAST;
+  }
+}
+
+// do the RIB entries of the given subtype carry a Path Identifier (RFC 8050)?
+#define TABLE_DUMP_V2_RIB_ADD_PATH(subtype)                                    \
+  ((subtype) >= PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH &&         \
+   (subtype) <= PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH)
+
 static parsebgp_error_t parse_table_dump_v2_rib_entries(
   parsebgp_opts_t *opts, parsebgp_mrt_table_dump_v2_subtype_t subtype,
-  parsebgp_mrt_table_dump_v2_rib_entry_t *entries, uint16_t entry_count,
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index,
   const uint8_t *buf, size_t *lenp, size_t remain)
 {
   size_t len = *lenp, nread = 0, slen;
   int i;
+  uint16_t entry_count = msg->entry_count, kept = 0, attrs_len;
+  uint32_t filter_known, filter_true, kept_known = 0, kept_true = 0;
   parsebgp_mrt_table_dump_v2_rib_entry_t *entry;
   parsebgp_error_t err;
+  int add_path = TABLE_DUMP_V2_RIB_ADD_PATH(subtype);
 
   opts->bgp.asn_4_byte = 1;
   opts->bgp.mp_reach_no_afi_safi_reserved = 1;
-  switch (subtype) {
-  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
-    opts->bgp.afi = PARSEBGP_BGP_AFI_IPV4;
-    opts->bgp.safi = PARSEBGP_BGP_SAFI_UNICAST;
-    break;
-
-  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
-    opts->bgp.afi = PARSEBGP_BGP_AFI_IPV4;
-    opts->bgp.safi = PARSEBGP_BGP_SAFI_MULTICAST;
-    break;
-
-  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
-    opts->bgp.afi = PARSEBGP_BGP_AFI_IPV6;
-    opts->bgp.safi = PARSEBGP_BGP_SAFI_UNICAST;
-    break;
-
-  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
-    opts->bgp.afi = PARSEBGP_BGP_AFI_IPV6;
-    opts->bgp.safi = PARSEBGP_BGP_SAFI_MULTICAST;
-    break;
-
-  default:
-    // programming error
-    assert(0);
-    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  opts->bgp.afi = table_dump_v2_rib_afi(subtype);
+  opts->bgp.safi = table_dump_v2_rib_safi(subtype);
+
+  // with a filter, each entry is matched separately (starting from the state
+  // for the record), and entries that do not match are dropped
+  filter_known = opts->_filter_known;
+  filter_true = opts->_filter_true;
+
+  // when streaming, every entry is decoded into the first slot, and the record
+  // only appears to hold that entry while the callback runs (it holds none
+  // otherwise, even if decoding fails part way through)
+  if (opts->mrt_rib_entry_cb != NULL) {
+    msg->entry_count = 0;
   }
 
   for (i = 0; i < entry_count; i++) {
-    entry = &entries[i];
+    entry = &msg->entries[opts->mrt_rib_entry_cb != NULL ? 0 : kept];
+
+    // the slot may still hold an entry of an earlier record
+    if (entry->_gen != msg->_gen) {
+      parsebgp_bgp_update_path_attrs_clear(&entry->path_attrs);
+      entry->_gen = msg->_gen;
+    }
+
+    PARSEBGP_DESERIALIZE_CHECK(len, nread, sizeof(entry->peer_index) +
+                                             sizeof(entry->originated_time));
 
     // Peer Index
-    PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, entry->peer_index);
+    PARSEBGP_DESERIALIZE_UINT16_UNCHECKED(buf, len, nread, entry->peer_index);
 
     // Originated Time
-    PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, entry->originated_time);
+    PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, len, nread,
+                                          entry->originated_time);
+
+    // Path Identifier
+    if (add_path) {
+      PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, entry->path_id);
+    } else {
+      entry->path_id = 0;
+    }
+
+    // skip the path attributes of peers that we are not interested in (and
+    // reuse the slot)
+    if (opts->mrt_peer_filter != NULL &&
+        !peer_filter_selected(opts->mrt_peer_filter, peer_index,
+                              entry->peer_index)) {
+      PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, attrs_len);
+      PARSEBGP_SKIP_SECTION(buf, len, nread, attrs_len);
+      continue;
+    }
 
     // Path Attributes
     slen = len - nread;
@@ -317,8 +535,48 @@ static parsebgp_error_t parse_table_dump_v2_rib_entries(
     }
     nread += slen;
     buf += slen;
+
+    if (opts->filter != NULL) {
+      opts->_filter_known = filter_known;
+      opts->_filter_true = filter_true;
+      parsebgp_filter_set_path_attrs(opts, &entry->path_attrs);
+      parsebgp_filter_done(opts);
+      if (parsebgp_filter_eval(opts) == PARSEBGP_FILTER_FALSE) {
+        // drop this entry, and reuse its slot
+        parsebgp_bgp_update_path_attrs_clear(&entry->path_attrs);
+        continue;
+      }
+      kept_known = opts->_filter_known;
+      kept_true = opts->_filter_true;
+    }
+
+    if (opts->mrt_rib_entry_cb != NULL) {
+      // hand the entry to the callback, and then reuse the slot
+      msg->entry_count = 1;
+      err = opts->mrt_rib_entry_cb(msg, entry, opts->mrt_rib_entry_cb_user);
+      msg->entry_count = 0;
+      parsebgp_bgp_update_path_attrs_clear(&entry->path_attrs);
+      if (err != PARSEBGP_OK) {
+        return err;
+      }
+    }
+    kept++;
   }
 
+  if (kept == 0 && opts->mrt_peer_filter != NULL) {
+    return PARSEBGP_FILTERED_OUT;
+  }
+  if (opts->filter != NULL) {
+    if (kept == 0) {
+      return PARSEBGP_FILTERED_OUT;
+    }
+    // leave the state of a matching entry, so that the record matches
+    opts->_filter_known = kept_known;
+    opts->_filter_true = kept_true;
+  }
+
+  // streamed entries have already been consumed
+  msg->entry_count = (opts->mrt_rib_entry_cb != NULL) ? 0 : kept;
   *lenp = nread;
   return PARSEBGP_OK;
 }
@@ -353,26 +611,29 @@ clear_table_dump_v2_rib_entries(parsebgp_mrt_table_dump_v2_rib_entry_t *entries,
 }
 
 static parsebgp_error_t
-parse_table_dump_v2_afi_safi_rib(parsebgp_opts_t *opts,
-                                 parsebgp_mrt_table_dump_v2_subtype_t subtype,
-                                 parsebgp_mrt_table_dump_v2_afi_safi_rib_t *msg,
-                                 const uint8_t *buf, size_t *lenp, size_t remain)
+parse_table_dump_v2_afi_safi_rib(
+  parsebgp_opts_t *opts, parsebgp_mrt_table_dump_v2_subtype_t subtype,
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index,
+  const uint8_t *buf, size_t *lenp, size_t remain)
 {
   size_t len = *lenp, nread = 0, slen;
   size_t max_pfx;
+  parsebgp_bgp_afi_t afi = table_dump_v2_rib_afi(subtype);
   parsebgp_error_t err;
 
+  PARSEBGP_DESERIALIZE_CHECK(len, nread,
+                             sizeof(msg->sequence) + sizeof(msg->prefix_len));
+
   // Sequence Number
-  PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, msg->sequence);
+  PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, len, nread, msg->sequence);
 
   // Prefix Length
-  PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, msg->prefix_len);
+  PARSEBGP_DESERIALIZE_UINT8_UNCHECKED(buf, len, nread, msg->prefix_len);
 
   // Prefix
   slen = len - nread;
-  max_pfx = (subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST ||
-             subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST) ?
-              32 : 128;
+  max_pfx = (afi == PARSEBGP_BGP_AFI_IPV4) ? 32 : 128;
   err = parsebgp_decode_prefix(msg->prefix_len, msg->prefix, buf, &slen,
       max_pfx);
   if (err != PARSEBGP_OK) {
@@ -381,19 +642,39 @@ parse_table_dump_v2_afi_safi_rib(parsebgp_opts_t *opts,
   nread += slen;
   buf += slen;
 
+  // skip the RIB entries of records for prefixes we are not interested in
+  if (!PARSEBGP_PREFIX_SELECTED(opts, afi, msg->prefix, msg->prefix_len)) {
+    return PARSEBGP_FILTERED_OUT;
+  }
+
+  if (opts->filter != NULL) {
+    parsebgp_filter_match_prefix(opts, afi, msg->prefix, msg->prefix_len);
+    parsebgp_filter_prefixes_done(opts);
+    PARSEBGP_FILTER_CHECK(opts);
+  }
+
   // Entry Count
   PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->entry_count);
 
+  if (!PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_MRT_RIB_ENTRIES)) {
+    // skip the RIB entries
+    msg->entry_count = 0;
+    PARSEBGP_SKIP_SECTION(buf, len, nread, remain - nread);
+    *lenp = nread;
+    return PARSEBGP_OK;
+  }
+
   // RIB Entries
-  // allocate some memory for the entries
-  PARSEBGP_MAYBE_REALLOC(msg->entries,
-                         msg->_entries_alloc_cnt, msg->entry_count);
+  // allocate some memory for the entries (a single slot is reused when they
+  // are streamed to a callback)
+  PARSEBGP_MAYBE_REALLOC(msg->entries, msg->_entries_alloc_cnt,
+                         opts->mrt_rib_entry_cb != NULL ? 1 : msg->entry_count);
 
   // and then parse the entries
   slen = len - nread;
-  if ((err = parse_table_dump_v2_rib_entries(
-         opts, subtype, msg->entries, msg->entry_count, buf, &slen,
-         (remain - nread))) != PARSEBGP_OK) {
+  if ((err = parse_table_dump_v2_rib_entries(opts, subtype, msg, peer_index,
+                                             buf, &slen, (remain - nread))) !=
+      PARSEBGP_OK) {
     return err;
   }
   nread += slen;
@@ -420,7 +701,11 @@ clear_table_dump_v2_afi_safi_rib(parsebgp_mrt_table_dump_v2_subtype_t subtype,
   if (msg == NULL) {
     return;
   }
-  clear_table_dump_v2_rib_entries(msg->entries, msg->entry_count);
+  // the entries are cleared lazily (see parse_table_dump_v2_rib_entries),
+  // unless the generation wraps around
+  if (++msg->_gen == 0) {
+    clear_table_dump_v2_rib_entries(msg->entries, msg->_entries_alloc_cnt);
+  }
   msg->entry_count = 0;
 }
 
@@ -432,10 +717,7 @@ dump_table_dump_v2_afi_safi_rib(
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_mrt_table_dump_v2_afi_safi_rib_t, depth);
 
-  int afi = (subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST ||
-             subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST)
-              ? PARSEBGP_BGP_AFI_IPV4
-              : PARSEBGP_BGP_AFI_IPV6;
+  int afi = table_dump_v2_rib_afi(subtype);
 
   PARSEBGP_DUMP_INT(depth, "Sequence", msg->sequence);
   PARSEBGP_DUMP_PFX(depth, "Prefix", afi, msg->prefix, msg->prefix_len);
@@ -451,6 +733,9 @@ dump_table_dump_v2_afi_safi_rib(
 
     PARSEBGP_DUMP_INT(depth, "Peer Index", entry->peer_index);
     PARSEBGP_DUMP_INT(depth, "Originated Time", entry->originated_time);
+    if (TABLE_DUMP_V2_RIB_ADD_PATH(subtype)) {
+      PARSEBGP_DUMP_INT(depth, "Path ID", entry->path_id);
+    }
 
     parsebgp_bgp_update_path_attrs_dump(&entry->path_attrs, depth + 1);
   }
@@ -465,18 +750,25 @@ static parsebgp_error_t parse_table_dump_v2(
   // parser
   switch (subtype) {
   case PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE:
-    return parse_table_dump_v2_peer_index(&msg->peer_index, buf, lenp, remain);
+    return parse_table_dump_v2_peer_index(opts, &msg->peer_index, buf, lenp,
+                                          remain);
     break;
 
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
     return parse_table_dump_v2_afi_safi_rib(opts, subtype, &msg->afi_safi_rib,
-                                            buf, lenp, remain);
+                                            &msg->peer_index, buf, lenp,
+                                            remain);
     break;
 
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC_ADDPATH:
     // these probably aren't too hard to support, but bgpdump doesn't support
     // them, so it likely means we don't have any actual use for it.
     PARSEBGP_SKIP_NOT_IMPLEMENTED(opts, buf, nread, remain,
@@ -524,10 +816,15 @@ static void clear_table_dump_v2(parsebgp_mrt_table_dump_v2_subtype_t subtype,
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
     clear_table_dump_v2_afi_safi_rib(subtype, &msg->afi_safi_rib);
     break;
 
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC_ADDPATH:
   default:
     break;
   }
@@ -548,10 +845,15 @@ static void dump_table_dump_v2(parsebgp_mrt_table_dump_v2_subtype_t subtype,
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
     dump_table_dump_v2_afi_safi_rib(subtype, &msg->afi_safi_rib, depth + 1);
     break;
 
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC_ADDPATH:
   default:
     break;
   }
@@ -659,12 +961,44 @@ static parsebgp_error_t parse_bgp(parsebgp_opts_t *opts,
   return PARSEBGP_OK;
 }
 
+// was the message in a BGP4MP MESSAGE subtype sent by the local speaker?
+#define BGP4MP_LOCAL(subtype)                                                  \
+  ((subtype) == PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL ||                           \
+   (subtype) == PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL ||                       \
+   (subtype) == PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL_ADDPATH ||                   \
+   (subtype) == PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH)
+
+// does the BGP4MP MESSAGE subtype carry ADD-PATH NLRI (RFC 8050)?
+#define BGP4MP_ADD_PATH(subtype)                                               \
+  ((subtype) >= PARSEBGP_MRT_BGP4MP_MESSAGE_ADDPATH &&                         \
+   (subtype) <= PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH)
+
+// identify the session between the peer and local speaker
+static void bgp4mp_session_key(parsebgp_session_key_t *key,
+                               const parsebgp_mrt_bgp4mp_t *msg)
+{
+  size_t len;
+
+  memset(key, 0, sizeof(*key));
+  key->src = PARSEBGP_SESSION_SRC_BGP4MP;
+  key->peer_asn = msg->peer_asn;
+  key->local_asn = msg->local_asn;
+  key->afi = msg->afi;
+  // only the address bytes for the AFI are valid (messages are reused)
+  len = msg->afi == PARSEBGP_BGP_AFI_IPV4 ? 4 : sizeof(key->peer_ip);
+  memcpy(key->peer_ip, msg->peer_ip, len);
+  memcpy(key->local_ip, msg->local_ip, len);
+}
+
 static parsebgp_error_t parse_bgp4mp(parsebgp_opts_t *opts,
                                      parsebgp_mrt_bgp4mp_subtype_t subtype,
                                      parsebgp_mrt_bgp4mp_t *msg, const uint8_t *buf,
                                      size_t *lenp, size_t remain)
 {
   size_t len = *lenp, nread = 0, slen = 0;
+  parsebgp_session_key_t key;
+  const parsebgp_session_t *session;
+  int local;
   parsebgp_error_t err = PARSEBGP_OK;
 
   // ASN fields
@@ -673,6 +1007,8 @@ static parsebgp_error_t parse_bgp4mp(parsebgp_opts_t *opts,
   case PARSEBGP_MRT_BGP4MP_STATE_CHANGE:
   case PARSEBGP_MRT_BGP4MP_MESSAGE:
   case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL_ADDPATH:
     // Peer ASN
     PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->peer_asn);
 
@@ -684,6 +1020,8 @@ static parsebgp_error_t parse_bgp4mp(parsebgp_opts_t *opts,
   case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
   case PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4:
   case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH:
     // Peer ASN
     PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, msg->peer_asn);
 
@@ -726,6 +1064,11 @@ static parsebgp_error_t parse_bgp4mp(parsebgp_opts_t *opts,
     DESERIALIZE_IP(msg->afi, buf, len, nread, msg->local_ip);
   }
 
+  if (opts->filter != NULL) {
+    parsebgp_filter_set_peer(opts, msg->afi, msg->peer_ip, msg->peer_asn);
+    PARSEBGP_FILTER_CHECK(opts);
+  }
+
   // And then the actual data, based on the subtype
   // the _AS4 subtypes actually only change the common part of the message, so
   // we can treat them the same as their non-AS4 subtype at this point.
@@ -737,15 +1080,38 @@ static parsebgp_error_t parse_bgp4mp(parsebgp_opts_t *opts,
 
     // New State
     PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->data.state_change.new_state);
+
+    // the session is (being) torn down
+    if (opts->sessions != NULL &&
+        msg->data.state_change.new_state <= PARSEBGP_MRT_FSM_CODE_ACTIVE) {
+      bgp4mp_session_key(&key, msg);
+      parsebgp_session_remove(opts->sessions, &key);
+    }
     break;
 
   case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
   case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH:
     opts->bgp.asn_4_byte = 1;
   // FALL THROUGH
 
   case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
   case PARSEBGP_MRT_BGP4MP_MESSAGE:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL_ADDPATH:
+    local = BGP4MP_LOCAL(subtype);
+    if (opts->sessions != NULL) {
+      bgp4mp_session_key(&key, msg);
+      // (the subtype says whether 4-byte AS numbers are used)
+      if ((session = parsebgp_session_get(opts->sessions, &key)) != NULL) {
+        parsebgp_session_apply(session, opts, local, 1);
+      }
+    }
+    // all NLRI in the *_ADDPATH subtypes carry Path Identifiers
+    if (BGP4MP_ADD_PATH(subtype)) {
+      opts->bgp.add_path = PARSEBGP_BGP_ADD_PATH_ALL;
+    }
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->data.bgp_msg);
     slen = len - nread;
     err = parsebgp_bgp_decode_ext(opts, msg->data.bgp_msg, buf, &slen, 1);
@@ -754,6 +1120,16 @@ static parsebgp_error_t parse_bgp4mp(parsebgp_opts_t *opts,
     }
     nread += slen;
     buf += slen;
+
+    // record the capabilities of the side that sent the OPEN
+    if (opts->sessions != NULL && err == PARSEBGP_OK &&
+        msg->data.bgp_msg->type == PARSEBGP_BGP_TYPE_OPEN) {
+      if ((err = parsebgp_session_set_open(opts->sessions, opts, &key, local,
+                                           msg->data.bgp_msg->types.open)) !=
+          PARSEBGP_OK) {
+        return err;
+      }
+    }
     break;
 
   default:
@@ -794,6 +1170,10 @@ static void clear_bgp4mp(parsebgp_mrt_bgp4mp_subtype_t subtype,
   case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
   case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
   case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH:
     parsebgp_bgp_clear_msg(msg->data.bgp_msg);
     break;
 
@@ -828,6 +1208,10 @@ static void dump_bgp4mp(parsebgp_mrt_bgp4mp_subtype_t subtype,
   case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
   case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
   case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH:
     parsebgp_bgp_dump_msg(msg->data.bgp_msg, depth);
     break;
 
@@ -842,17 +1226,20 @@ static parsebgp_error_t parse_common_hdr(parsebgp_opts_t *opts,
 {
   size_t len = *lenp, nread = 0;
 
+  // check the whole (fixed-size) header is present
+  PARSEBGP_DESERIALIZE_CHECK(len, nread, MRT_HDR_LEN);
+
   // Timestamp
-  PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, msg->timestamp_sec);
+  PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, len, nread, msg->timestamp_sec);
 
   // Type
-  PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->type);
+  PARSEBGP_DESERIALIZE_UINT16_UNCHECKED(buf, len, nread, msg->type);
 
   // Sub-type
-  PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->subtype);
+  PARSEBGP_DESERIALIZE_UINT16_UNCHECKED(buf, len, nread, msg->subtype);
 
   // Length
-  PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, msg->len);
+  PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, len, nread, msg->len);
   if (msg->len > len - nread) {
     return PARSEBGP_PARTIAL_MSG;
   }
@@ -894,6 +1281,36 @@ static void dump_common_hdr(const parsebgp_mrt_msg_t *msg, int depth)
   PARSEBGP_DUMP_INT(depth, "Timestamp.usec", msg->timestamp_usec);
 }
 
+// record the kind of message (if it is known from the MRT header) for the filter
+static void set_filter_kind(parsebgp_opts_t *opts,
+                            const parsebgp_mrt_msg_t *msg)
+{
+  switch (msg->type) {
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP:
+    parsebgp_filter_set_kind(opts, PARSEBGP_FILTER_KIND_RIB);
+    break;
+
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
+    parsebgp_filter_set_kind(
+      opts, msg->subtype == PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE
+              ? PARSEBGP_FILTER_KIND_PEER_INDEX
+              : PARSEBGP_FILTER_KIND_RIB);
+    break;
+
+  case PARSEBGP_MRT_TYPE_BGP4MP:
+  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+    if (msg->subtype == PARSEBGP_MRT_BGP4MP_STATE_CHANGE ||
+        msg->subtype == PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4) {
+      parsebgp_filter_set_kind(opts, PARSEBGP_FILTER_KIND_STATE_CHANGE);
+    }
+    // otherwise the kind is set by the BGP parser
+    break;
+
+  default:
+    break;
+  }
+}
+
 parsebgp_error_t parsebgp_mrt_decode(parsebgp_opts_t *opts,
                                      parsebgp_mrt_msg_t *msg, const uint8_t *buf,
                                      size_t *len)
@@ -926,6 +1343,19 @@ parsebgp_error_t parsebgp_mrt_decode(parsebgp_opts_t *opts,
     return PARSEBGP_PARTIAL_MSG;
   }
 
+  if (opts->filter != NULL) {
+    set_filter_kind(opts, msg);
+    // (peer index tables are always decoded if they are needed to resolve the
+    // peer filter, and are then filtered out once they have been decoded)
+    if (parsebgp_filter_eval(opts) == PARSEBGP_FILTER_FALSE &&
+        !(opts->mrt_peer_filter != NULL &&
+          msg->type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 &&
+          msg->subtype == PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE)) {
+      *len = nread + remain;
+      return PARSEBGP_FILTERED_OUT;
+    }
+  }
+
   slen = remain; // don't let sub-parsers go past the end of the MRT message
   switch (msg->type) {
 
@@ -968,6 +1398,11 @@ parsebgp_error_t parsebgp_mrt_decode(parsebgp_opts_t *opts,
     // unknown message type
     PARSEBGP_RETURN_INVALID_MSG_ERR;
   }
+  if (err == PARSEBGP_FILTERED_OUT) {
+    // skip the rest of the message
+    *len = nread + remain;
+    return err;
+  }
   if (err != PARSEBGP_OK && err != PARSEBGP_TRUNCATED_MSG) {
     return err;
   }
@@ -988,6 +1423,365 @@ parsebgp_error_t parsebgp_mrt_decode(parsebgp_opts_t *opts,
   return err;
 }
 
+/* -------------------- Validation ---------------------------------- */
+
+/** Number of bytes used to encode an IP address of the given AFI (0 if the AFI
+    is not supported) */
+static size_t validate_ip_len(uint16_t afi)
+{
+  switch (afi) {
+  case PARSEBGP_BGP_AFI_IPV4:
+    return 4;
+
+  case PARSEBGP_BGP_AFI_IPV6:
+    return 16;
+
+  default:
+    return 0;
+  }
+}
+
+// validate path attributes that must exactly fill the rest of the message
+static parsebgp_error_t validate_path_attrs(parsebgp_opts_t *opts,
+                                            const uint8_t *buf, size_t len,
+                                            const uint8_t **errp)
+{
+  size_t slen = len;
+  parsebgp_error_t err;
+
+  if ((err = parsebgp_bgp_update_path_attrs_validate(opts, buf, &slen,
+                                                     errp)) != PARSEBGP_OK) {
+    return err;
+  }
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + slen, slen == len);
+  return PARSEBGP_OK;
+}
+
+static parsebgp_error_t validate_table_dump(parsebgp_opts_t *opts,
+                                            parsebgp_bgp_afi_t afi,
+                                            const uint8_t *buf, size_t len,
+                                            const uint8_t **errp)
+{
+  size_t ip_len = validate_ip_len(afi), fixed_len;
+
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, ip_len != 0);
+
+  // View, Sequence, Prefix, Prefix Length, Status, Time, Peer IP, Peer ASN
+  fixed_len = 2 + 2 + ip_len + 1 + 1 + 4 + ip_len + 2;
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= fixed_len);
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + 4 + ip_len,
+                           buf[4 + ip_len] <= ip_len * 8);
+
+  // Path Attributes
+  return validate_path_attrs(opts, buf + fixed_len, len - fixed_len, errp);
+}
+
+static parsebgp_error_t validate_table_dump_v2_peer_index(const uint8_t *buf,
+                                                          size_t len,
+                                                          const uint8_t **errp)
+{
+  size_t nread = 0, entry_len;
+  uint16_t peer_count, i;
+
+  // Collector BGP ID, View Name Length
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= 6);
+  nread = 6 + nptohs(buf + 4);
+  // View Name, Peer Count
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + 4, len >= nread + 2);
+  peer_count = nptohs(buf + nread);
+  nread += 2;
+
+  // Peer Entries
+  for (i = 0; i < peer_count; i++) {
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, nread < len);
+    // Peer Type, BGP ID, IP, ASN
+    entry_len = 1 + 4 + ((buf[nread] & 0x01) ? 16 : 4) +
+                ((buf[nread] & 0x02) ? 4 : 2);
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, entry_len <= len - nread);
+    nread += entry_len;
+  }
+
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, nread == len);
+  return PARSEBGP_OK;
+}
+
+static parsebgp_error_t
+validate_table_dump_v2_afi_safi_rib(parsebgp_opts_t *opts,
+                                    parsebgp_mrt_table_dump_v2_subtype_t subtype,
+                                    const uint8_t *buf, size_t len,
+                                    const uint8_t **errp)
+{
+  size_t nread = 0, max_pfx, slen, entry_hdr_len;
+  uint16_t entry_count, i;
+  parsebgp_error_t err;
+
+  // same parser configuration as parse_table_dump_v2_rib_entries
+  opts->bgp.asn_4_byte = 1;
+  opts->bgp.mp_reach_no_afi_safi_reserved = 1;
+  opts->bgp.afi = table_dump_v2_rib_afi(subtype);
+  opts->bgp.safi = table_dump_v2_rib_safi(subtype);
+  max_pfx = (opts->bgp.afi == PARSEBGP_BGP_AFI_IPV4) ? 32 : 128;
+  // Peer Index, Originated Time (and Path Identifier)
+  entry_hdr_len = TABLE_DUMP_V2_RIB_ADD_PATH(subtype) ? 10 : 6;
+
+  // Sequence Number, Prefix Length
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= 5);
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + 4, buf[4] <= max_pfx);
+  nread = 5 + (buf[4] + 7) / 8;
+
+  // Prefix, Entry Count
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + 4, len >= nread + 2);
+  entry_count = nptohs(buf + nread);
+  nread += 2;
+
+  // RIB Entries
+  for (i = 0; i < entry_count; i++) {
+    // Peer Index, Originated Time (and Path Identifier)
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, len - nread >= entry_hdr_len);
+    nread += entry_hdr_len;
+
+    // Path Attributes
+    slen = len - nread;
+    if ((err = parsebgp_bgp_update_path_attrs_validate(opts, buf + nread, &slen,
+                                                       errp)) != PARSEBGP_OK) {
+      return err;
+    }
+    nread += slen;
+  }
+
+  PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, nread == len);
+  return PARSEBGP_OK;
+}
+
+static parsebgp_error_t
+validate_table_dump_v2(parsebgp_opts_t *opts,
+                       parsebgp_mrt_table_dump_v2_subtype_t subtype,
+                       const uint8_t *buf, size_t len, const uint8_t **errp)
+{
+  switch (subtype) {
+  case PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE:
+    return validate_table_dump_v2_peer_index(buf, len, errp);
+
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
+    return validate_table_dump_v2_afi_safi_rib(opts, subtype, buf, len, errp);
+
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC_ADDPATH:
+    // not parsed, so only the MRT framing can be checked
+    return PARSEBGP_OK;
+
+  default:
+    PARSEBGP_VALIDATE_ERR(errp, buf, PARSEBGP_INVALID_MSG);
+  }
+}
+
+static parsebgp_error_t validate_bgp(parsebgp_opts_t *opts,
+                                     parsebgp_mrt_bgp_subtype_t subtype,
+                                     const uint8_t *buf, size_t len,
+                                     const uint8_t **errp)
+{
+  // Peer ASN, Peer IP
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= 6);
+
+  switch (subtype) {
+  case PARSEBGP_MRT_BGP_MESSAGE_NULL:
+  case PARSEBGP_MRT_BGP_MESSAGE_PREF_UPDATE:
+  case PARSEBGP_MRT_BGP_MESSAGE_SYNC:
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + 6, len == 6);
+    return PARSEBGP_OK;
+
+  case PARSEBGP_MRT_BGP_MESSAGE_STATE_CHANGE:
+    // Old State, New State
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + 6, len == 10);
+    return PARSEBGP_OK;
+
+  case PARSEBGP_MRT_BGP_MESSAGE_KEEPALIVE:
+    // Local ASN, Local IP
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + 6, len == 12);
+    return PARSEBGP_OK;
+
+  case PARSEBGP_MRT_BGP_MESSAGE_NOTIFY:
+    // Local ASN, Local IP, Error Code, Error Subcode
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + 6, len >= 14);
+    return PARSEBGP_OK;
+
+  case PARSEBGP_MRT_BGP_MESSAGE_OPEN:
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + 6, len >= 12);
+    return parsebgp_bgp_open_validate(opts, buf + 12, len - 12, errp);
+
+  case PARSEBGP_MRT_BGP_MESSAGE_UPDATE:
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + 6, len >= 12);
+    return parsebgp_bgp_update_validate(opts, buf + 12, len - 12, errp);
+
+  default:
+    PARSEBGP_VALIDATE_ERR(errp, buf, PARSEBGP_INVALID_MSG);
+  }
+}
+
+static parsebgp_error_t validate_bgp4mp(parsebgp_opts_t *opts,
+                                        parsebgp_mrt_bgp4mp_subtype_t subtype,
+                                        const uint8_t *buf, size_t len,
+                                        const uint8_t **errp)
+{
+  size_t nread, ip_len, slen;
+  parsebgp_error_t err;
+
+  // Peer ASN, Local ASN
+  switch (subtype) {
+  case PARSEBGP_MRT_BGP4MP_STATE_CHANGE:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL_ADDPATH:
+    nread = 4;
+    break;
+
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
+  case PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH:
+    nread = 8;
+    break;
+
+  default:
+    PARSEBGP_VALIDATE_ERR(errp, buf, PARSEBGP_INVALID_MSG);
+  }
+  PARSEBGP_VALIDATE_ASSERT(errp, buf, len >= nread);
+
+  // see parse_bgp4mp for the old Quagga special cases
+  if (!((subtype == PARSEBGP_MRT_BGP4MP_STATE_CHANGE && len == 8) ||
+        (subtype == PARSEBGP_MRT_BGP4MP_MESSAGE && (len - nread) > 4 &&
+         memcmp(buf + nread + 2, "\xff\xff", 2) == 0))) {
+    // Interface Index, Address Family
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, len - nread >= 4);
+    ip_len = validate_ip_len(nptohs(buf + nread + 2));
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + nread + 2, ip_len != 0);
+    nread += 4;
+
+    // Peer IP, Local IP
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, len - nread >= 2 * ip_len);
+    nread += 2 * ip_len;
+  }
+
+  switch (subtype) {
+  case PARSEBGP_MRT_BGP4MP_STATE_CHANGE:
+  case PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4:
+    // Old State, New State
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + nread, len - nread == 4);
+    break;
+
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_ADDPATH:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH:
+    opts->bgp.asn_4_byte = 1;
+  // FALL THROUGH
+
+  default:
+    if (BGP4MP_ADD_PATH(subtype)) {
+      opts->bgp.add_path = PARSEBGP_BGP_ADD_PATH_ALL;
+    }
+    slen = len - nread;
+    err = parsebgp_bgp_validate(opts, buf + nread, &slen, errp);
+    if (err == PARSEBGP_PARTIAL_MSG) {
+      // the BGP message is longer than the MRT record
+      return PARSEBGP_TRUNCATED_MSG;
+    }
+    if (err != PARSEBGP_OK) {
+      return err;
+    }
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + nread + slen, slen == len - nread);
+    break;
+  }
+
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_mrt_validate(parsebgp_opts_t *opts,
+                                       const uint8_t *buf, size_t *len,
+                                       const uint8_t **errp)
+{
+  uint32_t msg_len;
+  uint16_t type, subtype;
+  size_t hdr_len = MRT_HDR_LEN;
+  parsebgp_error_t err;
+
+  if (*len < MRT_HDR_LEN) {
+    PARSEBGP_VALIDATE_ERR(errp, buf + *len, PARSEBGP_PARTIAL_MSG);
+  }
+
+  // Timestamp (skipped), Type, Sub-type, Length
+  type = nptohs(buf + 4);
+  subtype = nptohs(buf + 6);
+  msg_len = nptohl(buf + 8);
+  if (msg_len > *len - MRT_HDR_LEN) {
+    PARSEBGP_VALIDATE_ERR(errp, buf + *len, PARSEBGP_PARTIAL_MSG);
+  }
+
+  switch (type) {
+  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+  case PARSEBGP_MRT_TYPE_ISIS_ET:
+  case PARSEBGP_MRT_TYPE_OSPF_V3_ET:
+    // the microsecond timestamp is included in the message length
+    PARSEBGP_VALIDATE_ASSERT(errp, buf + 8, msg_len >= sizeof(uint32_t));
+    hdr_len += sizeof(uint32_t);
+    break;
+
+  default:
+    break;
+  }
+
+  switch (type) {
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP:
+    err = validate_table_dump(opts, subtype, buf + hdr_len,
+                              MRT_HDR_LEN + msg_len - hdr_len, errp);
+    break;
+
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
+    err = validate_table_dump_v2(opts, subtype, buf + hdr_len,
+                                 MRT_HDR_LEN + msg_len - hdr_len, errp);
+    break;
+
+  case PARSEBGP_MRT_TYPE_BGP4MP:
+  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+    err = validate_bgp4mp(opts, subtype, buf + hdr_len,
+                          MRT_HDR_LEN + msg_len - hdr_len, errp);
+    break;
+
+  case PARSEBGP_MRT_TYPE_BGP:
+    err = validate_bgp(opts, subtype, buf + hdr_len,
+                       MRT_HDR_LEN + msg_len - hdr_len, errp);
+    break;
+
+  case PARSEBGP_MRT_TYPE_ISIS:
+  case PARSEBGP_MRT_TYPE_ISIS_ET:
+  case PARSEBGP_MRT_TYPE_OSPF_V2:
+  case PARSEBGP_MRT_TYPE_OSPF_V3:
+  case PARSEBGP_MRT_TYPE_OSPF_V3_ET:
+    // not parsed, so only the MRT framing can be checked
+    err = PARSEBGP_OK;
+    break;
+
+  default:
+    // unknown message type
+    PARSEBGP_VALIDATE_ERR(errp, buf + 4, PARSEBGP_INVALID_MSG);
+  }
+  if (err != PARSEBGP_OK) {
+    return err;
+  }
+
+  *len = MRT_HDR_LEN + msg_len;
+  return PARSEBGP_OK;
+}
+
 void parsebgp_mrt_destroy_msg(parsebgp_mrt_msg_t *msg)
 {
   if (msg == NULL) {
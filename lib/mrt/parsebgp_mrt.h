@@ -106,6 +106,9 @@ typedef struct parsebgp_mrt_table_dump_v2_peer_entry {
   /** Peer ASN */
   uint32_t asn;
 
+  /** Is the peer in the ASNs or IPs of the peer filter? (INTERNAL) */
+  uint8_t _filter_matched;
+
 } parsebgp_mrt_table_dump_v2_peer_entry_t;
 
 /**
@@ -148,9 +151,16 @@ typedef struct parsebgp_mrt_table_dump_v2_rib_entry {
   /** Time prefix was heard (in seconds since the unix epoch) */
   uint32_t originated_time;
 
+  /** ADD-PATH Path Identifier (only set for the *_ADDPATH subtypes, RFC
+      8050) */
+  uint32_t path_id;
+
   /** Path Attributes */
   parsebgp_bgp_update_path_attrs_t path_attrs;
 
+  /** Generation of the record that this entry was decoded for (INTERNAL) */
+  uint32_t _gen;
+
 } parsebgp_mrt_table_dump_v2_rib_entry_t;
 
 /**
@@ -176,8 +186,36 @@ typedef struct parsebgp_mrt_table_dump_v2_afi_safi_rib {
   /** Number of allocated RIB entries (INTERNAL) */
   uint16_t _entries_alloc_cnt;
 
+  /** Generation of the record (INTERNAL)
+   *
+   * This is incremented when the record is cleared, rather than clearing each
+   * of the entries. Entries from an earlier generation are cleared when their
+   * slot is next used. This is the only lazily-cleared structure: all other
+   * messages (including the UPDATEs of BGP4MP and BMP) are cleared by
+   * parsebgp_clear_msg as before.
+   */
+  uint32_t _gen;
+
 } parsebgp_mrt_table_dump_v2_afi_safi_rib_t;
 
+/**
+ * Callback for streaming TABLE_DUMP_V2 RIB entries (see the mrt_rib_entry_cb
+ * parsing option)
+ *
+ * @param rib           Pointer to the RIB record being decoded. The entries
+ *                      array holds only the current entry.
+ * @param entry         Pointer to the current RIB entry
+ * @param user          User data given in the parsing options
+ * @return PARSEBGP_OK to continue decoding, or an error code to abort (the
+ * error is returned by parsebgp_decode)
+ *
+ * The entry (including its path attributes) is reused for the next entry once
+ * the callback returns, so anything that is needed later must be copied.
+ */
+typedef parsebgp_error_t (*parsebgp_mrt_rib_entry_func_t)(
+  const parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib,
+  const parsebgp_mrt_table_dump_v2_rib_entry_t *entry, void *user);
+
 /**
  * Table Dump V2 Subtypes
  */
@@ -201,6 +239,21 @@ typedef enum parsebgp_mrt_table_dump_v2_subtype {
   /** Generic RIB */
   PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC = 6,
 
+  /** IPv4 Unicast RIB with ADD-PATH Path Identifiers (RFC 8050) */
+  PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH = 8,
+
+  /** IPv4 Multicast RIB with ADD-PATH Path Identifiers (RFC 8050) */
+  PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH = 9,
+
+  /** IPv6 Unicast RIB with ADD-PATH Path Identifiers (RFC 8050) */
+  PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH = 10,
+
+  /** IPv6 Multicast RIB with ADD-PATH Path Identifiers (RFC 8050) */
+  PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH = 11,
+
+  /** Generic RIB with ADD-PATH Path Identifiers (RFC 8050) */
+  PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC_ADDPATH = 12,
+
 } parsebgp_mrt_table_dump_v2_subtype_t;
 
 /*
@@ -208,7 +261,12 @@ typedef enum parsebgp_mrt_table_dump_v2_subtype {
  */
 typedef struct parsebgp_mrt_table_dump_v2 {
 
-  /** Peer Index Table */
+  /** Peer Index Table
+   *
+   * The table is kept when the message is cleared (until the next
+   * PEER_INDEX_TABLE is decoded), so the peers of the RIB records that follow
+   * it can be looked up if the message structure is reused.
+   */
   parsebgp_mrt_table_dump_v2_peer_index_t peer_index;
 
   /** AFI/SAFI-specific RIB Table */
@@ -357,6 +415,18 @@ typedef enum {
   /** 7    BGP4MP_MESSAGE_AS4_LOCAL */
   PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL = 7,
 
+  /** 8    BGP4MP_MESSAGE_ADDPATH (RFC 8050) */
+  PARSEBGP_MRT_BGP4MP_MESSAGE_ADDPATH = 8,
+
+  /** 9    BGP4MP_MESSAGE_AS4_ADDPATH (RFC 8050) */
+  PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_ADDPATH = 9,
+
+  /** 10   BGP4MP_MESSAGE_LOCAL_ADDPATH (RFC 8050) */
+  PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL_ADDPATH = 10,
+
+  /** 11   BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH (RFC 8050) */
+  PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH = 11,
+
 } parsebgp_mrt_bgp4mp_subtype_t;
 
 /**
@@ -467,6 +537,9 @@ typedef struct parsebgp_mrt_msg {
 
 } parsebgp_mrt_msg_t;
 
+/** Opaque set of TABLE_DUMP_V2 peers whose RIB entries are to be decoded */
+typedef struct parsebgp_mrt_peer_filter parsebgp_mrt_peer_filter_t;
+
 /**
  * Decode (parse) a single MRT message from the given buffer into the given MRT
  * message structure.
@@ -483,6 +556,21 @@ parsebgp_error_t parsebgp_mrt_decode(parsebgp_opts_t *opts,
                                      parsebgp_mrt_msg_t *msg, const uint8_t *buf,
                                      size_t *len);
 
+/**
+ * Validate the structure of a single MRT message without decoding it
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] buf      Pointer to the start of a raw MRT message
+ * @param [in,out] len  Length of the data buffer. Updated to the length of the
+ *                      MRT message if it is valid.
+ * @param [out] errp    Set to the position of the first error on failure
+ * @return PARSEBGP_OK (0) if the message is well-formed, or an error code
+ * otherwise
+ */
+parsebgp_error_t parsebgp_mrt_validate(parsebgp_opts_t *opts,
+                                       const uint8_t *buf, size_t *len,
+                                       const uint8_t **errp);
+
 /** Destroy the given MRT message structure
  *
  * @param msg           Pointer to message structure to destroy
@@ -508,6 +596,80 @@ void parsebgp_mrt_clear_msg(parsebgp_mrt_msg_t *msg);
  */
 void parsebgp_mrt_dump_msg(const parsebgp_mrt_msg_t *msg, int depth);
 
+/**
+ * Create an (empty) TABLE_DUMP_V2 peer filter
+ *
+ * @return pointer to the new filter, or NULL if memory allocation failed
+ *
+ * To use the filter, set the mrt_peer_filter field of the parsing options.
+ * RIB entries for peers that are not in the filter are skipped over without
+ * decoding their path attributes, and are not included in the entries array
+ * of the RIB record. A RIB record with no entries left is skipped entirely
+ * (parsebgp_decode returns PARSEBGP_FILTERED_OUT).
+ *
+ * Peers may be given by their index in the PEER_INDEX_TABLE, or by ASN and/or
+ * IP address. Peers given by ASN or IP are resolved to indexes each time a
+ * PEER_INDEX_TABLE record is decoded using the filter (so the peer entries of
+ * that record must not be excluded by the projection option), and are then
+ * matched against the RIB records decoded into the same message structure.
+ * Decoding does not modify the filter, so it may be shared by parsers that
+ * decode different files concurrently (once all peers have been added).
+ */
+parsebgp_mrt_peer_filter_t *parsebgp_mrt_peer_filter_create(void);
+
+/**
+ * Destroy the given TABLE_DUMP_V2 peer filter
+ *
+ * @param filter        Pointer to the filter to destroy
+ */
+void parsebgp_mrt_peer_filter_destroy(parsebgp_mrt_peer_filter_t *filter);
+
+/**
+ * Add a peer to the filter by its index in the PEER_INDEX_TABLE
+ *
+ * @param filter        Pointer to the filter to update
+ * @param peer_index    Index of the peer
+ */
+void parsebgp_mrt_peer_filter_add_index(parsebgp_mrt_peer_filter_t *filter,
+                                        uint16_t peer_index);
+
+/**
+ * Add all peers with the given ASN to the filter
+ *
+ * @param filter        Pointer to the filter to update
+ * @param asn           ASN of the peer(s)
+ * @return PARSEBGP_OK if the ASN was added, or PARSEBGP_MALLOC_FAILURE
+ */
+parsebgp_error_t
+parsebgp_mrt_peer_filter_add_asn(parsebgp_mrt_peer_filter_t *filter,
+                                 uint32_t asn);
+
+/**
+ * Add all peers with the given IP address to the filter
+ *
+ * @param filter        Pointer to the filter to update
+ * @param afi           Address family of the IP address
+ * @param ip            IP address of the peer(s)
+ * @return PARSEBGP_OK if the address was added, or PARSEBGP_MALLOC_FAILURE
+ */
+parsebgp_error_t
+parsebgp_mrt_peer_filter_add_ip(parsebgp_mrt_peer_filter_t *filter,
+                                parsebgp_bgp_afi_t afi, const uint8_t *ip);
+
+/**
+ * Check if the peer with the given index is in the filter
+ *
+ * @param filter        Pointer to the filter
+ * @param peer_index    Pointer to the PEER_INDEX_TABLE that the index refers
+ *                      to (may be NULL, in which case only the peers added by
+ *                      index are matched)
+ * @param idx           Index of the peer
+ * @return 1 if RIB entries for the peer are decoded, 0 otherwise
+ */
+int parsebgp_mrt_peer_filter_match(
+  const parsebgp_mrt_peer_filter_t *filter,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index, uint16_t idx);
+
 #ifdef __cplusplus
 }
 #endif
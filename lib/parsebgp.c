@@ -28,36 +28,148 @@
 #include "parsebgp_bgp.h"
 #include "parsebgp_bmp.h"
 #include "parsebgp_mrt.h"
+#include "parsebgp_filter_impl.h"
 #include "parsebgp_utils.h"
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+
+#define MRT_HDR_LEN 12    ///< MRT common header length
+#define BGP_MARKER_LEN 16 ///< BGP marker length
 
 parsebgp_error_t parsebgp_decode(parsebgp_opts_t opts, parsebgp_msg_type_t type,
                                  parsebgp_msg_t *msg, const uint8_t *buffer,
                                  size_t *len)
 {
+  parsebgp_error_t err;
+
   msg->type = type;
+  opts._filter_known = 0;
+  opts._filter_true = 0;
 
   switch (type) {
   case PARSEBGP_MSG_TYPE_BMP:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.bmp);
-    return parsebgp_bmp_decode(&opts, msg->types.bmp, buffer, len);
+    err = parsebgp_bmp_decode(&opts, msg->types.bmp, buffer, len);
     break;
 
   case PARSEBGP_MSG_TYPE_MRT:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.mrt);
-    return parsebgp_mrt_decode(&opts, msg->types.mrt, buffer, len);
+    err = parsebgp_mrt_decode(&opts, msg->types.mrt, buffer, len);
     break;
 
   case PARSEBGP_MSG_TYPE_BGP:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.bgp);
-    return parsebgp_bgp_decode(&opts, msg->types.bgp, buffer, len);
+    err = parsebgp_bgp_decode(&opts, msg->types.bgp, buffer, len);
+    break;
+
+  default:
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
+
+  // now that the whole message has been decoded, any filter terms that are
+  // still unknown refer to fields that this message does not have
+  if (err == PARSEBGP_OK && opts.filter != NULL) {
+    parsebgp_filter_done(&opts);
+    if (parsebgp_filter_eval(&opts) == PARSEBGP_FILTER_FALSE) {
+      return PARSEBGP_FILTERED_OUT;
+    }
+  }
+
+  return err;
+}
+
+parsebgp_error_t parsebgp_validate(parsebgp_opts_t opts, parsebgp_msg_type_t type,
+                                   const uint8_t *buffer, size_t *len,
+                                   size_t *err_offset)
+{
+  const uint8_t *errp = buffer;
+  parsebgp_error_t err;
+
+  switch (type) {
+  case PARSEBGP_MSG_TYPE_BMP:
+    err = parsebgp_bmp_validate(&opts, buffer, len, &errp);
+    break;
+
+  case PARSEBGP_MSG_TYPE_MRT:
+    err = parsebgp_mrt_validate(&opts, buffer, len, &errp);
     break;
 
+  case PARSEBGP_MSG_TYPE_BGP:
+    err = parsebgp_bgp_validate(&opts, buffer, len, &errp);
+    break;
+
+  default:
+    err = PARSEBGP_INVALID_MSG;
+    break;
+  }
+
+  if (err != PARSEBGP_OK && err_offset != NULL) {
+    *err_offset = errp - buffer;
+  }
+  return err;
+}
+
+parsebgp_error_t parsebgp_msg_len(parsebgp_opts_t opts, parsebgp_msg_type_t type,
+                                  const uint8_t *buffer, size_t len,
+                                  size_t *msg_len)
+{
+  parsebgp_bmp_msg_t bmp;
+  size_t hdr_len;
+  parsebgp_error_t err;
+
+  switch (type) {
+  case PARSEBGP_MSG_TYPE_MRT:
+    // the length field (at offset 8) does not include the common header
+    if (len < MRT_HDR_LEN) {
+      return PARSEBGP_PARTIAL_MSG;
+    }
+    *msg_len = MRT_HDR_LEN + (size_t)nptohl(buffer + 8);
+    return PARSEBGP_OK;
+
+  case PARSEBGP_MSG_TYPE_BGP:
+    hdr_len = opts.bgp.marker_omitted ? 0 : BGP_MARKER_LEN;
+    if (len < hdr_len + 2) {
+      return PARSEBGP_PARTIAL_MSG;
+    }
+    *msg_len = nptohs(buffer + hdr_len);
+    if (*msg_len < hdr_len + 3) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+    return PARSEBGP_OK;
+
+  case PARSEBGP_MSG_TYPE_BMP:
+    if (len < 1) {
+      return PARSEBGP_PARTIAL_MSG;
+    }
+    if (buffer[0] == 3) {
+      // v3 messages carry their length (including the common header)
+      if (len < 5) {
+        return PARSEBGP_PARTIAL_MSG;
+      }
+      *msg_len = nptohl(buffer + 1);
+      if (*msg_len < 6) {
+        PARSEBGP_RETURN_INVALID_MSG_ERR;
+      }
+      return PARSEBGP_OK;
+    }
+    // the length of v1/v2 messages has to be inferred from the headers (which
+    // does not allocate anything)
+    memset(&bmp, 0, sizeof(bmp));
+    opts.filter = NULL;
+    opts.bmp.parse_headers_only = 1;
+    hdr_len = len;
+    err = parsebgp_bmp_decode(&opts, &bmp, buffer, &hdr_len);
+    if (err == PARSEBGP_OK ||
+        (err == PARSEBGP_PARTIAL_MSG && bmp.hdr_len != 0)) {
+      *msg_len = bmp.len;
+      return PARSEBGP_OK;
+    }
+    return err;
+
   default:
     PARSEBGP_RETURN_INVALID_MSG_ERR;
   }
-  assert(0);
 }
 
 parsebgp_msg_t *parsebgp_create_msg(void)
@@ -0,0 +1,393 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_attr_cache.h"
+#include "parsebgp_attr_cache_impl.h"
+#include "parsebgp_bgp_update_impl.h"
+#include "parsebgp_utils.h"
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of bytes of parsebgp_bgp_update_path_attrs_t that are shared with
+    (copied from) a cache entry */
+#define SHARED_LEN offsetof(parsebgp_bgp_update_path_attrs_t, _cache_entry)
+
+/** The options that affect how a Path Attributes block is decoded. Must be
+    zeroed (e.g., using memset) before the fields are filled, since contexts are
+    hashed and compared as raw bytes. */
+typedef struct cache_ctx {
+
+  /** Attribute handler registry */
+  const void *registry;
+
+  /** Interning store */
+  const void *intern;
+
+  /** bgp.afi */
+  uint16_t afi;
+
+  /** bgp.safi */
+  uint8_t safi;
+
+  /** bgp.asn_4_byte */
+  uint8_t asn_4_byte;
+
+  /** bgp.asn_4_byte_negotiated */
+  uint8_t asn_4_byte_negotiated;
+
+  /** bgp.add_path */
+  uint8_t add_path;
+
+  /** bgp.mp_reach_no_afi_safi_reserved */
+  uint8_t mp_reach_no_afi_safi_reserved;
+
+  /** bgp.as_path_merge */
+  uint8_t as_path_merge;
+
+  /** bgp.fingerprint */
+  uint8_t fingerprint;
+
+} cache_ctx_t;
+
+/** A decoded Path Attributes block */
+typedef struct parsebgp_attr_cache_entry {
+
+  /** Hash of the context and the raw block */
+  uint64_t hash;
+
+  /** Options the block was decoded with */
+  cache_ctx_t ctx;
+
+  /** Copy of the raw block */
+  uint8_t *raw;
+
+  /** Length of the raw block */
+  uint16_t len;
+
+  /** Is the entry still in the cache? */
+  uint8_t cached;
+
+  /** Number of references (from the cache, and from messages sharing it) */
+  uint32_t refcnt;
+
+  /** Decoded block */
+  parsebgp_bgp_update_path_attrs_t attrs;
+
+  /** Next entry in the same hash bucket */
+  struct parsebgp_attr_cache_entry *next;
+
+  /** Previous (more recently used) entry in the LRU list */
+  struct parsebgp_attr_cache_entry *lru_prev;
+
+  /** Next (less recently used) entry in the LRU list */
+  struct parsebgp_attr_cache_entry *lru_next;
+
+} parsebgp_attr_cache_entry_t;
+
+struct parsebgp_attr_cache {
+
+  /** Hash buckets (each is a list of entries) */
+  parsebgp_attr_cache_entry_t **buckets;
+
+  /** Number of buckets (a power of two) */
+  uint32_t buckets_cnt;
+
+  /** Maximum number of entries */
+  uint32_t max_entries;
+
+  /** Number of entries */
+  uint32_t entries_cnt;
+
+  /** Most recently used entry */
+  parsebgp_attr_cache_entry_t *lru_head;
+
+  /** Least recently used entry */
+  parsebgp_attr_cache_entry_t *lru_tail;
+
+  /** Statistics */
+  parsebgp_attr_cache_stats_t stats;
+};
+
+static void set_ctx(cache_ctx_t *ctx, const parsebgp_opts_t *opts)
+{
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->registry = opts->bgp.path_attr_registry;
+  ctx->intern = opts->intern;
+  ctx->afi = opts->bgp.afi;
+  ctx->safi = opts->bgp.safi;
+  ctx->asn_4_byte = !!opts->bgp.asn_4_byte;
+  ctx->asn_4_byte_negotiated = !!opts->bgp.asn_4_byte_negotiated;
+  ctx->add_path = opts->bgp.add_path;
+  ctx->mp_reach_no_afi_safi_reserved =
+    !!opts->bgp.mp_reach_no_afi_safi_reserved;
+  ctx->as_path_merge = !!opts->bgp.as_path_merge;
+  ctx->fingerprint = !!opts->bgp.fingerprint;
+}
+
+static uint64_t hash_block(const cache_ctx_t *ctx, const uint8_t *buf,
+                           uint16_t len)
+{
+  return parsebgp_hash64(buf, len, parsebgp_hash64(ctx, sizeof(*ctx), 0));
+}
+
+static parsebgp_attr_cache_entry_t **find(const parsebgp_attr_cache_t *cache,
+                                          uint64_t hash,
+                                          const cache_ctx_t *ctx,
+                                          const uint8_t *buf, uint16_t len)
+{
+  parsebgp_attr_cache_entry_t **ep =
+    &cache->buckets[hash & (cache->buckets_cnt - 1)];
+
+  while (*ep != NULL &&
+         ((*ep)->hash != hash || (*ep)->len != len ||
+          memcmp(&(*ep)->ctx, ctx, sizeof(*ctx)) != 0 ||
+          memcmp((*ep)->raw, buf, len) != 0)) {
+    ep = &(*ep)->next;
+  }
+  return ep;
+}
+
+static void lru_unlink(parsebgp_attr_cache_t *cache,
+                       parsebgp_attr_cache_entry_t *e)
+{
+  if (e->lru_prev != NULL) {
+    e->lru_prev->lru_next = e->lru_next;
+  } else {
+    cache->lru_head = e->lru_next;
+  }
+  if (e->lru_next != NULL) {
+    e->lru_next->lru_prev = e->lru_prev;
+  } else {
+    cache->lru_tail = e->lru_prev;
+  }
+  e->lru_prev = e->lru_next = NULL;
+}
+
+static void lru_push(parsebgp_attr_cache_t *cache,
+                     parsebgp_attr_cache_entry_t *e)
+{
+  e->lru_prev = NULL;
+  e->lru_next = cache->lru_head;
+  if (cache->lru_head != NULL) {
+    cache->lru_head->lru_prev = e;
+  } else {
+    cache->lru_tail = e;
+  }
+  cache->lru_head = e;
+}
+
+static void entry_unref(parsebgp_attr_cache_entry_t *e)
+{
+  if (--e->refcnt > 0) {
+    return;
+  }
+  parsebgp_bgp_update_path_attrs_destroy(&e->attrs);
+  free(e->raw);
+  free(e);
+}
+
+// remove the given entry from the cache (it is freed once it is no longer
+// shared by any messages)
+static void evict(parsebgp_attr_cache_t *cache, parsebgp_attr_cache_entry_t *e)
+{
+  parsebgp_attr_cache_entry_t **ep =
+    &cache->buckets[e->hash & (cache->buckets_cnt - 1)];
+
+  while (*ep != e) {
+    ep = &(*ep)->next;
+  }
+  *ep = e->next;
+  e->next = NULL;
+  lru_unlink(cache, e);
+  e->cached = 0;
+  cache->entries_cnt--;
+  entry_unref(e);
+}
+
+// make path_attrs share the given entry (stashing what it owns, if anything)
+static parsebgp_error_t share(parsebgp_attr_cache_entry_t *e,
+                              parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  PARSEBGP_MAYBE_MALLOC_ZERO(path_attrs->_stash);
+  memcpy(path_attrs->_stash, path_attrs, SHARED_LEN);
+  memcpy(path_attrs, &e->attrs, SHARED_LEN);
+  path_attrs->_cache_entry = e;
+  e->refcnt++;
+  return PARSEBGP_OK;
+}
+
+// could the given decoded block be reused for other messages?
+static int cacheable(const parsebgp_opts_t *opts,
+                     const parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  // MP_REACH and MP_UNREACH carry NLRI (except in TABLE_DUMP_V2), which are
+  // rarely repeated, and are subject to the prefix filters
+  if (opts->bgp.mp_reach_no_afi_safi_reserved) {
+    return 1;
+  }
+  return path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI].type ==
+           0 &&
+         path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI].type ==
+           0;
+}
+
+parsebgp_attr_cache_t *parsebgp_attr_cache_create(uint32_t max_entries)
+{
+  parsebgp_attr_cache_t *cache;
+  uint32_t buckets_cnt = 1;
+
+  if (max_entries == 0) {
+    return NULL;
+  }
+  while (buckets_cnt < max_entries && buckets_cnt < (UINT32_C(1) << 31)) {
+    buckets_cnt *= 2;
+  }
+
+  if ((cache = calloc(1, sizeof(*cache))) == NULL) {
+    return NULL;
+  }
+  if ((cache->buckets = calloc(buckets_cnt, sizeof(*cache->buckets))) ==
+      NULL) {
+    free(cache);
+    return NULL;
+  }
+  cache->buckets_cnt = buckets_cnt;
+  cache->max_entries = max_entries;
+  return cache;
+}
+
+void parsebgp_attr_cache_destroy(parsebgp_attr_cache_t *cache)
+{
+  if (cache == NULL) {
+    return;
+  }
+  parsebgp_attr_cache_clear(cache);
+  free(cache->buckets);
+  free(cache);
+}
+
+void parsebgp_attr_cache_clear(parsebgp_attr_cache_t *cache)
+{
+  while (cache->lru_tail != NULL) {
+    evict(cache, cache->lru_tail);
+  }
+}
+
+void parsebgp_attr_cache_get_stats(const parsebgp_attr_cache_t *cache,
+                                   parsebgp_attr_cache_stats_t *stats)
+{
+  *stats = cache->stats;
+}
+
+int parsebgp_attr_cache_lookup(parsebgp_attr_cache_t *cache,
+                               const parsebgp_opts_t *opts, const uint8_t *buf,
+                               uint16_t len,
+                               parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  parsebgp_attr_cache_entry_t *e;
+  cache_ctx_t ctx;
+
+  assert(path_attrs->_cache_entry == NULL);
+  cache->stats.lookups++;
+
+  set_ctx(&ctx, opts);
+  e = *find(cache, hash_block(&ctx, buf, len), &ctx, buf, len);
+  if (e == NULL || share(e, path_attrs) != PARSEBGP_OK) {
+    return 0;
+  }
+
+  if (cache->lru_head != e) {
+    lru_unlink(cache, e);
+    lru_push(cache, e);
+  }
+  cache->stats.hits++;
+  cache->stats.bytes_saved += len;
+  return 1;
+}
+
+parsebgp_error_t
+parsebgp_attr_cache_insert(parsebgp_attr_cache_t *cache,
+                           const parsebgp_opts_t *opts, const uint8_t *buf,
+                           uint16_t len,
+                           parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  parsebgp_attr_cache_entry_t *e, **ep;
+
+  assert(path_attrs->_cache_entry == NULL);
+  if (!cacheable(opts, path_attrs)) {
+    return PARSEBGP_OK;
+  }
+
+  if ((e = malloc_zero(sizeof(*e))) == NULL) {
+    return PARSEBGP_MALLOC_FAILURE;
+  }
+  if ((e->raw = malloc(len > 0 ? len : 1)) == NULL) {
+    free(e);
+    return PARSEBGP_MALLOC_FAILURE;
+  }
+  memcpy(e->raw, buf, len);
+  e->len = len;
+  set_ctx(&e->ctx, opts);
+  e->hash = hash_block(&e->ctx, buf, len);
+
+  if (cache->entries_cnt == cache->max_entries) {
+    evict(cache, cache->lru_tail);
+    cache->stats.evictions++;
+  }
+  ep = find(cache, e->hash, &e->ctx, buf, len);
+  // a lookup for this block must have just missed
+  assert(*ep == NULL);
+
+  // move the decoded data into the entry, and then share it (path_attrs is
+  // left owning nothing, so there is nothing to stash)
+  memcpy(&e->attrs, path_attrs, SHARED_LEN);
+  path_attrs->_cache_entry = e;
+  e->refcnt = 2;
+
+  e->cached = 1;
+  *ep = e;
+  lru_push(cache, e);
+  cache->entries_cnt++;
+  cache->stats.inserts++;
+  return PARSEBGP_OK;
+}
+
+void parsebgp_attr_cache_release(parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  parsebgp_attr_cache_entry_t *e = path_attrs->_cache_entry;
+
+  assert(e != NULL);
+  if (path_attrs->_stash != NULL) {
+    memcpy(path_attrs, path_attrs->_stash, SHARED_LEN);
+    memset(path_attrs->_stash, 0, SHARED_LEN);
+  } else {
+    memset(path_attrs, 0, SHARED_LEN);
+  }
+  path_attrs->_cache_entry = NULL;
+  entry_unref(e);
+}
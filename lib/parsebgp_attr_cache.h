@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_ATTR_CACHE_H
+#define __PARSEBGP_ATTR_CACHE_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque cache of decoded Path Attributes */
+typedef struct parsebgp_attr_cache parsebgp_attr_cache_t;
+
+/** Attribute cache statistics */
+typedef struct parsebgp_attr_cache_stats {
+
+  /** Number of Path Attribute blocks looked up in the cache */
+  uint64_t lookups;
+
+  /** Number of lookups that found a decoded copy of the block */
+  uint64_t hits;
+
+  /** Number of decoded blocks added to the cache */
+  uint64_t inserts;
+
+  /** Number of blocks evicted to make room for newer ones */
+  uint64_t evictions;
+
+  /** Number of Path Attribute bytes that did not need to be decoded */
+  uint64_t bytes_saved;
+
+} parsebgp_attr_cache_stats_t;
+
+/**
+ * Create an empty attribute cache
+ *
+ * @param max_entries   maximum number of decoded Path Attribute blocks to keep
+ *                      (the least recently used block is evicted to make room
+ *                      for a new one)
+ * @return pointer to the new cache, or NULL if memory could not be allocated
+ *
+ * To use the cache, set the attr_cache field of the parsing options. Each
+ * block of Path Attributes is then looked up (by its raw bytes) before it is
+ * decoded, and if the same block was recently decoded (using the same
+ * options), the message shares the cached copy instead of decoding it again.
+ * This is most effective for RIB dumps and BMP streams, where the same
+ * attributes are seen for many prefixes and peers.
+ *
+ * A shared copy must not be modified, and is only valid until the message is
+ * cleared or destroyed. Blocks that contain MP_REACH or MP_UNREACH attributes
+ * (with NLRI) are never cached, and any registered attribute handlers must
+ * not have side effects (since they are not called on a cache hit).
+ *
+ * The cache assumes that the path_attr_filter, path_attr_raw and prefix_set
+ * options do not change while it is in use (clear the cache if they do). It
+ * is modified while messages are decoded, so it must not be shared between
+ * parsers that run concurrently.
+ */
+parsebgp_attr_cache_t *parsebgp_attr_cache_create(uint32_t max_entries);
+
+/**
+ * Destroy the given attribute cache
+ *
+ * @param cache         pointer to the cache to destroy
+ *
+ * Messages that share decoded blocks with the cache remain valid until they
+ * are cleared or destroyed.
+ */
+void parsebgp_attr_cache_destroy(parsebgp_attr_cache_t *cache);
+
+/**
+ * Remove all blocks from the given cache (statistics are not reset)
+ *
+ * @param cache         pointer to the cache to clear
+ */
+void parsebgp_attr_cache_clear(parsebgp_attr_cache_t *cache);
+
+/**
+ * Get the statistics of the given cache
+ *
+ * @param cache         pointer to the cache
+ * @param [out] stats   filled with the statistics of the cache
+ */
+void parsebgp_attr_cache_get_stats(const parsebgp_attr_cache_t *cache,
+                                   parsebgp_attr_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PARSEBGP_ATTR_CACHE_H */
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_ATTR_CACHE_IMPL_H
+#define __PARSEBGP_ATTR_CACHE_IMPL_H
+
+#include "parsebgp_attr_cache.h"
+#include "parsebgp_bgp_update.h"
+#include "parsebgp_opts.h"
+#include <inttypes.h>
+
+/** Look up the given (raw) Path Attributes block. If a decoded copy is found,
+    path_attrs is made to share it, and 1 is returned. Otherwise 0 is
+    returned, and path_attrs is untouched. */
+int parsebgp_attr_cache_lookup(parsebgp_attr_cache_t *cache,
+                               const parsebgp_opts_t *opts, const uint8_t *buf,
+                               uint16_t len,
+                               parsebgp_bgp_update_path_attrs_t *path_attrs);
+
+/** Add the given block (just decoded into path_attrs) to the cache, if it can
+    be cached. The decoded data is moved into the cache, and path_attrs is made
+    to share it. */
+parsebgp_error_t
+parsebgp_attr_cache_insert(parsebgp_attr_cache_t *cache,
+                           const parsebgp_opts_t *opts, const uint8_t *buf,
+                           uint16_t len,
+                           parsebgp_bgp_update_path_attrs_t *path_attrs);
+
+/** Stop sharing a cached block, and restore the Path Attributes that
+    path_attrs owned before it started sharing (so that they can be reused) */
+void parsebgp_attr_cache_release(parsebgp_bgp_update_path_attrs_t *path_attrs);
+
+#endif /* __PARSEBGP_ATTR_CACHE_IMPL_H */
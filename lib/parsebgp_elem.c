@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_elem.h"
+#include "parsebgp.h"
+#include <string.h>
+
+/** Sources of elements, in the order they are visited */
+enum {
+  STAGE_WITHDRAWN,
+  STAGE_MP_UNREACH,
+  STAGE_ANNOUNCED,
+  STAGE_MP_REACH,
+  STAGE_RIB,
+  STAGE_SINGLE,
+  STAGE_DONE,
+};
+
+// do the given TABLE_DUMP_V2 subtype hold RIB entries that we can iterate?
+static int td2_rib_subtype(uint16_t subtype)
+{
+  switch (subtype) {
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
+    return 1;
+
+  default:
+    return 0;
+  }
+}
+
+static void set_rib_prefix(parsebgp_elem_iter_t *iter, parsebgp_bgp_afi_t afi,
+                           parsebgp_bgp_safi_t safi, const uint8_t *addr,
+                           uint8_t len)
+{
+  parsebgp_bgp_prefix_t *pfx = &iter->_prefix;
+
+  pfx->type = (afi == PARSEBGP_BGP_AFI_IPV4) ? PARSEBGP_BGP_PREFIX_UNICAST_IPV4
+                                             : PARSEBGP_BGP_PREFIX_UNICAST_IPV6;
+  pfx->afi = afi;
+  pfx->safi = safi;
+  pfx->len = len;
+  memcpy(pfx->addr, addr, sizeof(pfx->addr));
+  iter->_elem.prefix = pfx;
+}
+
+// point the element at the next hop given by the path attributes
+static void set_next_hop(parsebgp_elem_t *elem,
+                         const parsebgp_bgp_update_path_attrs_t *path_attrs,
+                         int mp)
+{
+  const parsebgp_bgp_update_path_attr_t *attr;
+
+  attr = &path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI];
+  if (mp && attr->type == PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI) {
+    elem->next_hop_afi = attr->data.mp_reach->afi;
+    elem->next_hop = attr->data.mp_reach->next_hop;
+    return;
+  }
+  attr = &path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_NEXT_HOP];
+  if (attr->type == PARSEBGP_BGP_PATH_ATTR_TYPE_NEXT_HOP) {
+    elem->next_hop_afi = PARSEBGP_BGP_AFI_IPV4;
+    elem->next_hop = attr->data.next_hop;
+  } else {
+    elem->next_hop_afi = 0;
+    elem->next_hop = NULL;
+  }
+}
+
+static void set_update(parsebgp_elem_iter_t *iter,
+                       const parsebgp_bgp_msg_t *bgp)
+{
+  if (bgp == NULL || bgp->type != PARSEBGP_BGP_TYPE_UPDATE) {
+    return;
+  }
+  iter->_update = bgp->types.update;
+  iter->_stage = STAGE_WITHDRAWN;
+}
+
+static void set_peer_state(parsebgp_elem_iter_t *iter, uint16_t old_state,
+                           uint16_t new_state)
+{
+  iter->_elem.type = PARSEBGP_ELEM_TYPE_PEER_STATE;
+  iter->_elem.old_state = old_state;
+  iter->_elem.new_state = new_state;
+  iter->_stage = STAGE_SINGLE;
+}
+
+static void init_bmp(parsebgp_elem_iter_t *iter, const parsebgp_bmp_msg_t *bmp)
+{
+  parsebgp_elem_t *elem = &iter->_elem;
+
+  if (!bmp->types_valid) {
+    return;
+  }
+
+  switch (bmp->type) {
+  case PARSEBGP_BMP_TYPE_ROUTE_MON:
+  case PARSEBGP_BMP_TYPE_PEER_UP:
+  case PARSEBGP_BMP_TYPE_PEER_DOWN:
+    elem->timestamp_sec = bmp->peer_hdr.ts_sec;
+    elem->timestamp_usec = bmp->peer_hdr.ts_usec;
+    elem->peer_afi = bmp->peer_hdr.afi;
+    elem->peer_ip = bmp->peer_hdr.addr;
+    elem->peer_asn = bmp->peer_hdr.asn;
+    break;
+
+  default:
+    return;
+  }
+
+  switch (bmp->type) {
+  case PARSEBGP_BMP_TYPE_ROUTE_MON:
+    set_update(iter, bmp->types.route_mon);
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_UP:
+    set_peer_state(iter, PARSEBGP_MRT_FSM_CODE_IDLE,
+                   PARSEBGP_MRT_FSM_CODE_ESTABLISHED);
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_DOWN:
+    set_peer_state(iter, PARSEBGP_MRT_FSM_CODE_ESTABLISHED,
+                   PARSEBGP_MRT_FSM_CODE_IDLE);
+    break;
+  }
+}
+
+static void init_table_dump_v2(
+  parsebgp_elem_iter_t *iter, const parsebgp_mrt_msg_t *mrt,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index)
+{
+  const parsebgp_mrt_table_dump_v2_t *td2 = mrt->types.table_dump_v2;
+  parsebgp_bgp_afi_t afi;
+  parsebgp_bgp_safi_t safi;
+
+  if (!td2_rib_subtype(mrt->subtype)) {
+    return;
+  }
+
+  switch (mrt->subtype) {
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+    afi = PARSEBGP_BGP_AFI_IPV4;
+    safi = PARSEBGP_BGP_SAFI_UNICAST;
+    break;
+
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+    afi = PARSEBGP_BGP_AFI_IPV4;
+    safi = PARSEBGP_BGP_SAFI_MULTICAST;
+    break;
+
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+    afi = PARSEBGP_BGP_AFI_IPV6;
+    safi = PARSEBGP_BGP_SAFI_UNICAST;
+    break;
+
+  default:
+    afi = PARSEBGP_BGP_AFI_IPV6;
+    safi = PARSEBGP_BGP_SAFI_MULTICAST;
+    break;
+  }
+
+  iter->_rib = &td2->afi_safi_rib;
+  iter->_peer_index = (peer_index != NULL) ? peer_index : &td2->peer_index;
+  set_rib_prefix(iter, afi, safi, iter->_rib->prefix, iter->_rib->prefix_len);
+  iter->_prefix.path_id_valid =
+    mrt->subtype >= PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH;
+  iter->_elem.type = PARSEBGP_ELEM_TYPE_RIB;
+  iter->_stage = STAGE_RIB;
+}
+
+static void init_mrt(parsebgp_elem_iter_t *iter, const parsebgp_mrt_msg_t *mrt,
+                     const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index)
+{
+  parsebgp_elem_t *elem = &iter->_elem;
+  const parsebgp_mrt_table_dump_t *td;
+  const parsebgp_mrt_bgp4mp_t *bgp4mp;
+  const parsebgp_mrt_bgp_t *bgp;
+
+  elem->timestamp_sec = mrt->timestamp_sec;
+  elem->timestamp_usec = mrt->timestamp_usec;
+
+  switch (mrt->type) {
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP:
+    // the subtype is the AFI
+    td = mrt->types.table_dump;
+    elem->type = PARSEBGP_ELEM_TYPE_RIB;
+    elem->peer_afi = mrt->subtype;
+    elem->peer_ip = td->peer_ip;
+    elem->peer_asn = td->peer_asn;
+    set_rib_prefix(iter, mrt->subtype, PARSEBGP_BGP_SAFI_UNICAST, td->prefix,
+                   td->prefix_len);
+    elem->path_attrs = &td->path_attrs;
+    set_next_hop(elem, &td->path_attrs, 1);
+    iter->_stage = STAGE_SINGLE;
+    break;
+
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
+    init_table_dump_v2(iter, mrt, peer_index);
+    break;
+
+  case PARSEBGP_MRT_TYPE_BGP4MP:
+  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+    bgp4mp = mrt->types.bgp4mp;
+    elem->peer_afi = bgp4mp->afi;
+    elem->peer_ip = bgp4mp->peer_ip;
+    elem->peer_asn = bgp4mp->peer_asn;
+    switch (mrt->subtype) {
+    case PARSEBGP_MRT_BGP4MP_STATE_CHANGE:
+    case PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4:
+      set_peer_state(iter, bgp4mp->data.state_change.old_state,
+                     bgp4mp->data.state_change.new_state);
+      break;
+
+    default:
+      set_update(iter, bgp4mp->data.bgp_msg);
+      break;
+    }
+    break;
+
+  case PARSEBGP_MRT_TYPE_BGP:
+    // the deprecated BGP type only supports IPv4 peers
+    bgp = mrt->types.bgp;
+    elem->peer_afi = PARSEBGP_BGP_AFI_IPV4;
+    elem->peer_ip = bgp->peer_ip;
+    elem->peer_asn = bgp->peer_asn;
+    switch (mrt->subtype) {
+    case PARSEBGP_MRT_BGP_MESSAGE_UPDATE:
+      if (bgp->data.update != NULL) {
+        iter->_update = bgp->data.update;
+        iter->_stage = STAGE_WITHDRAWN;
+      }
+      break;
+
+    case PARSEBGP_MRT_BGP_MESSAGE_STATE_CHANGE:
+      set_peer_state(iter, bgp->data.state_change.old_state,
+                     bgp->data.state_change.new_state);
+      break;
+    }
+    break;
+  }
+}
+
+void parsebgp_elem_iter_init(
+  parsebgp_elem_iter_t *iter, const struct parsebgp_msg *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index)
+{
+  memset(iter, 0, sizeof(*iter));
+  iter->_stage = STAGE_DONE;
+
+  switch (msg->type) {
+  case PARSEBGP_MSG_TYPE_BGP:
+    set_update(iter, msg->types.bgp);
+    break;
+
+  case PARSEBGP_MSG_TYPE_BMP:
+    init_bmp(iter, msg->types.bmp);
+    break;
+
+  case PARSEBGP_MSG_TYPE_MRT:
+    init_mrt(iter, msg->types.mrt, peer_index);
+    break;
+
+  default:
+    break;
+  }
+}
+
+const parsebgp_elem_t *parsebgp_elem_iter_next(parsebgp_elem_iter_t *iter)
+{
+  parsebgp_elem_t *elem = &iter->_elem;
+  const parsebgp_bgp_update_t *update = iter->_update;
+  const parsebgp_bgp_update_path_attr_t *attr;
+  const parsebgp_mrt_table_dump_v2_rib_entry_t *entry;
+  const parsebgp_mrt_table_dump_v2_peer_entry_t *peer;
+
+  for (;;) {
+    switch (iter->_stage) {
+    case STAGE_WITHDRAWN:
+      if (iter->_idx < update->withdrawn_nlris.prefixes_cnt) {
+        elem->type = PARSEBGP_ELEM_TYPE_WITHDRAWAL;
+        elem->prefix = &update->withdrawn_nlris.prefixes[iter->_idx++];
+        return elem;
+      }
+      break;
+
+    case STAGE_MP_UNREACH:
+      attr =
+        &update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI];
+      if (attr->type == PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI &&
+          iter->_idx < attr->data.mp_unreach->withdrawn_nlris_cnt) {
+        elem->type = PARSEBGP_ELEM_TYPE_WITHDRAWAL;
+        elem->prefix = &attr->data.mp_unreach->withdrawn_nlris[iter->_idx++];
+        return elem;
+      }
+      break;
+
+    case STAGE_ANNOUNCED:
+      if (iter->_idx < update->announced_nlris.prefixes_cnt) {
+        if (iter->_idx == 0) {
+          elem->type = PARSEBGP_ELEM_TYPE_ANNOUNCEMENT;
+          elem->path_attrs = &update->path_attrs;
+          set_next_hop(elem, &update->path_attrs, 0);
+        }
+        elem->prefix = &update->announced_nlris.prefixes[iter->_idx++];
+        return elem;
+      }
+      break;
+
+    case STAGE_MP_REACH:
+      attr =
+        &update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI];
+      if (attr->type == PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI &&
+          iter->_idx < attr->data.mp_reach->nlris_cnt) {
+        if (iter->_idx == 0) {
+          elem->type = PARSEBGP_ELEM_TYPE_ANNOUNCEMENT;
+          elem->path_attrs = &update->path_attrs;
+          set_next_hop(elem, &update->path_attrs, 1);
+        }
+        elem->prefix = &attr->data.mp_reach->nlris[iter->_idx++];
+        return elem;
+      }
+      break;
+
+    case STAGE_RIB:
+      if (iter->_idx < iter->_rib->entry_count) {
+        entry = &iter->_rib->entries[iter->_idx++];
+        if (entry->peer_index < iter->_peer_index->peer_count) {
+          peer = &iter->_peer_index->peer_entries[entry->peer_index];
+          elem->peer_afi = peer->ip_afi;
+          elem->peer_ip = peer->ip;
+          elem->peer_asn = peer->asn;
+        } else {
+          elem->peer_afi = 0;
+          elem->peer_ip = NULL;
+          elem->peer_asn = 0;
+        }
+        iter->_prefix.path_id = entry->path_id;
+        elem->path_attrs = &entry->path_attrs;
+        set_next_hop(elem, &entry->path_attrs, 1);
+        return elem;
+      }
+      iter->_stage = STAGE_DONE;
+      return NULL;
+
+    case STAGE_SINGLE:
+      iter->_stage = STAGE_DONE;
+      return elem;
+
+    default:
+      return NULL;
+    }
+
+    // move on to the next source of UPDATE elements
+    if (++iter->_stage == STAGE_RIB) {
+      iter->_stage = STAGE_DONE;
+      return NULL;
+    }
+    iter->_idx = 0;
+    elem->path_attrs = NULL;
+    elem->next_hop_afi = 0;
+    elem->next_hop = NULL;
+  }
+}
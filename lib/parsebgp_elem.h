@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_ELEM_H
+#define __PARSEBGP_ELEM_H
+
+#include "parsebgp_bgp.h"
+#include "parsebgp_mrt.h"
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct parsebgp_msg;
+
+/** Types of route elements */
+typedef enum {
+
+  /** A prefix held in a RIB dump (TABLE_DUMP or TABLE_DUMP_V2) */
+  PARSEBGP_ELEM_TYPE_RIB = 1,
+
+  /** A prefix announced in an UPDATE message */
+  PARSEBGP_ELEM_TYPE_ANNOUNCEMENT = 2,
+
+  /** A prefix withdrawn in an UPDATE message */
+  PARSEBGP_ELEM_TYPE_WITHDRAWAL = 3,
+
+  /** A change in the state of a peering session (BGP4MP/BGP STATE_CHANGE,
+      BMP Peer Up and Peer Down) */
+  PARSEBGP_ELEM_TYPE_PEER_STATE = 4,
+
+} parsebgp_elem_type_t;
+
+/**
+ * Route Element
+ *
+ * All pointers refer to data held in the message (or in the iterator) that the
+ * element was produced from, so they are only valid until the message is
+ * cleared or the iterator is advanced.
+ */
+typedef struct parsebgp_elem {
+
+  /** Type of element */
+  parsebgp_elem_type_t type;
+
+  /** Time of the element (seconds since the unix epoch), taken from the MRT
+      header or the BMP peer header (zero for bare BGP messages) */
+  uint32_t timestamp_sec;
+
+  /** Microseconds portion of the element time */
+  uint32_t timestamp_usec;
+
+  /** Address family of the peer (zero if the peer is not known) */
+  parsebgp_bgp_afi_t peer_afi;
+
+  /** IP address of the peer (NULL if the peer is not known) */
+  const uint8_t *peer_ip;
+
+  /** ASN of the peer */
+  uint32_t peer_asn;
+
+  /** Prefix (NULL for PEER_STATE elements) */
+  const parsebgp_bgp_prefix_t *prefix;
+
+  /** Address family of the next hop (zero if there is no next hop) */
+  parsebgp_bgp_afi_t next_hop_afi;
+
+  /** Next hop of an announcement or RIB entry (NULL if there is none) */
+  const uint8_t *next_hop;
+
+  /** Path attributes of an announcement or RIB entry (NULL otherwise). These
+      are shared by all the elements of the message (or RIB entry). */
+  const parsebgp_bgp_update_path_attrs_t *path_attrs;
+
+  /** Previous session state (parsebgp_mrt_fsm_code_t, PEER_STATE only) */
+  uint16_t old_state;
+
+  /** New session state (parsebgp_mrt_fsm_code_t, PEER_STATE only) */
+  uint16_t new_state;
+
+} parsebgp_elem_t;
+
+/**
+ * Route Element Iterator
+ *
+ * The fields of this structure are INTERNAL; use parsebgp_elem_iter_init and
+ * parsebgp_elem_iter_next.
+ */
+typedef struct parsebgp_elem_iter {
+
+  /** Element most recently returned */
+  parsebgp_elem_t _elem;
+
+  /** UPDATE message being iterated over */
+  const parsebgp_bgp_update_t *_update;
+
+  /** TABLE_DUMP_V2 RIB being iterated over */
+  const parsebgp_mrt_table_dump_v2_afi_safi_rib_t *_rib;
+
+  /** Peer Index Table used to look up TABLE_DUMP_V2 peers */
+  const parsebgp_mrt_table_dump_v2_peer_index_t *_peer_index;
+
+  /** Next hop of announcements in the withdrawn/announced NLRI fields */
+  const uint8_t *_next_hop;
+
+  /** Prefix built for RIB elements (whose prefix is not stored in a
+      parsebgp_bgp_prefix_t) */
+  parsebgp_bgp_prefix_t _prefix;
+
+  /** Current source of elements */
+  int _stage;
+
+  /** Index of the next element in the current source */
+  int _idx;
+
+} parsebgp_elem_iter_t;
+
+/**
+ * Prepare to iterate over the route elements of a parsed message
+ *
+ * @param iter          pointer to the iterator to initialize
+ * @param msg           pointer to a message filled by parsebgp_decode
+ * @param peer_index    Peer Index Table used to find the peers of
+ *                      TABLE_DUMP_V2 RIB entries. If NULL, the table left in
+ *                      msg by the last PEER_INDEX_TABLE it was used to decode
+ *                      is used.
+ *
+ * The iterator does not allocate memory, and nothing needs to be done once
+ * iteration is finished. Messages that were filtered out (i.e.,
+ * PARSEBGP_FILTERED_OUT was returned) must not be iterated over. A BMP message
+ * that was only partially decoded (e.g., with parse_headers_only) yields no
+ * elements, as does a TABLE_DUMP_V2 RIB whose entries were streamed to
+ * mrt_rib_entry_cb.
+ */
+void parsebgp_elem_iter_init(
+  parsebgp_elem_iter_t *iter, const struct parsebgp_msg *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index);
+
+/**
+ * Get the next route element of a message
+ *
+ * @param iter          pointer to an iterator set up by parsebgp_elem_iter_init
+ * @return pointer to the next element, or NULL if there are no more elements
+ *
+ * The returned element is owned by the iterator and is overwritten by the next
+ * call. Elements of an UPDATE message are returned in the order: withdrawn
+ * NLRIs, MP_UNREACH NLRIs, announced NLRIs, MP_REACH NLRIs.
+ */
+const parsebgp_elem_t *parsebgp_elem_iter_next(parsebgp_elem_iter_t *iter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PARSEBGP_ELEM_H */
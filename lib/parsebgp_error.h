@@ -57,7 +57,10 @@ typedef enum parsebgp_error {
   /** Message does not contain an entire sub-message */
   PARSEBGP_TRUNCATED_MSG = -5,
 
-  PARSEBGP_N_ERR = -6,
+  /** Message was skipped because it does not match the filter */
+  PARSEBGP_FILTERED_OUT = -6,
+
+  PARSEBGP_N_ERR = -7,
 
 } parsebgp_error_t;
 
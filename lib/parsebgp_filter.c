@@ -0,0 +1,707 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_filter.h"
+#include "parsebgp_filter_impl.h"
+#include "parsebgp_utils.h"
+#include <arpa/inet.h>
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Maximum length of a compiled filter program */
+#define MAX_PROG_LEN (4 * PARSEBGP_FILTER_MAX_TERMS)
+
+/** Maximum length of a single token in a filter expression */
+#define MAX_TOKEN_LEN 64
+
+/** Program opcodes (opcodes below OP_AND push the value of that term) */
+#define OP_AND 0xFD
+#define OP_OR 0xFE
+#define OP_NOT 0xFF
+
+/** Types of filter term */
+typedef enum {
+  TERM_KIND,
+  TERM_PEER_ASN,
+  TERM_PEER_IP,
+  TERM_ORIGIN_ASN,
+  TERM_PATH_ASN,
+  TERM_COMMUNITY,
+  TERM_PREFIX,
+} term_type_t;
+
+/** Groups of fields that become known at the same time */
+typedef enum {
+  GROUP_KIND,
+  GROUP_PEER,
+  GROUP_ATTRS,
+  GROUP_PREFIX,
+  GROUP_CNT,
+} group_t;
+
+static const group_t term_groups[] = {
+  GROUP_KIND,   // TERM_KIND
+  GROUP_PEER,   // TERM_PEER_ASN
+  GROUP_PEER,   // TERM_PEER_IP
+  GROUP_ATTRS,  // TERM_ORIGIN_ASN
+  GROUP_ATTRS,  // TERM_PATH_ASN
+  GROUP_ATTRS,  // TERM_COMMUNITY
+  GROUP_PREFIX, // TERM_PREFIX
+};
+
+/** Names of the message kinds (indexed by parsebgp_filter_kind_t) */
+static const char *kind_names[] = {
+  "update",       // PARSEBGP_FILTER_KIND_UPDATE
+  "open",         // PARSEBGP_FILTER_KIND_OPEN
+  "notification", // PARSEBGP_FILTER_KIND_NOTIFICATION
+  "keepalive",    // PARSEBGP_FILTER_KIND_KEEPALIVE
+  "route-refresh", // PARSEBGP_FILTER_KIND_ROUTE_REFRESH
+  "rib",          // PARSEBGP_FILTER_KIND_RIB
+  "peer-index",   // PARSEBGP_FILTER_KIND_PEER_INDEX
+  "state-change", // PARSEBGP_FILTER_KIND_STATE_CHANGE
+  "stats",        // PARSEBGP_FILTER_KIND_STATS
+  "peer-up",      // PARSEBGP_FILTER_KIND_PEER_UP
+  "peer-down",    // PARSEBGP_FILTER_KIND_PEER_DOWN
+  "init",         // PARSEBGP_FILTER_KIND_INIT
+  "term",         // PARSEBGP_FILTER_KIND_TERM
+};
+
+#define KIND_CNT (sizeof(kind_names) / sizeof(kind_names[0]))
+
+/** A single filter term */
+typedef struct filter_term {
+
+  /** Type of the term (term_type_t) */
+  uint8_t type;
+
+  /** AFI of the address (TERM_PEER_IP and TERM_PREFIX) */
+  uint8_t afi;
+
+  /** Prefix length (TERM_PREFIX) */
+  uint8_t len;
+
+  /** Kind, ASN or community value */
+  uint32_t val;
+
+  /** Address (TERM_PEER_IP and TERM_PREFIX) */
+  uint8_t addr[16];
+
+} filter_term_t;
+
+struct parsebgp_filter {
+
+  /** Terms referenced by the program */
+  filter_term_t terms[PARSEBGP_FILTER_MAX_TERMS];
+
+  /** Number of terms */
+  int terms_cnt;
+
+  /** Mask of the terms in each group */
+  uint32_t group_masks[GROUP_CNT];
+
+  /** Mask of the terms of each type */
+  uint32_t type_masks[TERM_PREFIX + 1];
+
+  /** Compiled program (in postfix order) */
+  uint8_t prog[MAX_PROG_LEN];
+
+  /** Length of the compiled program */
+  int prog_len;
+};
+
+/* -------------------- Compiler -------------------- */
+
+typedef struct compiler {
+
+  /** Filter being compiled */
+  parsebgp_filter_t *filter;
+
+  /** Remaining (unparsed) expression */
+  const char *p;
+
+  /** Current token */
+  char tok[MAX_TOKEN_LEN];
+
+  /** Number of 'not's and '('s that the parser is inside */
+  int depth;
+
+} compiler_t;
+
+static int next_token(compiler_t *c)
+{
+  size_t n = 0;
+
+  while (isspace((unsigned char)*c->p)) {
+    c->p++;
+  }
+  if (*c->p == '(' || *c->p == ')') {
+    c->tok[n++] = *(c->p++);
+  } else {
+    while (*c->p != '\0' && !isspace((unsigned char)*c->p) && *c->p != '(' &&
+           *c->p != ')') {
+      if (n == sizeof(c->tok) - 1) {
+        fprintf(stderr, "ERROR: Filter token too long\n");
+        return -1;
+      }
+      c->tok[n++] = *(c->p++);
+    }
+  }
+  c->tok[n] = '\0';
+  return 0;
+}
+
+static int emit(compiler_t *c, uint8_t op)
+{
+  if (c->filter->prog_len == MAX_PROG_LEN) {
+    fprintf(stderr, "ERROR: Filter expression too long\n");
+    return -1;
+  }
+  c->filter->prog[c->filter->prog_len++] = op;
+  return 0;
+}
+
+static int parse_uint32(const char *str, uint32_t *val)
+{
+  char *end;
+  unsigned long long v;
+
+  if (!isdigit((unsigned char)*str)) {
+    return -1;
+  }
+  errno = 0;
+  v = strtoull(str, &end, 10);
+  if (errno != 0 || *end != '\0' || v > UINT32_MAX) {
+    return -1;
+  }
+  *val = (uint32_t)v;
+  return 0;
+}
+
+static int parse_addr(const char *str, filter_term_t *term)
+{
+  if (inet_pton(AF_INET, str, term->addr) == 1) {
+    term->afi = PARSEBGP_BGP_AFI_IPV4;
+    return 0;
+  }
+  if (inet_pton(AF_INET6, str, term->addr) == 1) {
+    term->afi = PARSEBGP_BGP_AFI_IPV6;
+    return 0;
+  }
+  return -1;
+}
+
+static int parse_term_value(filter_term_t *term, char *val)
+{
+  char *sep;
+  uint32_t hi, lo;
+  size_t i;
+
+  switch (term->type) {
+  case TERM_KIND:
+    for (i = 0; i < KIND_CNT; i++) {
+      if (strcmp(val, kind_names[i]) == 0) {
+        term->val = i;
+        return 0;
+      }
+    }
+    return -1;
+
+  case TERM_PEER_ASN:
+  case TERM_ORIGIN_ASN:
+  case TERM_PATH_ASN:
+    return parse_uint32(val, &term->val);
+
+  case TERM_PEER_IP:
+    return parse_addr(val, term);
+
+  case TERM_COMMUNITY:
+    if ((sep = strchr(val, ':')) == NULL) {
+      return -1;
+    }
+    *(sep++) = '\0';
+    if (parse_uint32(val, &hi) != 0 || parse_uint32(sep, &lo) != 0 ||
+        hi > UINT16_MAX || lo > UINT16_MAX) {
+      return -1;
+    }
+    term->val = (hi << 16) | lo;
+    return 0;
+
+  case TERM_PREFIX:
+    if ((sep = strchr(val, '/')) == NULL) {
+      return -1;
+    }
+    *(sep++) = '\0';
+    if (parse_addr(val, term) != 0 || parse_uint32(sep, &hi) != 0 ||
+        hi > (term->afi == PARSEBGP_BGP_AFI_IPV4 ? 32 : 128)) {
+      return -1;
+    }
+    term->len = hi;
+    return 0;
+  }
+
+  return -1;
+}
+
+static int parse_term(compiler_t *c)
+{
+  static const struct {
+    const char *name;
+    term_type_t type;
+  } names[] = {
+    {"type", TERM_KIND},
+    {"peer-asn", TERM_PEER_ASN},
+    {"peer-ip", TERM_PEER_IP},
+    {"origin-asn", TERM_ORIGIN_ASN},
+    {"path-asn", TERM_PATH_ASN},
+    {"community", TERM_COMMUNITY},
+    {"prefix", TERM_PREFIX},
+  };
+  parsebgp_filter_t *f = c->filter;
+  filter_term_t *term;
+  size_t i;
+
+  for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (strcmp(c->tok, names[i].name) == 0) {
+      break;
+    }
+  }
+  if (i == sizeof(names) / sizeof(names[0])) {
+    fprintf(stderr, "ERROR: Unknown filter term '%s'\n", c->tok);
+    return -1;
+  }
+  if (f->terms_cnt == PARSEBGP_FILTER_MAX_TERMS) {
+    fprintf(stderr, "ERROR: Too many filter terms (max %d)\n",
+            PARSEBGP_FILTER_MAX_TERMS);
+    return -1;
+  }
+  term = &f->terms[f->terms_cnt];
+  term->type = names[i].type;
+
+  if (next_token(c) != 0) {
+    return -1;
+  }
+  if (parse_term_value(term, c->tok) != 0) {
+    fprintf(stderr, "ERROR: Invalid value for filter term '%s'\n",
+            names[i].name);
+    return -1;
+  }
+
+  f->group_masks[term_groups[term->type]] |= (1U << f->terms_cnt);
+  f->type_masks[term->type] |= (1U << f->terms_cnt);
+  if (emit(c, f->terms_cnt) != 0) {
+    return -1;
+  }
+  f->terms_cnt++;
+
+  return next_token(c);
+}
+
+static int parse_or(compiler_t *c);
+
+// enter a 'not' or '(', rejecting expressions nested more deeply than a
+// program can be long before the parser recurses (so that a long run of them
+// cannot overflow the stack)
+static int nest(compiler_t *c)
+{
+  if (++c->depth > MAX_PROG_LEN) {
+    fprintf(stderr, "ERROR: Filter expression nested too deeply\n");
+    return -1;
+  }
+  return 0;
+}
+
+static int parse_not(compiler_t *c)
+{
+  if (strcmp(c->tok, "not") == 0) {
+    if (nest(c) != 0 || next_token(c) != 0 || parse_not(c) != 0) {
+      return -1;
+    }
+    c->depth--;
+    return emit(c, OP_NOT);
+  }
+
+  if (strcmp(c->tok, "(") == 0) {
+    if (nest(c) != 0 || next_token(c) != 0 || parse_or(c) != 0) {
+      return -1;
+    }
+    c->depth--;
+    if (strcmp(c->tok, ")") != 0) {
+      fprintf(stderr, "ERROR: Expecting ')' in filter expression\n");
+      return -1;
+    }
+    return next_token(c);
+  }
+
+  if (c->tok[0] == '\0') {
+    fprintf(stderr, "ERROR: Unexpected end of filter expression\n");
+    return -1;
+  }
+
+  return parse_term(c);
+}
+
+static int parse_and(compiler_t *c)
+{
+  if (parse_not(c) != 0) {
+    return -1;
+  }
+  while (strcmp(c->tok, "and") == 0) {
+    if (next_token(c) != 0 || parse_not(c) != 0 || emit(c, OP_AND) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int parse_or(compiler_t *c)
+{
+  if (parse_and(c) != 0) {
+    return -1;
+  }
+  while (strcmp(c->tok, "or") == 0) {
+    if (next_token(c) != 0 || parse_and(c) != 0 || emit(c, OP_OR) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+parsebgp_filter_t *parsebgp_filter_create(const char *expr)
+{
+  compiler_t c;
+
+  if ((c.filter = malloc_zero(sizeof(parsebgp_filter_t))) == NULL) {
+    return NULL;
+  }
+  c.p = expr;
+  c.depth = 0;
+
+  if (next_token(&c) != 0 || parse_or(&c) != 0) {
+    goto err;
+  }
+  if (c.tok[0] != '\0') {
+    fprintf(stderr, "ERROR: Unexpected '%s' in filter expression\n", c.tok);
+    goto err;
+  }
+
+  return c.filter;
+
+err:
+  parsebgp_filter_destroy(c.filter);
+  return NULL;
+}
+
+void parsebgp_filter_destroy(parsebgp_filter_t *filter)
+{
+  free(filter);
+}
+
+/* -------------------- Evaluation -------------------- */
+
+static int addr_match(const uint8_t *a, const uint8_t *b, uint8_t bits)
+{
+  uint8_t bytes = bits / 8, rem = bits % 8;
+
+  if (memcmp(a, b, bytes) != 0) {
+    return 0;
+  }
+  if (rem != 0 && ((a[bytes] ^ b[bytes]) & (0xFF << (8 - rem))) != 0) {
+    return 0;
+  }
+  return 1;
+}
+
+// mark the given group as known, with the given matching terms
+static void set_group(parsebgp_opts_t *opts, group_t group, uint32_t matched)
+{
+  uint32_t mask = opts->filter->group_masks[group];
+  opts->_filter_true |= matched & mask;
+  opts->_filter_known |= mask;
+}
+
+// has the given group already been set for this message?
+static int group_known(const parsebgp_opts_t *opts, group_t group)
+{
+  uint32_t mask = opts->filter->group_masks[group];
+  return (opts->_filter_known & mask) == mask;
+}
+
+void parsebgp_filter_set_kind(parsebgp_opts_t *opts,
+                              parsebgp_filter_kind_t kind)
+{
+  const parsebgp_filter_t *f = opts->filter;
+  uint32_t matched = 0;
+  int i;
+
+  if (group_known(opts, GROUP_KIND)) {
+    return;
+  }
+  for (i = 0; i < f->terms_cnt; i++) {
+    if (f->terms[i].type == TERM_KIND && f->terms[i].val == kind) {
+      matched |= 1U << i;
+    }
+  }
+  set_group(opts, GROUP_KIND, matched);
+}
+
+void parsebgp_filter_set_peer(parsebgp_opts_t *opts, parsebgp_bgp_afi_t afi,
+                              const uint8_t *ip, uint32_t asn)
+{
+  const parsebgp_filter_t *f = opts->filter;
+  const filter_term_t *term;
+  uint32_t matched = 0;
+  int i;
+
+  if (group_known(opts, GROUP_PEER)) {
+    return;
+  }
+  for (i = 0; i < f->terms_cnt; i++) {
+    term = &f->terms[i];
+    if ((term->type == TERM_PEER_ASN && term->val == asn) ||
+        (term->type == TERM_PEER_IP && term->afi == afi &&
+         addr_match(term->addr, ip,
+                    afi == PARSEBGP_BGP_AFI_IPV4 ? 32 : 128))) {
+      matched |= 1U << i;
+    }
+  }
+  set_group(opts, GROUP_PEER, matched);
+}
+
+// does the given AS path contain the ASN (anywhere, or as the origin)
+static int as_path_match(const parsebgp_bgp_update_as_path_t *as_path,
+                         uint32_t asn, int origin_only)
+{
+  const parsebgp_bgp_update_as_path_seg_t *seg;
+  int i = 0, j;
+
+  if (origin_only) {
+    if (as_path->segs_cnt == 0) {
+      return 0;
+    }
+    // the origin is the last ASN of a final AS_SEQUENCE, or any member of a
+    // final AS_SET
+    i = as_path->segs_cnt - 1;
+    seg = &as_path->segs[i];
+    if (seg->type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ) {
+      return seg->asns_cnt > 0 && seg->asns[seg->asns_cnt - 1] == asn;
+    }
+  }
+
+  for (; i < as_path->segs_cnt; i++) {
+    seg = &as_path->segs[i];
+    for (j = 0; j < seg->asns_cnt; j++) {
+      if (seg->asns[j] == asn) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+void parsebgp_filter_set_path_attrs(
+  parsebgp_opts_t *opts, const parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  const parsebgp_filter_t *f = opts->filter;
+  const parsebgp_bgp_update_path_attr_t *attr;
+  const parsebgp_bgp_update_communities_t *comms = NULL;
+  const parsebgp_bgp_update_as_path_t *as_path = NULL;
+  const filter_term_t *term;
+  uint32_t matched = 0;
+  int i, j;
+
+  // prefixes carried in the multi-protocol attributes
+  if (f->group_masks[GROUP_PREFIX] != 0) {
+    attr = &path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI];
+    if (attr->type != 0) {
+      parsebgp_filter_match_prefixes(opts, attr->data.mp_reach->nlris,
+                                     attr->data.mp_reach->nlris_cnt);
+    }
+    attr = &path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI];
+    if (attr->type != 0) {
+      parsebgp_filter_match_prefixes(
+        opts, attr->data.mp_unreach->withdrawn_nlris,
+        attr->data.mp_unreach->withdrawn_nlris_cnt);
+    }
+  }
+
+  if (f->group_masks[GROUP_ATTRS] == 0 || group_known(opts, GROUP_ATTRS)) {
+    return;
+  }
+
+  // prefer the effective path (with AS4_PATH merged in) if it was computed
+  attr = &path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH];
+  if (path_attrs->as_path_merged.valid) {
+    as_path = &path_attrs->as_path_merged.path;
+  } else if (attr->type != 0) {
+    as_path = attr->data.as_path;
+  }
+  // (raw-parsed communities are not decoded, so cannot be matched)
+  attr = &path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES];
+  if (attr->type != 0 &&
+      !(opts->bgp.path_attr_raw_enabled &&
+        opts->bgp.path_attr_raw[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES])) {
+    comms = attr->data.communities;
+  }
+
+  for (i = 0; i < f->terms_cnt; i++) {
+    term = &f->terms[i];
+    switch (term->type) {
+    case TERM_ORIGIN_ASN:
+    case TERM_PATH_ASN:
+      if (as_path != NULL &&
+          as_path_match(as_path, term->val, term->type == TERM_ORIGIN_ASN)) {
+        matched |= 1U << i;
+      }
+      break;
+
+    case TERM_COMMUNITY:
+      for (j = 0; comms != NULL && j < comms->communities_cnt; j++) {
+        if (comms->communities[j] == term->val) {
+          matched |= 1U << i;
+          break;
+        }
+      }
+      break;
+
+    default:
+      break;
+    }
+  }
+  set_group(opts, GROUP_ATTRS, matched);
+}
+
+void parsebgp_filter_match_prefix(parsebgp_opts_t *opts, uint16_t afi,
+                                  const uint8_t *addr, uint8_t len)
+{
+  const parsebgp_filter_t *f = opts->filter;
+  const filter_term_t *term;
+  uint32_t pending;
+  int i;
+
+  // only check terms that have not already matched
+  pending = f->type_masks[TERM_PREFIX] &
+            ~(opts->_filter_known | opts->_filter_true);
+  for (i = 0; pending != 0; i++, pending >>= 1) {
+    if ((pending & 1) == 0) {
+      continue;
+    }
+    term = &f->terms[i];
+    if (term->afi == afi && len >= term->len &&
+        addr_match(term->addr, addr, term->len)) {
+      opts->_filter_true |= 1U << i;
+    }
+  }
+}
+
+void parsebgp_filter_match_prefixes(parsebgp_opts_t *opts,
+                                    const parsebgp_bgp_prefix_t *prefixes,
+                                    int prefixes_cnt)
+{
+  int i;
+
+  if (opts->filter->type_masks[TERM_PREFIX] == 0) {
+    return;
+  }
+  for (i = 0; i < prefixes_cnt; i++) {
+    parsebgp_filter_match_prefix(opts, prefixes[i].afi, prefixes[i].addr,
+                                 prefixes[i].len);
+  }
+}
+
+void parsebgp_filter_prefixes_done(parsebgp_opts_t *opts)
+{
+  // prefix terms are set to true as they match, so the rest are false
+  set_group(opts, GROUP_PREFIX, 0);
+}
+
+void parsebgp_filter_done(parsebgp_opts_t *opts)
+{
+  // any fields that we have not seen, the message does not have
+  opts->_filter_known = UINT32_MAX;
+}
+
+parsebgp_filter_result_t parsebgp_filter_eval(const parsebgp_opts_t *opts)
+{
+  const parsebgp_filter_t *f = opts->filter;
+  uint8_t stack[MAX_PROG_LEN];
+  int sp = 0, i;
+  uint8_t op, a, b;
+
+  for (i = 0; i < f->prog_len; i++) {
+    op = f->prog[i];
+    switch (op) {
+    case OP_NOT:
+      a = stack[sp - 1];
+      if (a != PARSEBGP_FILTER_UNKNOWN) {
+        stack[sp - 1] = !a;
+      }
+      break;
+
+    case OP_AND:
+      b = stack[--sp];
+      a = stack[sp - 1];
+      if (a == PARSEBGP_FILTER_FALSE || b == PARSEBGP_FILTER_FALSE) {
+        stack[sp - 1] = PARSEBGP_FILTER_FALSE;
+      } else if (a == PARSEBGP_FILTER_TRUE && b == PARSEBGP_FILTER_TRUE) {
+        stack[sp - 1] = PARSEBGP_FILTER_TRUE;
+      } else {
+        stack[sp - 1] = PARSEBGP_FILTER_UNKNOWN;
+      }
+      break;
+
+    case OP_OR:
+      b = stack[--sp];
+      a = stack[sp - 1];
+      if (a == PARSEBGP_FILTER_TRUE || b == PARSEBGP_FILTER_TRUE) {
+        stack[sp - 1] = PARSEBGP_FILTER_TRUE;
+      } else if (a == PARSEBGP_FILTER_FALSE && b == PARSEBGP_FILTER_FALSE) {
+        stack[sp - 1] = PARSEBGP_FILTER_FALSE;
+      } else {
+        stack[sp - 1] = PARSEBGP_FILTER_UNKNOWN;
+      }
+      break;
+
+    default:
+      // push a term (a term that has matched is true, even if the rest of its
+      // group is not yet known)
+      if (opts->_filter_true & (1U << op)) {
+        stack[sp++] = PARSEBGP_FILTER_TRUE;
+      } else if (opts->_filter_known & (1U << op)) {
+        stack[sp++] = PARSEBGP_FILTER_FALSE;
+      } else {
+        stack[sp++] = PARSEBGP_FILTER_UNKNOWN;
+      }
+      break;
+    }
+  }
+
+  assert(sp == 1);
+  return stack[0];
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_FILTER_H
+#define __PARSEBGP_FILTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum number of terms in a single filter expression */
+#define PARSEBGP_FILTER_MAX_TERMS 32
+
+/** Opaque structure holding a compiled filter expression */
+typedef struct parsebgp_filter parsebgp_filter_t;
+
+/**
+ * Compile a filter expression
+ *
+ * @param expr          filter expression to compile
+ * @return pointer to the compiled filter, or NULL if the expression could not
+ * be compiled (an error message is written to stderr)
+ *
+ * An expression is made up of terms, combined using "and", "or", "not" and
+ * parentheses ("and" binds more tightly than "or"). The supported terms are:
+ *
+ *   type <kind>          message (or record) kind, one of: update, open,
+ *                        notification, keepalive, route-refresh, rib,
+ *                        peer-index, state-change, stats, peer-up, peer-down,
+ *                        init, term
+ *   peer-asn <asn>       ASN of the peer (BGP4MP, TABLE_DUMP, BMP peer header)
+ *   peer-ip <address>    IP address of the peer (as for peer-asn)
+ *   origin-asn <asn>     last ASN of the AS_PATH (any member of a final AS_SET)
+ *   path-asn <asn>       any ASN in the AS_PATH
+ *   community <asn>:<v>  a community in the COMMUNITIES attribute
+ *   prefix <pfx>/<len>   any prefix (announced, withdrawn or in a RIB record)
+ *                        that is equal to, or more specific than, pfx/len
+ *
+ * e.g., "type update and (peer-asn 65001 or peer-asn 65002) and not prefix
+ * 10.0.0.0/8"
+ *
+ * A term that refers to a field that a message does not have (e.g., peer-asn
+ * for a bare BGP message) does not match that message.
+ *
+ * The caller owns the returned filter and must call parsebgp_filter_destroy to
+ * free it once it is no longer used by any parser options.
+ */
+parsebgp_filter_t *parsebgp_filter_create(const char *expr);
+
+/**
+ * Destroy the given filter
+ *
+ * @param filter        pointer to the filter to destroy
+ */
+void parsebgp_filter_destroy(parsebgp_filter_t *filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PARSEBGP_FILTER_H */
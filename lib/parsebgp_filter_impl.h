@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_FILTER_IMPL_H
+#define __PARSEBGP_FILTER_IMPL_H
+
+#include "parsebgp_bgp_common.h"
+#include "parsebgp_bgp_update.h"
+#include "parsebgp_filter.h"
+#include "parsebgp_opts.h"
+#include <inttypes.h>
+
+/** Kinds of message that may be matched by a "type" filter term */
+typedef enum {
+  PARSEBGP_FILTER_KIND_UPDATE,
+  PARSEBGP_FILTER_KIND_OPEN,
+  PARSEBGP_FILTER_KIND_NOTIFICATION,
+  PARSEBGP_FILTER_KIND_KEEPALIVE,
+  PARSEBGP_FILTER_KIND_ROUTE_REFRESH,
+  PARSEBGP_FILTER_KIND_RIB,
+  PARSEBGP_FILTER_KIND_PEER_INDEX,
+  PARSEBGP_FILTER_KIND_STATE_CHANGE,
+  PARSEBGP_FILTER_KIND_STATS,
+  PARSEBGP_FILTER_KIND_PEER_UP,
+  PARSEBGP_FILTER_KIND_PEER_DOWN,
+  PARSEBGP_FILTER_KIND_INIT,
+  PARSEBGP_FILTER_KIND_TERM,
+} parsebgp_filter_kind_t;
+
+/** Result of evaluating a filter against a partially-decoded message */
+typedef enum {
+  PARSEBGP_FILTER_FALSE = 0,
+  PARSEBGP_FILTER_TRUE = 1,
+  PARSEBGP_FILTER_UNKNOWN = 2,
+} parsebgp_filter_result_t;
+
+/* The functions below record the value of message fields as they are decoded.
+ * They must only be called if opts->filter is set. For each group of fields
+ * (kind, peer, path attributes, prefixes), the first message-level call wins,
+ * so that (e.g.) the OPEN messages inside a BMP Peer Up message do not change
+ * the kind of the outer message. */
+
+/** Record the kind of message being decoded */
+void parsebgp_filter_set_kind(parsebgp_opts_t *opts,
+                              parsebgp_filter_kind_t kind);
+
+/** Record the peer that the message is from */
+void parsebgp_filter_set_peer(parsebgp_opts_t *opts, parsebgp_bgp_afi_t afi,
+                              const uint8_t *ip, uint32_t asn);
+
+/** Record the (decoded) path attributes of the message. This also matches any
+ * prefixes in the MP_REACH_NLRI and MP_UNREACH_NLRI attributes. */
+void parsebgp_filter_set_path_attrs(
+  parsebgp_opts_t *opts, const parsebgp_bgp_update_path_attrs_t *path_attrs);
+
+/** Match the given prefixes against the filter */
+void parsebgp_filter_match_prefixes(parsebgp_opts_t *opts,
+                                    const parsebgp_bgp_prefix_t *prefixes,
+                                    int prefixes_cnt);
+
+/** Match a single prefix against the filter */
+void parsebgp_filter_match_prefix(parsebgp_opts_t *opts, uint16_t afi,
+                                  const uint8_t *addr, uint8_t len);
+
+/** Record that all prefixes of the message have been matched */
+void parsebgp_filter_prefixes_done(parsebgp_opts_t *opts);
+
+/** Record that all fields of the message have been decoded */
+void parsebgp_filter_done(parsebgp_opts_t *opts);
+
+/** Evaluate the filter using the fields decoded so far */
+parsebgp_filter_result_t parsebgp_filter_eval(const parsebgp_opts_t *opts);
+
+/** Convenience macro to give up on a message as soon as it is known that it
+    cannot match the filter */
+#define PARSEBGP_FILTER_CHECK(opts)                                            \
+  do {                                                                         \
+    if ((opts)->filter != NULL &&                                              \
+        parsebgp_filter_eval(opts) == PARSEBGP_FILTER_FALSE) {                 \
+      return PARSEBGP_FILTERED_OUT;                                            \
+    }                                                                          \
+  } while (0)
+
+#endif /* __PARSEBGP_FILTER_IMPL_H */
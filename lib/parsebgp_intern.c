@@ -0,0 +1,464 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_intern.h"
+#include "parsebgp_utils.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Values are looked up without locks: the hash table and the entries are
+ * only ever added to (by one writer at a time, holding the lock of the kind),
+ * and are published using release stores that lookups pair with acquire
+ * loads. When the hash table grows, the old table is kept (until the store is
+ * destroyed) since lookups may still be using it. */
+
+/** log2 of the number of entries in each chunk of the entry directory */
+#define CHUNK_BITS 16
+
+/** Number of entries in each chunk of the entry directory */
+#define CHUNK_SIZE (1 << CHUNK_BITS)
+
+/** Number of chunks in the entry directory (enough for all 32-bit IDs) */
+#define CHUNKS_CNT (1 << (32 - CHUNK_BITS))
+
+/** Size of the blocks that (small) values are allocated from */
+#define ARENA_BLOCK_SIZE (1 << 20)
+
+/** Initial number of hash table slots (must be a power of two) */
+#define INITIAL_SLOTS_CNT 1024
+
+/** Magic bytes at the start of a saved store */
+#define SAVE_MAGIC "PBGPINT1"
+
+#define LOAD_ACQ(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/** An interned value */
+typedef struct intern_entry {
+
+  /** Hash of the value */
+  uint64_t hash;
+
+  /** Length of the value */
+  uint32_t len;
+
+  /** The value */
+  uint8_t data[];
+
+} intern_entry_t;
+
+/** Hash table of IDs */
+typedef struct intern_table {
+
+  /** Number of slots minus one */
+  uint32_t mask;
+
+  /** Previous (smaller) table, kept for concurrent lookups */
+  struct intern_table *retired;
+
+  /** Slots: the upper 32 bits of the hash of the value and the ID of the
+      value (or 0 if the slot is empty) */
+  uint64_t slots[];
+
+} intern_table_t;
+
+/** Block of memory that entries are allocated from */
+typedef struct intern_arena_block {
+
+  /** Next (older) block */
+  struct intern_arena_block *next;
+
+  /** Number of bytes used */
+  size_t used;
+
+  /** Block contents */
+  uint8_t data[];
+
+} intern_arena_block_t;
+
+/** Values of one kind */
+typedef struct intern_kind {
+
+  /** Lock held while adding a value */
+  pthread_mutex_t lock;
+
+  /** Current hash table */
+  intern_table_t *table;
+
+  /** Number of values (the largest ID in use) */
+  uint32_t cnt;
+
+  /** Blocks that entries are allocated from (most recent first) */
+  intern_arena_block_t *arena;
+
+  /** Entry directory: chunks[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)] */
+  intern_entry_t **chunks[CHUNKS_CNT];
+
+} intern_kind_t;
+
+struct parsebgp_intern {
+
+  /** Values of each kind */
+  intern_kind_t kinds[PARSEBGP_INTERN_KINDS_CNT];
+};
+
+#define SLOT(hash, id) (((hash) & 0xffffffff00000000ULL) | (id))
+#define SLOT_ID(slot) ((uint32_t)(slot))
+#define SLOT_HASH_MATCH(slot, hash)                                            \
+  (((slot) ^ (hash)) < (UINT64_C(1) << 32))
+
+static intern_table_t *table_create(uint32_t slots_cnt)
+{
+  intern_table_t *t;
+
+  if ((t = calloc(1, sizeof(*t) + sizeof(t->slots[0]) * slots_cnt)) == NULL) {
+    return NULL;
+  }
+  t->mask = slots_cnt - 1;
+  return t;
+}
+
+static const intern_entry_t *get_entry(const intern_kind_t *k, uint32_t id)
+{
+  intern_entry_t **chunk = LOAD_ACQ(&k->chunks[id >> CHUNK_BITS]);
+
+  if (chunk == NULL) {
+    return NULL;
+  }
+  return LOAD_ACQ(&chunk[id & (CHUNK_SIZE - 1)]);
+}
+
+// find the ID of the given value in the given table (0 if not found)
+static uint32_t table_find(const intern_kind_t *k, const intern_table_t *t,
+                           uint64_t hash, const void *data, size_t len)
+{
+  uint32_t i = (uint32_t)hash & t->mask;
+  const intern_entry_t *e;
+  uint64_t slot;
+
+  while ((slot = LOAD_ACQ(&t->slots[i])) != 0) {
+    if (SLOT_HASH_MATCH(slot, hash)) {
+      e = get_entry(k, SLOT_ID(slot));
+      if (e->len == len && memcmp(e->data, data, len) == 0) {
+        return SLOT_ID(slot);
+      }
+    }
+    i = (i + 1) & t->mask;
+  }
+  return 0;
+}
+
+static void table_insert(intern_table_t *t, uint64_t hash, uint32_t id)
+{
+  uint32_t i = (uint32_t)hash & t->mask;
+
+  while (t->slots[i] != 0) {
+    i = (i + 1) & t->mask;
+  }
+  STORE_REL(&t->slots[i], SLOT(hash, id));
+}
+
+// double the size of the hash table (the lock must be held)
+static int grow(intern_kind_t *k)
+{
+  intern_table_t *t;
+  uint32_t id;
+
+  if (k->table->mask >= (UINT32_C(1) << 31) - 1 ||
+      (t = table_create((k->table->mask + 1) * 2)) == NULL) {
+    return -1;
+  }
+  for (id = 1; id <= k->cnt; id++) {
+    table_insert(t, get_entry(k, id)->hash, id);
+  }
+  t->retired = k->table;
+  STORE_REL(&k->table, t);
+  return 0;
+}
+
+// allocate an entry for a value of the given length (the lock must be held)
+static intern_entry_t *entry_alloc(intern_kind_t *k, size_t len)
+{
+  size_t size = (sizeof(intern_entry_t) + len + 7) & ~(size_t)7;
+  intern_arena_block_t *b = k->arena;
+
+  if (size > ARENA_BLOCK_SIZE / 16) {
+    // large values get their own block (behind the current one)
+    if ((b = malloc(sizeof(*b) + size)) == NULL) {
+      return NULL;
+    }
+    b->used = size;
+    if (k->arena == NULL) {
+      b->next = NULL;
+      k->arena = b;
+    } else {
+      b->next = k->arena->next;
+      k->arena->next = b;
+    }
+    return (intern_entry_t *)b->data;
+  }
+
+  if (b == NULL || ARENA_BLOCK_SIZE - b->used < size) {
+    if ((b = malloc(sizeof(*b) + ARENA_BLOCK_SIZE)) == NULL) {
+      return NULL;
+    }
+    b->used = 0;
+    b->next = k->arena;
+    k->arena = b;
+  }
+  b->used += size;
+  return (intern_entry_t *)(b->data + b->used - size);
+}
+
+parsebgp_intern_t *parsebgp_intern_create(void)
+{
+  parsebgp_intern_t *store;
+  int i;
+
+  if ((store = calloc(1, sizeof(*store))) == NULL) {
+    return NULL;
+  }
+  for (i = 0; i < PARSEBGP_INTERN_KINDS_CNT; i++) {
+    pthread_mutex_init(&store->kinds[i].lock, NULL);
+    if ((store->kinds[i].table = table_create(INITIAL_SLOTS_CNT)) == NULL) {
+      parsebgp_intern_destroy(store);
+      return NULL;
+    }
+  }
+  return store;
+}
+
+void parsebgp_intern_destroy(parsebgp_intern_t *store)
+{
+  intern_kind_t *k;
+  intern_table_t *t, *tnext;
+  intern_arena_block_t *b, *bnext;
+  int i, j;
+
+  if (store == NULL) {
+    return;
+  }
+
+  for (i = 0; i < PARSEBGP_INTERN_KINDS_CNT; i++) {
+    k = &store->kinds[i];
+    for (t = k->table; t != NULL; t = tnext) {
+      tnext = t->retired;
+      free(t);
+    }
+    for (b = k->arena; b != NULL; b = bnext) {
+      bnext = b->next;
+      free(b);
+    }
+    for (j = 0; j < CHUNKS_CNT; j++) {
+      free(k->chunks[j]);
+    }
+    pthread_mutex_destroy(&k->lock);
+  }
+  free(store);
+}
+
+parsebgp_error_t parsebgp_intern(parsebgp_intern_t *store,
+                                 parsebgp_intern_kind_t kind,
+                                 const void *data, size_t len, uint32_t *idp)
+{
+  intern_kind_t *k = &store->kinds[kind];
+  uint64_t hash = parsebgp_hash64(data, len, kind);
+  intern_entry_t *e, ***chunkp;
+  parsebgp_error_t err = PARSEBGP_MALLOC_FAILURE;
+  uint32_t id;
+
+  // the common case: the value is already known
+  if ((*idp = table_find(k, LOAD_ACQ(&k->table), hash, data, len)) != 0) {
+    return PARSEBGP_OK;
+  }
+
+  pthread_mutex_lock(&k->lock);
+
+  // someone may have added it in the meantime
+  if ((*idp = table_find(k, k->table, hash, data, len)) != 0) {
+    err = PARSEBGP_OK;
+    goto done;
+  }
+
+  if (k->cnt == UINT32_MAX || len > UINT32_MAX) {
+    goto done;
+  }
+  if ((uint64_t)(k->cnt + 1) * 4 > (uint64_t)(k->table->mask + 1) * 3 &&
+      grow(k) != 0) {
+    goto done;
+  }
+
+  id = k->cnt + 1;
+  chunkp = &k->chunks[id >> CHUNK_BITS];
+  if (*chunkp == NULL) {
+    intern_entry_t **chunk = calloc(CHUNK_SIZE, sizeof(*chunk));
+    if (chunk == NULL) {
+      goto done;
+    }
+    STORE_REL(chunkp, chunk);
+  }
+  if ((e = entry_alloc(k, len)) == NULL) {
+    goto done;
+  }
+  e->hash = hash;
+  e->len = len;
+  memcpy(e->data, data, len);
+
+  // publish the entry (and the ID) before the slot that refers to it
+  STORE_REL(&(*chunkp)[id & (CHUNK_SIZE - 1)], e);
+  STORE_REL(&k->cnt, id);
+  table_insert(k->table, hash, id);
+
+  *idp = id;
+  err = PARSEBGP_OK;
+
+done:
+  pthread_mutex_unlock(&k->lock);
+  return err;
+}
+
+uint32_t parsebgp_intern_find(const parsebgp_intern_t *store,
+                              parsebgp_intern_kind_t kind, const void *data,
+                              size_t len)
+{
+  const intern_kind_t *k = &store->kinds[kind];
+
+  return table_find(k, LOAD_ACQ(&k->table), parsebgp_hash64(data, len, kind),
+                    data, len);
+}
+
+const uint8_t *parsebgp_intern_get(const parsebgp_intern_t *store,
+                                   parsebgp_intern_kind_t kind, uint32_t id,
+                                   size_t *lenp)
+{
+  const intern_kind_t *k = &store->kinds[kind];
+  const intern_entry_t *e;
+
+  if (id == 0 || id > LOAD_ACQ(&k->cnt) || (e = get_entry(k, id)) == NULL) {
+    return NULL;
+  }
+  *lenp = e->len;
+  return e->data;
+}
+
+uint32_t parsebgp_intern_count(const parsebgp_intern_t *store,
+                               parsebgp_intern_kind_t kind)
+{
+  return LOAD_ACQ(&store->kinds[kind].cnt);
+}
+
+static int write_u32(FILE *f, uint32_t val)
+{
+  uint8_t buf[4] = {val >> 24, val >> 16, val >> 8, val};
+  return fwrite(buf, sizeof(buf), 1, f) == 1 ? 0 : -1;
+}
+
+static int read_u32(FILE *f, uint32_t *val)
+{
+  uint8_t buf[4];
+  if (fread(buf, sizeof(buf), 1, f) != 1) {
+    return -1;
+  }
+  *val = nptohl(buf);
+  return 0;
+}
+
+int parsebgp_intern_save(const parsebgp_intern_t *store, FILE *f)
+{
+  const intern_kind_t *k;
+  const intern_entry_t *e;
+  uint32_t cnt, id;
+  int i;
+
+  if (fwrite(SAVE_MAGIC, sizeof(SAVE_MAGIC) - 1, 1, f) != 1 ||
+      write_u32(f, PARSEBGP_INTERN_KINDS_CNT) != 0) {
+    return -1;
+  }
+  for (i = 0; i < PARSEBGP_INTERN_KINDS_CNT; i++) {
+    k = &store->kinds[i];
+    // entries are immutable, so only the count needs to be consistent
+    cnt = LOAD_ACQ(&k->cnt);
+    if (write_u32(f, cnt) != 0) {
+      return -1;
+    }
+    for (id = 1; id <= cnt; id++) {
+      e = get_entry(k, id);
+      if (write_u32(f, e->len) != 0 ||
+          (e->len > 0 && fwrite(e->data, e->len, 1, f) != 1)) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+parsebgp_intern_t *parsebgp_intern_load(FILE *f)
+{
+  parsebgp_intern_t *store;
+  char magic[sizeof(SAVE_MAGIC) - 1];
+  uint8_t *buf = NULL, *tmp;
+  uint32_t kinds_cnt, cnt, len, alloc_len = 0, id, i, j;
+
+  if (fread(magic, sizeof(magic), 1, f) != 1 ||
+      memcmp(magic, SAVE_MAGIC, sizeof(magic)) != 0 ||
+      read_u32(f, &kinds_cnt) != 0 || kinds_cnt != PARSEBGP_INTERN_KINDS_CNT ||
+      (store = parsebgp_intern_create()) == NULL) {
+    return NULL;
+  }
+
+  for (i = 0; i < kinds_cnt; i++) {
+    if (read_u32(f, &cnt) != 0) {
+      goto err;
+    }
+    for (j = 1; j <= cnt; j++) {
+      if (read_u32(f, &len) != 0) {
+        goto err;
+      }
+      if (len > alloc_len) {
+        if ((tmp = realloc(buf, len)) == NULL) {
+          goto err;
+        }
+        buf = tmp;
+        alloc_len = len;
+      }
+      if ((len > 0 && fread(buf, len, 1, f) != 1) ||
+          parsebgp_intern(store, i, buf, len, &id) != PARSEBGP_OK ||
+          id != j) {
+        // (a duplicate value would not get the expected ID)
+        goto err;
+      }
+    }
+  }
+
+  free(buf);
+  return store;
+
+err:
+  free(buf);
+  parsebgp_intern_destroy(store);
+  return NULL;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_INTERN_H
+#define __PARSEBGP_INTERN_H
+
+#include "parsebgp_error.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque store that maps (canonical) values to dense IDs */
+typedef struct parsebgp_intern parsebgp_intern_t;
+
+/**
+ * Kinds of interned values
+ *
+ * Each kind has its own ID space. IDs start at 1 (0 means "no value") and are
+ * allocated densely, in the order that values are first seen.
+ */
+typedef enum {
+
+  /** AS paths
+   *
+   * Canonical form: for each segment, the segment type (1 byte), the number of
+   * ASNs (1 byte), and then the ASNs (4 bytes each, in network byte order),
+   * regardless of whether the path was encoded using 2 or 4-byte ASNs.
+   */
+  PARSEBGP_INTERN_AS_PATH = 0,
+
+  /** Community sets
+   *
+   * Canonical form: for each of the COMMUNITIES, EXT_COMMUNITIES,
+   * IPV6_EXT_COMMUNITIES and LARGE_COMMUNITIES attributes (in that order) that
+   * is present, the attribute type (1 byte), the number of communities (2
+   * bytes, in network byte order), and then the sorted and de-duplicated
+   * communities (as encoded in the attribute).
+   */
+  PARSEBGP_INTERN_COMMUNITIES = 1,
+
+  /** Path Attribute blocks
+   *
+   * Canonical form: the raw Path Attributes data (as encoded in the message)
+   */
+  PARSEBGP_INTERN_ATTRS = 2,
+
+  /** Number of kinds (INTERNAL) */
+  PARSEBGP_INTERN_KINDS_CNT = 3,
+
+} parsebgp_intern_kind_t;
+
+/**
+ * Create an empty interning store
+ *
+ * @return pointer to the new store, or NULL if memory could not be allocated
+ *
+ * To intern the AS path, communities and Path Attributes of each decoded
+ * message, set the intern field of the parsing options (the IDs are stored in
+ * the intern_ids field of parsebgp_bgp_update_path_attrs_t).
+ *
+ * Unlike other parsing state, a store may be shared between parsers that run
+ * concurrently (e.g., to build one dictionary while decoding many files in
+ * parallel). Lookups of known values do not take any locks.
+ */
+parsebgp_intern_t *parsebgp_intern_create(void);
+
+/**
+ * Destroy the given interning store
+ *
+ * @param store         pointer to the store to destroy
+ */
+void parsebgp_intern_destroy(parsebgp_intern_t *store);
+
+/**
+ * Get the ID of the given value, adding it to the store if needed
+ *
+ * @param store         pointer to the store
+ * @param kind          kind of the value (parsebgp_intern_kind_t)
+ * @param data          pointer to the (canonical) value
+ * @param len           length of the value (in bytes)
+ * @param [out] idp     set to the ID of the value
+ * @return PARSEBGP_OK if successful, or an error code otherwise
+ */
+parsebgp_error_t parsebgp_intern(parsebgp_intern_t *store,
+                                 parsebgp_intern_kind_t kind,
+                                 const void *data, size_t len, uint32_t *idp);
+
+/**
+ * Get the ID of the given value, if it is in the store
+ *
+ * @param store         pointer to the store
+ * @param kind          kind of the value (parsebgp_intern_kind_t)
+ * @param data          pointer to the (canonical) value
+ * @param len           length of the value (in bytes)
+ * @return the ID of the value, or 0 if it is not in the store
+ */
+uint32_t parsebgp_intern_find(const parsebgp_intern_t *store,
+                              parsebgp_intern_kind_t kind, const void *data,
+                              size_t len);
+
+/**
+ * Get the value with the given ID
+ *
+ * @param store         pointer to the store
+ * @param kind          kind of the value (parsebgp_intern_kind_t)
+ * @param id            ID of the value
+ * @param [out] lenp    set to the length of the value (in bytes)
+ * @return pointer to the (canonical) value, or NULL if there is no value with
+ * the given ID. The value is valid until the store is destroyed.
+ */
+const uint8_t *parsebgp_intern_get(const parsebgp_intern_t *store,
+                                   parsebgp_intern_kind_t kind, uint32_t id,
+                                   size_t *lenp);
+
+/**
+ * Get the number of values of the given kind in the store
+ *
+ * @param store         pointer to the store
+ * @param kind          kind of the values (parsebgp_intern_kind_t)
+ * @return the number of values (i.e., the largest ID in use)
+ */
+uint32_t parsebgp_intern_count(const parsebgp_intern_t *store,
+                               parsebgp_intern_kind_t kind);
+
+/**
+ * Write the contents of the store to the given file
+ *
+ * @param store         pointer to the store
+ * @param f             file to write to
+ * @return 0 if successful, -1 otherwise (e.g., on a write error)
+ *
+ * The values are written in ID order, so the IDs are preserved when the file
+ * is read back using parsebgp_intern_load. The store may be in use by other
+ * parsers while it is being saved (values added in the meantime may or may
+ * not be included).
+ */
+int parsebgp_intern_save(const parsebgp_intern_t *store, FILE *f);
+
+/**
+ * Create an interning store from a file written by parsebgp_intern_save
+ *
+ * @param f             file to read from
+ * @return pointer to the new store, or NULL if the file could not be read (or
+ * memory could not be allocated)
+ *
+ * Values that are added to the store later are given new IDs that follow on
+ * from those in the file.
+ */
+parsebgp_intern_t *parsebgp_intern_load(FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PARSEBGP_INTERN_H */
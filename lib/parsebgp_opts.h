@@ -27,13 +27,68 @@
 #ifndef __PARSEBGP_OPTS_H
 #define __PARSEBGP_OPTS_H
 
+#include "parsebgp_attr_cache.h"
 #include "parsebgp_bgp_opts.h"
 #include "parsebgp_bmp_opts.h"
+#include "parsebgp_filter.h"
+#include "parsebgp_intern.h"
+#include "parsebgp_prefix_set.h"
+#include "parsebgp_session.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct parsebgp_mrt_table_dump_v2_afi_safi_rib;
+struct parsebgp_mrt_table_dump_v2_rib_entry;
+
+/**
+ * Message sections that may be selected for decoding (see
+ * parsebgp_opts_t.projection)
+ *
+ * Message headers (MRT common header, BMP common and per-peer headers, BGP
+ * header, and the fixed fields of each message type) are needed to frame the
+ * rest of the message and so are always decoded.
+ */
+typedef enum {
+
+  /** BGP UPDATE Withdrawn Routes (and MP_UNREACH_NLRI prefixes) */
+  PARSEBGP_PROJ_BGP_WITHDRAWN = 0x0001,
+
+  /** BGP UPDATE Path Attributes (also used by MRT RIB entries). Individual
+      attributes may be selected using the path_attr_filter BGP option. */
+  PARSEBGP_PROJ_BGP_PATH_ATTRS = 0x0002,
+
+  /** BGP UPDATE announced NLRI (and MP_REACH_NLRI prefixes) */
+  PARSEBGP_PROJ_BGP_ANNOUNCED = 0x0004,
+
+  /** BGP OPEN Capabilities. Individual capabilities may be selected using the
+      capability_filter BGP option. */
+  PARSEBGP_PROJ_BGP_OPEN_CAPS = 0x0008,
+
+  /** BMP Route Monitoring message body (the BGP UPDATE message) */
+  PARSEBGP_PROJ_BMP_ROUTE_MON = 0x0010,
+
+  /** BMP Stats Report message body */
+  PARSEBGP_PROJ_BMP_STATS = 0x0020,
+
+  /** BMP Peer Up and Peer Down message bodies */
+  PARSEBGP_PROJ_BMP_PEER_EVENTS = 0x0040,
+
+  /** BMP Initiation and Termination message bodies */
+  PARSEBGP_PROJ_BMP_INFO = 0x0080,
+
+  /** MRT TABLE_DUMP_V2 Peer Index Table peer entries */
+  PARSEBGP_PROJ_MRT_PEER_INDEX = 0x0100,
+
+  /** MRT TABLE_DUMP_V2 RIB entries (the prefix is always decoded) */
+  PARSEBGP_PROJ_MRT_RIB_ENTRIES = 0x0200,
+
+  /** All sections */
+  PARSEBGP_PROJ_ALL = 0x03FF,
+
+} parsebgp_projection_t;
+
 /**
  * Parsing Options
  */
@@ -87,6 +142,131 @@ typedef struct parsebgp_opts {
    */
   int silence_invalid;
 
+  /**
+   * Should only some sections of messages be decoded?
+   *
+   * If this is set, the projection field is checked by each decoder before
+   * parsing an optional section of a message. Sections that are not selected
+   * are skipped over (using their encoded length) without being parsed, and
+   * the corresponding fields of the parsed structure are left empty (e.g.,
+   * prefixes_cnt is zero). Skipped BMP message bodies are reported by clearing
+   * types_valid in the BMP message (as for the parse_headers_only BMP option).
+   */
+  int projection_enabled;
+
+  /**
+   * Bitwise OR of the parsebgp_projection_t sections to decode (see
+   * documentation for projection_enabled for more information).
+   */
+  uint32_t projection;
+
+  /**
+   * Message filter
+   *
+   * If this is set (see parsebgp_filter_create), each decoder evaluates the
+   * filter as soon as the fields that it refers to have been parsed. As soon as
+   * it is known that a message cannot match, the rest of the message is skipped
+   * and parsebgp_decode returns PARSEBGP_FILTERED_OUT (with the length set to
+   * the length of the message, so that the caller can move on to the next
+   * one). For MRT TABLE_DUMP_V2 RIB records, the filter is applied to each RIB
+   * entry, and entries that do not match are dropped from the record.
+   *
+   * The filter can only match fields that are decoded, so the projection and
+   * path attribute filter options should not exclude them.
+   */
+  const parsebgp_filter_t *filter;
+
+  /** Filter evaluation state (for internal use) */
+  uint32_t _filter_known;
+  uint32_t _filter_true;
+
+  /**
+   * Prefix set
+   *
+   * If this is set (see parsebgp_prefix_set_create), prefixes are matched
+   * against the set (using prefix_set_match) as they are decoded:
+   *  - BGP UPDATE prefixes (including those in MP_REACH_NLRI and
+   *    MP_UNREACH_NLRI) that do not match are dropped, and an UPDATE that is
+   *    left with no prefixes at all is skipped;
+   *  - MRT TABLE_DUMP and TABLE_DUMP_V2 RIB records whose prefix does not match
+   *    are skipped before their path attributes or RIB entries are parsed.
+   * Skipped messages are reported by parsebgp_decode returning
+   * PARSEBGP_FILTERED_OUT (see the filter option). Other messages (e.g., OPEN
+   * or BMP Peer Up) are not affected.
+   *
+   * Prefixes in sections excluded by the projection option are not decoded and
+   * so cannot match.
+   */
+  const parsebgp_prefix_set_t *prefix_set;
+
+  /** How prefixes must match the prefix set (see parsebgp_prefix_set_match) */
+  parsebgp_prefix_set_match_t prefix_set_match;
+
+  /**
+   * MRT TABLE_DUMP_V2 peer filter
+   *
+   * If this is set (see parsebgp_mrt_peer_filter_create), only the RIB entries
+   * of the peers in the filter are decoded.
+   */
+  struct parsebgp_mrt_peer_filter *mrt_peer_filter;
+
+  /**
+   * MRT TABLE_DUMP_V2 RIB entry callback (a parsebgp_mrt_rib_entry_func_t)
+   *
+   * If this is set, the RIB entries of TABLE_DUMP_V2 records are not collected
+   * into the entries array of the record. Instead, each entry is decoded into
+   * a single reusable slot and passed to this callback (after the peer filter
+   * and filter options have been applied), so that memory use does not depend
+   * on the number of entries in a record. The record has an entry_count of 1
+   * while the callback runs, and of zero once parsebgp_decode returns (even if
+   * it fails).
+   */
+  parsebgp_error_t (*mrt_rib_entry_cb)(
+    const struct parsebgp_mrt_table_dump_v2_afi_safi_rib *rib,
+    const struct parsebgp_mrt_table_dump_v2_rib_entry *entry, void *user);
+
+  /** User data passed to mrt_rib_entry_cb */
+  void *mrt_rib_entry_cb_user;
+
+  /**
+   * Session table
+   *
+   * If this is set (see parsebgp_session_table_create), the capabilities of
+   * each BGP session are learned from BMP Peer Up messages and BGP4MP OPEN
+   * messages, and are used to decode later UPDATE messages from the same
+   * session. The negotiated ADD-PATH capabilities are always used, but the
+   * 4-byte AS capability is only used for BMP Route Monitoring messages whose
+   * peer header does not say that 2-byte AS numbers are used (for BGP4MP
+   * messages the subtype decides, and 4-byte AS paths are still decoded again
+   * using 2-byte AS numbers if they cannot be decoded). Sessions are
+   * forgotten when a BMP Peer Down message or a BGP4MP state change to Idle,
+   * Connect or Active is seen.
+   *
+   * The OPEN capabilities must not be excluded by the projection or
+   * capability_filter options.
+   */
+  parsebgp_session_table_t *sessions;
+
+  /**
+   * Attribute cache
+   *
+   * If this is set (see parsebgp_attr_cache_create), decoded blocks of Path
+   * Attributes are cached, and messages with the same (raw) Path Attributes
+   * as a recent message share the decoded copy instead of decoding it again.
+   */
+  parsebgp_attr_cache_t *attr_cache;
+
+  /**
+   * Interning store
+   *
+   * If this is set (see parsebgp_intern_create), the AS path, the community
+   * set and the whole block of Path Attributes of each message are mapped to
+   * dense IDs while they are decoded (see the intern_ids field of
+   * parsebgp_bgp_update_path_attrs_t). Unlike the other state in these
+   * options, the store may be shared with other parsers.
+   */
+  parsebgp_intern_t *intern;
+
   /** BGP-specific parsing options */
   parsebgp_bgp_opts_t bgp;
 
@@ -0,0 +1,498 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_pack.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Round up to a multiple of 8 bytes (the alignment used within a block) */
+#define ALIGN8(x) (((x) + 7) & ~(size_t)7)
+
+/** Header of a packed message */
+struct parsebgp_msg_packed {
+
+  /** Length of the block (in bytes) */
+  uint32_t len;
+
+  /** Message type (parsebgp_msg_type_t) */
+  uint32_t type;
+
+  /** Number of elements */
+  uint32_t elems_cnt;
+
+  /** Number of path attribute sets */
+  uint32_t attrs_cnt;
+
+  /** Offset of the array of elements */
+  uint32_t elems_off;
+
+  /** Offset of the array of path attribute sets */
+  uint32_t attrs_off;
+
+};
+
+/** Sizes of the parts of a packed message */
+typedef struct pack_layout {
+
+  uint32_t elems_cnt;
+
+  uint32_t attrs_cnt;
+
+  /** Length of the variable-length attribute data */
+  size_t data_len;
+
+} pack_layout_t;
+
+/** Variable-length attributes that are packed as plain arrays */
+enum {
+  ARR_COMMUNITIES,
+  ARR_EXT_COMMUNITIES,
+  ARR_IPV6_EXT_COMMUNITIES,
+  ARR_LARGE_COMMUNITIES,
+  ARR_CLUSTER_IDS,
+  ARR_CNT,
+};
+
+typedef struct attr_array {
+
+  const void *items;
+
+  uint32_t cnt;
+
+  size_t item_size;
+
+} attr_array_t;
+
+static const parsebgp_bgp_update_as_path_t *
+get_as_path(const parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  const parsebgp_bgp_update_as_path_t *as_path = NULL;
+
+  if (path_attrs->as_path_merged.valid) {
+    as_path = &path_attrs->as_path_merged.path;
+  } else if (path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH].type ==
+             PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH) {
+    as_path =
+      path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH].data.as_path;
+  }
+  // segments are not decoded by shallow parsing
+  if (as_path == NULL || as_path->segs == NULL) {
+    return NULL;
+  }
+  return as_path;
+}
+
+#define ATTR_PRESENT(path_attrs, attr_type)                                    \
+  ((path_attrs)->attrs[(attr_type)].type == (attr_type))
+
+static void get_arrays(const parsebgp_bgp_update_path_attrs_t *path_attrs,
+                       attr_array_t *arrays)
+{
+  const parsebgp_bgp_update_path_attr_t *attrs = path_attrs->attrs;
+  const parsebgp_bgp_update_ext_communities_t *ext;
+
+  memset(arrays, 0, sizeof(*arrays) * ARR_CNT);
+
+  if (ATTR_PRESENT(path_attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES)) {
+    arrays[ARR_COMMUNITIES].items =
+      attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES]
+        .data.communities->communities;
+    arrays[ARR_COMMUNITIES].cnt =
+      attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES]
+        .data.communities->communities_cnt;
+  }
+  arrays[ARR_COMMUNITIES].item_size = sizeof(uint32_t);
+
+  if (ATTR_PRESENT(path_attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES)) {
+    ext =
+      attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES].data.ext_communities;
+    arrays[ARR_EXT_COMMUNITIES].items = ext->communities;
+    arrays[ARR_EXT_COMMUNITIES].cnt = ext->communities_cnt;
+  }
+  arrays[ARR_EXT_COMMUNITIES].item_size =
+    sizeof(parsebgp_bgp_update_ext_community_t);
+
+  if (ATTR_PRESENT(path_attrs,
+                   PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES)) {
+    ext = attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES]
+            .data.ext_communities;
+    arrays[ARR_IPV6_EXT_COMMUNITIES].items = ext->communities;
+    arrays[ARR_IPV6_EXT_COMMUNITIES].cnt = ext->communities_cnt;
+  }
+  arrays[ARR_IPV6_EXT_COMMUNITIES].item_size =
+    sizeof(parsebgp_bgp_update_ext_community_t);
+
+  if (ATTR_PRESENT(path_attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES)) {
+    arrays[ARR_LARGE_COMMUNITIES].items =
+      attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES]
+        .data.large_communities->communities;
+    arrays[ARR_LARGE_COMMUNITIES].cnt =
+      attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES]
+        .data.large_communities->communities_cnt;
+  }
+  arrays[ARR_LARGE_COMMUNITIES].item_size =
+    sizeof(parsebgp_bgp_update_large_community_t);
+
+  if (ATTR_PRESENT(path_attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST)) {
+    arrays[ARR_CLUSTER_IDS].items =
+      attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST]
+        .data.cluster_list->cluster_ids;
+    arrays[ARR_CLUSTER_IDS].cnt =
+      attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST]
+        .data.cluster_list->cluster_ids_cnt;
+  }
+  arrays[ARR_CLUSTER_IDS].item_size = sizeof(uint32_t);
+}
+
+// length of the variable-length data of the given attributes
+static size_t attrs_data_len(const parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  const parsebgp_bgp_update_as_path_t *as_path;
+  attr_array_t arrays[ARR_CNT];
+  size_t len = 0;
+  int i;
+
+  if ((as_path = get_as_path(path_attrs)) != NULL) {
+    len += ALIGN8(as_path->segs_cnt * sizeof(parsebgp_packed_as_path_seg_t));
+    for (i = 0; i < as_path->segs_cnt; i++) {
+      len += ALIGN8(as_path->segs[i].asns_cnt * sizeof(uint32_t));
+    }
+  }
+
+  get_arrays(path_attrs, arrays);
+  for (i = 0; i < ARR_CNT; i++) {
+    if (arrays[i].items != NULL) {
+      len += ALIGN8(arrays[i].cnt * arrays[i].item_size);
+    }
+  }
+
+  return len;
+}
+
+// work out the layout of the packed form of a message, returning its length
+// (or 0 if it is too large to be addressed with 32-bit offsets)
+static size_t measure(const parsebgp_msg_t *msg,
+                      const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index,
+                      pack_layout_t *layout)
+{
+  parsebgp_elem_iter_t iter;
+  const parsebgp_elem_t *elem;
+  const parsebgp_bgp_update_path_attrs_t *last_attrs = NULL;
+  size_t len;
+
+  memset(layout, 0, sizeof(*layout));
+  parsebgp_elem_iter_init(&iter, msg, peer_index);
+  while ((elem = parsebgp_elem_iter_next(&iter)) != NULL) {
+    layout->elems_cnt++;
+    // elements that share attributes are adjacent
+    if (elem->path_attrs != NULL && elem->path_attrs != last_attrs) {
+      layout->attrs_cnt++;
+      layout->data_len += attrs_data_len(elem->path_attrs);
+      last_attrs = elem->path_attrs;
+    }
+  }
+
+  len = ALIGN8(sizeof(parsebgp_msg_packed_t)) +
+        ALIGN8((size_t)layout->elems_cnt * sizeof(parsebgp_packed_elem_t)) +
+        ALIGN8((size_t)layout->attrs_cnt * sizeof(parsebgp_packed_attrs_t)) +
+        layout->data_len;
+  return (len > UINT32_MAX) ? 0 : len;
+}
+
+// copy len bytes to the data area of the block, returning their offset
+static uint32_t put_data(uint8_t *buf, size_t *data_off, const void *src,
+                         size_t len)
+{
+  uint32_t off = *data_off;
+  memcpy(buf + off, src, len);
+  *data_off = ALIGN8(off + len);
+  return off;
+}
+
+static void pack_attrs(uint8_t *buf, size_t *data_off,
+                       parsebgp_packed_attrs_t *pa,
+                       const parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  const parsebgp_bgp_update_path_attr_t *attrs = path_attrs->attrs;
+  const parsebgp_bgp_update_as_path_t *as_path;
+  parsebgp_packed_as_path_seg_t *segs;
+  attr_array_t arrays[ARR_CNT];
+  uint32_t *cnts[ARR_CNT] = {
+    &pa->communities_cnt,          &pa->ext_communities_cnt,
+    &pa->ipv6_ext_communities_cnt, &pa->large_communities_cnt,
+    &pa->cluster_ids_cnt,
+  };
+  uint32_t *offs[ARR_CNT] = {
+    &pa->_communities_off,          &pa->_ext_communities_off,
+    &pa->_ipv6_ext_communities_off, &pa->_large_communities_off,
+    &pa->_cluster_ids_off,
+  };
+  int i, type;
+
+  for (i = 0; i < path_attrs->attrs_cnt; i++) {
+    type = path_attrs->attrs_used[i];
+    if (type < PARSEBGP_BGP_PATH_ATTRS_LEN && attrs[type].type == type) {
+      pa->present |= (uint64_t)1 << type;
+    }
+  }
+
+  pa->origin = attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN].data.origin;
+  pa->med = attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MED].data.med;
+  pa->local_pref =
+    attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_LOCAL_PREF].data.local_pref;
+  pa->aggregator =
+    attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR].data.aggregator;
+  pa->originator_id =
+    attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGINATOR_ID].data.originator_id;
+  pa->fingerprints = path_attrs->fingerprints;
+  pa->intern_ids = path_attrs->intern_ids;
+
+  if ((as_path = get_as_path(path_attrs)) != NULL) {
+    pa->as_path_segs_cnt = as_path->segs_cnt;
+    pa->_as_path_off = *data_off;
+    segs = (parsebgp_packed_as_path_seg_t *)(buf + *data_off);
+    *data_off +=
+      ALIGN8(as_path->segs_cnt * sizeof(parsebgp_packed_as_path_seg_t));
+    for (i = 0; i < as_path->segs_cnt; i++) {
+      segs[i].type = as_path->segs[i].type;
+      segs[i].asns_cnt = as_path->segs[i].asns_cnt;
+      segs[i]._asns_off =
+        put_data(buf, data_off, as_path->segs[i].asns,
+                 as_path->segs[i].asns_cnt * sizeof(uint32_t));
+    }
+  }
+
+  get_arrays(path_attrs, arrays);
+  for (i = 0; i < ARR_CNT; i++) {
+    if (arrays[i].items != NULL) {
+      *cnts[i] = arrays[i].cnt;
+      *offs[i] = put_data(buf, data_off, arrays[i].items,
+                          arrays[i].cnt * arrays[i].item_size);
+    }
+  }
+}
+
+static void pack_elem(parsebgp_packed_elem_t *pe, const parsebgp_elem_t *elem)
+{
+  pe->type = elem->type;
+  pe->timestamp_sec = elem->timestamp_sec;
+  pe->timestamp_usec = elem->timestamp_usec;
+  if (elem->peer_ip != NULL) {
+    pe->peer_afi = elem->peer_afi;
+    memcpy(pe->peer_ip, elem->peer_ip,
+           elem->peer_afi == PARSEBGP_BGP_AFI_IPV4 ? 4 : 16);
+  }
+  pe->peer_asn = elem->peer_asn;
+  if (elem->prefix != NULL) {
+    pe->prefix = *elem->prefix;
+  }
+  if (elem->next_hop != NULL) {
+    // an IPv4 NEXT_HOP attribute only has room for 4 bytes
+    pe->next_hop_afi = elem->next_hop_afi;
+    memcpy(pe->next_hop, elem->next_hop,
+           elem->next_hop_afi == PARSEBGP_BGP_AFI_IPV4 ? 4 : 16);
+  }
+  pe->old_state = elem->old_state;
+  pe->new_state = elem->new_state;
+}
+
+static void
+write_packed(const parsebgp_msg_t *msg,
+             const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index,
+             const pack_layout_t *layout, uint8_t *buf, size_t len)
+{
+  parsebgp_msg_packed_t *hdr = (parsebgp_msg_packed_t *)buf;
+  parsebgp_packed_elem_t *elems;
+  parsebgp_packed_attrs_t *attrs;
+  parsebgp_elem_iter_t iter;
+  const parsebgp_elem_t *elem;
+  const parsebgp_bgp_update_path_attrs_t *last_attrs = NULL;
+  uint32_t elem_idx = 0, attrs_idx = 0;
+  size_t data_off;
+
+  // zero everything, including padding, so that equal messages give equal
+  // blocks
+  memset(buf, 0, len);
+
+  hdr->len = len;
+  hdr->type = msg->type;
+  hdr->elems_cnt = layout->elems_cnt;
+  hdr->attrs_cnt = layout->attrs_cnt;
+  hdr->elems_off = ALIGN8(sizeof(parsebgp_msg_packed_t));
+  hdr->attrs_off =
+    hdr->elems_off +
+    ALIGN8((size_t)layout->elems_cnt * sizeof(parsebgp_packed_elem_t));
+  data_off =
+    hdr->attrs_off +
+    ALIGN8((size_t)layout->attrs_cnt * sizeof(parsebgp_packed_attrs_t));
+
+  elems = (parsebgp_packed_elem_t *)(buf + hdr->elems_off);
+  attrs = (parsebgp_packed_attrs_t *)(buf + hdr->attrs_off);
+
+  parsebgp_elem_iter_init(&iter, msg, peer_index);
+  while ((elem = parsebgp_elem_iter_next(&iter)) != NULL) {
+    pack_elem(&elems[elem_idx], elem);
+    if (elem->path_attrs == NULL) {
+      elems[elem_idx].attrs_idx = PARSEBGP_PACKED_NO_ATTRS;
+    } else {
+      if (elem->path_attrs != last_attrs) {
+        pack_attrs(buf, &data_off, &attrs[attrs_idx++], elem->path_attrs);
+        last_attrs = elem->path_attrs;
+      }
+      elems[elem_idx].attrs_idx = attrs_idx - 1;
+    }
+    elem_idx++;
+  }
+}
+
+size_t parsebgp_msg_pack_size(
+  const parsebgp_msg_t *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index)
+{
+  pack_layout_t layout;
+  return measure(msg, peer_index, &layout);
+}
+
+size_t parsebgp_msg_pack_into(
+  const parsebgp_msg_t *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index, void *buf,
+  size_t len)
+{
+  pack_layout_t layout;
+  size_t need;
+
+  if ((need = measure(msg, peer_index, &layout)) == 0 || need > len) {
+    return 0;
+  }
+  write_packed(msg, peer_index, &layout, buf, need);
+  return need;
+}
+
+parsebgp_msg_packed_t *parsebgp_msg_pack(
+  const parsebgp_msg_t *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index)
+{
+  pack_layout_t layout;
+  uint8_t *buf;
+  size_t len;
+
+  if ((len = measure(msg, peer_index, &layout)) == 0 ||
+      (buf = malloc(len)) == NULL) {
+    return NULL;
+  }
+  write_packed(msg, peer_index, &layout, buf, len);
+  return (parsebgp_msg_packed_t *)buf;
+}
+
+#define PACKED_PTR(packed, off) ((const uint8_t *)(packed) + (off))
+
+size_t parsebgp_msg_packed_len(const parsebgp_msg_packed_t *packed)
+{
+  return packed->len;
+}
+
+parsebgp_msg_type_t
+parsebgp_msg_packed_type(const parsebgp_msg_packed_t *packed)
+{
+  return packed->type;
+}
+
+uint32_t parsebgp_msg_packed_elems_cnt(const parsebgp_msg_packed_t *packed)
+{
+  return packed->elems_cnt;
+}
+
+const parsebgp_packed_elem_t *
+parsebgp_msg_packed_elem(const parsebgp_msg_packed_t *packed, uint32_t idx)
+{
+  return (const parsebgp_packed_elem_t *)PACKED_PTR(packed, packed->elems_off) +
+         idx;
+}
+
+const parsebgp_packed_attrs_t *
+parsebgp_msg_packed_attrs(const parsebgp_msg_packed_t *packed,
+                          const parsebgp_packed_elem_t *elem)
+{
+  if (elem->attrs_idx == PARSEBGP_PACKED_NO_ATTRS) {
+    return NULL;
+  }
+  return (const parsebgp_packed_attrs_t *)PACKED_PTR(packed,
+                                                     packed->attrs_off) +
+         elem->attrs_idx;
+}
+
+const parsebgp_packed_as_path_seg_t *
+parsebgp_msg_packed_as_path(const parsebgp_msg_packed_t *packed,
+                            const parsebgp_packed_attrs_t *attrs)
+{
+  return (const parsebgp_packed_as_path_seg_t *)PACKED_PTR(packed,
+                                                           attrs->_as_path_off);
+}
+
+const uint32_t *
+parsebgp_msg_packed_seg_asns(const parsebgp_msg_packed_t *packed,
+                             const parsebgp_packed_as_path_seg_t *seg)
+{
+  return (const uint32_t *)PACKED_PTR(packed, seg->_asns_off);
+}
+
+const uint32_t *
+parsebgp_msg_packed_communities(const parsebgp_msg_packed_t *packed,
+                                const parsebgp_packed_attrs_t *attrs)
+{
+  return (const uint32_t *)PACKED_PTR(packed, attrs->_communities_off);
+}
+
+const parsebgp_bgp_update_ext_community_t *
+parsebgp_msg_packed_ext_communities(const parsebgp_msg_packed_t *packed,
+                                    const parsebgp_packed_attrs_t *attrs)
+{
+  return (const parsebgp_bgp_update_ext_community_t *)PACKED_PTR(
+    packed, attrs->_ext_communities_off);
+}
+
+const parsebgp_bgp_update_ext_community_t *
+parsebgp_msg_packed_ipv6_ext_communities(const parsebgp_msg_packed_t *packed,
+                                         const parsebgp_packed_attrs_t *attrs)
+{
+  return (const parsebgp_bgp_update_ext_community_t *)PACKED_PTR(
+    packed, attrs->_ipv6_ext_communities_off);
+}
+
+const parsebgp_bgp_update_large_community_t *
+parsebgp_msg_packed_large_communities(const parsebgp_msg_packed_t *packed,
+                                      const parsebgp_packed_attrs_t *attrs)
+{
+  return (const parsebgp_bgp_update_large_community_t *)PACKED_PTR(
+    packed, attrs->_large_communities_off);
+}
+
+const uint32_t *
+parsebgp_msg_packed_cluster_ids(const parsebgp_msg_packed_t *packed,
+                                const parsebgp_packed_attrs_t *attrs)
+{
+  return (const uint32_t *)PACKED_PTR(packed, attrs->_cluster_ids_off);
+}
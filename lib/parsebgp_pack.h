@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_PACK_H
+#define __PARSEBGP_PACK_H
+
+#include "parsebgp.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Packed Message
+ *
+ * An opaque, contiguous copy of the route elements of a parsed message (see
+ * parsebgp_elem.h) and the path attributes they refer to. All references
+ * within the block are offsets from its start, so it may be moved (e.g.,
+ * copied through a ring buffer or shared memory) with memcpy, and is freed
+ * with a single free(). The block must be 8-byte aligned, and can only be read
+ * on a host with the same byte order as the one that packed it.
+ */
+typedef struct parsebgp_msg_packed parsebgp_msg_packed_t;
+
+/** Value of parsebgp_packed_elem_t.attrs_idx for elements without path
+    attributes */
+#define PARSEBGP_PACKED_NO_ATTRS UINT32_MAX
+
+/**
+ * Packed Route Element
+ *
+ * A copy of a parsebgp_elem_t, with addresses stored inline.
+ */
+typedef struct parsebgp_packed_elem {
+
+  /** Type of element (parsebgp_elem_type_t) */
+  uint8_t type;
+
+  /** Address family of the peer (zero if the peer is not known) */
+  uint8_t peer_afi;
+
+  /** Address family of the next hop (zero if there is no next hop) */
+  uint8_t next_hop_afi;
+
+  /** Time of the element (seconds since the unix epoch) */
+  uint32_t timestamp_sec;
+
+  /** Microseconds portion of the element time */
+  uint32_t timestamp_usec;
+
+  /** IP address of the peer */
+  uint8_t peer_ip[16];
+
+  /** ASN of the peer */
+  uint32_t peer_asn;
+
+  /** Prefix (unset for PEER_STATE elements) */
+  parsebgp_bgp_prefix_t prefix;
+
+  /** Next hop of an announcement or RIB entry */
+  uint8_t next_hop[16];
+
+  /** Previous session state (PEER_STATE only) */
+  uint16_t old_state;
+
+  /** New session state (PEER_STATE only) */
+  uint16_t new_state;
+
+  /** Index of the path attributes of the element (see
+      parsebgp_msg_packed_attrs), or PARSEBGP_PACKED_NO_ATTRS */
+  uint32_t attrs_idx;
+
+} parsebgp_packed_elem_t;
+
+/**
+ * Packed AS Path Segment
+ */
+typedef struct parsebgp_packed_as_path_seg {
+
+  /** Segment Type (parsebgp_bgp_update_as_path_seg_type_t) */
+  uint8_t type;
+
+  /** Number of ASNs in the segment */
+  uint8_t asns_cnt;
+
+  /** Offset of the ASNs (use parsebgp_msg_packed_seg_asns) */
+  uint32_t _asns_off;
+
+} parsebgp_packed_as_path_seg_t;
+
+/**
+ * Packed Path Attributes
+ *
+ * Fixed-size attributes are stored inline, and are only valid if the
+ * attribute is present (see parsebgp_packed_attrs_has). Variable-length
+ * attributes are read with the parsebgp_msg_packed_* accessors.
+ */
+typedef struct parsebgp_packed_attrs {
+
+  /** Bitmap of the types of the attributes present (bit N is set if
+      attrs[N] of the original path attributes was set) */
+  uint64_t present;
+
+  /** ORIGIN (parsebgp_bgp_update_origin_type_t) */
+  uint8_t origin;
+
+  /** MULTI_EXIT_DISC */
+  uint32_t med;
+
+  /** LOCAL_PREF */
+  uint32_t local_pref;
+
+  /** AGGREGATOR */
+  parsebgp_bgp_update_aggregator_t aggregator;
+
+  /** ORIGINATOR_ID */
+  uint32_t originator_id;
+
+  /** Fingerprints (see the fingerprint option) */
+  parsebgp_bgp_update_fingerprints_t fingerprints;
+
+  /** Interned IDs (see the intern option) */
+  parsebgp_bgp_update_intern_ids_t intern_ids;
+
+  /** Number of AS Path segments */
+  uint32_t as_path_segs_cnt;
+
+  /** Number of COMMUNITIES */
+  uint32_t communities_cnt;
+
+  /** Number of EXT_COMMUNITIES */
+  uint32_t ext_communities_cnt;
+
+  /** Number of IPV6_EXT_COMMUNITIES */
+  uint32_t ipv6_ext_communities_cnt;
+
+  /** Number of LARGE_COMMUNITIES */
+  uint32_t large_communities_cnt;
+
+  /** Number of CLUSTER_IDs */
+  uint32_t cluster_ids_cnt;
+
+  /** Offsets of the variable-length attributes (INTERNAL) */
+  uint32_t _as_path_off;
+  uint32_t _communities_off;
+  uint32_t _ext_communities_off;
+  uint32_t _ipv6_ext_communities_off;
+  uint32_t _large_communities_off;
+  uint32_t _cluster_ids_off;
+
+} parsebgp_packed_attrs_t;
+
+/** Is the attribute of the given type present in the packed attributes? */
+#define parsebgp_packed_attrs_has(attrs, attr_type)                            \
+  (((attrs)->present >> (attr_type)) & 1)
+
+/**
+ * Compute the size of the packed form of the given message
+ *
+ * @param msg           pointer to a message filled by parsebgp_decode
+ * @param peer_index    Peer Index Table for TABLE_DUMP_V2 RIB entries (see
+ *                      parsebgp_elem_iter_init)
+ * @return the exact number of bytes that parsebgp_msg_pack_into will write
+ */
+size_t parsebgp_msg_pack_size(
+  const parsebgp_msg_t *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index);
+
+/**
+ * Pack the given message into a caller-provided buffer
+ *
+ * @param msg           pointer to a message filled by parsebgp_decode
+ * @param peer_index    Peer Index Table for TABLE_DUMP_V2 RIB entries (see
+ *                      parsebgp_elem_iter_init)
+ * @param buf           8-byte aligned buffer to pack into
+ * @param len           length of the buffer
+ * @return the number of bytes written, or 0 if the buffer is too small (see
+ * parsebgp_msg_pack_size)
+ *
+ * The path attributes shared by several elements are packed only once. The
+ * AS path is the effective AS path if as_path_merge is enabled, and the
+ * AS_PATH attribute otherwise.
+ */
+size_t parsebgp_msg_pack_into(
+  const parsebgp_msg_t *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index, void *buf,
+  size_t len);
+
+/**
+ * Pack the given message into a newly allocated block
+ *
+ * @param msg           pointer to a message filled by parsebgp_decode
+ * @param peer_index    Peer Index Table for TABLE_DUMP_V2 RIB entries (see
+ *                      parsebgp_elem_iter_init)
+ * @return pointer to the packed message (to be freed with free()), or NULL if
+ * memory could not be allocated
+ */
+parsebgp_msg_packed_t *parsebgp_msg_pack(
+  const parsebgp_msg_t *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index);
+
+/**
+ * Get the length of the given packed message
+ *
+ * @param packed        pointer to the packed message
+ * @return the length of the block (in bytes)
+ */
+size_t parsebgp_msg_packed_len(const parsebgp_msg_packed_t *packed);
+
+/**
+ * Get the type of message that the given packed message was packed from
+ *
+ * @param packed        pointer to the packed message
+ * @return the message type
+ */
+parsebgp_msg_type_t
+parsebgp_msg_packed_type(const parsebgp_msg_packed_t *packed);
+
+/**
+ * Get the number of route elements in the given packed message
+ *
+ * @param packed        pointer to the packed message
+ * @return the number of elements
+ */
+uint32_t parsebgp_msg_packed_elems_cnt(const parsebgp_msg_packed_t *packed);
+
+/**
+ * Get a route element of the given packed message
+ *
+ * @param packed        pointer to the packed message
+ * @param idx           index of the element (less than the element count)
+ * @return pointer to the element (within the block)
+ */
+const parsebgp_packed_elem_t *
+parsebgp_msg_packed_elem(const parsebgp_msg_packed_t *packed, uint32_t idx);
+
+/**
+ * Get the path attributes of a packed route element
+ *
+ * @param packed        pointer to the packed message
+ * @param elem          pointer to an element of the packed message
+ * @return pointer to the attributes (within the block), or NULL if the element
+ * has none
+ */
+const parsebgp_packed_attrs_t *
+parsebgp_msg_packed_attrs(const parsebgp_msg_packed_t *packed,
+                          const parsebgp_packed_elem_t *elem);
+
+/**
+ * Get the AS Path segments of packed path attributes
+ *
+ * @param packed        pointer to the packed message
+ * @param attrs         pointer to attributes of the packed message
+ * @return array of attrs->as_path_segs_cnt segments
+ */
+const parsebgp_packed_as_path_seg_t *
+parsebgp_msg_packed_as_path(const parsebgp_msg_packed_t *packed,
+                            const parsebgp_packed_attrs_t *attrs);
+
+/**
+ * Get the ASNs of a packed AS Path segment
+ *
+ * @param packed        pointer to the packed message
+ * @param seg           pointer to a segment of the packed message
+ * @return array of seg->asns_cnt ASNs
+ */
+const uint32_t *
+parsebgp_msg_packed_seg_asns(const parsebgp_msg_packed_t *packed,
+                             const parsebgp_packed_as_path_seg_t *seg);
+
+/**
+ * Get the COMMUNITIES of packed path attributes
+ *
+ * @param packed        pointer to the packed message
+ * @param attrs         pointer to attributes of the packed message
+ * @return array of attrs->communities_cnt communities
+ */
+const uint32_t *
+parsebgp_msg_packed_communities(const parsebgp_msg_packed_t *packed,
+                                const parsebgp_packed_attrs_t *attrs);
+
+/**
+ * Get the EXT_COMMUNITIES of packed path attributes
+ *
+ * @param packed        pointer to the packed message
+ * @param attrs         pointer to attributes of the packed message
+ * @return array of attrs->ext_communities_cnt communities
+ */
+const parsebgp_bgp_update_ext_community_t *
+parsebgp_msg_packed_ext_communities(const parsebgp_msg_packed_t *packed,
+                                    const parsebgp_packed_attrs_t *attrs);
+
+/**
+ * Get the IPV6_EXT_COMMUNITIES of packed path attributes
+ *
+ * @param packed        pointer to the packed message
+ * @param attrs         pointer to attributes of the packed message
+ * @return array of attrs->ipv6_ext_communities_cnt communities
+ */
+const parsebgp_bgp_update_ext_community_t *
+parsebgp_msg_packed_ipv6_ext_communities(const parsebgp_msg_packed_t *packed,
+                                         const parsebgp_packed_attrs_t *attrs);
+
+/**
+ * Get the LARGE_COMMUNITIES of packed path attributes
+ *
+ * @param packed        pointer to the packed message
+ * @param attrs         pointer to attributes of the packed message
+ * @return array of attrs->large_communities_cnt communities
+ */
+const parsebgp_bgp_update_large_community_t *
+parsebgp_msg_packed_large_communities(const parsebgp_msg_packed_t *packed,
+                                      const parsebgp_packed_attrs_t *attrs);
+
+/**
+ * Get the CLUSTER_LIST of packed path attributes
+ *
+ * @param packed        pointer to the packed message
+ * @param attrs         pointer to attributes of the packed message
+ * @return array of attrs->cluster_ids_cnt CLUSTER_IDs
+ */
+const uint32_t *
+parsebgp_msg_packed_cluster_ids(const parsebgp_msg_packed_t *packed,
+                                const parsebgp_packed_attrs_t *attrs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PARSEBGP_PACK_H */
@@ -0,0 +1,820 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_pipeline.h"
+#include "parsebgp_utils.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOAD_ACQ(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define LOAD_RLX(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/** Initial size of the reader buffer (grown if a message does not fit) */
+#define READ_BUFLEN (1024 * 1024)
+
+/** Size of a cache line, used to keep ring positions apart */
+#define CACHE_LINE 64
+
+/** Slot index that tells a worker to exit */
+#define SLOT_NONE UINT32_MAX
+
+/** Number of times an idle worker polls (see backoff) before it parks */
+#define IDLE_SPINS 128
+
+/** Cell of a ring (see ring_push) */
+typedef struct ring_cell {
+
+  /** Position that the cell is ready for */
+  size_t seq;
+
+  /** Slot index held by the cell */
+  uint32_t val;
+
+} ring_cell_t;
+
+/** Bounded lock-free multi-producer multi-consumer queue of slot indexes
+    (Dmitry Vyukov's design) */
+typedef struct ring {
+
+  /** Array of (mask + 1) cells */
+  ring_cell_t *cells;
+
+  size_t mask;
+
+  char _pad0[CACHE_LINE];
+
+  /** Position of the next push */
+  size_t head;
+
+  char _pad1[CACHE_LINE];
+
+  /** Position of the next pop */
+  size_t tail;
+
+  char _pad2[CACHE_LINE];
+
+} ring_t;
+
+/** A message in flight */
+typedef struct slot {
+
+  /** Sequence number of the message in the stream */
+  uint64_t seq;
+
+  /** Raw message */
+  uint8_t *buf;
+
+  /** Length of the raw message */
+  size_t len;
+
+  /** Allocated length of buf */
+  size_t alloc_len;
+
+  /** Decoded message (reused for the life of the pipeline) */
+  parsebgp_msg_t *msg;
+
+  /** Result of decoding the message */
+  parsebgp_error_t err;
+
+} slot_t;
+
+/** Fields of the BMP peer header that identify a peer */
+typedef struct peer_key {
+
+  uint64_t dist_id;
+
+  uint8_t addr[16];
+
+  uint32_t asn;
+
+  uint8_t bgp_id[4];
+
+  uint8_t type;
+
+} peer_key_t;
+
+/** A decode worker */
+typedef struct worker {
+
+  /** Pipeline that the worker belongs to */
+  struct parsebgp_pipeline *p;
+
+  /** Slots that must be decoded by this worker (used when sharding BMP
+      streams by peer, and to stop the worker) */
+  ring_t queue;
+
+  /** Signalled to wake the worker when it is parked */
+  pthread_cond_t wake;
+
+  /** Set while the worker is parked (protected by idle_mutex) */
+  int parked;
+
+  pthread_t thread;
+
+} worker_t;
+
+struct parsebgp_pipeline {
+
+  /** Configuration */
+  parsebgp_pipeline_config_t config;
+
+  /** Number of slots (a power of two) */
+  uint32_t window;
+
+  /** Array of (window) slots */
+  slot_t *slots;
+
+  /** Slots that the reader may fill */
+  ring_t free_slots;
+
+  /** Slots that are waiting to be decoded (by any worker) */
+  ring_t work;
+
+  /** Slots that have been decoded */
+  ring_t done;
+
+  /** Decoded slots that arrived early, indexed by sequence number (ordered
+      output only) */
+  uint32_t *pending;
+
+  /** Array of (config.workers) workers */
+  worker_t *workers;
+
+  /** Number of running workers */
+  int workers_cnt;
+
+  /** Protects the parked flags of the workers */
+  pthread_mutex_t idle_mutex;
+
+  /** Number of parked workers (checked before taking idle_mutex) */
+  int parked_cnt;
+
+  /** Message holding the most recent Peer Index Table */
+  parsebgp_msg_t *peer_index_msg;
+
+  /** Peer Index Table passed to the output callback (NULL until one has been
+      output in the current stream) */
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index;
+
+  /* Reader state */
+
+  /** Type of the messages in the current stream */
+  parsebgp_msg_type_t type;
+
+  /** Current stream */
+  FILE *fp;
+
+  /** Read buffer */
+  uint8_t *read_buf;
+
+  /** Allocated length of the read buffer */
+  size_t read_buf_len;
+
+  /** Options used to decode BMP headers (when sharding by peer) */
+  parsebgp_opts_t frame_opts;
+
+  /** Message used to decode BMP headers (when sharding by peer) */
+  parsebgp_bmp_msg_t *frame_bmp;
+
+  /** Number of messages handed to the workers */
+  uint64_t submitted;
+
+  /** Number of messages that the workers have decoded */
+  uint64_t decoded;
+
+  /** Set once the reader has finished with the stream */
+  int reader_done;
+
+  /** Why the reader stopped early (if it did) */
+  parsebgp_error_t read_err;
+
+  /** Set by the output stage to stop the reader */
+  int stop;
+};
+
+static int ring_init(ring_t *ring, uint32_t cnt)
+{
+  uint32_t i;
+
+  if ((ring->cells = malloc(sizeof(ring_cell_t) * cnt)) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < cnt; i++) {
+    ring->cells[i].seq = i;
+  }
+  ring->mask = cnt - 1;
+  ring->head = 0;
+  ring->tail = 0;
+  return 0;
+}
+
+// returns 0 if the ring is full
+static int ring_push(ring_t *ring, uint32_t val)
+{
+  size_t pos = LOAD_RLX(&ring->head);
+  ring_cell_t *cell;
+  intptr_t dif;
+
+  for (;;) {
+    cell = &ring->cells[pos & ring->mask];
+    dif = (intptr_t)LOAD_ACQ(&cell->seq) - (intptr_t)pos;
+    if (dif == 0) {
+      if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return 0;
+    } else {
+      pos = LOAD_RLX(&ring->head);
+    }
+  }
+
+  cell->val = val;
+  STORE_REL(&cell->seq, pos + 1);
+  return 1;
+}
+
+// returns 0 if the ring is empty
+static int ring_pop(ring_t *ring, uint32_t *val)
+{
+  size_t pos = LOAD_RLX(&ring->tail);
+  ring_cell_t *cell;
+  intptr_t dif;
+
+  for (;;) {
+    cell = &ring->cells[pos & ring->mask];
+    dif = (intptr_t)LOAD_ACQ(&cell->seq) - (intptr_t)(pos + 1);
+    if (dif == 0) {
+      if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return 0;
+    } else {
+      pos = LOAD_RLX(&ring->tail);
+    }
+  }
+
+  *val = cell->val;
+  STORE_REL(&cell->seq, pos + ring->mask + 1);
+  return 1;
+}
+
+// wait before polling again: spin, then yield, then sleep for increasingly
+// long (up to about 1ms)
+static void backoff(unsigned int *n)
+{
+  struct timespec ts;
+
+  if (*n < 64) {
+    (*n)++;
+    return;
+  }
+  if (*n < 128) {
+    (*n)++;
+    sched_yield();
+    return;
+  }
+  ts.tv_sec = 0;
+  ts.tv_nsec = 1000L << (*n - 128);
+  if (*n < 128 + 10) {
+    (*n)++;
+  }
+  nanosleep(&ts, NULL);
+}
+
+// wake a parked worker: the given one, or any if w is NULL. the fence pairs
+// with the one in park_worker, so that either the worker sees the slot that
+// was just queued, or this sees that the worker is parked.
+static void wake_worker(parsebgp_pipeline_t *p, worker_t *w)
+{
+  int i;
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (LOAD_RLX(&p->parked_cnt) == 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&p->idle_mutex);
+  for (i = 0; w == NULL && i < p->workers_cnt; i++) {
+    if (p->workers[i].parked) {
+      w = &p->workers[i];
+    }
+  }
+  if (w != NULL && w->parked) {
+    w->parked = 0;
+    __atomic_fetch_sub(&p->parked_cnt, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal(&w->wake);
+  }
+  pthread_mutex_unlock(&p->idle_mutex);
+}
+
+// sleep until there is a slot for the worker to decode, and take it
+static void park_worker(worker_t *w, uint32_t *idx)
+{
+  parsebgp_pipeline_t *p = w->p;
+
+  pthread_mutex_lock(&p->idle_mutex);
+  for (;;) {
+    if (!w->parked) {
+      w->parked = 1;
+      __atomic_fetch_add(&p->parked_cnt, 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+    if (ring_pop(&w->queue, idx) || ring_pop(&p->work, idx)) {
+      break;
+    }
+    // (a worker that is woken but finds nothing, e.g. because another worker
+    // took the slot, parks again)
+    pthread_cond_wait(&w->wake, &p->idle_mutex);
+  }
+  if (w->parked) {
+    w->parked = 0;
+    __atomic_fetch_sub(&p->parked_cnt, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&p->idle_mutex);
+}
+
+static void *worker_main(void *arg)
+{
+  worker_t *w = arg;
+  parsebgp_pipeline_t *p = w->p;
+  unsigned int n = 0;
+  uint32_t idx;
+  slot_t *slot;
+  size_t len;
+
+  for (;;) {
+    if (!ring_pop(&w->queue, &idx) && !ring_pop(&p->work, &idx)) {
+      if (n < IDLE_SPINS) {
+        backoff(&n);
+        continue;
+      }
+      // idle (e.g., between streams), so stop polling
+      park_worker(w, &idx);
+    }
+    n = 0;
+    if (idx == SLOT_NONE) {
+      break;
+    }
+
+    slot = &p->slots[idx];
+    parsebgp_clear_msg(slot->msg);
+    len = slot->len;
+    slot->err =
+      parsebgp_decode(p->config.opts, p->type, slot->msg, slot->buf, &len);
+    if (p->config.decoded_cb != NULL) {
+      p->config.decoded_cb(slot->seq, slot->err, slot->msg, p->config.user);
+    }
+    // (counted only once queued for output, see submit_alone)
+    ring_push(&p->done, idx);
+    __atomic_fetch_add(&p->decoded, 1, __ATOMIC_RELEASE);
+  }
+
+  return NULL;
+}
+
+// find the length of the message at the start of the buffer
+static parsebgp_error_t frame_msg(parsebgp_pipeline_t *p, const uint8_t *buf,
+                                  size_t len, size_t *msg_len)
+{
+  parsebgp_error_t err;
+
+  if ((err = parsebgp_msg_len(p->config.opts, p->type, buf, len, msg_len)) !=
+      PARSEBGP_OK) {
+    return err;
+  }
+  return (*msg_len > len) ? PARSEBGP_PARTIAL_MSG : PARSEBGP_OK;
+}
+
+// hand a message to the workers (or to the given worker), waiting for a free
+// slot if necessary
+static int submit(parsebgp_pipeline_t *p, worker_t *w, const uint8_t *buf,
+                  size_t len)
+{
+  ring_t *queue = (w != NULL) ? &w->queue : &p->work;
+  unsigned int n = 0;
+  uint32_t idx;
+  slot_t *slot;
+  uint8_t *tmp;
+
+  while (!ring_pop(&p->free_slots, &idx)) {
+    if (LOAD_ACQ(&p->stop)) {
+      return -1;
+    }
+    backoff(&n);
+  }
+
+  slot = &p->slots[idx];
+  if (len > slot->alloc_len) {
+    if ((tmp = realloc(slot->buf, len)) == NULL) {
+      ring_push(&p->free_slots, idx);
+      p->read_err = PARSEBGP_MALLOC_FAILURE;
+      return -1;
+    }
+    slot->buf = tmp;
+    slot->alloc_len = len;
+  }
+  memcpy(slot->buf, buf, len);
+  slot->len = len;
+  slot->seq = p->submitted;
+
+  // there are never more slots in flight than the ring can hold
+  if (!ring_push(queue, idx)) {
+    assert(0);
+  }
+  STORE_REL(&p->submitted, p->submitted + 1);
+  wake_worker(p, w);
+  return 0;
+}
+
+// wait until the workers have decoded every message handed to them
+static int drain_workers(parsebgp_pipeline_t *p)
+{
+  unsigned int n = 0;
+
+  while (LOAD_ACQ(&p->decoded) != p->submitted) {
+    if (LOAD_ACQ(&p->stop)) {
+      return -1;
+    }
+    backoff(&n);
+  }
+  return 0;
+}
+
+// hand a message to the workers once all earlier messages have been decoded,
+// and wait for it to be decoded before any later message is handed over. since
+// the workers queue messages for output before counting them as decoded, the
+// message is also output after all earlier messages and before any later one.
+static int submit_alone(parsebgp_pipeline_t *p, const uint8_t *buf,
+                        size_t len)
+{
+  return (drain_workers(p) != 0 ||
+          submit(p, &p->workers[0], buf, len) != 0 ||
+          drain_workers(p) != 0)
+           ? -1
+           : 0;
+}
+
+// hand a message to the worker that decodes the messages of its BMP peer
+static int dispatch_bmp_peer(parsebgp_pipeline_t *p, const uint8_t *buf,
+                             size_t len)
+{
+  parsebgp_bmp_msg_t *bmp = p->frame_bmp;
+  peer_key_t key;
+  size_t hdr_len = len;
+
+  if (parsebgp_bmp_decode(&p->frame_opts, bmp, buf, &hdr_len) !=
+        PARSEBGP_OK ||
+      bmp->type == PARSEBGP_BMP_TYPE_INIT_MSG ||
+      bmp->type == PARSEBGP_BMP_TYPE_TERM_MSG) {
+    // messages without a (valid) peer header are decoded on their own
+    return submit_alone(p, buf, len);
+  }
+
+  // the peer flags are not part of the key, so that (e.g.) pre- and
+  // post-policy messages stay in order with the Peer Down message
+  memset(&key, 0, sizeof(key));
+  key.dist_id = bmp->peer_hdr.dist_id;
+  // only the first 4 bytes of an IPv4 address are set
+  memcpy(key.addr, bmp->peer_hdr.addr,
+         bmp->peer_hdr.afi == PARSEBGP_BGP_AFI_IPV4 ? 4 : sizeof(key.addr));
+  key.asn = bmp->peer_hdr.asn;
+  memcpy(key.bgp_id, bmp->peer_hdr.bgp_id, sizeof(key.bgp_id));
+  key.type = bmp->peer_hdr.type;
+  return submit(
+    p, &p->workers[parsebgp_hash64(&key, sizeof(key), 0) % p->workers_cnt],
+    buf, len);
+}
+
+// is the (framed) MRT message a TABLE_DUMP_V2 PEER_INDEX_TABLE?
+static int is_peer_index_frame(const uint8_t *buf)
+{
+  // Timestamp (4), Type (2), Subtype (2)
+  return nptohs(buf + 4) == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 &&
+         nptohs(buf + 6) == PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE;
+}
+
+static int dispatch(parsebgp_pipeline_t *p, const uint8_t *buf, size_t len)
+{
+  if (p->config.shard_bmp_peers && p->type == PARSEBGP_MSG_TYPE_BMP &&
+      p->workers_cnt > 1) {
+    return dispatch_bmp_peer(p, buf, len);
+  }
+  // when output is not ordered, a RIB record could otherwise be output before
+  // the table that it refers to (or after the next one)
+  if (!p->config.ordered && p->type == PARSEBGP_MSG_TYPE_MRT &&
+      p->workers_cnt > 1 && is_peer_index_frame(buf)) {
+    return submit_alone(p, buf, len);
+  }
+  return submit(p, NULL, buf, len);
+}
+
+static void *reader_main(void *arg)
+{
+  parsebgp_pipeline_t *p = arg;
+  size_t fill = 0, off = 0, msg_len, nread;
+  parsebgp_error_t err;
+  uint8_t *tmp;
+
+  for (;;) {
+    // hand over all the complete messages in the buffer
+    while (!LOAD_ACQ(&p->stop)) {
+      err = frame_msg(p, p->read_buf + off, fill - off, &msg_len);
+      if (err == PARSEBGP_PARTIAL_MSG) {
+        break;
+      }
+      if (err != PARSEBGP_OK) {
+        p->read_err = err;
+        goto done;
+      }
+      if (dispatch(p, p->read_buf + off, msg_len) != 0) {
+        goto done;
+      }
+      off += msg_len;
+    }
+    if (LOAD_ACQ(&p->stop)) {
+      break;
+    }
+
+    // move the partial message to the start of the buffer and read more
+    memmove(p->read_buf, p->read_buf + off, fill - off);
+    fill -= off;
+    off = 0;
+    if (fill == p->read_buf_len) {
+      // the message is larger than the buffer
+      if ((tmp = realloc(p->read_buf, p->read_buf_len * 2)) == NULL) {
+        p->read_err = PARSEBGP_MALLOC_FAILURE;
+        break;
+      }
+      p->read_buf = tmp;
+      p->read_buf_len *= 2;
+    }
+    if (feof(p->fp)) {
+      if (fill > 0) {
+        p->read_err = PARSEBGP_PARTIAL_MSG;
+      }
+      break;
+    }
+    nread = fread(p->read_buf + fill, 1, p->read_buf_len - fill, p->fp);
+    if (ferror(p->fp)) {
+      p->read_err = PARSEBGP_INVALID_MSG;
+      break;
+    }
+    fill += nread;
+  }
+
+done:
+  STORE_REL(&p->reader_done, 1);
+  return NULL;
+}
+
+static int is_peer_index(const parsebgp_msg_t *msg)
+{
+  return msg->type == PARSEBGP_MSG_TYPE_MRT &&
+         msg->types.mrt->type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 &&
+         msg->types.mrt->subtype == PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE;
+}
+
+// pass a decoded message to the output callback and free its slot
+static void output(parsebgp_pipeline_t *p, uint32_t idx, parsebgp_error_t *err)
+{
+  slot_t *slot = &p->slots[idx];
+  parsebgp_msg_t *tmp;
+
+  // once the pipeline has been stopped, messages are only drained
+  if (*err == PARSEBGP_OK) {
+    *err = p->config.output_cb(slot->seq, slot->err, slot->msg, p->peer_index,
+                               p->config.user);
+    if (*err != PARSEBGP_OK) {
+      STORE_REL(&p->stop, 1);
+    }
+  }
+
+  // keep the table for the RIB records that follow it (the slot gets the
+  // message that held the previous table)
+  if (slot->err == PARSEBGP_OK && is_peer_index(slot->msg)) {
+    tmp = p->peer_index_msg;
+    p->peer_index_msg = slot->msg;
+    slot->msg = tmp;
+    p->peer_index =
+      &p->peer_index_msg->types.mrt->types.table_dump_v2->peer_index;
+  }
+
+  ring_push(&p->free_slots, idx);
+}
+
+void parsebgp_pipeline_config_init(parsebgp_pipeline_config_t *config)
+{
+  memset(config, 0, sizeof(*config));
+  parsebgp_opts_init(&config->opts);
+  config->workers = 1;
+  config->window = 1024;
+  config->ordered = 1;
+}
+
+parsebgp_pipeline_t *
+parsebgp_pipeline_create(const parsebgp_pipeline_config_t *config)
+{
+  parsebgp_pipeline_t *p;
+  uint32_t window = 1, i;
+
+  if (config->output_cb == NULL || config->workers < 1 ||
+      (config->workers > 1 &&
+       (config->opts.sessions != NULL || config->opts.attr_cache != NULL ||
+        config->opts.mrt_peer_filter != NULL))) {
+    return NULL;
+  }
+  while (window < (uint32_t)config->window ||
+         window < (uint32_t)config->workers) {
+    window <<= 1;
+  }
+
+  if ((p = malloc_zero(sizeof(parsebgp_pipeline_t))) == NULL) {
+    return NULL;
+  }
+  p->config = *config;
+  p->window = window;
+
+  p->frame_opts = config->opts;
+  p->frame_opts.filter = NULL;
+  p->frame_opts.bmp.parse_headers_only = 1;
+
+  if ((p->workers = malloc_zero(sizeof(worker_t) * config->workers)) ==
+      NULL) {
+    goto err;
+  }
+  pthread_mutex_init(&p->idle_mutex, NULL);
+  for (i = 0; i < (uint32_t)config->workers; i++) {
+    pthread_cond_init(&p->workers[i].wake, NULL);
+  }
+
+  if ((p->slots = malloc_zero(sizeof(slot_t) * window)) == NULL ||
+      (p->pending = malloc(sizeof(uint32_t) * window)) == NULL ||
+      ring_init(&p->free_slots, window) != 0 ||
+      ring_init(&p->work, window) != 0 || ring_init(&p->done, window) != 0 ||
+      (p->peer_index_msg = parsebgp_create_msg()) == NULL ||
+      (p->frame_bmp = malloc_zero(sizeof(parsebgp_bmp_msg_t))) == NULL ||
+      (p->read_buf = malloc(READ_BUFLEN)) == NULL) {
+    goto err;
+  }
+  p->read_buf_len = READ_BUFLEN;
+
+  for (i = 0; i < window; i++) {
+    if ((p->slots[i].msg = parsebgp_create_msg()) == NULL) {
+      goto err;
+    }
+    ring_push(&p->free_slots, i);
+  }
+
+  for (i = 0; i < (uint32_t)config->workers; i++) {
+    p->workers[i].p = p;
+    if (ring_init(&p->workers[i].queue, window) != 0 ||
+        pthread_create(&p->workers[i].thread, NULL, worker_main,
+                       &p->workers[i]) != 0) {
+      goto err;
+    }
+    p->workers_cnt++;
+  }
+
+  return p;
+
+err:
+  parsebgp_pipeline_destroy(p);
+  return NULL;
+}
+
+void parsebgp_pipeline_destroy(parsebgp_pipeline_t *pipeline)
+{
+  int i;
+  uint32_t j;
+
+  if (pipeline == NULL) {
+    return;
+  }
+
+  // no messages are in flight, so there is room for the stop markers
+  for (i = 0; i < pipeline->workers_cnt; i++) {
+    ring_push(&pipeline->workers[i].queue, SLOT_NONE);
+    wake_worker(pipeline, &pipeline->workers[i]);
+  }
+  for (i = 0; i < pipeline->workers_cnt; i++) {
+    pthread_join(pipeline->workers[i].thread, NULL);
+  }
+  if (pipeline->workers != NULL) {
+    for (i = 0; i < pipeline->config.workers; i++) {
+      free(pipeline->workers[i].queue.cells);
+      pthread_cond_destroy(&pipeline->workers[i].wake);
+    }
+    pthread_mutex_destroy(&pipeline->idle_mutex);
+    free(pipeline->workers);
+  }
+
+  if (pipeline->slots != NULL) {
+    for (j = 0; j < pipeline->window; j++) {
+      parsebgp_destroy_msg(pipeline->slots[j].msg);
+      free(pipeline->slots[j].buf);
+    }
+    free(pipeline->slots);
+  }
+  free(pipeline->pending);
+  free(pipeline->free_slots.cells);
+  free(pipeline->work.cells);
+  free(pipeline->done.cells);
+  parsebgp_destroy_msg(pipeline->peer_index_msg);
+  parsebgp_bmp_destroy_msg(pipeline->frame_bmp);
+  free(pipeline->read_buf);
+  free(pipeline);
+}
+
+parsebgp_error_t parsebgp_pipeline_run(parsebgp_pipeline_t *pipeline,
+                                       parsebgp_msg_type_t type, FILE *fp)
+{
+  parsebgp_pipeline_t *p = pipeline;
+  parsebgp_error_t err = PARSEBGP_OK;
+  uint32_t mask = p->window - 1, idx, i;
+  uint64_t next = 0, emitted = 0;
+  unsigned int n = 0;
+  pthread_t reader;
+  slot_t *slot;
+
+  p->type = type;
+  p->fp = fp;
+  p->submitted = 0;
+  p->decoded = 0;
+  p->reader_done = 0;
+  p->read_err = PARSEBGP_OK;
+  p->stop = 0;
+  p->peer_index = NULL;
+  for (i = 0; i < p->window; i++) {
+    p->pending[i] = SLOT_NONE;
+  }
+
+  if (pthread_create(&reader, NULL, reader_main, p) != 0) {
+    return PARSEBGP_MALLOC_FAILURE;
+  }
+
+  for (;;) {
+    if (p->config.ordered && p->pending[next & mask] != SLOT_NONE) {
+      idx = p->pending[next & mask];
+      p->pending[next & mask] = SLOT_NONE;
+    } else if (ring_pop(&p->done, &idx)) {
+      slot = &p->slots[idx];
+      if (p->config.ordered && slot->seq != next) {
+        // wait for the messages before this one
+        p->pending[slot->seq & mask] = idx;
+        continue;
+      }
+    } else {
+      if (LOAD_ACQ(&p->reader_done) && emitted == LOAD_ACQ(&p->submitted)) {
+        break;
+      }
+      backoff(&n);
+      continue;
+    }
+    n = 0;
+
+    output(p, idx, &err);
+    emitted++;
+    next++;
+  }
+
+  pthread_join(reader, NULL);
+
+  // the workers count a message as decoded just after queuing it for output,
+  // so wait for the last counts before the next stream resets them
+  while (LOAD_ACQ(&p->decoded) != p->submitted) {
+    backoff(&n);
+  }
+  return (err != PARSEBGP_OK) ? err : p->read_err;
+}
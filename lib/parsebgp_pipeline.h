@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_PIPELINE_H
+#define __PARSEBGP_PIPELINE_H
+
+#include "parsebgp.h"
+#include <inttypes.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque structure representing a concurrent parse pipeline */
+typedef struct parsebgp_pipeline parsebgp_pipeline_t;
+
+/**
+ * Callback run by a decode worker once it has decoded a message
+ *
+ * @param seq           sequence number of the message in the stream
+ * @param err           result of parsebgp_decode for the message
+ * @param msg           the decoded message
+ * @param user          user data from the pipeline configuration
+ *
+ * This is called concurrently by all workers, so it must be thread-safe. It may
+ * be used to do expensive per-message work (e.g., parsebgp_msg_pack) in
+ * parallel. The message must not be kept after the callback returns.
+ */
+typedef void (*parsebgp_pipeline_decoded_func_t)(uint64_t seq,
+                                                 parsebgp_error_t err,
+                                                 parsebgp_msg_t *msg,
+                                                 void *user);
+
+/**
+ * Callback run by the output stage for each message
+ *
+ * @param seq           sequence number of the message in the stream
+ * @param err           result of parsebgp_decode for the message
+ * @param msg           the decoded message
+ * @param peer_index    most recent TABLE_DUMP_V2 Peer Index Table passed to
+ *                      this callback (NULL if none). Use this (rather than the
+ *                      table in msg) with parsebgp_elem_iter_init.
+ * @param user          user data from the pipeline configuration
+ * @return PARSEBGP_OK to continue, or an error code to stop the pipeline (which
+ * is then returned by parsebgp_pipeline_run)
+ *
+ * This is always called from the thread running parsebgp_pipeline_run, one
+ * message at a time. The message must not be kept after the callback returns.
+ */
+typedef parsebgp_error_t (*parsebgp_pipeline_output_func_t)(
+  uint64_t seq, parsebgp_error_t err, parsebgp_msg_t *msg,
+  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index, void *user);
+
+/** Pipeline configuration */
+typedef struct parsebgp_pipeline_config {
+
+  /** Options used by the decode workers
+   *
+   * The session table (sessions) and attribute cache (attr_cache) are not
+   * thread-safe, and the MRT peer filter (mrt_peer_filter) is resolved using
+   * the PEER_INDEX_TABLE decoded by the same worker, so they can only be used
+   * if there is a single worker. The mrt_rib_entry_cb callback is called by the
+   * workers, and so must be thread-safe.
+   */
+  parsebgp_opts_t opts;
+
+  /** Number of decode worker threads (default 1) */
+  int workers;
+
+  /** Maximum number of messages in flight between the reader and output
+      stages (rounded up to a power of two, default 1024) */
+  int window;
+
+  /** Should messages be output in the order they were read? (default 1)
+   *
+   * If not set, messages are output as soon as they have been decoded, except
+   * that an MRT PEER_INDEX_TABLE is output after all earlier messages and
+   * before any later message, so that each RIB record is output with the
+   * table of its own dump (at the cost of waiting for the workers to finish
+   * their messages each time a table is read).
+   */
+  int ordered;
+
+  /** Should BMP messages be dispatched to workers by peer? (default 0)
+   *
+   * If set, all the messages of a BMP peer (i.e., with the same peer type,
+   * distinguisher, address, ASN and BGP ID) are decoded by the same worker, in
+   * stream order, so that decoded_cb sees the messages of each peer in order
+   * while different peers are decoded in parallel. Peer Up and Peer Down
+   * messages are ordered with the other messages of their peer. Initiation and
+   * Termination messages are decoded once all the earlier messages have been,
+   * and before any later message. This has no effect on other types of stream.
+   */
+  int shard_bmp_peers;
+
+  /** Callback run by the workers (optional) */
+  parsebgp_pipeline_decoded_func_t decoded_cb;
+
+  /** Callback run by the output stage (required) */
+  parsebgp_pipeline_output_func_t output_cb;
+
+  /** User data passed to the callbacks */
+  void *user;
+
+} parsebgp_pipeline_config_t;
+
+/**
+ * Initialize a pipeline configuration to default values
+ *
+ * @param config        pointer to the configuration to initialize
+ */
+void parsebgp_pipeline_config_init(parsebgp_pipeline_config_t *config);
+
+/**
+ * Create a pipeline and start its decode workers
+ *
+ * @param config        pointer to the pipeline configuration (copied)
+ * @return pointer to the new pipeline, or NULL if the configuration is invalid
+ * (e.g., options that are not thread-safe are used with several workers) or
+ * the pipeline could not be created
+ *
+ * Each in-flight message has its own parsebgp_msg_t, which is reused for the
+ * life of the pipeline. Stages are connected by bounded lock-free queues, so
+ * the reader blocks (after reading at most window messages ahead of the output
+ * stage) rather than buffering without limit.
+ */
+parsebgp_pipeline_t *
+parsebgp_pipeline_create(const parsebgp_pipeline_config_t *config);
+
+/**
+ * Stop the workers of the given pipeline and free it
+ *
+ * @param pipeline      pointer to the pipeline to destroy
+ */
+void parsebgp_pipeline_destroy(parsebgp_pipeline_t *pipeline);
+
+/**
+ * Decode a stream of messages using the given pipeline
+ *
+ * @param pipeline      pointer to the pipeline
+ * @param type          type of the messages in the stream
+ * @param fp            stream to read messages from (until EOF)
+ * @return PARSEBGP_OK if the whole stream was decoded, the error returned by
+ * the output callback if it stopped the pipeline, PARSEBGP_PARTIAL_MSG if the
+ * stream ends with an incomplete message, PARSEBGP_INVALID_MSG if the stream
+ * could not be read, or the error that prevented the stream from being split
+ * into messages
+ *
+ * The stream is read by a separate reader thread, which splits it into
+ * messages using only their headers. The output callback is run by the calling
+ * thread. Sequence numbers start from zero for each stream. This function
+ * returns once every message read from the stream has been output.
+ */
+parsebgp_error_t parsebgp_pipeline_run(parsebgp_pipeline_t *pipeline,
+                                       parsebgp_msg_type_t type, FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PARSEBGP_PIPELINE_H */
@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_prefix_set.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** A node in the radix trie. Nodes that are not members of the set ("glue"
+    nodes) only exist where two branches split, so every leaf is a member. */
+typedef struct prefix_node {
+
+  /** Prefix address (bits beyond len are zero) */
+  uint8_t addr[16];
+
+  /** Prefix length */
+  uint8_t len;
+
+  /** Is this prefix a member of the set? */
+  uint8_t member;
+
+  /** Children, indexed by the bit of the address following the prefix */
+  struct prefix_node *child[2];
+
+} prefix_node_t;
+
+struct parsebgp_prefix_set {
+
+  /** Root of the IPv4 (0) and IPv6 (1) tries */
+  prefix_node_t *root[2];
+
+  /** Number of members */
+  uint64_t size;
+};
+
+// index of the trie for the given AFI (-1 if unsupported)
+static int afi_idx(parsebgp_bgp_afi_t afi)
+{
+  switch (afi) {
+  case PARSEBGP_BGP_AFI_IPV4:
+    return 0;
+
+  case PARSEBGP_BGP_AFI_IPV6:
+    return 1;
+
+  default:
+    return -1;
+  }
+}
+
+// get the given bit (0 is the most significant) of an address
+static int get_bit(const uint8_t *addr, uint8_t bit)
+{
+  return (addr[bit / 8] >> (7 - (bit % 8))) & 0x1;
+}
+
+// copy the first len bits of src into dst, zeroing the rest
+static void mask_addr(uint8_t *dst, const uint8_t *src, uint8_t len)
+{
+  uint8_t bytes = len / 8, rem = len % 8;
+
+  memset(dst, 0, 16);
+  memcpy(dst, src, bytes);
+  if (rem != 0) {
+    dst[bytes] = src[bytes] & (0xFF << (8 - rem));
+  }
+}
+
+// number of leading bits (up to max) that are the same in both addresses
+static uint8_t common_len(const uint8_t *a, const uint8_t *b, uint8_t max)
+{
+  uint8_t i, diff, n = 0;
+
+  for (i = 0; n < max; i++) {
+    if ((diff = a[i] ^ b[i]) == 0) {
+      n += 8;
+      continue;
+    }
+    while ((diff & 0x80) == 0) {
+      diff <<= 1;
+      n++;
+    }
+    break;
+  }
+  return n < max ? n : max;
+}
+
+static prefix_node_t *create_node(const uint8_t *addr, uint8_t len,
+                                  uint8_t member)
+{
+  prefix_node_t *node;
+
+  if ((node = malloc(sizeof(*node))) == NULL) {
+    return NULL;
+  }
+  mask_addr(node->addr, addr, len);
+  node->len = len;
+  node->member = member;
+  node->child[0] = node->child[1] = NULL;
+  return node;
+}
+
+static void destroy_node(prefix_node_t *node)
+{
+  if (node == NULL) {
+    return;
+  }
+  destroy_node(node->child[0]);
+  destroy_node(node->child[1]);
+  free(node);
+}
+
+parsebgp_prefix_set_t *parsebgp_prefix_set_create(void)
+{
+  return calloc(1, sizeof(parsebgp_prefix_set_t));
+}
+
+void parsebgp_prefix_set_destroy(parsebgp_prefix_set_t *set)
+{
+  if (set == NULL) {
+    return;
+  }
+  destroy_node(set->root[0]);
+  destroy_node(set->root[1]);
+  free(set);
+}
+
+parsebgp_error_t parsebgp_prefix_set_add(parsebgp_prefix_set_t *set,
+                                         parsebgp_bgp_afi_t afi,
+                                         const uint8_t *addr, uint8_t len)
+{
+  int idx = afi_idx(afi);
+  prefix_node_t **np, *node, *leaf, *glue;
+  uint8_t cl;
+
+  if (idx < 0 || len > (idx == 0 ? 32 : 128)) {
+    return PARSEBGP_INVALID_MSG;
+  }
+
+  np = &set->root[idx];
+  while ((node = *np) != NULL) {
+    cl = common_len(node->addr, addr, node->len < len ? node->len : len);
+
+    if (cl == node->len) {
+      // this node covers the new prefix
+      if (node->len == len) {
+        if (!node->member) {
+          node->member = 1;
+          set->size++;
+        }
+        return PARSEBGP_OK;
+      }
+      np = &node->child[get_bit(addr, node->len)];
+      continue;
+    }
+
+    // the new prefix diverges from this node (or covers it), so insert a new
+    // node above it
+    if ((leaf = create_node(addr, len, 1)) == NULL) {
+      return PARSEBGP_MALLOC_FAILURE;
+    }
+    if (cl == len) {
+      // the new prefix covers this node
+      leaf->child[get_bit(node->addr, len)] = node;
+      *np = leaf;
+    } else {
+      // split at the first differing bit
+      if ((glue = create_node(addr, cl, 0)) == NULL) {
+        free(leaf);
+        return PARSEBGP_MALLOC_FAILURE;
+      }
+      glue->child[get_bit(addr, cl)] = leaf;
+      glue->child[get_bit(node->addr, cl)] = node;
+      *np = glue;
+    }
+    set->size++;
+    return PARSEBGP_OK;
+  }
+
+  if ((*np = create_node(addr, len, 1)) == NULL) {
+    return PARSEBGP_MALLOC_FAILURE;
+  }
+  set->size++;
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_prefix_set_add_str(parsebgp_prefix_set_t *set,
+                                             const char *str)
+{
+  char buf[INET6_ADDRSTRLEN + 5];
+  uint8_t addr[16];
+  parsebgp_bgp_afi_t afi;
+  char *sep, *end;
+  unsigned long len;
+
+  if (strlen(str) >= sizeof(buf) || (sep = strchr(str, '/')) == NULL) {
+    return PARSEBGP_INVALID_MSG;
+  }
+  strcpy(buf, str);
+  sep = buf + (sep - str);
+  *(sep++) = '\0';
+
+  if (inet_pton(AF_INET, buf, addr) == 1) {
+    afi = PARSEBGP_BGP_AFI_IPV4;
+  } else if (inet_pton(AF_INET6, buf, addr) == 1) {
+    afi = PARSEBGP_BGP_AFI_IPV6;
+  } else {
+    return PARSEBGP_INVALID_MSG;
+  }
+
+  errno = 0;
+  len = strtoul(sep, &end, 10);
+  if (errno != 0 || end == sep || *end != '\0' || len > 128) {
+    return PARSEBGP_INVALID_MSG;
+  }
+
+  return parsebgp_prefix_set_add(set, afi, addr, (uint8_t)len);
+}
+
+uint64_t parsebgp_prefix_set_size(const parsebgp_prefix_set_t *set)
+{
+  return set->size;
+}
+
+int parsebgp_prefix_set_match(const parsebgp_prefix_set_t *set,
+                              parsebgp_prefix_set_match_t match,
+                              parsebgp_bgp_afi_t afi, const uint8_t *addr,
+                              uint8_t len)
+{
+  int idx = afi_idx(afi);
+  const prefix_node_t *node;
+
+  if (idx < 0 || len > (idx == 0 ? 32 : 128)) {
+    return 0;
+  }
+
+  for (node = set->root[idx]; node != NULL;
+       node = node->child[get_bit(addr, node->len)]) {
+    if (node->len >= len) {
+      // this node (and its subtree) is at least as specific as the prefix
+      if (common_len(node->addr, addr, len) < len) {
+        return 0;
+      }
+      switch (match) {
+      case PARSEBGP_PREFIX_SET_MATCH_EXACT:
+      case PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC:
+        return node->len == len && node->member;
+
+      case PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC:
+        // every subtree contains at least one member
+        return 1;
+      }
+      return 0;
+    }
+
+    // this node is less specific than the prefix
+    if (common_len(node->addr, addr, node->len) < node->len) {
+      return 0;
+    }
+    if (node->member && match == PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_PREFIX_SET_H
+#define __PARSEBGP_PREFIX_SET_H
+
+#include "parsebgp_bgp_common.h"
+#include "parsebgp_error.h"
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Ways in which a prefix may match the members of a prefix set */
+typedef enum {
+
+  /** The prefix is a member of the set */
+  PARSEBGP_PREFIX_SET_MATCH_EXACT = 0,
+
+  /** The prefix is a member of the set, or is more specific than a member
+      (i.e., it is covered by a member) */
+  PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC = 1,
+
+  /** The prefix is a member of the set, or is less specific than a member
+      (i.e., it covers a member) */
+  PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC = 2,
+
+} parsebgp_prefix_set_match_t;
+
+/** Opaque structure holding a set of IPv4 and IPv6 prefixes */
+typedef struct parsebgp_prefix_set parsebgp_prefix_set_t;
+
+/**
+ * Create an empty prefix set
+ *
+ * @return pointer to the new set, or NULL if memory could not be allocated
+ *
+ * Prefixes are stored in a path-compressed binary radix trie (one per address
+ * family), so matching a prefix costs at most one node visit per bit of the
+ * prefix, regardless of the number of prefixes in the set.
+ *
+ * The caller owns the returned set and must call parsebgp_prefix_set_destroy
+ * to free it once it is no longer used by any parser options.
+ */
+parsebgp_prefix_set_t *parsebgp_prefix_set_create(void);
+
+/**
+ * Destroy the given prefix set
+ *
+ * @param set           pointer to the set to destroy
+ */
+void parsebgp_prefix_set_destroy(parsebgp_prefix_set_t *set);
+
+/**
+ * Add a prefix to the given set
+ *
+ * @param set           pointer to the set to add to
+ * @param afi           address family of the prefix (IPv4 or IPv6)
+ * @param addr          prefix address (host bits are ignored)
+ * @param len           prefix length
+ * @return PARSEBGP_OK if the prefix was added (or was already a member),
+ * PARSEBGP_INVALID_MSG if the AFI or length are invalid, or
+ * PARSEBGP_MALLOC_FAILURE if memory could not be allocated
+ */
+parsebgp_error_t parsebgp_prefix_set_add(parsebgp_prefix_set_t *set,
+                                         parsebgp_bgp_afi_t afi,
+                                         const uint8_t *addr, uint8_t len);
+
+/**
+ * Add a prefix, given in "address/length" notation, to the given set
+ *
+ * @param set           pointer to the set to add to
+ * @param str           prefix string (e.g., "192.0.2.0/24" or "2001:db8::/32")
+ * @return PARSEBGP_OK if the prefix was added, PARSEBGP_INVALID_MSG if it could
+ * not be parsed, or PARSEBGP_MALLOC_FAILURE if memory could not be allocated
+ */
+parsebgp_error_t parsebgp_prefix_set_add_str(parsebgp_prefix_set_t *set,
+                                             const char *str);
+
+/**
+ * Get the number of prefixes in the given set
+ *
+ * @param set           pointer to the set
+ * @return the number of distinct prefixes that have been added to the set
+ */
+uint64_t parsebgp_prefix_set_size(const parsebgp_prefix_set_t *set);
+
+/**
+ * Check if a prefix matches the given set
+ *
+ * @param set           pointer to the set to match against
+ * @param match         how the prefix must relate to a member of the set
+ * @param afi           address family of the prefix
+ * @param addr          prefix address
+ * @param len           prefix length
+ * @return 1 if the prefix matches, 0 otherwise
+ */
+int parsebgp_prefix_set_match(const parsebgp_prefix_set_t *set,
+                              parsebgp_prefix_set_match_t match,
+                              parsebgp_bgp_afi_t afi, const uint8_t *addr,
+                              uint8_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PARSEBGP_PREFIX_SET_H */
@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_session.h"
+#include "parsebgp_bgp_common_impl.h"
+#include "parsebgp_session_impl.h"
+#include "parsebgp_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial number of hash buckets (must be a power of two) */
+#define INITIAL_BUCKETS_CNT 64
+
+struct parsebgp_session_table {
+
+  /** Hash buckets (each is a list of sessions) */
+  parsebgp_session_t **buckets;
+
+  /** Number of buckets (a power of two) */
+  uint32_t buckets_cnt;
+
+  /** Number of sessions */
+  uint64_t size;
+};
+
+// FNV-1a hash of the key bytes
+static uint64_t hash_key(const parsebgp_session_key_t *key)
+{
+  const uint8_t *p = (const uint8_t *)key;
+  uint64_t h = 0xcbf29ce484222325ULL;
+  size_t i;
+
+  for (i = 0; i < sizeof(*key); i++) {
+    h ^= p[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static parsebgp_session_t **find(const parsebgp_session_table_t *table,
+                                 const parsebgp_session_key_t *key)
+{
+  parsebgp_session_t **sp =
+    &table->buckets[hash_key(key) & (table->buckets_cnt - 1)];
+
+  while (*sp != NULL && memcmp(&(*sp)->key, key, sizeof(*key)) != 0) {
+    sp = &(*sp)->next;
+  }
+  return sp;
+}
+
+static int grow(parsebgp_session_table_t *table)
+{
+  uint32_t cnt = table->buckets_cnt * 2, i;
+  parsebgp_session_t **buckets, *s, *next;
+  uint64_t h;
+
+  if ((buckets = calloc(cnt, sizeof(*buckets))) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < table->buckets_cnt; i++) {
+    for (s = table->buckets[i]; s != NULL; s = next) {
+      next = s->next;
+      h = hash_key(&s->key) & (cnt - 1);
+      s->next = buckets[h];
+      buckets[h] = s;
+    }
+  }
+  free(table->buckets);
+  table->buckets = buckets;
+  table->buckets_cnt = cnt;
+  return 0;
+}
+
+parsebgp_session_table_t *parsebgp_session_table_create(void)
+{
+  parsebgp_session_table_t *table;
+
+  if ((table = calloc(1, sizeof(*table))) == NULL) {
+    return NULL;
+  }
+  if ((table->buckets = calloc(INITIAL_BUCKETS_CNT,
+                               sizeof(*table->buckets))) == NULL) {
+    free(table);
+    return NULL;
+  }
+  table->buckets_cnt = INITIAL_BUCKETS_CNT;
+  return table;
+}
+
+void parsebgp_session_table_destroy(parsebgp_session_table_t *table)
+{
+  if (table == NULL) {
+    return;
+  }
+  parsebgp_session_table_clear(table);
+  free(table->buckets);
+  free(table);
+}
+
+void parsebgp_session_table_clear(parsebgp_session_table_t *table)
+{
+  parsebgp_session_t *s, *next;
+  uint32_t i;
+
+  for (i = 0; i < table->buckets_cnt; i++) {
+    for (s = table->buckets[i]; s != NULL; s = next) {
+      next = s->next;
+      free(s);
+    }
+    table->buckets[i] = NULL;
+  }
+  table->size = 0;
+}
+
+uint64_t parsebgp_session_table_size(const parsebgp_session_table_t *table)
+{
+  return table->size;
+}
+
+const parsebgp_session_t *
+parsebgp_session_get(const parsebgp_session_table_t *table,
+                     const parsebgp_session_key_t *key)
+{
+  return *find(table, key);
+}
+
+void parsebgp_session_remove(parsebgp_session_table_t *table,
+                             const parsebgp_session_key_t *key)
+{
+  parsebgp_session_t **sp = find(table, key), *s;
+
+  if ((s = *sp) == NULL) {
+    return;
+  }
+  *sp = s->next;
+  free(s);
+  table->size--;
+}
+
+// have the capabilities that we need been decoded?
+static int caps_decoded(const parsebgp_opts_t *opts)
+{
+  const uint8_t *filter = opts->bgp.capability_filter;
+
+  if (!PARSEBGP_PROJECTED(opts, PARSEBGP_PROJ_BGP_OPEN_CAPS)) {
+    return 0;
+  }
+  return !opts->bgp.capability_filter_enabled ||
+         (filter[PARSEBGP_BGP_OPEN_CAPABILITY_MPBGP] &&
+          filter[PARSEBGP_BGP_OPEN_CAPABILITY_AS4] &&
+          filter[PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH]);
+}
+
+// find (or add) the given AFI/SAFI
+static int caps_afi_safi(parsebgp_session_caps_t *caps, uint16_t afi,
+                         uint8_t safi)
+{
+  int i;
+
+  for (i = 0; i < caps->afi_safi_cnt; i++) {
+    if (caps->afi_safi[i].afi == afi && caps->afi_safi[i].safi == safi) {
+      return i;
+    }
+  }
+  if (caps->afi_safi_cnt == PARSEBGP_SESSION_MAX_AFI_SAFI) {
+    return -1;
+  }
+  i = caps->afi_safi_cnt++;
+  memset(&caps->afi_safi[i], 0, sizeof(caps->afi_safi[i]));
+  caps->afi_safi[i].afi = afi;
+  caps->afi_safi[i].safi = safi;
+  return i;
+}
+
+static void set_caps(parsebgp_session_caps_t *caps,
+                     const parsebgp_bgp_open_t *open)
+{
+  const parsebgp_bgp_open_capability_t *cap;
+  const uint8_t *data;
+  uint16_t afi;
+  int i, j, idx;
+
+  memset(caps, 0, sizeof(*caps));
+  caps->seen = 1;
+
+  for (i = 0; i < open->capabilities_cnt; i++) {
+    cap = &open->capabilities[i];
+
+    switch (cap->code) {
+    case PARSEBGP_BGP_OPEN_CAPABILITY_AS4:
+      caps->as4 = 1;
+      break;
+
+    case PARSEBGP_BGP_OPEN_CAPABILITY_MPBGP:
+      idx = caps_afi_safi(caps, cap->values.mpbgp.afi, cap->values.mpbgp.safi);
+      if (idx >= 0) {
+        caps->afi_safi[idx].mp = 1;
+      }
+      break;
+
+    case PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH:
+      // list of AFI (2), SAFI (1), Send/Receive (1) tuples
+      if ((data = BGPSTREAM_OPEN_CAPABILITY_RAW_DATA(cap)) == NULL) {
+        break;
+      }
+      for (j = 0; j + 4 <= cap->len; j += 4) {
+        afi = (uint16_t)((data[j] << 8) | data[j + 1]);
+        if ((idx = caps_afi_safi(caps, afi, data[j + 2])) >= 0) {
+          caps->afi_safi[idx].add_path = data[j + 3] & 0x3;
+        }
+      }
+      break;
+
+    default:
+      break;
+    }
+  }
+}
+
+// the ADD-PATH mode advertised by one side for the given AFI/SAFI
+static uint8_t caps_add_path(const parsebgp_session_caps_t *caps, uint16_t afi,
+                             uint8_t safi)
+{
+  int i;
+
+  for (i = 0; i < caps->afi_safi_cnt; i++) {
+    if (caps->afi_safi[i].afi == afi && caps->afi_safi[i].safi == safi) {
+      return caps->afi_safi[i].add_path;
+    }
+  }
+  return 0;
+}
+
+int parsebgp_session_add_path(const parsebgp_session_t *session, int local,
+                              uint16_t afi, uint8_t safi)
+{
+  const parsebgp_session_caps_t *sender = local ? &session->local
+                                                : &session->remote,
+                                *receiver = local ? &session->remote
+                                                  : &session->local;
+
+  // RFC 7911: the sender must have advertised that it can send, and the
+  // receiver that it can receive
+  return (caps_add_path(sender, afi, safi) & PARSEBGP_SESSION_ADD_PATH_SEND) &&
+         (caps_add_path(receiver, afi, safi) &
+          PARSEBGP_SESSION_ADD_PATH_RECEIVE);
+}
+
+// work out the ADD-PATH NLRI encoding used in each direction
+static void set_add_path(parsebgp_session_t *s)
+{
+  static const struct {
+    uint16_t afi;
+    uint8_t safi;
+  } afi_safis[] = {
+    {PARSEBGP_BGP_AFI_IPV4, PARSEBGP_BGP_SAFI_UNICAST},
+    {PARSEBGP_BGP_AFI_IPV4, PARSEBGP_BGP_SAFI_MULTICAST},
+    {PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_UNICAST},
+    {PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_MULTICAST},
+  };
+  size_t i;
+  uint16_t afi;
+  uint8_t safi;
+
+  s->add_path_remote = 0;
+  s->add_path_local = 0;
+  for (i = 0; i < sizeof(afi_safis) / sizeof(afi_safis[0]); i++) {
+    afi = afi_safis[i].afi;
+    safi = afi_safis[i].safi;
+    if (parsebgp_session_add_path(s, 0, afi, safi)) {
+      s->add_path_remote |= PARSEBGP_BGP_ADD_PATH_FLAG(afi, safi);
+    }
+    if (parsebgp_session_add_path(s, 1, afi, safi)) {
+      s->add_path_local |= PARSEBGP_BGP_ADD_PATH_FLAG(afi, safi);
+    }
+  }
+}
+
+parsebgp_error_t parsebgp_session_set_open(parsebgp_session_table_t *table,
+                                           const parsebgp_opts_t *opts,
+                                           const parsebgp_session_key_t *key,
+                                           int local,
+                                           const parsebgp_bgp_open_t *open)
+{
+  parsebgp_session_t **sp, *s;
+
+  if (!caps_decoded(opts)) {
+    return PARSEBGP_OK;
+  }
+
+  sp = find(table, key);
+  if ((s = *sp) == NULL) {
+    if ((s = calloc(1, sizeof(*s))) == NULL) {
+      return PARSEBGP_MALLOC_FAILURE;
+    }
+    s->key = *key;
+    if (table->size >= table->buckets_cnt && grow(table) == 0) {
+      sp = find(table, key);
+    }
+    *sp = s;
+    table->size++;
+  }
+
+  set_caps(local ? &s->local : &s->remote, open);
+  set_add_path(s);
+  return PARSEBGP_OK;
+}
+
+void parsebgp_session_apply(const parsebgp_session_t *session,
+                            parsebgp_opts_t *opts, int local, int asn_known)
+{
+  if (!PARSEBGP_SESSION_NEGOTIATED(session)) {
+    return;
+  }
+  // RFC 6793: 4-byte ASNs are used only if both sides support them
+  if (!asn_known) {
+    opts->bgp.asn_4_byte = session->local.as4 && session->remote.as4;
+    opts->bgp.asn_4_byte_negotiated = 1;
+  }
+  opts->bgp.add_path =
+    local ? session->add_path_local : session->add_path_remote;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_SESSION_H
+#define __PARSEBGP_SESSION_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque table of BGP sessions and their negotiated capabilities */
+typedef struct parsebgp_session_table parsebgp_session_table_t;
+
+/**
+ * Create an empty session table
+ *
+ * @return pointer to the new table, or NULL if memory could not be allocated
+ *
+ * To use the table, set the sessions field of the parsing options. The parser
+ * then records the capabilities advertised in the OPEN messages of each
+ * session (from BMP Peer Up messages, and BGP4MP OPEN messages), and uses the
+ * capabilities negotiated for a session to decode later UPDATE messages from
+ * that session, instead of guessing (e.g., the size of AS numbers).
+ *
+ * BMP sessions are identified by the peer header (peer type, distinguisher and
+ * address), so a separate table should be used for each BMP router. BGP4MP
+ * sessions are identified by the peer and local addresses and ASNs.
+ *
+ * The table is modified while messages are decoded, so it must not be shared
+ * between parsers that run concurrently.
+ */
+parsebgp_session_table_t *parsebgp_session_table_create(void);
+
+/**
+ * Destroy the given session table
+ *
+ * @param table         pointer to the table to destroy
+ */
+void parsebgp_session_table_destroy(parsebgp_session_table_t *table);
+
+/**
+ * Remove all sessions from the given table
+ *
+ * @param table         pointer to the table to clear
+ */
+void parsebgp_session_table_clear(parsebgp_session_table_t *table);
+
+/**
+ * Get the number of sessions in the given table
+ *
+ * @param table         pointer to the table
+ * @return the number of sessions that are currently known
+ */
+uint64_t parsebgp_session_table_size(const parsebgp_session_table_t *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PARSEBGP_SESSION_H */
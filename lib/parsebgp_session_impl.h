@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_SESSION_IMPL_H
+#define __PARSEBGP_SESSION_IMPL_H
+
+#include "parsebgp_bgp_open.h"
+#include "parsebgp_opts.h"
+#include "parsebgp_session.h"
+#include <inttypes.h>
+
+/** Maximum number of AFI/SAFIs recorded for each side of a session */
+#define PARSEBGP_SESSION_MAX_AFI_SAFI 16
+
+/** Where a session was learned from */
+typedef enum {
+  PARSEBGP_SESSION_SRC_BMP = 1,
+  PARSEBGP_SESSION_SRC_BGP4MP = 2,
+} parsebgp_session_src_t;
+
+/** ADD-PATH Send/Receive modes (RFC 7911) */
+typedef enum {
+  PARSEBGP_SESSION_ADD_PATH_RECEIVE = 0x1,
+  PARSEBGP_SESSION_ADD_PATH_SEND = 0x2,
+} parsebgp_session_add_path_t;
+
+/** Session identifier. Must be zeroed (e.g., using memset) before the fields
+    are filled, since keys are hashed and compared as raw bytes. */
+typedef struct parsebgp_session_key {
+
+  /** BMP Peer Distinguisher */
+  uint64_t dist_id;
+
+  /** Peer ASN (BGP4MP only) */
+  uint32_t peer_asn;
+
+  /** Local ASN (BGP4MP only) */
+  uint32_t local_asn;
+
+  /** AFI of the peer (and local) IP addresses */
+  uint16_t afi;
+
+  /** Source of the session (parsebgp_session_src_t) */
+  uint8_t src;
+
+  /** BMP Peer Type */
+  uint8_t peer_type;
+
+  /** Peer IP address */
+  uint8_t peer_ip[16];
+
+  /** Local IP address (BGP4MP only) */
+  uint8_t local_ip[16];
+
+} parsebgp_session_key_t;
+
+/** Capabilities advertised by one side of a session */
+typedef struct parsebgp_session_caps {
+
+  /** Has the OPEN message of this side been seen? */
+  uint8_t seen;
+
+  /** Was the 4-byte ASN capability advertised? */
+  uint8_t as4;
+
+  /** Number of AFI/SAFIs in afi_safi */
+  uint8_t afi_safi_cnt;
+
+  /** AFI/SAFIs advertised by the MPBGP and/or ADD-PATH capabilities */
+  struct {
+    uint16_t afi;
+    uint8_t safi;
+
+    /** Advertised using the MPBGP capability? */
+    uint8_t mp;
+
+    /** ADD-PATH Send/Receive mode (parsebgp_session_add_path_t flags) */
+    uint8_t add_path;
+  } afi_safi[PARSEBGP_SESSION_MAX_AFI_SAFI];
+
+} parsebgp_session_caps_t;
+
+/** A BGP session */
+typedef struct parsebgp_session {
+
+  /** Session identifier */
+  parsebgp_session_key_t key;
+
+  /** Capabilities advertised by the local (monitored/collector) speaker */
+  parsebgp_session_caps_t local;
+
+  /** Capabilities advertised by the peer */
+  parsebgp_session_caps_t remote;
+
+  /** AFI/SAFIs with ADD-PATH NLRI in UPDATEs sent by the peer
+      (parsebgp_bgp_add_path_flags_t flags) */
+  uint8_t add_path_remote;
+
+  /** AFI/SAFIs with ADD-PATH NLRI in UPDATEs sent by the local speaker */
+  uint8_t add_path_local;
+
+  /** Next session in the same hash bucket */
+  struct parsebgp_session *next;
+
+} parsebgp_session_t;
+
+/** Find the given session (returns NULL if it is not known) */
+const parsebgp_session_t *
+parsebgp_session_get(const parsebgp_session_table_t *table,
+                     const parsebgp_session_key_t *key);
+
+/** Record the capabilities in the OPEN message sent by one side of a session
+    (creating the session if needed). The message is ignored if the parsing
+    options prevented its capabilities from being decoded. */
+parsebgp_error_t parsebgp_session_set_open(parsebgp_session_table_t *table,
+                                           const parsebgp_opts_t *opts,
+                                           const parsebgp_session_key_t *key,
+                                           int local,
+                                           const parsebgp_bgp_open_t *open);
+
+/** Forget the given session */
+void parsebgp_session_remove(parsebgp_session_table_t *table,
+                             const parsebgp_session_key_t *key);
+
+/** Are the capabilities of both sides of the session known? */
+#define PARSEBGP_SESSION_NEGOTIATED(session)                                   \
+  ((session)->local.seen && (session)->remote.seen)
+
+/** Configure the parser to decode UPDATEs sent by the peer (or, if local is
+    set, by the local speaker) of the given session (only if the capabilities
+    of both sides are known). If asn_known is set, the message itself says
+    whether 4-byte AS numbers are used, and only the ADD-PATH configuration is
+    changed. */
+void parsebgp_session_apply(const parsebgp_session_t *session,
+                            parsebgp_opts_t *opts, int local, int asn_known);
+
+/** Do UPDATEs sent by the peer (or, if local is set, by the local speaker)
+    carry ADD-PATH Path Identifiers for the given AFI/SAFI? */
+int parsebgp_session_add_path(const parsebgp_session_t *session, int local,
+                              uint16_t afi, uint8_t safi);
+
+#endif /* __PARSEBGP_SESSION_IMPL_H */
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_stream.h"
+#include "parsebgp_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct parsebgp_stream {
+
+  /** Parsing options */
+  parsebgp_opts_t opts;
+
+  /** Type of the messages in the stream */
+  parsebgp_msg_type_t type;
+
+  /** Message that is returned by parsebgp_stream_next */
+  parsebgp_msg_t *msg;
+
+  /** Current chunk */
+  const uint8_t *chunk;
+
+  /** Length of the current chunk */
+  size_t chunk_len;
+
+  /** Number of bytes of the current chunk that have been used */
+  size_t chunk_off;
+
+  /** Start of a message that did not fit in the earlier chunks */
+  uint8_t *partial;
+
+  /** Number of bytes in partial */
+  size_t partial_len;
+
+  /** Allocated length of partial */
+  size_t partial_alloc;
+
+  /** Length of the message in partial (0 until its headers are complete) */
+  size_t partial_msg_len;
+
+  /** Error that prevented the stream from being split into messages */
+  parsebgp_error_t err;
+};
+
+// the stream can no longer be split into messages, so the rest of the chunk is
+// of no use
+static parsebgp_error_t fail(parsebgp_stream_t *stream, parsebgp_error_t err)
+{
+  stream->chunk_off = stream->chunk_len;
+  return stream->err = err;
+}
+
+static parsebgp_error_t append(parsebgp_stream_t *stream, const uint8_t *buf,
+                               size_t len)
+{
+  size_t alloc_len;
+  uint8_t *tmp;
+
+  if (stream->partial_len + len > stream->partial_alloc) {
+    // grow with the data that has arrived (rather than trusting the length of
+    // the message) so that a bogus length cannot cause a huge allocation
+    alloc_len = stream->partial_alloc * 2;
+    if (alloc_len < stream->partial_len + len) {
+      alloc_len = stream->partial_len + len;
+    }
+    if ((tmp = realloc(stream->partial, alloc_len)) == NULL) {
+      return fail(stream, PARSEBGP_MALLOC_FAILURE);
+    }
+    stream->partial = tmp;
+    stream->partial_alloc = alloc_len;
+  }
+  memcpy(stream->partial + stream->partial_len, buf, len);
+  stream->partial_len += len;
+  stream->chunk_off += len;
+  return PARSEBGP_OK;
+}
+
+static parsebgp_error_t decode(parsebgp_stream_t *stream, const uint8_t *buf,
+                               size_t len, parsebgp_msg_t **msg)
+{
+  parsebgp_error_t err;
+
+  parsebgp_clear_msg(stream->msg);
+  err = parsebgp_decode(stream->opts, stream->type, stream->msg, buf, &len);
+  *msg = stream->msg;
+  // the headers said that the whole message is there
+  return (err == PARSEBGP_PARTIAL_MSG) ? PARSEBGP_INVALID_MSG : err;
+}
+
+parsebgp_stream_t *parsebgp_stream_create(const parsebgp_opts_t *opts,
+                                          parsebgp_msg_type_t type)
+{
+  parsebgp_stream_t *stream;
+
+  if ((stream = malloc_zero(sizeof(parsebgp_stream_t))) == NULL) {
+    return NULL;
+  }
+  stream->opts = *opts;
+  stream->type = type;
+  if ((stream->msg = parsebgp_create_msg()) == NULL) {
+    free(stream);
+    return NULL;
+  }
+  return stream;
+}
+
+void parsebgp_stream_destroy(parsebgp_stream_t *stream)
+{
+  if (stream == NULL) {
+    return;
+  }
+  parsebgp_destroy_msg(stream->msg);
+  free(stream->partial);
+  free(stream);
+}
+
+void parsebgp_stream_reset(parsebgp_stream_t *stream)
+{
+  parsebgp_clear_msg(stream->msg);
+  stream->chunk = NULL;
+  stream->chunk_len = 0;
+  stream->chunk_off = 0;
+  stream->partial_len = 0;
+  stream->partial_msg_len = 0;
+  stream->err = PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_stream_feed(parsebgp_stream_t *stream,
+                                      const uint8_t *buf, size_t len)
+{
+  if (stream->chunk_off < stream->chunk_len) {
+    return PARSEBGP_INVALID_MSG;
+  }
+  stream->chunk = buf;
+  stream->chunk_len = len;
+  stream->chunk_off = 0;
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_stream_next(parsebgp_stream_t *stream,
+                                      parsebgp_msg_t **msg)
+{
+  const uint8_t *buf = stream->chunk + stream->chunk_off;
+  size_t avail = stream->chunk_len - stream->chunk_off;
+  size_t msg_len, cnt;
+  parsebgp_error_t err;
+
+  if (stream->err != PARSEBGP_OK) {
+    return fail(stream, stream->err);
+  }
+
+  if (stream->partial_len > 0) {
+    // complete the message that was started in an earlier chunk, adding one
+    // byte at a time until its headers are complete (so that nothing beyond
+    // the message is copied)
+    while (stream->partial_msg_len == 0) {
+      err = parsebgp_msg_len(stream->opts, stream->type, stream->partial,
+                             stream->partial_len, &msg_len);
+      if (err == PARSEBGP_OK) {
+        stream->partial_msg_len = msg_len;
+        break;
+      }
+      if (err != PARSEBGP_PARTIAL_MSG) {
+        return fail(stream, err);
+      }
+      if (avail == 0) {
+        return PARSEBGP_PARTIAL_MSG;
+      }
+      if ((err = append(stream, buf, 1)) != PARSEBGP_OK) {
+        return err;
+      }
+      buf++;
+      avail--;
+    }
+
+    cnt = stream->partial_msg_len - stream->partial_len;
+    if (cnt > avail) {
+      cnt = avail;
+    }
+    if ((err = append(stream, buf, cnt)) != PARSEBGP_OK) {
+      return err;
+    }
+    if (stream->partial_len < stream->partial_msg_len) {
+      return PARSEBGP_PARTIAL_MSG;
+    }
+
+    msg_len = stream->partial_msg_len;
+    stream->partial_len = 0;
+    stream->partial_msg_len = 0;
+    return decode(stream, stream->partial, msg_len, msg);
+  }
+
+  if (avail == 0) {
+    return PARSEBGP_PARTIAL_MSG;
+  }
+
+  // decode straight from the chunk if the whole message is there
+  err = parsebgp_msg_len(stream->opts, stream->type, buf, avail, &msg_len);
+  if (err == PARSEBGP_OK && msg_len <= avail) {
+    stream->chunk_off += msg_len;
+    return decode(stream, buf, msg_len, msg);
+  }
+  if (err != PARSEBGP_OK && err != PARSEBGP_PARTIAL_MSG) {
+    return fail(stream, err);
+  }
+
+  // otherwise keep the start of the message until the rest arrives
+  stream->partial_msg_len = (err == PARSEBGP_OK) ? msg_len : 0;
+  if ((err = append(stream, buf, avail)) != PARSEBGP_OK) {
+    return err;
+  }
+  return PARSEBGP_PARTIAL_MSG;
+}
+
+parsebgp_error_t parsebgp_stream_push(parsebgp_stream_t *stream,
+                                      const uint8_t *buf, size_t len,
+                                      parsebgp_stream_msg_func_t cb,
+                                      void *user)
+{
+  parsebgp_msg_t *msg;
+  parsebgp_error_t err;
+
+  if ((err = parsebgp_stream_feed(stream, buf, len)) != PARSEBGP_OK) {
+    return err;
+  }
+
+  while ((err = parsebgp_stream_next(stream, &msg)) != PARSEBGP_PARTIAL_MSG) {
+    if (stream->err != PARSEBGP_OK) {
+      break;
+    }
+    if ((err = cb(err, msg, user)) != PARSEBGP_OK) {
+      break;
+    }
+  }
+  // the chunk is not kept
+  stream->chunk_off = stream->chunk_len;
+  return (err == PARSEBGP_PARTIAL_MSG) ? PARSEBGP_OK : err;
+}
+
+size_t parsebgp_stream_unfeed(parsebgp_stream_t *stream)
+{
+  size_t unused = stream->chunk_len - stream->chunk_off;
+
+  // only the bytes that have been used are copied into partial
+  stream->chunk = NULL;
+  stream->chunk_len = 0;
+  stream->chunk_off = 0;
+  return unused;
+}
+
+size_t parsebgp_stream_unused(const parsebgp_stream_t *stream)
+{
+  return stream->chunk_len - stream->chunk_off;
+}
+
+parsebgp_error_t parsebgp_stream_error(const parsebgp_stream_t *stream)
+{
+  return stream->err;
+}
+
+size_t parsebgp_stream_buffered(const parsebgp_stream_t *stream)
+{
+  return stream->partial_len;
+}
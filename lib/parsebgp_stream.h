@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_STREAM_H
+#define __PARSEBGP_STREAM_H
+
+#include "parsebgp.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque structure representing an incremental (push) decoder */
+typedef struct parsebgp_stream parsebgp_stream_t;
+
+/**
+ * Callback run by parsebgp_stream_push for each message
+ *
+ * @param err           result of decoding the message
+ * @param msg           the decoded message
+ * @param user          user data passed to parsebgp_stream_push
+ * @return PARSEBGP_OK to continue, or an error code to stop (which is then
+ * returned by parsebgp_stream_push)
+ */
+typedef parsebgp_error_t (*parsebgp_stream_msg_func_t)(parsebgp_error_t err,
+                                                       parsebgp_msg_t *msg,
+                                                       void *user);
+
+/**
+ * Create a decoder for a stream of messages of the given type
+ *
+ * @param opts          pointer to the parsing options (copied)
+ * @param type          type of the messages in the stream
+ * @return pointer to the new decoder, or NULL if it could not be created
+ *
+ * The decoder never blocks: it is handed chunks of the stream as they arrive
+ * (e.g., from a non-blocking socket read), decodes messages directly from
+ * them, and only copies the start of a message that does not fit in a chunk
+ * (until the rest of it arrives). A decoder is not thread-safe, but many
+ * decoders (e.g., one per BMP session) can be used by one thread.
+ */
+parsebgp_stream_t *parsebgp_stream_create(const parsebgp_opts_t *opts,
+                                          parsebgp_msg_type_t type);
+
+/**
+ * Destroy the given decoder
+ *
+ * @param stream        pointer to the decoder to destroy
+ */
+void parsebgp_stream_destroy(parsebgp_stream_t *stream);
+
+/**
+ * Forget any data held by the given decoder (e.g., when a session restarts)
+ *
+ * @param stream        pointer to the decoder to reset
+ */
+void parsebgp_stream_reset(parsebgp_stream_t *stream);
+
+/**
+ * Hand the next chunk of the stream to the given decoder
+ *
+ * @param stream        pointer to the decoder
+ * @param buf           pointer to the chunk
+ * @param len           length of the chunk
+ * @return PARSEBGP_OK, or PARSEBGP_INVALID_MSG if the previous chunk has not
+ * been used up (i.e., parsebgp_stream_next has not returned
+ * PARSEBGP_PARTIAL_MSG since it was handed over)
+ *
+ * The chunk is not copied, so it must be kept until parsebgp_stream_next
+ * returns PARSEBGP_PARTIAL_MSG.
+ */
+parsebgp_error_t parsebgp_stream_feed(parsebgp_stream_t *stream,
+                                      const uint8_t *buf, size_t len);
+
+/**
+ * Decode the next message in the chunks handed to the given decoder
+ *
+ * @param stream        pointer to the decoder
+ * @param [out] msg     set to the decoded message
+ * @return the result of decoding the message, PARSEBGP_PARTIAL_MSG if more of
+ * the stream is needed, or the error that prevented the stream from being
+ * split into messages
+ *
+ * If a message cannot be decoded (including PARSEBGP_FILTERED_OUT), it is
+ * skipped, and the next call moves on to the following message. If the stream
+ * itself cannot be split into messages (i.e., the message headers are
+ * invalid), the rest of the chunk is discarded, and the same error is returned
+ * (by every call, whatever chunks are fed) until the decoder is reset. Use
+ * parsebgp_stream_error to tell the two apart.
+ *
+ * The message belongs to the decoder, and may refer to the chunk it was
+ * decoded from. It can be used until the next call to parsebgp_stream_next,
+ * parsebgp_stream_feed or parsebgp_stream_reset.
+ */
+parsebgp_error_t parsebgp_stream_next(parsebgp_stream_t *stream,
+                                      parsebgp_msg_t **msg);
+
+/**
+ * Decode the messages completed by the given chunk
+ *
+ * @param stream        pointer to the decoder
+ * @param buf           pointer to the chunk
+ * @param len           length of the chunk
+ * @param cb            callback to run for each message
+ * @param user          user data passed to the callback
+ * @return PARSEBGP_OK if the whole chunk was used, the error returned by the
+ * callback if it stopped early, or the error that prevented the stream from
+ * being split into messages
+ *
+ * This is equivalent to parsebgp_stream_feed followed by calls to
+ * parsebgp_stream_next until more data is needed. The chunk is not needed once
+ * this returns. If the callback stops early, the rest of the chunk is
+ * discarded, so the decoder should be reset before it is used again.
+ */
+parsebgp_error_t parsebgp_stream_push(parsebgp_stream_t *stream,
+                                      const uint8_t *buf, size_t len,
+                                      parsebgp_stream_msg_func_t cb,
+                                      void *user);
+
+/**
+ * Take back the part of the current chunk that has not been used
+ *
+ * @param stream        pointer to the decoder
+ * @return the number of bytes at the end of the chunk that have not been used
+ *
+ * Those bytes must be fed again (e.g., from a copy) before any later data.
+ * Any incomplete message held by the decoder is kept, so this can be used to
+ * stop decoding part way through a chunk that is not kept.
+ */
+size_t parsebgp_stream_unfeed(parsebgp_stream_t *stream);
+
+/**
+ * Get the number of bytes of the current chunk that have not been used
+ *
+ * @param stream        pointer to the decoder
+ * @return the number of bytes at the end of the chunk that have not been used
+ */
+size_t parsebgp_stream_unused(const parsebgp_stream_t *stream);
+
+/**
+ * Get the error that prevented the stream from being split into messages
+ *
+ * @param stream        pointer to the decoder
+ * @return PARSEBGP_OK if the decoder can still be used, otherwise the error
+ * that parsebgp_stream_next returns until the decoder is reset
+ */
+parsebgp_error_t parsebgp_stream_error(const parsebgp_stream_t *stream);
+
+/**
+ * Get the number of bytes of an incomplete message held by the given decoder
+ *
+ * @param stream        pointer to the decoder
+ * @return the number of bytes copied from earlier chunks (e.g., to report
+ * trailing garbage when the stream ends)
+ */
+size_t parsebgp_stream_buffered(const parsebgp_stream_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PARSEBGP_STREAM_H */
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_STREAM_HPP
+#define __PARSEBGP_STREAM_HPP
+
+/* C++20 adapter for the incremental decoder in parsebgp_stream.h. This header
+ * is not used to build the library, only by C++ applications. */
+
+#include "parsebgp_stream.h"
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace parsebgp {
+
+/** A message returned by a Stream */
+struct Message {
+
+  /** Result of decoding the message (see parsebgp_stream_next) */
+  parsebgp_error_t err;
+
+  /** The decoded message (owned by the stream), or nullptr if the stream
+      could not be split into messages */
+  parsebgp_msg_t *msg;
+};
+
+/**
+ * Incremental decoder for a stream of messages
+ *
+ * Messages can be taken from the stream in two ways:
+ *
+ * - by iterating over the range returned by feed() (e.g., from an event loop
+ *   callback), which yields each message completed by the chunk:
+ *
+ *     for (parsebgp::Message m : stream.feed(buf, len)) { ... }
+ *
+ * - from a coroutine that awaits next(), while the event loop hands chunks to
+ *   push() (which resumes the coroutine for each message that completes):
+ *
+ *     for (;;) { parsebgp::Message m = co_await stream.next(); ... }
+ *
+ * In both cases a message can only be used until the next one is requested.
+ *
+ * If the stream cannot be split into messages (see parsebgp_stream_next), the
+ * error is yielded once for each chunk (with a null msg), after which the
+ * range ends, or next() waits for the following chunk. The decoder must be
+ * reset before it can decode messages again.
+ */
+class Stream {
+public:
+  /** Iterator over the messages completed by a chunk */
+  class Iterator {
+  public:
+    using value_type = Message;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() = default;
+
+    explicit Iterator(parsebgp_stream_t *stream) : stream_(stream)
+    {
+      ++*this;
+    }
+
+    const Message &operator*() const { return msg_; }
+
+    const Message *operator->() const { return &msg_; }
+
+    Iterator &operator++()
+    {
+      if (failed_) {
+        // the stream error has been yielded
+        stream_ = nullptr;
+        return *this;
+      }
+      msg_.err = parsebgp_stream_next(stream_, &msg_.msg);
+      if (msg_.err == PARSEBGP_PARTIAL_MSG) {
+        stream_ = nullptr;
+      } else if (parsebgp_stream_error(stream_) != PARSEBGP_OK) {
+        msg_.msg = nullptr;
+        failed_ = true;
+      }
+      return *this;
+    }
+
+    void operator++(int) { ++*this; }
+
+    bool operator==(std::default_sentinel_t) const
+    {
+      return stream_ == nullptr;
+    }
+
+  private:
+    parsebgp_stream_t *stream_ = nullptr;
+    Message msg_ = {PARSEBGP_OK, nullptr};
+    bool failed_ = false;
+  };
+
+  /** Range of the messages completed by a chunk */
+  class Messages {
+  public:
+    explicit Messages(parsebgp_stream_t *stream) : stream_(stream) {}
+
+    Iterator begin() const { return Iterator(stream_); }
+
+    std::default_sentinel_t end() const { return {}; }
+
+  private:
+    parsebgp_stream_t *stream_;
+  };
+
+  /** Awaitable returned by next() */
+  class NextAwaiter {
+  public:
+    explicit NextAwaiter(Stream &stream) : stream_(stream) {}
+
+    bool await_ready()
+    {
+      for (;;) {
+        // (once the stream error has been returned, wait for the next chunk)
+        if (!stream_.failed_) {
+          msg_.err = stream_.next_msg(&msg_.msg);
+          if (msg_.err != PARSEBGP_PARTIAL_MSG) {
+            return true;
+          }
+        }
+        // use the data pushed while nobody was waiting before suspending
+        if (!stream_.take_backlog()) {
+          return false;
+        }
+      }
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+      stream_.waiter_ = handle;
+      stream_.waiter_msg_ = &msg_;
+    }
+
+    Message await_resume() const { return msg_; }
+
+  private:
+    Stream &stream_;
+    Message msg_ = {PARSEBGP_OK, nullptr};
+  };
+
+  /** Create a decoder for a stream of messages of the given type */
+  Stream(const parsebgp_opts_t &opts, parsebgp_msg_type_t type)
+    : stream_(parsebgp_stream_create(&opts, type))
+  {
+    if (stream_ == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+
+  ~Stream() { parsebgp_stream_destroy(stream_); }
+
+  Stream(const Stream &) = delete;
+  Stream &operator=(const Stream &) = delete;
+
+  /** Get the underlying decoder */
+  parsebgp_stream_t *get() const { return stream_; }
+
+  /**
+   * Hand the next chunk of the stream to the decoder
+   *
+   * @return the range of messages completed by the chunk. The chunk must be
+   * kept until the range has been iterated to its end.
+   */
+  Messages feed(const uint8_t *buf, size_t len)
+  {
+    hand_over(buf, len);
+    feeding_.clear();
+    return Messages(stream_);
+  }
+
+  /** Get the next message (in a coroutine) */
+  NextAwaiter next() { return NextAwaiter(*this); }
+
+  /**
+   * Hand the next chunk of the stream to the decoder, and resume the coroutine
+   * waiting in next() for each message that the chunk completes
+   *
+   * The chunk is not needed once this returns. If no coroutine is waiting
+   * for (the rest of) the chunk, e.g., because none has awaited next() yet,
+   * or it returned instead of awaiting next() again, the rest is copied and
+   * kept for the next coroutine that awaits next().
+   */
+  void push(const uint8_t *buf, size_t len)
+  {
+    Message msg;
+    size_t unused;
+
+    if (!waiter_) {
+      keep(buf, len);
+      return;
+    }
+    hand_over(buf, len);
+    feeding_.clear();
+    while (waiter_ && !failed_) {
+      msg.err = next_msg(&msg.msg);
+      if (msg.err == PARSEBGP_PARTIAL_MSG) {
+        return;
+      }
+      *waiter_msg_ = msg;
+      std::exchange(waiter_, nullptr).resume();
+    }
+    if (waiter_) {
+      // the stream error has been returned to the waiter
+      return;
+    }
+    // nobody is waiting for the rest of the chunk
+    unused = parsebgp_stream_unfeed(stream_);
+    keep(buf + len - unused, unused);
+  }
+
+  /** Forget any data held by the decoder */
+  void reset()
+  {
+    parsebgp_stream_reset(stream_);
+    backlog_.clear();
+    feeding_.clear();
+    failed_ = false;
+  }
+
+  /**
+   * Get the number of bytes held by the decoder: the start of an incomplete
+   * message, and data pushed while no coroutine was waiting
+   */
+  size_t buffered() const
+  {
+    return parsebgp_stream_buffered(stream_) + backlog_.size() +
+           (feeding_.empty() ? 0 : parsebgp_stream_unused(stream_));
+  }
+
+private:
+  void hand_over(const uint8_t *buf, size_t len)
+  {
+    if (parsebgp_stream_feed(stream_, buf, len) != PARSEBGP_OK) {
+      throw std::logic_error("parsebgp::Stream: previous chunk not used up");
+    }
+    failed_ = false;
+  }
+
+  // copy data that nobody is waiting for, to be decoded after any that is
+  // already kept
+  void keep(const uint8_t *buf, size_t len)
+  {
+    backlog_.insert(backlog_.end(), buf, buf + len);
+  }
+
+  // hand the kept data to the decoder (once it has used up its chunk)
+  bool take_backlog()
+  {
+    if (backlog_.empty()) {
+      return false;
+    }
+    feeding_.swap(backlog_);
+    backlog_.clear();
+    hand_over(feeding_.data(), feeding_.size());
+    return true;
+  }
+
+  // get the next message for next() or push(), noting if it is the stream
+  // error (which is only returned once per chunk)
+  parsebgp_error_t next_msg(parsebgp_msg_t **msg)
+  {
+    parsebgp_error_t err = parsebgp_stream_next(stream_, msg);
+
+    if (err != PARSEBGP_PARTIAL_MSG &&
+        parsebgp_stream_error(stream_) != PARSEBGP_OK) {
+      *msg = nullptr;
+      failed_ = true;
+    }
+    return err;
+  }
+
+  parsebgp_stream_t *stream_;
+  std::coroutine_handle<> waiter_;
+  Message *waiter_msg_ = nullptr;
+
+  // has the stream error been returned for the current chunk
+  bool failed_ = false;
+
+  // data pushed while no coroutine was waiting, and the part of it that has
+  // been handed to the decoder
+  std::vector<uint8_t> backlog_;
+  std::vector<uint8_t> feeding_;
+};
+
+} // namespace parsebgp
+
+#endif /* __PARSEBGP_STREAM_HPP */
@@ -62,6 +62,127 @@ parsebgp_error_t parsebgp_decode_prefix(uint8_t pfx_len, uint8_t *dst,
   return PARSEBGP_OK;
 }
 
+parsebgp_error_t parsebgp_validate_prefixes(const uint8_t *buf, size_t len,
+                                            size_t max_pfx_len, int add_path,
+                                            const uint8_t **errp)
+{
+  size_t nread = 0, bytes;
+
+  while (nread < len) {
+    if (add_path) {
+      // Path Identifier
+      PARSEBGP_VALIDATE_ASSERT(errp, buf, len - nread > sizeof(uint32_t));
+      nread += sizeof(uint32_t);
+      buf += sizeof(uint32_t);
+    }
+    // Prefix Length
+    PARSEBGP_VALIDATE_ASSERT(errp, buf, *buf <= max_pfx_len);
+    bytes = (*buf + 7) / 8;
+    // Prefix
+    PARSEBGP_VALIDATE_ASSERT(errp, buf, bytes < len - nread);
+    nread += 1 + bytes;
+    buf += 1 + bytes;
+  }
+
+  return PARSEBGP_OK;
+}
+
+/* -------------------- 64-bit Hashing (wyhash) -------------------- */
+
+static const uint64_t wy_secret[4] = {
+  0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull,
+  0x4d5a2da51de1aa47ull};
+
+// 64x64 -> 128-bit multiply, leaving the low half in *a and the high in *b
+static inline void wy_mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = *a;
+  r *= *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32), c = t < rl, lo, hi;
+  lo = t + (rm1 << 32);
+  c += lo < t;
+  hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+  *a = lo;
+  *b = hi;
+#endif
+}
+
+static inline uint64_t wy_mix(uint64_t a, uint64_t b)
+{
+  wy_mum(&a, &b);
+  return a ^ b;
+}
+
+// little-endian reads (so that hashes do not depend on the host byte order)
+static inline uint64_t wy_r8(const uint8_t *p)
+{
+  return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) |
+         ((uint64_t)p[3] << 24) | ((uint64_t)p[4] << 32) |
+         ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) |
+         ((uint64_t)p[7] << 56);
+}
+
+static inline uint64_t wy_r4(const uint8_t *p)
+{
+  return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) |
+         ((uint64_t)p[3] << 24);
+}
+
+static inline uint64_t wy_r3(const uint8_t *p, size_t k)
+{
+  return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+uint64_t parsebgp_hash64(const void *buf, size_t len, uint64_t seed)
+{
+  const uint8_t *p = buf;
+  uint64_t a, b, see1, see2;
+  size_t i = len;
+
+  seed ^= wy_mix(seed ^ wy_secret[0], wy_secret[1]);
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (wy_r4(p) << 32) | wy_r4(p + ((len >> 3) << 2));
+      b = (wy_r4(p + len - 4) << 32) | wy_r4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = wy_r3(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    if (i > 48) {
+      see1 = seed;
+      see2 = seed;
+      do {
+        seed = wy_mix(wy_r8(p) ^ wy_secret[1], wy_r8(p + 8) ^ seed);
+        see1 = wy_mix(wy_r8(p + 16) ^ wy_secret[2], wy_r8(p + 24) ^ see1);
+        see2 = wy_mix(wy_r8(p + 32) ^ wy_secret[3], wy_r8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = wy_mix(wy_r8(p) ^ wy_secret[1], wy_r8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = wy_r8(p + i - 16);
+    b = wy_r8(p + i - 8);
+  }
+  a ^= wy_secret[1];
+  b ^= seed;
+  wy_mum(&a, &b);
+  return wy_mix(a ^ wy_secret[0] ^ len, b ^ wy_secret[1]);
+}
+
 void *malloc_zero(const size_t size)
 {
   return calloc(size, 1);
@@ -152,6 +152,113 @@
     buf += (n);                                                                \
   } while (0)
 
+/** Convenience macro to check (once) that a fixed-size block of fields is
+ * present in the buffer, so that the fields can then be read using the
+ * PARSEBGP_DESERIALIZE_*_UNCHECKED macros.
+ *
+ * @param len           total length of the buffer
+ * @param read          the number of bytes already read from the buffer
+ * @param n             number of bytes that must be available
+ */
+#define PARSEBGP_DESERIALIZE_CHECK(len, read, n)                               \
+  do {                                                                         \
+    assert((len) >= (read));                                                   \
+    if (((len) - (read)) < (n)) {                                              \
+      return PARSEBGP_PARTIAL_MSG;                                             \
+    }                                                                          \
+  } while (0)
+
+/** Variants of the PARSEBGP_DESERIALIZE_* macros that do not check the buffer
+ * length. These must only be used once the caller has established that the
+ * bytes are present, either with PARSEBGP_DESERIALIZE_CHECK, or because a
+ * semantic length (e.g., the attribute length) has already been checked
+ * against the buffer.
+ *
+ * If PARSEBGP_CHECKED_READS is defined, these are the checked macros instead.
+ * The test suite builds the library both ways and compares the results, which
+ * catches an unchecked read that is not actually covered by an earlier check.
+ *
+ * @param buf           pointer to the buffer (will be updated)
+ * @param len           length that the caller has established bounds the read
+ *                      (e.g., the attribute length), only used if
+ *                      PARSEBGP_CHECKED_READS is defined
+ * @param read          the number of bytes already read from the buffer
+ *                      (will be updated)
+ * @param to            the variable to deserialize into
+ */
+#ifdef PARSEBGP_CHECKED_READS
+
+#define PARSEBGP_DESERIALIZE_UINT8_UNCHECKED(buf, len, read, to)               \
+  PARSEBGP_DESERIALIZE_UINT8(buf, len, read, to)
+
+#define PARSEBGP_DESERIALIZE_UINT16_UNCHECKED(buf, len, read, to)              \
+  PARSEBGP_DESERIALIZE_UINT16(buf, len, read, to)
+
+#define PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, len, read, to)              \
+  PARSEBGP_DESERIALIZE_UINT32(buf, len, read, to)
+
+#define PARSEBGP_DESERIALIZE_UINT64_UNCHECKED(buf, len, read, to)              \
+  PARSEBGP_DESERIALIZE_UINT64(buf, len, read, to)
+
+#define PARSEBGP_DESERIALIZE_VAL_UNCHECKED(buf, len, read, to)                 \
+  PARSEBGP_DESERIALIZE_VAL(buf, len, read, to)
+
+#else
+
+#define PARSEBGP_DESERIALIZE_UINT8_UNCHECKED(buf, len, read, to)               \
+  PARSEBGP_DESERIALIZE_INT_UNCHECKED(buf, read, to, uint8_t,                   \
+                                     *(const uint8_t*))
+
+#define PARSEBGP_DESERIALIZE_UINT16_UNCHECKED(buf, len, read, to)              \
+  PARSEBGP_DESERIALIZE_INT_UNCHECKED(buf, read, to, uint16_t, nptohs)
+
+#define PARSEBGP_DESERIALIZE_UINT32_UNCHECKED(buf, len, read, to)              \
+  PARSEBGP_DESERIALIZE_INT_UNCHECKED(buf, read, to, uint32_t, nptohl)
+
+#define PARSEBGP_DESERIALIZE_UINT64_UNCHECKED(buf, len, read, to)              \
+  PARSEBGP_DESERIALIZE_INT_UNCHECKED(buf, read, to, uint64_t, nptohll)
+
+#define PARSEBGP_DESERIALIZE_INT_UNCHECKED(buf, read, to, type, getval)        \
+  do {                                                                         \
+    to = getval(buf);                                                          \
+    read += sizeof(type);                                                      \
+    buf += sizeof(type);                                                       \
+  } while (0)
+
+#define PARSEBGP_DESERIALIZE_VAL_UNCHECKED(buf, len, read, to)                 \
+  do {                                                                         \
+    memcpy(&(to), (buf), sizeof(to));                                          \
+    read += sizeof(to);                                                        \
+    buf += sizeof(to);                                                         \
+  } while (0)
+
+#endif
+
+/** Is the given section (a parsebgp_projection_t value) to be decoded? */
+#define PARSEBGP_PROJECTED(opts, section)                                      \
+  (!(opts)->projection_enabled || ((opts)->projection & (section)))
+
+/** Convenience macro to skip an optional section of a message (that was not
+ * selected by the projection) using its encoded length.
+ *
+ * @param buf           pointer to the buffer (will be updated)
+ * @param len           total length of the buffer
+ * @param read          the number of bytes already read from the buffer
+ *                      (will be updated)
+ * @param n             number of bytes to skip
+ */
+#define PARSEBGP_SKIP_SECTION(buf, len, read, n)                               \
+  do {                                                                         \
+    PARSEBGP_DESERIALIZE_CHECK(len, read, n);                                  \
+    read += (n);                                                               \
+    buf += (n);                                                                \
+  } while (0)
+
+/** Is the given prefix selected by the prefix set (if any) in the options? */
+#define PARSEBGP_PREFIX_SELECTED(opts, afi, addr, len)                         \
+  ((opts)->prefix_set == NULL ||                                               \
+   parsebgp_prefix_set_match((opts)->prefix_set, (opts)->prefix_set_match,    \
+                             (afi), (addr), (len)))
 
 /** Convenience macro to either abort parsing or skip an unimplemented feature
     depending on run-time configuration */
@@ -207,6 +314,21 @@
   } while (0)
 
 
+/** Record the position of a validation failure and return the given error */
+#define PARSEBGP_VALIDATE_ERR(errp, pos, err)                                  \
+  do {                                                                         \
+    *(errp) = (pos);                                                           \
+    return (err);                                                              \
+  } while (0)
+
+/** Fail validation (as an invalid message) at pos unless condition holds */
+#define PARSEBGP_VALIDATE_ASSERT(errp, pos, condition)                         \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      PARSEBGP_VALIDATE_ERR(errp, pos, PARSEBGP_INVALID_MSG);                  \
+    }                                                                          \
+  } while (0)
+
 #define PARSEBGP_DUMP_STRUCT_HDR(struct_name, depth)                           \
   do {                                                                         \
     int _i;                                                                    \
@@ -308,6 +430,37 @@ parsebgp_error_t parsebgp_decode_prefix(uint8_t pfx_len, uint8_t *dst,
                                         const uint8_t *buf, size_t *buf_len,
                                         size_t max_pfx_len);
 
+/**
+ * Validate a sequence of (length, prefix) NLRI tuples without decoding them
+ *
+ * @param buf           Buffer to read the prefixes from
+ * @param len           Number of bytes of NLRI in the buffer (must be consumed
+ *                      exactly)
+ * @param max_pfx_len   Maximum allowed prefix length (32 for IPv4, 128 for
+ *                      IPv6)
+ * @param add_path      Is each tuple preceded by an ADD-PATH Path Identifier?
+ * @param [out] errp    Set to the position of the offending byte on failure
+ * @return PARSEBGP_OK if the prefixes are well-formed, PARSEBGP_INVALID_MSG
+ * otherwise
+ */
+parsebgp_error_t parsebgp_validate_prefixes(const uint8_t *buf, size_t len,
+                                            size_t max_pfx_len, int add_path,
+                                            const uint8_t **errp);
+
+/**
+ * Compute a fast 64-bit (non-cryptographic) hash of a buffer
+ *
+ * This is the wyhash algorithm (final version 4), which is in the public
+ * domain. Hashes are stable across platforms, but are not guaranteed to be
+ * stable across library versions.
+ *
+ * @param buf           Buffer to hash
+ * @param len           Number of bytes to hash
+ * @param seed          Seed (e.g., to distinguish different kinds of data)
+ * @return the 64-bit hash of the buffer
+ */
+uint64_t parsebgp_hash64(const void *buf, size_t len, uint64_t seed);
+
 /** Convenience function to allocate and zero memory */
 void *malloc_zero(const size_t size);
 
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Decode deterministic mutations of a set of seed messages, dumping each
+ * result to stdout. test_checked_reads.sh runs this against the library and
+ * against a copy built with PARSEBGP_CHECKED_READS: any difference means that
+ * an unchecked read went past the end of its buffer. */
+
+/** Number of mutants decoded per seed message */
+#define MUTANTS 5000
+
+typedef struct seed {
+  parsebgp_msg_type_t type;
+  parsebgp_opts_t opts;
+  test_buf_t buf;
+} seed_t;
+
+static uint32_t rand_state = 1;
+
+/* a fixed LCG so that both programs see the same mutants everywhere */
+static uint32_t next_rand(void)
+{
+  rand_state = rand_state * 1103515245 + 12345;
+  return (rand_state >> 8) & 0xffffff;
+}
+
+static void build_attrs(test_buf_t *attrs, int asn_4_byte)
+{
+  uint32_t path[] = {65001, 4200000000u, 3356};
+  uint32_t comms[] = {0xfde80064, 0xfde80065, 0xffffff01};
+  uint8_t aggregator[8] = {0, 0, 0xfd, 0xe9, 192, 0, 2, 1};
+  uint8_t u32[4] = {0, 0, 0, 100};
+  uint8_t cluster[8] = {10, 0, 0, 1, 10, 0, 0, 2};
+  uint8_t large[24] = {0, 0, 0xfd, 0xe9, 0, 0, 0, 1, 0, 0, 0, 2,
+                       0, 0, 0xfd, 0xe9, 0, 0, 0, 3, 0, 0, 0, 4};
+  uint8_t ext[8] = {0, 2, 0xfd, 0xe9, 0, 0, 0, 1};
+
+  tb_attr_origin(attrs, 1);
+  tb_attr_as_path(attrs, 2, asn_4_byte, path, asn_4_byte ? 3 : 1);
+  tb_attr_next_hop(attrs, "192.0.2.1");
+  tb_attr(attrs, 0x80, 4, u32, 4);  // MED
+  tb_attr(attrs, 0x40, 5, u32, 4);  // LOCAL_PREF
+  tb_attr(attrs, 0x40, 6, NULL, 0); // ATOMIC_AGGREGATE
+  if (asn_4_byte) {
+    tb_attr(attrs, 0xc0, 7, aggregator, 8);
+  } else {
+    tb_attr(attrs, 0xc0, 7, aggregator + 2, 6);
+  }
+  tb_attr_communities(attrs, comms, 3);
+  tb_attr(attrs, 0x80, 9, u32, 4); // ORIGINATOR_ID
+  tb_attr(attrs, 0x80, 10, cluster, sizeof(cluster));
+  tb_attr(attrs, 0xc0, 16, ext, sizeof(ext));
+  tb_attr(attrs, 0xc0, 32, large, sizeof(large));
+}
+
+static void build_update(test_buf_t *tb, int asn_4_byte, int add_path)
+{
+  test_buf_t withdrawn, attrs, nlri, nh, mp_nlri;
+
+  tb_init(&withdrawn);
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&nh);
+  tb_init(&mp_nlri);
+
+  build_attrs(&attrs, asn_4_byte);
+  tb_ip6(&nh, "2001:db8::1");
+  tb_prefix(&mp_nlri, "2001:db8:1::/48");
+  tb_prefix(&mp_nlri, "2001:db8:2::/64");
+  tb_attr_mp_reach(&attrs, PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_UNICAST, &nh,
+                   &mp_nlri);
+  tb_attr_mp_unreach(&attrs, PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_UNICAST,
+                     &mp_nlri);
+  if (add_path) {
+    tb_prefix_ap(&withdrawn, 1, "198.51.100.0/24");
+    tb_prefix_ap(&nlri, 2, "10.0.0.0/8");
+    tb_prefix_ap(&nlri, 3, "10.1.0.0/16");
+  } else {
+    tb_prefix(&withdrawn, "198.51.100.0/24");
+    tb_prefix(&withdrawn, "198.51.101.0/25");
+    tb_prefix(&nlri, "10.0.0.0/8");
+    tb_prefix(&nlri, "10.1.0.0/16");
+    tb_prefix(&nlri, "10.1.2.0/23");
+  }
+  tb_bgp_update(tb, &withdrawn, &attrs, &nlri);
+
+  tb_free(&withdrawn);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&nh);
+  tb_free(&mp_nlri);
+}
+
+static int build_seeds(seed_t *seeds)
+{
+  const char *ips[] = {"192.0.2.1", "192.0.2.2"};
+  uint32_t asns[] = {65001, 4200000000u};
+  test_buf_t attrs;
+  size_t off;
+  int cnt = 0;
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    parsebgp_opts_init(&seeds[i].opts);
+    seeds[i].opts.ignore_not_implemented = 1;
+    seeds[i].opts.silence_not_implemented = 1;
+    seeds[i].opts.silence_invalid = 1;
+    tb_init(&seeds[i].buf);
+  }
+
+  // BGP UPDATEs with 4-byte and 2-byte ASNs, and with ADD-PATH
+  seeds[cnt].type = PARSEBGP_MSG_TYPE_BGP;
+  seeds[cnt].opts.bgp.asn_4_byte = 1;
+  build_update(&seeds[cnt++].buf, 1, 0);
+
+  seeds[cnt].type = PARSEBGP_MSG_TYPE_BGP;
+  build_update(&seeds[cnt++].buf, 0, 0);
+
+  seeds[cnt].type = PARSEBGP_MSG_TYPE_BGP;
+  seeds[cnt].opts.bgp.asn_4_byte = 1;
+  seeds[cnt].opts.bgp.add_path = PARSEBGP_BGP_ADD_PATH_ALL;
+  build_update(&seeds[cnt++].buf, 1, 1);
+
+  // MRT: a PEER_INDEX_TABLE followed by IPv4 and IPv6 RIB records
+  tb_init(&attrs);
+  build_attrs(&attrs, 1);
+  seeds[cnt].type = PARSEBGP_MSG_TYPE_MRT;
+  tb_peer_index(&seeds[cnt].buf, 2, ips, asns);
+  off = tb_rib_begin(&seeds[cnt].buf, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST,
+                     0, "10.0.0.0/8", 2);
+  tb_rib_entry(&seeds[cnt].buf, 0, 0, 0, &attrs);
+  tb_rib_entry(&seeds[cnt].buf, 1, 0, 0, &attrs);
+  tb_mrt_end(&seeds[cnt].buf, off);
+  off = tb_rib_begin(&seeds[cnt].buf,
+                     PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH, 1,
+                     "2001:db8::/32", 1);
+  tb_rib_entry(&seeds[cnt].buf, 1, 1, 7, &attrs);
+  tb_mrt_end(&seeds[cnt++].buf, off);
+  tb_free(&attrs);
+
+  // MRT: BGP4MP messages
+  seeds[cnt].type = PARSEBGP_MSG_TYPE_MRT;
+  off = tb_bgp4mp_begin(&seeds[cnt].buf, 2000, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4,
+                        65001, "192.0.2.1");
+  build_update(&seeds[cnt].buf, 1, 0);
+  tb_mrt_end(&seeds[cnt].buf, off);
+  off = tb_bgp4mp_begin(&seeds[cnt].buf, 2001,
+                        PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_ADDPATH, 65001,
+                        "192.0.2.1");
+  build_update(&seeds[cnt].buf, 1, 1);
+  tb_mrt_end(&seeds[cnt++].buf, off);
+
+  // BMP: Route Monitoring from an IPv4 peer and a (2-byte AS) IPv6 peer
+  seeds[cnt].type = PARSEBGP_MSG_TYPE_BMP;
+  off = tb_bmp_begin(&seeds[cnt].buf, PARSEBGP_BMP_TYPE_ROUTE_MON);
+  tb_bmp_peer_hdr(&seeds[cnt].buf, 0, "192.0.2.1", 65001);
+  build_update(&seeds[cnt].buf, 1, 0);
+  tb_bmp_end(&seeds[cnt].buf, off);
+  off = tb_bmp_begin(&seeds[cnt].buf, PARSEBGP_BMP_TYPE_ROUTE_MON);
+  tb_bmp_peer_hdr(&seeds[cnt].buf,
+                  PARSEBGP_BMP_PEER_FLAG_IPV6 |
+                    PARSEBGP_BMP_PEER_FLAG_2_BYTE_AS_PATH,
+                  "192.0.2.2", 65002);
+  build_update(&seeds[cnt].buf, 0, 0);
+  tb_bmp_end(&seeds[cnt++].buf, off);
+
+  return cnt;
+}
+
+static void mutate(test_buf_t *out, const test_buf_t *in)
+{
+  int mutations = 1 + next_rand() % 4;
+  size_t pos;
+
+  tb_reset(out);
+  tb_bytes(out, in->buf, in->len);
+  while (mutations-- > 0) {
+    pos = next_rand() % out->len;
+    switch (next_rand() % 8) {
+    case 0:
+      // truncate
+      out->len = pos;
+      return;
+
+    case 1:
+    case 2:
+      // small change (e.g., to a length)
+      out->buf[pos] += (next_rand() % 5) - 2;
+      break;
+
+    case 3:
+      out->buf[pos] = 0xff;
+      break;
+
+    default:
+      out->buf[pos] = next_rand() & 0xff;
+      break;
+    }
+  }
+}
+
+static void decode_all(seed_t *seed, parsebgp_msg_t *msg, const test_buf_t *tb)
+{
+  size_t off = 0, len;
+  parsebgp_error_t err = PARSEBGP_OK;
+
+  while (off < tb->len && err == PARSEBGP_OK) {
+    len = tb->len - off;
+    err = parsebgp_decode(seed->opts, seed->type, msg, tb->buf + off, &len);
+    printf("decode at %zu: %d", off, err);
+    if (err == PARSEBGP_OK) {
+      printf(" (%zu bytes)\n", len);
+      parsebgp_dump_msg(msg);
+      off += len;
+    } else {
+      printf("\n");
+    }
+    parsebgp_clear_msg(msg);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  seed_t seeds[8];
+  int seeds_cnt = build_seeds(seeds);
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  test_buf_t mutant;
+  int i, j;
+
+  tb_init(&mutant);
+  for (i = 0; i < seeds_cnt; i++) {
+    printf("seed %d\n", i);
+    decode_all(&seeds[i], msg, &seeds[i].buf);
+    for (j = 0; j < MUTANTS; j++) {
+      printf("mutant %d.%d\n", i, j);
+      mutate(&mutant, &seeds[i].buf);
+      decode_all(&seeds[i], msg, &mutant);
+    }
+    tb_free(&seeds[i].buf);
+  }
+  tb_free(&mutant);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Write the files that test_tools.sh runs the parsebgp tools on:
+ *
+ *  - tool_updates.mrt: BGP4MP updates from a mix of peers
+ *  - tool_rib.mrt: three TABLE_DUMP_V2 dumps, each with its own Peer Index
+ *    Table, so that chunks must carry the right table
+ *  - tool_small.mrt: a few updates (parsed as a single task)
+ *  - tool_large.mrt: enough updates to need several of the tool's 1MB read
+ *    buffers
+ *  - tool_trunc.mrt: updates followed by a truncated record
+ *  - tool_peers.bmp: Route Monitoring messages from a mix of peers
+ */
+
+static int write_file(const char *fname, const test_buf_t *tb)
+{
+  FILE *fp;
+
+  if ((fp = fopen(fname, "wb")) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s\n", fname);
+    return -1;
+  }
+  if (fwrite(tb->buf, 1, tb->len, fp) != tb->len) {
+    fprintf(stderr, "ERROR: Could not write %s\n", fname);
+    fclose(fp);
+    return -1;
+  }
+  fclose(fp);
+  return 0;
+}
+
+static void build_updates(test_buf_t *tb, int cnt)
+{
+  char ip[32], prefix[32];
+  size_t off;
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    snprintf(ip, sizeof(ip), "192.0.2.%d", i % 7 + 1);
+    snprintf(prefix, sizeof(prefix), "10.%d.%d.0/24", i / 256, i % 256);
+    off = tb_bgp4mp_begin(tb, 1000 + i,
+                          PARSEBGP_MRT_BGP4MP_MESSAGE_AS4, 65000 + i % 7, ip);
+    tb_simple_update(tb, 1, 65000 + i % 7, prefix);
+    tb_mrt_end(tb, off);
+  }
+}
+
+static void build_ribs(test_buf_t *tb)
+{
+  const char *peer_ips[] = {"192.0.2.1", "192.0.2.2"};
+  uint32_t peer_asns[2], path[2];
+  char prefix[32];
+  test_buf_t attrs;
+  size_t off;
+  int dump, i;
+
+  tb_init(&attrs);
+  for (dump = 0; dump < 3; dump++) {
+    // the peers differ between dumps, which shows up in the elem output
+    peer_asns[0] = 65100 + dump;
+    peer_asns[1] = 65200 + dump;
+    tb_peer_index(tb, 2, peer_ips, peer_asns);
+    for (i = 0; i < 300; i++) {
+      snprintf(prefix, sizeof(prefix), "10.%d.%d.0/24", dump * 2 + i / 256,
+               i % 256);
+      off = tb_rib_begin(tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST, i,
+                         prefix, 2);
+      tb_reset(&attrs);
+      tb_attr_origin(&attrs, 0);
+      path[0] = peer_asns[0];
+      path[1] = 3356;
+      tb_attr_as_path(&attrs, 2, 1, path, 2);
+      tb_attr_next_hop(&attrs, peer_ips[0]);
+      tb_rib_entry(tb, 0, 0, 0, &attrs);
+      tb_reset(&attrs);
+      tb_attr_origin(&attrs, 0);
+      path[0] = peer_asns[1];
+      tb_attr_as_path(&attrs, 2, 1, path, 2);
+      tb_attr_next_hop(&attrs, peer_ips[1]);
+      tb_rib_entry(tb, 1, 0, 0, &attrs);
+      tb_mrt_end(tb, off);
+    }
+  }
+  tb_free(&attrs);
+}
+
+static void build_bmp(test_buf_t *tb, int cnt)
+{
+  char ip[32], prefix[32];
+  size_t off;
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    snprintf(ip, sizeof(ip), "192.0.2.%d", i % 5 + 1);
+    snprintf(prefix, sizeof(prefix), "10.%d.%d.0/24", i / 256, i % 256);
+    off = tb_bmp_begin(tb, PARSEBGP_BMP_TYPE_ROUTE_MON);
+    tb_bmp_peer_hdr(tb, 0, ip, 65000 + i % 5);
+    tb_simple_update(tb, 1, 65000 + i % 5, prefix);
+    tb_bmp_end(tb, off);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  test_buf_t tb;
+  int ret = 0;
+
+  tb_init(&tb);
+  build_updates(&tb, 2000);
+  ret |= write_file("tool_updates.mrt", &tb);
+
+  tb_reset(&tb);
+  build_ribs(&tb);
+  ret |= write_file("tool_rib.mrt", &tb);
+
+  tb_reset(&tb);
+  build_updates(&tb, 10);
+  ret |= write_file("tool_small.mrt", &tb);
+
+  tb_reset(&tb);
+  build_updates(&tb, 40000);
+  ret |= write_file("tool_large.mrt", &tb);
+
+  // cut the last record short
+  tb_reset(&tb);
+  build_updates(&tb, 500);
+  tb.len -= 10;
+  ret |= write_file("tool_trunc.mrt", &tb);
+
+  tb_reset(&tb);
+  build_bmp(&tb, 1000);
+  ret |= write_file("tool_peers.bmp", &tb);
+
+  tb_free(&tb);
+  return ret ? -1 : 0;
+}
@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Tests for ADD-PATH (RFC 7911 and RFC 8050) NLRI decoding */
+
+/* Check that a decoded prefix is as expected (path_id 0 means that no Path
+   Identifier is expected, in which case the path_id field is not used) */
+static int check_prefix(const parsebgp_bgp_prefix_t *prefix, uint32_t path_id,
+                        const char *expected)
+{
+  char buf[64];
+
+  CHECK(strcmp(test_prefix_str(prefix, buf), expected) == 0);
+  CHECK(prefix->path_id_valid == (path_id != 0));
+  CHECK(path_id == 0 || prefix->path_id == path_id);
+  return 0;
+}
+
+/* Build the path attributes of an UPDATE, with an optional MP_REACH attribute
+   for IPv6 unicast */
+static void build_attrs(test_buf_t *attrs, const test_buf_t *mp_nlri)
+{
+  test_buf_t nh;
+
+  tb_basic_attrs(attrs, 1);
+  if (mp_nlri != NULL) {
+    tb_init(&nh);
+    tb_ip6(&nh, "2001:db8::1");
+    tb_attr_mp_reach(attrs, PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_UNICAST,
+                     &nh, mp_nlri);
+    tb_free(&nh);
+  }
+}
+
+static int test_bgp(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_t *update;
+  test_buf_t withdrawn, attrs, nlri, tb;
+
+  tb_init(&withdrawn);
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&tb);
+  tb_prefix_ap(&withdrawn, 9, "172.16.0.0/12");
+  build_attrs(&attrs, NULL);
+  tb_prefix_ap(&nlri, 1, "10.0.0.0/8");
+  tb_prefix_ap(&nlri, 2, "10.0.0.0/8");
+  tb_prefix_ap(&nlri, 0xffffffff, "192.0.2.0/24");
+  tb_bgp_update(&tb, &withdrawn, &attrs, &nlri);
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.bgp.add_path = PARSEBGP_BGP_ADD_PATH_IPV4_UNICAST;
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->withdrawn_nlris.prefixes_cnt == 1);
+  CHECK(check_prefix(&update->withdrawn_nlris.prefixes[0], 9,
+                     "172.16.0.0/12") == 0);
+  CHECK(update->announced_nlris.prefixes_cnt == 3);
+  CHECK(check_prefix(&update->announced_nlris.prefixes[0], 1, "10.0.0.0/8") ==
+        0);
+  CHECK(check_prefix(&update->announced_nlris.prefixes[1], 2, "10.0.0.0/8") ==
+        0);
+  CHECK(check_prefix(&update->announced_nlris.prefixes[2], 0xffffffff,
+                     "192.0.2.0/24") == 0);
+
+  // the same message without ADD-PATH is not decoded as such
+  tb_reset(&nlri);
+  tb_reset(&tb);
+  tb_prefix(&nlri, "10.0.0.0/8");
+  tb_bgp_update(&tb, NULL, &attrs, &nlri);
+  opts.bgp.add_path = 0;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(check_prefix(&update->announced_nlris.prefixes[0], 0, "10.0.0.0/8") ==
+        0);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&withdrawn);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_per_afi_safi(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_t *update;
+  parsebgp_bgp_update_mp_reach_t *mp_reach;
+  parsebgp_bgp_update_mp_unreach_t *mp_unreach;
+  test_buf_t attrs, nlri, mp_nlri, mp_withdrawn, tb;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&mp_nlri);
+  tb_init(&mp_withdrawn);
+  tb_init(&tb);
+  tb_prefix_ap(&mp_nlri, 5, "2001:db8::/32");
+  tb_prefix_ap(&mp_withdrawn, 6, "2001:db8:1::/48");
+  build_attrs(&attrs, &mp_nlri);
+  tb_attr_mp_unreach(&attrs, PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_UNICAST,
+                     &mp_withdrawn);
+  tb_prefix(&nlri, "10.0.0.0/8");
+  tb_bgp_update(&tb, NULL, &attrs, &nlri);
+
+  // only the IPv6 unicast NLRI carry Path Identifiers
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.bgp.add_path = PARSEBGP_BGP_ADD_PATH_IPV6_UNICAST;
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(check_prefix(&update->announced_nlris.prefixes[0], 0, "10.0.0.0/8") ==
+        0);
+  mp_reach = update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI]
+               .data.mp_reach;
+  CHECK(mp_reach->nlris_cnt == 1);
+  CHECK(check_prefix(&mp_reach->nlris[0], 5, "2001:db8::/32") == 0);
+  mp_unreach =
+    update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI]
+      .data.mp_unreach;
+  CHECK(mp_unreach->withdrawn_nlris_cnt == 1);
+  CHECK(check_prefix(&mp_unreach->withdrawn_nlris[0], 6, "2001:db8:1::/48") ==
+        0);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&mp_nlri);
+  tb_free(&mp_withdrawn);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_invalid(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  test_buf_t attrs, nlri, tb;
+  size_t len;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&tb);
+  build_attrs(&attrs, NULL);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.bgp.add_path = PARSEBGP_BGP_ADD_PATH_ALL;
+
+  // a prefix that is too long for its AFI
+  tb_u32(&nlri, 1);
+  tb_u8(&nlri, 33);
+  tb_u32(&nlri, 0x0a000000);
+  tb_u8(&nlri, 0);
+  tb_bgp_update(&tb, NULL, &attrs, &nlri);
+  len = tb.len;
+  CHECK_ERR(PARSEBGP_INVALID_MSG,
+            parsebgp_decode(opts, PARSEBGP_MSG_TYPE_BGP, msg, tb.buf, &len));
+  len = tb.len;
+  CHECK_ERR(PARSEBGP_INVALID_MSG,
+            parsebgp_validate(opts, PARSEBGP_MSG_TYPE_BGP, tb.buf, &len, NULL));
+
+  // a Path Identifier that is cut short by the end of the message
+  tb_reset(&nlri);
+  tb_reset(&tb);
+  tb_prefix_ap(&nlri, 1, "10.0.0.0/8");
+  tb_u16(&nlri, 0);
+  tb_u8(&nlri, 0);
+  tb_bgp_update(&tb, NULL, &attrs, &nlri);
+  parsebgp_clear_msg(msg);
+  len = tb.len;
+  CHECK(parsebgp_decode(opts, PARSEBGP_MSG_TYPE_BGP, msg, tb.buf, &len) !=
+        PARSEBGP_OK);
+  len = tb.len;
+  CHECK(parsebgp_validate(opts, PARSEBGP_MSG_TYPE_BGP, tb.buf, &len, NULL) !=
+        PARSEBGP_OK);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_mrt_subtypes(void)
+{
+  const char *ips[] = {"192.0.2.1"};
+  uint32_t asns[] = {65001};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib;
+  parsebgp_bgp_update_t *update;
+  test_buf_t attrs, nlri, tb;
+  size_t off;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&tb);
+  build_attrs(&attrs, NULL);
+  parsebgp_opts_init(&opts);
+
+  // BGP4MP (the option is not needed)
+  tb_prefix_ap(&nlri, 3, "10.0.0.0/8");
+  off = tb_bgp4mp_begin(&tb, 0, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_ADDPATH, 65001,
+                        "192.0.2.1");
+  tb_bgp_update(&tb, NULL, &attrs, &nlri);
+  tb_mrt_end(&tb, off);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(check_prefix(&update->announced_nlris.prefixes[0], 3, "10.0.0.0/8") ==
+        0);
+
+  // TABLE_DUMP_V2 (several paths from the same peer)
+  tb_reset(&tb);
+  tb_peer_index(&tb, 1, ips, asns);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  tb_reset(&tb);
+  off = tb_rib_begin(&tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH,
+                     0, "10.0.0.0/8", 2);
+  tb_rib_entry(&tb, 0, 1, 11, &attrs);
+  tb_rib_entry(&tb, 0, 1, 12, &attrs);
+  tb_mrt_end(&tb, off);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((rib = test_rib(msg)) != NULL);
+  CHECK(rib->entry_count == 2);
+  CHECK(rib->entries[0].peer_index == 0 && rib->entries[0].path_id == 11);
+  CHECK(rib->entries[1].peer_index == 0 && rib->entries[1].path_id == 12);
+
+  // and the plain subtype has no Path Identifiers
+  tb_reset(&tb);
+  off = tb_rib_begin(&tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST, 0,
+                     "10.0.0.0/8", 1);
+  tb_rib_entry(&tb, 0, 0, 0, &attrs);
+  tb_mrt_end(&tb, off);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((rib = test_rib(msg)) != NULL);
+  CHECK(rib->entry_count == 1 && rib->entries[0].path_id == 0);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_session_direction(void)
+{
+  parsebgp_session_table_t *sessions;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_t *update;
+  test_buf_t attrs, nlri, tb;
+  size_t off;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&tb);
+  build_attrs(&attrs, NULL);
+  tb_prefix_ap(&nlri, 4, "10.0.0.0/8");
+  CHECK((sessions = parsebgp_session_table_create()) != NULL);
+  parsebgp_opts_init(&opts);
+  opts.sessions = sessions;
+
+  // the local speaker can only receive, and the peer can only send
+  off = tb_bgp4mp_begin(&tb, 0, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL, 65001,
+                        "192.0.2.1");
+  tb_bgp_open(&tb, 65000, 1, 1);
+  tb_mrt_end(&tb, off);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  tb_reset(&tb);
+  off = tb_bgp4mp_begin(&tb, 0, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4, 65001,
+                        "192.0.2.1");
+  tb_bgp_open(&tb, 65001, 1, 2);
+  tb_mrt_end(&tb, off);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+
+  // so UPDATEs from the peer carry Path Identifiers
+  tb_reset(&tb);
+  off = tb_bgp4mp_begin(&tb, 0, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4, 65001,
+                        "192.0.2.1");
+  tb_bgp_update(&tb, NULL, &attrs, &nlri);
+  tb_mrt_end(&tb, off);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(check_prefix(&update->announced_nlris.prefixes[0], 4, "10.0.0.0/8") ==
+        0);
+
+  // but those from the local speaker do not
+  tb_reset(&nlri);
+  tb_reset(&tb);
+  tb_prefix(&nlri, "10.0.0.0/8");
+  off = tb_bgp4mp_begin(&tb, 0, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL, 65001,
+                        "192.0.2.1");
+  tb_bgp_update(&tb, NULL, &attrs, &nlri);
+  tb_mrt_end(&tb, off);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(check_prefix(&update->announced_nlris.prefixes[0], 0, "10.0.0.0/8") ==
+        0);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_session_table_destroy(sessions);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_bgp),
+    TEST(test_per_afi_safi),
+    TEST(test_invalid),
+    TEST(test_mrt_subtypes),
+    TEST(test_session_direction),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
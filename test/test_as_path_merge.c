@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Tests for merging AS4_PATH into AS_PATH (RFC 6793 section 4.2.3) */
+
+/* Paths are written as space-separated segments, each a segment type
+   ("seq", "set", "cseq" or "cset") followed by a colon and a comma-separated
+   list of ASNs, e.g., "seq:65001,23456 set:1,2" */
+
+static const char *seg_names[] = {NULL, "set", "seq", "cseq", "cset"};
+
+/* Append an AS_PATH (or AS4_PATH) attribute with the given segments */
+static void build_path(test_buf_t *attrs, uint8_t type, int asn_4_byte,
+                       const char *spec)
+{
+  test_buf_t data;
+  const char *p = spec;
+  char *end;
+  size_t cnt_off;
+  int seg_type, cnt;
+  uint32_t asn;
+
+  tb_init(&data);
+  while (*p != '\0') {
+    for (seg_type = 1; strncmp(p, seg_names[seg_type],
+                               strlen(seg_names[seg_type])) != 0 ||
+                       p[strlen(seg_names[seg_type])] != ':';
+         seg_type++)
+      ;
+    p += strlen(seg_names[seg_type]) + 1;
+    tb_u8(&data, seg_type);
+    cnt_off = data.len;
+    tb_u8(&data, 0);
+    cnt = 0;
+    while (*p != ' ' && *p != '\0') {
+      asn = strtoul(p, &end, 10);
+      p = (*end == ',') ? end + 1 : end;
+      if (asn_4_byte) {
+        tb_u32(&data, asn);
+      } else {
+        tb_u16(&data, asn);
+      }
+      cnt++;
+    }
+    data.buf[cnt_off] = cnt;
+    while (*p == ' ') {
+      p++;
+    }
+  }
+  tb_attr(attrs, type == PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH ? 0x40 : 0xC0,
+          type, data.buf, data.len);
+  tb_free(&data);
+}
+
+/* Format a decoded path in the same way */
+static const char *path_str(const parsebgp_bgp_update_as_path_t *path,
+                            char *buf, size_t len)
+{
+  size_t off = 0;
+  int i, j;
+
+  buf[0] = '\0';
+  for (i = 0; i < path->segs_cnt; i++) {
+    off += snprintf(buf + off, len - off, "%s%s:", i > 0 ? " " : "",
+                    seg_names[path->segs[i].type]);
+    for (j = 0; j < path->segs[i].asns_cnt; j++) {
+      off += snprintf(buf + off, len - off, "%s%u", j > 0 ? "," : "",
+                      path->segs[i].asns[j]);
+    }
+  }
+  return buf;
+}
+
+/* Decode an UPDATE with the given attributes (from a 2-byte speaker unless
+   asn_4_byte is set) */
+static int decode_attrs(parsebgp_msg_t *msg, int asn_4_byte, int merge,
+                        const test_buf_t *attrs,
+                        parsebgp_bgp_update_path_attrs_t **path_attrs)
+{
+  parsebgp_opts_t opts;
+  parsebgp_bgp_update_t *update;
+  test_buf_t nlri, tb;
+
+  tb_init(&nlri);
+  tb_init(&tb);
+  tb_prefix(&nlri, "10.0.0.0/8");
+  tb_bgp_update(&tb, NULL, attrs, &nlri);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = asn_4_byte;
+  opts.bgp.asn_4_byte_negotiated = 1;
+  opts.bgp.as_path_merge = merge;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  *path_attrs = &update->path_attrs;
+  tb_free(&nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+/* Check the merged path of an UPDATE with the given AS_PATH and AS4_PATH */
+static int check_merge(const char *as_path, const char *as4_path,
+                       const char *expected, uint32_t origin_asn,
+                       uint32_t first_hop_asn, int path_len)
+{
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_path_attrs_t *path_attrs;
+  parsebgp_bgp_update_as_path_merged_t *merged;
+  test_buf_t attrs;
+  char buf[256];
+
+  tb_init(&attrs);
+  tb_attr_origin(&attrs, 0);
+  build_path(&attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH, 0, as_path);
+  if (as4_path != NULL) {
+    build_path(&attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH, 1, as4_path);
+  }
+  CHECK(decode_attrs(msg, 0, 1, &attrs, &path_attrs) == 0);
+  merged = &path_attrs->as_path_merged;
+  CHECK(merged->valid);
+  if (strcmp(path_str(&merged->path, buf, sizeof(buf)), expected) != 0) {
+    fprintf(stderr, "merged '%s' and '%s' into '%s', expected '%s'\n", as_path,
+            as4_path != NULL ? as4_path : "", buf, expected);
+    return -1;
+  }
+  CHECK(merged->path.asn_4_byte);
+  CHECK(merged->origin_asn == origin_asn);
+  CHECK(merged->first_hop_asn == first_hop_asn);
+  CHECK(merged->path_len == path_len);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&attrs);
+  return 0;
+}
+
+static int test_merge(void)
+{
+  // no AS4_PATH
+  CHECK(check_merge("seq:65001,65002", NULL, "seq:65001,65002", 65002, 65001,
+                    2) == 0);
+  CHECK(check_merge("", NULL, "", 0, 0, 0) == 0);
+
+  // AS_TRANS replaced by the 4-byte ASNs
+  CHECK(check_merge("seq:65001,23456,23456,65003",
+                    "seq:4200000001,4200000002,65003",
+                    "seq:65001,4200000001,4200000002,65003", 65003, 65001,
+                    4) == 0);
+  CHECK(check_merge("seq:23456", "seq:4200000001", "seq:4200000001",
+                    4200000001U, 4200000001U, 1) == 0);
+
+  // an AS4_PATH that is longer than the AS_PATH is ignored
+  CHECK(check_merge("seq:65001,23456", "seq:1,2,4200000001",
+                    "seq:65001,23456", 23456, 65001, 2) == 0);
+
+  // AS_SETs count as one ASN, and a path ending in one has no origin
+  CHECK(check_merge("seq:65001,23456 set:1,2", "seq:4200000001 set:1,2",
+                    "seq:65001,4200000001 set:1,2", 0, 65001, 3) == 0);
+  CHECK(check_merge("set:1,2 seq:65001", NULL, "set:1,2 seq:65001", 65001, 0,
+                    2) == 0);
+
+  // confederation segments are kept from the AS_PATH, are not counted, and
+  // are dropped from the AS4_PATH
+  CHECK(check_merge("cseq:64512 seq:65001,23456", "seq:4200000001",
+                    "cseq:64512 seq:65001,4200000001", 4200000001U, 65001,
+                    2) == 0);
+  CHECK(check_merge("seq:65001,23456", "cseq:64512 seq:4200000001",
+                    "seq:65001,4200000001", 4200000001U, 65001, 2) == 0);
+  return 0;
+}
+
+static int test_aggregator(void)
+{
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_path_attrs_t *path_attrs;
+  uint8_t aggr[6] = {0xfd, 0xe9, 192, 0, 2, 1}; // 65001
+  uint8_t as4_aggr[8] = {0xfa, 0x56, 0xea, 0x01, 192, 0, 2, 1};
+  test_buf_t attrs;
+  char buf[256];
+
+  // a NEW speaker aggregated the route, so its AS4_PATH is ignored
+  tb_init(&attrs);
+  tb_attr_origin(&attrs, 0);
+  build_path(&attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH, 0, "seq:65001,23456");
+  build_path(&attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH, 1,
+             "seq:4200000001");
+  tb_attr(&attrs, 0xC0, PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR, aggr,
+          sizeof(aggr));
+  tb_attr(&attrs, 0xC0, PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_AGGREGATOR, as4_aggr,
+          sizeof(as4_aggr));
+  CHECK(decode_attrs(msg, 0, 1, &attrs, &path_attrs) == 0);
+  CHECK(strcmp(path_str(&path_attrs->as_path_merged.path, buf, sizeof(buf)),
+               "seq:65001,23456") == 0);
+
+  // but not if the AGGREGATOR is AS_TRANS
+  tb_reset(&attrs);
+  aggr[0] = 0x5b;
+  aggr[1] = 0xa0;
+  tb_attr_origin(&attrs, 0);
+  build_path(&attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH, 0, "seq:65001,23456");
+  build_path(&attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH, 1,
+             "seq:4200000001");
+  tb_attr(&attrs, 0xC0, PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR, aggr,
+          sizeof(aggr));
+  tb_attr(&attrs, 0xC0, PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_AGGREGATOR, as4_aggr,
+          sizeof(as4_aggr));
+  CHECK(decode_attrs(msg, 0, 1, &attrs, &path_attrs) == 0);
+  CHECK(strcmp(path_str(&path_attrs->as_path_merged.path, buf, sizeof(buf)),
+               "seq:65001,4200000001") == 0);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&attrs);
+  return 0;
+}
+
+static int test_not_merged(void)
+{
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_path_attrs_t *path_attrs;
+  test_buf_t attrs;
+  char buf[256];
+
+  // a 4-byte AS_PATH is used as is (an AS4_PATH should not be there)
+  tb_init(&attrs);
+  tb_attr_origin(&attrs, 0);
+  build_path(&attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH, 1,
+             "seq:4200000001,23456");
+  build_path(&attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH, 1, "seq:1");
+  CHECK(decode_attrs(msg, 1, 1, &attrs, &path_attrs) == 0);
+  CHECK(path_attrs->as_path_merged.valid);
+  CHECK(strcmp(path_str(&path_attrs->as_path_merged.path, buf, sizeof(buf)),
+               "seq:4200000001,23456") == 0);
+
+  // nothing is merged unless the option is set
+  CHECK(decode_attrs(msg, 1, 0, &attrs, &path_attrs) == 0);
+  CHECK(!path_attrs->as_path_merged.valid);
+
+  // or if there is no AS_PATH (even when the message is reused)
+  CHECK(decode_attrs(msg, 1, 1, &attrs, &path_attrs) == 0);
+  CHECK(path_attrs->as_path_merged.valid);
+  tb_reset(&attrs);
+  tb_attr_origin(&attrs, 0);
+  CHECK(decode_attrs(msg, 1, 1, &attrs, &path_attrs) == 0);
+  CHECK(!path_attrs->as_path_merged.valid);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&attrs);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_merge),
+    TEST(test_aggregator),
+    TEST(test_not_merged),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
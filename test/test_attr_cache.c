@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Tests for the attribute cache */
+
+/* Build an UPDATE for the given prefix, whose attributes differ by the given
+   community */
+static void build_update(test_buf_t *tb, uint32_t comm, const char *prefix)
+{
+  uint32_t path[] = {65001, 65002};
+  test_buf_t attrs, nlri;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_attr_origin(&attrs, 0);
+  tb_attr_as_path(&attrs, 2, 1, path, 2);
+  tb_attr_next_hop(&attrs, "192.0.2.1");
+  tb_attr_communities(&attrs, &comm, 1);
+  tb_prefix(&nlri, prefix);
+  tb_reset(tb);
+  tb_bgp_update(tb, NULL, &attrs, &nlri);
+  tb_free(&attrs);
+  tb_free(&nlri);
+}
+
+/* Check that the decoded UPDATE has the expected community and prefix */
+static int check_update(parsebgp_msg_t *msg, uint32_t comm, const char *prefix)
+{
+  parsebgp_bgp_update_t *update;
+  parsebgp_bgp_update_communities_t *comms;
+  parsebgp_bgp_update_as_path_t *as_path;
+  char buf[64];
+
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->path_attrs.attrs_cnt == 4);
+  as_path =
+    update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH].data.as_path;
+  CHECK(as_path->segs_cnt == 1 && as_path->segs[0].asns_cnt == 2 &&
+        as_path->segs[0].asns[1] == 65002);
+  comms = update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES]
+            .data.communities;
+  CHECK(comms->communities_cnt == 1 && comms->communities[0] == comm);
+  CHECK(update->announced_nlris.prefixes_cnt == 1);
+  CHECK(strcmp(test_prefix_str(&update->announced_nlris.prefixes[0], buf),
+               prefix) == 0);
+  return 0;
+}
+
+/* Decode an UPDATE and check the result */
+static int decode_update(parsebgp_opts_t *opts, parsebgp_msg_t *msg,
+                         uint32_t comm, const char *prefix)
+{
+  test_buf_t tb;
+
+  tb_init(&tb);
+  build_update(&tb, comm, prefix);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  tb_free(&tb);
+  return check_update(msg, comm, prefix);
+}
+
+static int test_hits(void)
+{
+  parsebgp_attr_cache_t *cache;
+  parsebgp_attr_cache_stats_t stats;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg1 = parsebgp_create_msg();
+  parsebgp_msg_t *msg2 = parsebgp_create_msg();
+
+  CHECK((cache = parsebgp_attr_cache_create(16)) != NULL);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.attr_cache = cache;
+
+  // the NLRI are decoded from each message, but the attributes are shared
+  CHECK(decode_update(&opts, msg1, 100, "10.0.0.0/8") == 0);
+  CHECK(decode_update(&opts, msg2, 100, "10.1.0.0/16") == 0);
+  parsebgp_attr_cache_get_stats(cache, &stats);
+  CHECK(stats.lookups == 2 && stats.hits == 1 && stats.inserts == 1);
+  CHECK(stats.bytes_saved > 0);
+  CHECK(check_update(msg1, 100, "10.0.0.0/8") == 0);
+
+  // a message that shared a copy can go back to decoding its own
+  CHECK(decode_update(&opts, msg2, 200, "10.2.0.0/16") == 0);
+  CHECK(decode_update(&opts, msg2, 100, "10.3.0.0/16") == 0);
+  parsebgp_attr_cache_get_stats(cache, &stats);
+  CHECK(stats.lookups == 4 && stats.hits == 2 && stats.inserts == 2);
+
+  // a different configuration does not share the copy
+  opts.bgp.fingerprint = 1;
+  CHECK(decode_update(&opts, msg2, 100, "10.0.0.0/8") == 0);
+  CHECK(test_update(msg2)->path_attrs.fingerprints.valid);
+  parsebgp_attr_cache_get_stats(cache, &stats);
+  CHECK(stats.hits == 2 && stats.inserts == 3);
+
+  // clearing the cache keeps the statistics
+  parsebgp_attr_cache_clear(cache);
+  CHECK(decode_update(&opts, msg2, 100, "10.0.0.0/8") == 0);
+  parsebgp_attr_cache_get_stats(cache, &stats);
+  CHECK(stats.lookups == 6 && stats.hits == 2 && stats.inserts == 4);
+
+  // shared copies outlive the cache
+  CHECK(decode_update(&opts, msg1, 100, "10.0.0.0/8") == 0);
+  parsebgp_attr_cache_destroy(cache);
+  CHECK(check_update(msg1, 100, "10.0.0.0/8") == 0);
+  CHECK(check_update(msg2, 100, "10.0.0.0/8") == 0);
+
+  parsebgp_destroy_msg(msg1);
+  parsebgp_destroy_msg(msg2);
+  return 0;
+}
+
+static int test_eviction(void)
+{
+  parsebgp_attr_cache_t *cache;
+  parsebgp_attr_cache_stats_t stats;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+
+  CHECK((cache = parsebgp_attr_cache_create(2)) != NULL);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.attr_cache = cache;
+
+  CHECK(decode_update(&opts, msg, 1, "10.0.0.0/8") == 0);
+  CHECK(decode_update(&opts, msg, 2, "10.0.0.0/8") == 0);
+  CHECK(decode_update(&opts, msg, 1, "10.0.0.0/8") == 0); // hit
+  CHECK(decode_update(&opts, msg, 3, "10.0.0.0/8") == 0); // evicts 2
+  parsebgp_attr_cache_get_stats(cache, &stats);
+  CHECK(stats.hits == 1 && stats.evictions == 1);
+
+  CHECK(decode_update(&opts, msg, 1, "10.0.0.0/8") == 0); // hit
+  CHECK(decode_update(&opts, msg, 3, "10.0.0.0/8") == 0); // hit
+  CHECK(decode_update(&opts, msg, 2, "10.0.0.0/8") == 0); // evicts 1
+  parsebgp_attr_cache_get_stats(cache, &stats);
+  CHECK(stats.hits == 3 && stats.evictions == 2 && stats.inserts == 4);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_attr_cache_destroy(cache);
+  return 0;
+}
+
+static int test_mp_reach(void)
+{
+  parsebgp_attr_cache_t *cache;
+  parsebgp_attr_cache_stats_t stats;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_t *update;
+  test_buf_t attrs, nh, nlri, tb;
+  int i;
+
+  tb_init(&attrs);
+  tb_init(&nh);
+  tb_init(&nlri);
+  tb_init(&tb);
+  tb_basic_attrs(&attrs, 0);
+  tb_ip6(&nh, "2001:db8::1");
+  tb_prefix(&nlri, "2001:db8::/32");
+  tb_attr_mp_reach(&attrs, PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_UNICAST,
+                   &nh, &nlri);
+  tb_bgp_update(&tb, NULL, &attrs, NULL);
+
+  CHECK((cache = parsebgp_attr_cache_create(16)) != NULL);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.attr_cache = cache;
+
+  // attributes with NLRI are never cached
+  for (i = 0; i < 2; i++) {
+    parsebgp_clear_msg(msg);
+    CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+    CHECK((update = test_update(msg)) != NULL);
+    CHECK(update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI]
+            .data.mp_reach->nlris_cnt == 1);
+  }
+  parsebgp_attr_cache_get_stats(cache, &stats);
+  CHECK(stats.hits == 0 && stats.inserts == 0);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_attr_cache_destroy(cache);
+  tb_free(&attrs);
+  tb_free(&nh);
+  tb_free(&nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_rib_entries(void)
+{
+  uint32_t comm = 100;
+  parsebgp_attr_cache_t *cache;
+  parsebgp_attr_cache_stats_t stats;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib;
+  test_buf_t attrs, nh, tb;
+  size_t off;
+  int i;
+
+  tb_init(&attrs);
+  tb_init(&nh);
+  tb_init(&tb);
+  tb_basic_attrs(&attrs, 0);
+  tb_attr_communities(&attrs, &comm, 1);
+  // TABLE_DUMP_V2 MP_REACH attributes only hold the next hop
+  tb_u8(&attrs, 0x80);
+  tb_u8(&attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI);
+  tb_u8(&attrs, 17);
+  tb_u8(&attrs, 16);
+  tb_ip6(&attrs, "2001:db8::1");
+  off = tb_rib_begin(&tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST, 0,
+                     "2001:db8::/32", 3);
+  for (i = 0; i < 3; i++) {
+    tb_rib_entry(&tb, i, 0, 0, &attrs);
+  }
+  tb_mrt_end(&tb, off);
+
+  CHECK((cache = parsebgp_attr_cache_create(16)) != NULL);
+  parsebgp_opts_init(&opts);
+  opts.attr_cache = cache;
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((rib = test_rib(msg)) != NULL);
+  CHECK(rib->entry_count == 3);
+  for (i = 0; i < 3; i++) {
+    CHECK(rib->entries[i].peer_index == i);
+    CHECK(rib->entries[i].path_attrs.attrs_cnt == 4);
+    CHECK(rib->entries[i]
+            .path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES]
+            .data.communities->communities[0] == comm);
+    CHECK(rib->entries[i]
+            .path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI]
+            .data.mp_reach->next_hop_len == 16);
+  }
+  parsebgp_attr_cache_get_stats(cache, &stats);
+  CHECK(stats.lookups == 3 && stats.hits == 2 && stats.inserts == 1);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_attr_cache_destroy(cache);
+  tb_free(&attrs);
+  tb_free(&nh);
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_hits),
+    TEST(test_eviction),
+    TEST(test_mp_reach),
+    TEST(test_rib_entries),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
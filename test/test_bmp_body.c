@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Tests for finishing header-only BMP decodes (parsebgp_bmp_decode_body) */
+
+#define PEER_IP "192.0.2.1"
+#define PEER_ASN 65001
+
+/* Append a BMP Route Monitoring message holding an UPDATE for the prefix */
+static void build_route_mon(test_buf_t *tb, const char *prefix)
+{
+  size_t off = tb_bmp_begin(tb, PARSEBGP_BMP_TYPE_ROUTE_MON);
+
+  tb_bmp_peer_hdr(tb, 0, PEER_IP, PEER_ASN);
+  tb_simple_update(tb, 1, PEER_ASN, prefix);
+  tb_bmp_end(tb, off);
+}
+
+/* Append a BMP Peer Up message from an IPv6 peer */
+static void build_peer_up_ipv6(test_buf_t *tb)
+{
+  size_t off = tb_bmp_begin(tb, PARSEBGP_BMP_TYPE_PEER_UP);
+
+  tb_u8(tb, 0); // global instance peer
+  tb_u8(tb, PARSEBGP_BMP_PEER_FLAG_IPV6);
+  tb_u64(tb, 0); // distinguisher
+  tb_ip6(tb, "2001:db8::1");
+  tb_u32(tb, PEER_ASN);
+  tb_ip4(tb, PEER_IP); // BGP ID
+  tb_u32(tb, 3000);
+  tb_u32(tb, 0);
+  tb_ip6(tb, "2001:db8::fe");
+  tb_u16(tb, 179);
+  tb_u16(tb, 33000);
+  tb_bgp_open(tb, 65000, 1, 0);
+  tb_bgp_open(tb, PEER_ASN, 1, 0);
+  tb_bmp_end(tb, off);
+}
+
+/* Decode only the headers of the BMP message in tb */
+static int decode_headers(parsebgp_opts_t *opts, parsebgp_msg_t *msg,
+                          const test_buf_t *tb)
+{
+  opts->bmp.parse_headers_only = 1;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(opts, PARSEBGP_MSG_TYPE_BMP, msg, tb));
+  CHECK(!msg->types.bmp->types_valid);
+  CHECK(msg->types.bmp->len == tb->len);
+  return 0;
+}
+
+/* Finish decoding the BMP message in tb, giving only the first body_len bytes
+   of its body */
+static parsebgp_error_t decode_body(parsebgp_opts_t *opts, parsebgp_msg_t *msg,
+                                    const test_buf_t *tb, size_t body_len)
+{
+  parsebgp_bmp_msg_t *bmp = msg->types.bmp;
+  size_t len = body_len;
+  parsebgp_error_t err;
+
+  if ((err = parsebgp_bmp_decode_body(opts, bmp, tb->buf + bmp->hdr_len,
+                                      &len)) != PARSEBGP_OK &&
+      err != PARSEBGP_FILTERED_OUT) {
+    return err;
+  }
+  // the whole body is used, even if it is filtered out
+  return len == tb->len - bmp->hdr_len ? err : PARSEBGP_INVALID_MSG;
+}
+
+static int test_route_mon(void)
+{
+  parsebgp_opts_t io_opts, worker_opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_t *update;
+  test_buf_t tb;
+  char buf[64];
+
+  tb_init(&tb);
+  build_route_mon(&tb, "10.0.0.0/8");
+  parsebgp_opts_init(&io_opts);
+  parsebgp_opts_init(&worker_opts);
+
+  // the headers are enough to find the peer
+  CHECK(decode_headers(&io_opts, msg, &tb) == 0);
+  CHECK(msg->types.bmp->type == PARSEBGP_BMP_TYPE_ROUTE_MON);
+  CHECK(msg->types.bmp->hdr_len == 6 + 42);
+  CHECK(msg->types.bmp->peer_hdr.asn == PEER_ASN);
+  CHECK(test_update(msg) == NULL);
+
+  // and the body can be decoded later with other options
+  CHECK_ERR(PARSEBGP_OK, decode_body(&worker_opts, msg, &tb,
+                                     tb.len - msg->types.bmp->hdr_len));
+  CHECK(msg->types.bmp->types_valid);
+  CHECK(msg->types.bmp->peer_hdr.asn == PEER_ASN);
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->announced_nlris.prefixes_cnt == 1);
+  CHECK(strcmp(test_prefix_str(&update->announced_nlris.prefixes[0], buf),
+               "10.0.0.0/8") == 0);
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+static int test_peer_afi(void)
+{
+  static const uint8_t local_ip[16] = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+                                       0,    0,    0,    0,    0, 0, 0, 0xfe};
+  parsebgp_opts_t io_opts, worker_opts;
+  parsebgp_msg_t *msg1 = parsebgp_create_msg();
+  parsebgp_msg_t *msg2 = parsebgp_create_msg();
+  parsebgp_bmp_peer_up_t *peer_up;
+  test_buf_t tb1, tb2;
+
+  tb_init(&tb1);
+  tb_init(&tb2);
+  build_peer_up_ipv6(&tb1);
+  build_route_mon(&tb2, "10.0.0.0/8");
+  parsebgp_opts_init(&io_opts);
+  parsebgp_opts_init(&worker_opts);
+
+  // the options are left with the address family of the last (IPv4) peer, but
+  // the body of the Peer Up is decoded using that of its own (IPv6) peer
+  CHECK(decode_headers(&io_opts, msg1, &tb1) == 0);
+  CHECK(decode_headers(&io_opts, msg2, &tb2) == 0);
+  CHECK(msg1->types.bmp->peer_hdr.afi == PARSEBGP_BGP_AFI_IPV6);
+  CHECK_ERR(PARSEBGP_OK, decode_body(&worker_opts, msg1, &tb1,
+                                     tb1.len - msg1->types.bmp->hdr_len));
+  peer_up = msg1->types.bmp->types.peer_up;
+  CHECK(peer_up->local_ip_afi == PARSEBGP_BGP_AFI_IPV6);
+  CHECK(memcmp(peer_up->local_ip, local_ip, sizeof(local_ip)) == 0);
+  CHECK(peer_up->local_port == 179 && peer_up->remote_port == 33000);
+  CHECK(peer_up->recv_open->types.open->asn == PEER_ASN);
+
+  CHECK_ERR(PARSEBGP_OK, decode_body(&worker_opts, msg2, &tb2,
+                                     tb2.len - msg2->types.bmp->hdr_len));
+  CHECK(test_update(msg2) != NULL);
+
+  tb_free(&tb1);
+  tb_free(&tb2);
+  parsebgp_destroy_msg(msg1);
+  parsebgp_destroy_msg(msg2);
+  return 0;
+}
+
+static int test_errors(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  size_t body_len;
+  test_buf_t tb;
+
+  tb_init(&tb);
+  build_route_mon(&tb, "10.0.0.0/8");
+  parsebgp_opts_init(&opts);
+
+  // only a header-only message can be resumed
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BMP, msg, &tb));
+  CHECK(msg->types.bmp->types_valid);
+  CHECK_ERR(PARSEBGP_INVALID_MSG,
+            decode_body(&opts, msg, &tb, tb.len - msg->types.bmp->hdr_len));
+
+  // a truncated body can be retried once the rest is available
+  CHECK(decode_headers(&opts, msg, &tb) == 0);
+  opts.bmp.parse_headers_only = 0;
+  body_len = tb.len - msg->types.bmp->hdr_len;
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG, decode_body(&opts, msg, &tb, body_len - 1));
+  CHECK(!msg->types.bmp->types_valid);
+  CHECK_ERR(PARSEBGP_OK, decode_body(&opts, msg, &tb, body_len));
+  CHECK(test_update(msg) != NULL);
+
+  // parse_headers_only is ignored when resuming
+  CHECK(decode_headers(&opts, msg, &tb) == 0);
+  CHECK_ERR(PARSEBGP_OK, decode_body(&opts, msg, &tb, body_len));
+  CHECK(msg->types.bmp->types_valid);
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+static int test_filter(void)
+{
+  static const struct {
+    const char *expr;
+    parsebgp_error_t err;
+  } cases[] = {
+    {"peer-asn 65001", PARSEBGP_OK},
+    {"peer-asn 65002", PARSEBGP_FILTERED_OUT},
+    {"prefix 10.0.0.0/8", PARSEBGP_OK},
+    {"prefix 192.168.0.0/16", PARSEBGP_FILTERED_OUT},
+  };
+  parsebgp_opts_t io_opts, worker_opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_filter_t *filter;
+  test_buf_t tb;
+  unsigned int i;
+
+  tb_init(&tb);
+  build_route_mon(&tb, "10.0.0.0/8");
+  parsebgp_opts_init(&io_opts);
+
+  // the filter of the options used to resume is applied to both the (already
+  // decoded) headers and the body
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    CHECK((filter = parsebgp_filter_create(cases[i].expr)) != NULL);
+    parsebgp_opts_init(&worker_opts);
+    worker_opts.filter = filter;
+    CHECK(decode_headers(&io_opts, msg, &tb) == 0);
+    CHECK_ERR(cases[i].err, decode_body(&worker_opts, msg, &tb,
+                                        tb.len - msg->types.bmp->hdr_len));
+    parsebgp_filter_destroy(filter);
+  }
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_route_mon),
+    TEST(test_peer_afi),
+    TEST(test_errors),
+    TEST(test_filter),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
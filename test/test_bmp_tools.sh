@@ -0,0 +1,147 @@
+#
+# Copyright (C) 2017 The Regents of the University of California.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+#
+# Replay BMP messages (and MRT updates wrapped in BMP) with parsebgp-bmpreplay
+# to parsebgp-bmpd on localhost, and check that the collector decodes and
+# archives all of them, and that the replay tool sends them as asked.
+#
+
+if [ ! -x ../tools/parsebgp-bmpd ]; then
+    echo "parsebgp-bmpd was not built"
+    exit 77
+fi
+
+./make_tool_input || exit 1
+rm -rf tools_archive
+mkdir tools_archive || exit 1
+
+# start the collector on a free port, waiting until it is listening
+start_bmpd() {
+    tries=0
+    while [ $tries -lt 10 ]; do
+        port=$(( 20000 + ($$ + tries * 997) % 30000 ))
+        ../tools/parsebgp-bmpd -l 127.0.0.1 -p $port "$@" \
+            > tools_bmpd.out 2>&1 &
+        bmpd=$!
+        waited=0
+        while [ $waited -lt 50 ]; do
+            if grep -q '^INFO: Listening' tools_bmpd.out; then
+                return 0
+            fi
+            if ! kill -0 $bmpd 2>/dev/null; then
+                break
+            fi
+            sleep 0.1
+            waited=$((waited + 1))
+        done
+        kill $bmpd 2>/dev/null
+        wait $bmpd
+        tries=$((tries + 1))
+    done
+    echo "could not start parsebgp-bmpd:"
+    cat tools_bmpd.out
+    return 1
+}
+
+# wait for the collector to exit once the sessions close (killing it if it
+# does not)
+wait_bmpd() {
+    (sleep 30; kill $bmpd 2>/dev/null) &
+    watchdog=$!
+    wait $bmpd
+    ret=$?
+    kill $watchdog 2>/dev/null
+    return $ret
+}
+
+fail() {
+    echo "$1"
+    echo "--- parsebgp-bmpd:"
+    cat tools_bmpd.out
+    exit 1
+}
+
+# 3 sessions, each sending the 1000 BMP messages and the 2000 BGP4MP updates
+# twice
+start_bmpd -t 2 -n 3 -w tools_archive || exit 1
+../tools/parsebgp-bmpreplay -H 127.0.0.1 -p $port -c 3 -l 2 \
+    tool_peers.bmp tool_updates.mrt > tools_replay.out 2>&1 ||
+    fail "parsebgp-bmpreplay failed: $(cat tools_replay.out)"
+wait_bmpd || fail "parsebgp-bmpd failed"
+
+grep -q '^INFO: 3 sessions: 18000 messages, .* 0 errors' tools_bmpd.out ||
+    fail "parsebgp-bmpd did not decode all the messages"
+if [ "$(grep -c '^INFO: Closed .*: 6000 messages (6000 route monitoring' \
+        tools_bmpd.out)" != 3 ]; then
+    fail "parsebgp-bmpd did not report each session"
+fi
+
+# the archives hold the messages that were sent
+for f in tools_archive/*.bmp; do
+    ../tools/parsebgp -q "bmp:$f" 2>&1 |
+        grep -q "^INFO: Read 6000 messages" ||
+        fail "$f does not hold the messages that were sent"
+done
+if [ "$(ls tools_archive | wc -l)" != 3 ]; then
+    fail "parsebgp-bmpd did not archive each session"
+fi
+
+# MRT updates are wrapped in Route Monitoring messages that decode to the same
+# routes, and are sent at the given rate
+rm -f tools_archive/*
+start_bmpd -n 1 -w tools_archive || exit 1
+../tools/parsebgp-bmpreplay -H 127.0.0.1 -p $port -r 4000 tool_updates.mrt \
+    > tools_replay.out 2>&1 ||
+    fail "parsebgp-bmpreplay failed: $(cat tools_replay.out)"
+wait_bmpd || fail "parsebgp-bmpd failed"
+
+../tools/parsebgp -E tool_updates.mrt > tools_mrt.out 2>/dev/null
+../tools/parsebgp -E "bmp:$(ls tools_archive/*.bmp)" > tools_bmp.out \
+    2>/dev/null
+cmp -s tools_mrt.out tools_bmp.out ||
+    fail "wrapped updates differ: $(diff tools_mrt.out tools_bmp.out | head)"
+secs=$(sed -n 's/^INFO: Done: .* in \([0-9.]*\)s .*/\1/p' tools_replay.out)
+if ! awk -v secs="$secs" 'BEGIN { exit !(secs >= 0.4) }'; then
+    fail "2000 messages at 4000 msgs/s took ${secs}s: $(cat tools_replay.out)"
+fi
+
+# looping sessions stop after the given time, and the collector decodes all
+# the messages that they sent
+start_bmpd -n 2 || exit 1
+../tools/parsebgp-bmpreplay -H 127.0.0.1 -p $port -c 2 -t 2 -l 0 -d 1 \
+    -r 20000 tool_peers.bmp > tools_replay.out 2>&1 ||
+    fail "parsebgp-bmpreplay failed: $(cat tools_replay.out)"
+wait_bmpd || fail "parsebgp-bmpd failed"
+
+sent=$(sed -n 's/^INFO: Done: sent \([0-9]*\) messages.*/\1/p' tools_replay.out)
+if [ -z "$sent" ] || [ "$sent" -le 2000 ]; then
+    fail "looping sessions did not loop: $(cat tools_replay.out)"
+fi
+grep -q "^INFO: 2 sessions: $sent messages, .* 0 errors" tools_bmpd.out ||
+    fail "parsebgp-bmpd did not decode the $sent messages sent"
+
+rm -rf tools_archive
+exit 0
@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Copyright (C) 2017 The Regents of the University of California.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Decode the same mutated messages with the library and with a copy of it built
+# with PARSEBGP_CHECKED_READS (see fuzz_decode.c), and check that the results
+# are identical.
+#
+
+# the output is large, so only compare checksums unless there is a difference
+unchecked=$(./fuzz_unchecked 2>/dev/null | cksum) || exit 1
+checked=$(./fuzz_checked 2>/dev/null | cksum) || exit 1
+if [ "$unchecked" != "$checked" ]; then
+    echo "checked and unchecked reads decoded differently:"
+    ./fuzz_unchecked > fuzz_unchecked.out 2>/dev/null
+    ./fuzz_checked > fuzz_checked.out 2>/dev/null
+    diff fuzz_unchecked.out fuzz_checked.out | head -20
+    exit 1
+fi
+exit 0
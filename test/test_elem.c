@@ -0,0 +1,393 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <arpa/inet.h>
+#include <string.h>
+
+/* Tests for the route element iterator */
+
+#define PEER_IP "192.0.2.1"
+#define PEER_ASN 65001
+
+/* Format the given address (or "-" if there is none) */
+static const char *addr_str(parsebgp_bgp_afi_t afi, const uint8_t *addr,
+                            char *buf)
+{
+  if (addr == NULL) {
+    return "-";
+  }
+  return inet_ntop(afi == PARSEBGP_BGP_AFI_IPV6 ? AF_INET6 : AF_INET, addr,
+                   buf, INET6_ADDRSTRLEN);
+}
+
+/* Check that the element has the given type, prefix and next hop (NULL if
+   there should be none) */
+static int check_elem(const parsebgp_elem_t *elem, parsebgp_elem_type_t type,
+                      const char *prefix, const char *next_hop)
+{
+  char buf[64];
+
+  CHECK(elem != NULL);
+  CHECK(elem->type == type);
+  CHECK(elem->prefix != NULL);
+  CHECK(strcmp(test_prefix_str(elem->prefix, buf), prefix) == 0);
+  if (next_hop == NULL) {
+    CHECK(elem->next_hop == NULL && elem->path_attrs == NULL);
+  } else {
+    CHECK(elem->path_attrs != NULL);
+    CHECK(strcmp(addr_str(elem->next_hop_afi, elem->next_hop, buf),
+                 next_hop) == 0);
+  }
+  return 0;
+}
+
+/* Check the peer and time of the given element */
+static int check_peer(const parsebgp_elem_t *elem, const char *peer_ip,
+                      uint32_t peer_asn, uint32_t timestamp)
+{
+  char buf[INET6_ADDRSTRLEN];
+
+  CHECK(elem->timestamp_sec == timestamp && elem->timestamp_usec == 0);
+  if (peer_ip == NULL) {
+    CHECK(elem->peer_ip == NULL && elem->peer_afi == 0);
+  } else {
+    CHECK(elem->peer_afi == PARSEBGP_BGP_AFI_IPV4);
+    CHECK(strcmp(addr_str(elem->peer_afi, elem->peer_ip, buf), peer_ip) == 0);
+  }
+  CHECK(elem->peer_asn == peer_asn);
+  return 0;
+}
+
+/* Build the body of an UPDATE with NLRI in all four fields */
+static void build_update(test_buf_t *tb)
+{
+  uint32_t asn = PEER_ASN;
+  test_buf_t attrs, wd, nlri, mp_wd, mp_nlri, nh;
+
+  tb_init(&attrs);
+  tb_init(&wd);
+  tb_init(&nlri);
+  tb_init(&mp_wd);
+  tb_init(&mp_nlri);
+  tb_init(&nh);
+  tb_prefix(&wd, "10.1.0.0/16");
+  tb_prefix(&wd, "10.2.0.0/16");
+  tb_prefix(&mp_wd, "2001:db8:1::/48");
+  tb_prefix(&nlri, "10.3.0.0/16");
+  tb_prefix(&mp_nlri, "2001:db8:2::/48");
+  tb_prefix(&mp_nlri, "2001:db8:3::/48");
+  tb_ip6(&nh, "2001:db8::1");
+  tb_attr_origin(&attrs, 0);
+  tb_attr_as_path(&attrs, 2, 1, &asn, 1);
+  tb_attr_next_hop(&attrs, PEER_IP);
+  tb_attr_mp_reach(&attrs, PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_UNICAST,
+                   &nh, &mp_nlri);
+  tb_attr_mp_unreach(&attrs, PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_UNICAST,
+                     &mp_wd);
+  tb_bgp_update(tb, &wd, &attrs, &nlri);
+  tb_free(&attrs);
+  tb_free(&wd);
+  tb_free(&nlri);
+  tb_free(&mp_wd);
+  tb_free(&mp_nlri);
+  tb_free(&nh);
+}
+
+/* Check the elements of the UPDATE built by build_update */
+static int check_update(parsebgp_msg_t *msg, const char *peer_ip,
+                        uint32_t peer_asn, uint32_t timestamp)
+{
+  const parsebgp_bgp_update_path_attrs_t *path_attrs;
+  const parsebgp_elem_t *elem;
+  parsebgp_elem_iter_t iter;
+
+  parsebgp_elem_iter_init(&iter, msg, NULL);
+  elem = parsebgp_elem_iter_next(&iter);
+  CHECK(check_elem(elem, PARSEBGP_ELEM_TYPE_WITHDRAWAL,
+                   "10.1.0.0/16", NULL) == 0);
+  CHECK(check_peer(elem, peer_ip, peer_asn, timestamp) == 0);
+  elem = parsebgp_elem_iter_next(&iter);
+  CHECK(check_elem(elem, PARSEBGP_ELEM_TYPE_WITHDRAWAL,
+                   "10.2.0.0/16", NULL) == 0);
+  elem = parsebgp_elem_iter_next(&iter);
+  CHECK(check_elem(elem, PARSEBGP_ELEM_TYPE_WITHDRAWAL,
+                   "2001:db8:1::/48", NULL) == 0);
+  elem = parsebgp_elem_iter_next(&iter);
+  CHECK(check_elem(elem, PARSEBGP_ELEM_TYPE_ANNOUNCEMENT,
+                   "10.3.0.0/16", PEER_IP) == 0);
+  path_attrs = elem->path_attrs;
+  CHECK(path_attrs == &test_update(msg)->path_attrs);
+  elem = parsebgp_elem_iter_next(&iter);
+  CHECK(check_elem(elem, PARSEBGP_ELEM_TYPE_ANNOUNCEMENT,
+                   "2001:db8:2::/48", "2001:db8::1") == 0);
+  elem = parsebgp_elem_iter_next(&iter);
+  CHECK(check_elem(elem, PARSEBGP_ELEM_TYPE_ANNOUNCEMENT,
+                   "2001:db8:3::/48", "2001:db8::1") == 0);
+  CHECK(elem->path_attrs == path_attrs);
+  CHECK(check_peer(elem, peer_ip, peer_asn, timestamp) == 0);
+  CHECK(parsebgp_elem_iter_next(&iter) == NULL);
+  CHECK(parsebgp_elem_iter_next(&iter) == NULL);
+  return 0;
+}
+
+static int test_bgp(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_elem_iter_t iter;
+  test_buf_t tb;
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  tb_init(&tb);
+
+  // a bare UPDATE has no peer or time
+  build_update(&tb);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK(check_update(msg, NULL, 0, 0) == 0);
+
+  // other messages have no elements
+  tb_reset(&tb);
+  tb_bgp_open(&tb, PEER_ASN, 1, 0);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  parsebgp_elem_iter_init(&iter, msg, NULL);
+  CHECK(parsebgp_elem_iter_next(&iter) == NULL);
+
+  // nor does an empty UPDATE
+  tb_reset(&tb);
+  tb_bgp_update(&tb, NULL, NULL, NULL);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  parsebgp_elem_iter_init(&iter, msg, NULL);
+  CHECK(parsebgp_elem_iter_next(&iter) == NULL);
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+static int test_bgp4mp(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_elem_iter_t iter;
+  const parsebgp_elem_t *elem;
+  test_buf_t tb;
+  size_t off;
+
+  parsebgp_opts_init(&opts);
+  tb_init(&tb);
+
+  off = tb_bgp4mp_begin(&tb, 2000, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4, PEER_ASN,
+                        PEER_IP);
+  build_update(&tb);
+  tb_mrt_end(&tb, off);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(check_update(msg, PEER_IP, PEER_ASN, 2000) == 0);
+
+  tb_reset(&tb);
+  off = tb_bgp4mp_begin(&tb, 2001, PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4,
+                        PEER_ASN, PEER_IP);
+  tb_u16(&tb, PARSEBGP_MRT_FSM_CODE_OPENCONFIRM);
+  tb_u16(&tb, PARSEBGP_MRT_FSM_CODE_ESTABLISHED);
+  tb_mrt_end(&tb, off);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  parsebgp_elem_iter_init(&iter, msg, NULL);
+  CHECK((elem = parsebgp_elem_iter_next(&iter)) != NULL);
+  CHECK(elem->type == PARSEBGP_ELEM_TYPE_PEER_STATE);
+  CHECK(elem->old_state == PARSEBGP_MRT_FSM_CODE_OPENCONFIRM &&
+        elem->new_state == PARSEBGP_MRT_FSM_CODE_ESTABLISHED);
+  CHECK(elem->prefix == NULL && elem->path_attrs == NULL);
+  CHECK(check_peer(elem, PEER_IP, PEER_ASN, 2001) == 0);
+  CHECK(parsebgp_elem_iter_next(&iter) == NULL);
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+/* Build a RIB record with entries for the given peer indexes */
+static void build_rib(test_buf_t *tb, uint16_t subtype, const char *prefix,
+                      const uint16_t *peers, int peers_cnt)
+{
+  uint32_t asn = PEER_ASN;
+  test_buf_t attrs;
+  size_t off;
+  int i;
+
+  tb_init(&attrs);
+  tb_attr_origin(&attrs, 0);
+  tb_attr_as_path(&attrs, 2, 1, &asn, 1);
+  tb_attr_next_hop(&attrs, PEER_IP);
+  tb_reset(tb);
+  off = tb_rib_begin(tb, subtype, 0, prefix, peers_cnt);
+  for (i = 0; i < peers_cnt; i++) {
+    tb_rib_entry(tb, peers[i],
+                 subtype >= PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH,
+                 100 + i, &attrs);
+  }
+  tb_mrt_end(tb, off);
+  tb_free(&attrs);
+}
+
+static int test_table_dump_v2(void)
+{
+  static const char *ips1[] = {"192.0.2.1", "192.0.2.2"};
+  static const uint32_t asns1[] = {65001, 65002};
+  static const char *ips2[] = {"198.51.100.1"};
+  static const uint32_t asns2[] = {65100};
+  static const uint16_t peers[] = {1, 0, 7};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_msg_t *pi_msg = parsebgp_create_msg();
+  parsebgp_elem_iter_t iter;
+  const parsebgp_elem_t *elem;
+  test_buf_t tb;
+  int i;
+
+  parsebgp_opts_init(&opts);
+  tb_init(&tb);
+
+  // the peers are looked up in the table decoded into the same message, which
+  // survives clearing the message
+  tb_peer_index(&tb, 2, ips1, asns1);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  parsebgp_elem_iter_init(&iter, msg, NULL);
+  CHECK(parsebgp_elem_iter_next(&iter) == NULL);
+  build_rib(&tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST, "10.0.0.0/8",
+            peers, 3);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  parsebgp_elem_iter_init(&iter, msg, NULL);
+  for (i = 0; i < 3; i++) {
+    elem = parsebgp_elem_iter_next(&iter);
+    CHECK(check_elem(elem, PARSEBGP_ELEM_TYPE_RIB, "10.0.0.0/8", PEER_IP) == 0);
+    CHECK(elem->path_attrs == &test_rib(msg)->entries[i].path_attrs);
+    CHECK(!elem->prefix->path_id_valid);
+    if (peers[i] < 2) {
+      CHECK(check_peer(elem, ips1[peers[i]], asns1[peers[i]], 1000) == 0);
+    } else {
+      // an unknown peer index gives no peer
+      CHECK(check_peer(elem, NULL, 0, 1000) == 0);
+    }
+  }
+  CHECK(parsebgp_elem_iter_next(&iter) == NULL);
+
+  // an explicit table is used instead of the one in the message
+  tb_reset(&tb);
+  tb_peer_index(&tb, 1, ips2, asns2);
+  CHECK_ERR(PARSEBGP_OK,
+            test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, pi_msg, &tb));
+  parsebgp_elem_iter_init(
+    &iter, msg, &pi_msg->types.mrt->types.table_dump_v2->peer_index);
+  CHECK((elem = parsebgp_elem_iter_next(&iter)) != NULL);
+  CHECK(check_peer(elem, NULL, 0, 1000) == 0);
+  CHECK((elem = parsebgp_elem_iter_next(&iter)) != NULL);
+  CHECK(check_peer(elem, ips2[0], asns2[0], 1000) == 0);
+
+  // ADD-PATH RIBs give the Path Identifier of each entry
+  build_rib(&tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH,
+            "2001:db8::/32", peers, 2);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  parsebgp_elem_iter_init(&iter, msg, NULL);
+  for (i = 0; i < 2; i++) {
+    elem = parsebgp_elem_iter_next(&iter);
+    CHECK(check_elem(elem, PARSEBGP_ELEM_TYPE_RIB,
+                     "2001:db8::/32", PEER_IP) == 0);
+    CHECK(elem->prefix->path_id_valid && elem->prefix->path_id == 100 + i);
+    CHECK(check_peer(elem, ips1[peers[i]], asns1[peers[i]], 1000) == 0);
+  }
+  CHECK(parsebgp_elem_iter_next(&iter) == NULL);
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  parsebgp_destroy_msg(pi_msg);
+  return 0;
+}
+
+static int test_bmp(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_elem_iter_t iter;
+  const parsebgp_elem_t *elem;
+  test_buf_t tb;
+  size_t off;
+
+  parsebgp_opts_init(&opts);
+  tb_init(&tb);
+
+  off = tb_bmp_begin(&tb, PARSEBGP_BMP_TYPE_ROUTE_MON);
+  tb_bmp_peer_hdr(&tb, 0, PEER_IP, PEER_ASN);
+  build_update(&tb);
+  tb_bmp_end(&tb, off);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BMP, msg, &tb));
+  CHECK(check_update(msg, PEER_IP, PEER_ASN, 3000) == 0);
+
+  // a header-only message has no elements
+  opts.bmp.parse_headers_only = 1;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BMP, msg, &tb));
+  parsebgp_elem_iter_init(&iter, msg, NULL);
+  CHECK(parsebgp_elem_iter_next(&iter) == NULL);
+  opts.bmp.parse_headers_only = 0;
+
+  // Peer Down is a state change
+  tb_reset(&tb);
+  off = tb_bmp_begin(&tb, PARSEBGP_BMP_TYPE_PEER_DOWN);
+  tb_bmp_peer_hdr(&tb, 0, PEER_IP, PEER_ASN);
+  tb_u8(&tb, PARSEBGP_BMP_PEER_DOWN_LOCAL_CLOSE);
+  tb_u16(&tb, 0); // FSM event
+  tb_bmp_end(&tb, off);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BMP, msg, &tb));
+  parsebgp_elem_iter_init(&iter, msg, NULL);
+  CHECK((elem = parsebgp_elem_iter_next(&iter)) != NULL);
+  CHECK(elem->type == PARSEBGP_ELEM_TYPE_PEER_STATE);
+  CHECK(elem->old_state == PARSEBGP_MRT_FSM_CODE_ESTABLISHED &&
+        elem->new_state == PARSEBGP_MRT_FSM_CODE_IDLE);
+  CHECK(check_peer(elem, PEER_IP, PEER_ASN, 3000) == 0);
+  CHECK(parsebgp_elem_iter_next(&iter) == NULL);
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_bgp),
+    TEST(test_bgp4mp),
+    TEST(test_table_dump_v2),
+    TEST(test_bmp),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
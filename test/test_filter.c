@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Tests for filter expressions */
+
+/* A BGP4MP UPDATE from AS65001 (192.0.2.1) with the AS path 65001 3356 15169,
+   the community 65000:100, and the prefix 10.0.0.0/8 */
+static void build_bgp4mp(test_buf_t *tb)
+{
+  test_buf_t attrs, nlri;
+  uint32_t path[] = {65001, 3356, 15169};
+  uint32_t comm = (65000u << 16) | 100;
+  size_t off;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_attr_origin(&attrs, 0);
+  tb_attr_as_path(&attrs, 2, 1, path, 3);
+  tb_attr_next_hop(&attrs, "192.0.2.1");
+  tb_attr_communities(&attrs, &comm, 1);
+  tb_prefix(&nlri, "10.0.0.0/8");
+  off = tb_bgp4mp_begin(tb, 2000, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4, 65001,
+                        "192.0.2.1");
+  tb_bgp_update(tb, NULL, &attrs, &nlri);
+  tb_mrt_end(tb, off);
+  tb_free(&attrs);
+  tb_free(&nlri);
+}
+
+/* Decode tb with the given filter, returning the result */
+static parsebgp_error_t decode_filtered(const char *expr,
+                                        parsebgp_msg_type_t type,
+                                        parsebgp_msg_t *msg,
+                                        const test_buf_t *tb)
+{
+  parsebgp_opts_t opts;
+  parsebgp_filter_t *filter;
+  parsebgp_error_t err;
+  size_t len = tb->len;
+
+  if ((filter = parsebgp_filter_create(expr)) == NULL) {
+    fprintf(stderr, "could not compile '%s'\n", expr);
+    return PARSEBGP_INVALID_MSG;
+  }
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.filter = filter;
+  parsebgp_clear_msg(msg);
+  err = parsebgp_decode(opts, type, msg, tb->buf, &len);
+  // even a filtered-out message is consumed
+  if ((err == PARSEBGP_OK || err == PARSEBGP_FILTERED_OUT) && len != tb->len) {
+    fprintf(stderr, "'%s' used %zu of %zu bytes\n", expr, len, tb->len);
+    err = PARSEBGP_INVALID_MSG;
+  }
+  parsebgp_filter_destroy(filter);
+  return err;
+}
+
+/* Check whether "type update" nested in the given prefix and suffix the given
+   number of times compiles */
+static int check_nested(const char *prefix, const char *suffix, int cnt,
+                        int compiles)
+{
+  size_t prefix_len = strlen(prefix), suffix_len = strlen(suffix);
+  parsebgp_filter_t *filter;
+  char *expr, *p;
+  int i;
+
+  CHECK((expr = malloc((prefix_len + suffix_len) * cnt + 16)) != NULL);
+  p = expr;
+  for (i = 0; i < cnt; i++) {
+    memcpy(p, prefix, prefix_len);
+    p += prefix_len;
+  }
+  strcpy(p, "type update");
+  p += strlen(p);
+  for (i = 0; i < cnt; i++) {
+    memcpy(p, suffix, suffix_len);
+    p += suffix_len;
+  }
+  *p = '\0';
+
+  filter = parsebgp_filter_create(expr);
+  free(expr);
+  CHECK((filter != NULL) == compiles);
+  parsebgp_filter_destroy(filter);
+  return 0;
+}
+
+static int test_compile_errors(void)
+{
+  const char *bad[] = {
+    "",
+    "type",
+    "type bogus",
+    "peer-asn x",
+    "peer-asn 99999999999",
+    "peer-ip 300.0.0.1",
+    "prefix 10.0.0.0/33",
+    "prefix 10.0.0.0",
+    "community 65000",
+    "(type update",
+    "type update)",
+    "type update and",
+    "or type update",
+    "not",
+    "type update peer-asn 1",
+    "bogus 1",
+  };
+  char big[1024] = "peer-asn 1";
+  size_t i;
+
+  for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    if (parsebgp_filter_create(bad[i]) != NULL) {
+      fprintf(stderr, "'%s' compiled\n", bad[i]);
+      return -1;
+    }
+  }
+
+  // too many terms
+  for (i = 1; i <= PARSEBGP_FILTER_MAX_TERMS; i++) {
+    strcat(big, " or peer-asn 1");
+  }
+  CHECK(parsebgp_filter_create(big) == NULL);
+
+  // nested too deeply, rejected before the parser recurses that far
+  CHECK(check_nested("not ", "", 1000000, 0) == 0);
+  CHECK(check_nested("(", "", 1000000, 0) == 0);
+  CHECK(check_nested("( not ", ")", 1000, 0) == 0);
+
+  // but not when nested within the limit
+  CHECK(check_nested("not ", "", 100, 1) == 0);
+  CHECK(check_nested("(", ")", 100, 1) == 0);
+  return 0;
+}
+
+static int test_bgp4mp_terms(void)
+{
+  struct {
+    const char *expr;
+    int match;
+  } cases[] = {
+    {"type update", 1},
+    {"type open", 0},
+    {"type rib", 0},
+    {"peer-asn 65001", 1},
+    {"peer-asn 65002", 0},
+    {"peer-ip 192.0.2.1", 1},
+    {"peer-ip 192.0.2.2", 0},
+    {"peer-ip 2001:db8::1", 0},
+    {"origin-asn 15169", 1},
+    {"origin-asn 3356", 0},
+    {"path-asn 3356", 1},
+    {"path-asn 174", 0},
+    {"community 65000:100", 1},
+    {"community 65000:101", 0},
+    {"prefix 10.0.0.0/8", 1},
+    {"prefix 8.0.0.0/6", 1},
+    {"prefix 10.1.0.0/16", 0},
+    {"prefix 2001:db8::/32", 0},
+    {"not type update", 0},
+    {"not type open", 1},
+    {"type update and peer-asn 65001", 1},
+    {"type update and peer-asn 65002", 0},
+    {"type open or peer-asn 65001", 1},
+    // "and" binds more tightly than "or"
+    {"type open and peer-asn 65001 or path-asn 3356", 1},
+    {"type open and (peer-asn 65001 or path-asn 3356)", 0},
+    {"type update and not (peer-asn 1 or peer-asn 2)", 1},
+    {"not not type update", 1},
+  };
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_error_t err;
+  test_buf_t tb;
+  size_t i;
+
+  tb_init(&tb);
+  build_bgp4mp(&tb);
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    err = decode_filtered(cases[i].expr, PARSEBGP_MSG_TYPE_MRT, msg, &tb);
+    if (err != (cases[i].match ? PARSEBGP_OK : PARSEBGP_FILTERED_OUT)) {
+      fprintf(stderr, "'%s' returned %d\n", cases[i].expr, err);
+      return -1;
+    }
+  }
+  parsebgp_destroy_msg(msg);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_missing_fields(void)
+{
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  test_buf_t tb;
+
+  // a bare BGP message has no peer
+  tb_init(&tb);
+  tb_simple_update(&tb, 1, 65001, "10.0.0.0/8");
+  CHECK_ERR(PARSEBGP_FILTERED_OUT,
+            decode_filtered("peer-asn 65001", PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK_ERR(PARSEBGP_OK, decode_filtered("not peer-asn 65001",
+                                         PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK_ERR(PARSEBGP_OK,
+            decode_filtered("origin-asn 65001", PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  // and an UPDATE without COMMUNITIES has no communities
+  CHECK_ERR(PARSEBGP_FILTERED_OUT, decode_filtered("community 65000:100",
+                                                   PARSEBGP_MSG_TYPE_BGP, msg,
+                                                   &tb));
+  parsebgp_destroy_msg(msg);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_rib_entries(void)
+{
+  const char *ips[] = {"192.0.2.1", "192.0.2.2", "192.0.2.3"};
+  uint32_t asns[] = {65001, 65002, 65003};
+  uint32_t path1[] = {65001, 15169};
+  uint32_t path2[] = {65002, 3356};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib;
+  parsebgp_filter_t *filter;
+  test_buf_t attrs1, attrs2, pi, tb;
+  size_t off, len;
+
+  tb_init(&attrs1);
+  tb_init(&attrs2);
+  tb_init(&pi);
+  tb_init(&tb);
+  tb_peer_index(&pi, 3, ips, asns);
+  tb_attr_origin(&attrs1, 0);
+  tb_attr_as_path(&attrs1, 2, 1, path1, 2);
+  tb_attr_origin(&attrs2, 0);
+  tb_attr_as_path(&attrs2, 2, 1, path2, 2);
+  off = tb_rib_begin(&tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST, 0,
+                     "10.0.0.0/8", 3);
+  tb_rib_entry(&tb, 0, 0, 0, &attrs1);
+  tb_rib_entry(&tb, 1, 0, 0, &attrs2);
+  tb_rib_entry(&tb, 2, 0, 0, &attrs1);
+  tb_mrt_end(&tb, off);
+
+  // each entry is matched separately
+  CHECK((filter = parsebgp_filter_create(
+           "type rib and (path-asn 65002 or origin-asn 15169)")) != NULL);
+  parsebgp_opts_init(&opts);
+  opts.filter = filter;
+  len = pi.len;
+  CHECK_ERR(PARSEBGP_FILTERED_OUT,
+            parsebgp_decode(opts, PARSEBGP_MSG_TYPE_MRT, msg, pi.buf, &len));
+  CHECK(len == pi.len);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((rib = test_rib(msg)) != NULL);
+  CHECK(rib->entry_count == 3);
+  parsebgp_filter_destroy(filter);
+
+  CHECK((filter = parsebgp_filter_create("origin-asn 3356")) != NULL);
+  opts.filter = filter;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((rib = test_rib(msg)) != NULL);
+  CHECK(rib->entry_count == 1);
+  CHECK(rib->entries[0].peer_index == 1);
+  parsebgp_filter_destroy(filter);
+
+  // a record with no matching entries is filtered out (and TABLE_DUMP_V2
+  // entries have no peer ASN of their own)
+  CHECK((filter = parsebgp_filter_create("origin-asn 174")) != NULL);
+  opts.filter = filter;
+  parsebgp_clear_msg(msg);
+  len = tb.len;
+  CHECK_ERR(PARSEBGP_FILTERED_OUT,
+            parsebgp_decode(opts, PARSEBGP_MSG_TYPE_MRT, msg, tb.buf, &len));
+  CHECK(len == tb.len);
+  parsebgp_filter_destroy(filter);
+
+  CHECK((filter = parsebgp_filter_create("peer-asn 65001")) != NULL);
+  opts.filter = filter;
+  parsebgp_clear_msg(msg);
+  len = tb.len;
+  CHECK_ERR(PARSEBGP_FILTERED_OUT,
+            parsebgp_decode(opts, PARSEBGP_MSG_TYPE_MRT, msg, tb.buf, &len));
+  CHECK(len == tb.len);
+  parsebgp_filter_destroy(filter);
+
+  CHECK((filter = parsebgp_filter_create("prefix 10.0.0.0/16")) != NULL);
+  opts.filter = filter;
+  parsebgp_clear_msg(msg);
+  len = tb.len;
+  CHECK_ERR(PARSEBGP_FILTERED_OUT,
+            parsebgp_decode(opts, PARSEBGP_MSG_TYPE_MRT, msg, tb.buf, &len));
+  parsebgp_filter_destroy(filter);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&attrs1);
+  tb_free(&attrs2);
+  tb_free(&pi);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_bmp_peer(void)
+{
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  test_buf_t tb;
+  size_t off;
+
+  tb_init(&tb);
+  off = tb_bmp_begin(&tb, PARSEBGP_BMP_TYPE_ROUTE_MON);
+  tb_bmp_peer_hdr(&tb, 0, "192.0.2.7", 65007);
+  tb_simple_update(&tb, 1, 65007, "10.0.0.0/8");
+  tb_bmp_end(&tb, off);
+  CHECK_ERR(PARSEBGP_OK,
+            decode_filtered("peer-asn 65007 and peer-ip 192.0.2.7",
+                            PARSEBGP_MSG_TYPE_BMP, msg, &tb));
+  CHECK_ERR(PARSEBGP_FILTERED_OUT, decode_filtered("type peer-up",
+                                                   PARSEBGP_MSG_TYPE_BMP, msg,
+                                                   &tb));
+  parsebgp_destroy_msg(msg);
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_compile_errors),
+    TEST(test_bgp4mp_terms),
+    TEST(test_missing_fields),
+    TEST(test_rib_entries),
+    TEST(test_bmp_peer),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include "parsebgp_utils.h"
+#include <string.h>
+
+/* Tests for path attribute fingerprints */
+
+/* Decode an UPDATE with the given attributes, returning its path
+   attributes */
+static parsebgp_bgp_update_path_attrs_t *
+decode_attrs(parsebgp_msg_t *msg, const parsebgp_opts_t *opts,
+             const test_buf_t *attrs)
+{
+  parsebgp_opts_t o = *opts;
+  test_buf_t nlri, tb;
+  parsebgp_error_t err;
+
+  tb_init(&nlri);
+  tb_init(&tb);
+  tb_prefix(&nlri, "10.0.0.0/8");
+  tb_bgp_update(&tb, NULL, attrs, &nlri);
+  parsebgp_clear_msg(msg);
+  err = test_decode(&o, PARSEBGP_MSG_TYPE_BGP, msg, &tb);
+  tb_free(&nlri);
+  tb_free(&tb);
+  return err == PARSEBGP_OK ? &test_update(msg)->path_attrs : NULL;
+}
+
+/* Build the attributes of a route with the given AS path (encoded using 2- or
+   4-byte ASNs) and community */
+static void build_attrs(test_buf_t *attrs, int asn_4_byte,
+                        const uint32_t *asns, int asns_cnt, uint32_t comm)
+{
+  tb_reset(attrs);
+  tb_attr_origin(attrs, 0);
+  tb_attr_as_path(attrs, 2, asn_4_byte, asns, asns_cnt);
+  tb_attr_next_hop(attrs, "192.0.2.1");
+  if (comm != 0) {
+    tb_attr_communities(attrs, &comm, 1);
+  }
+}
+
+static int test_hash64(void)
+{
+  uint8_t buf[128];
+  uint64_t hashes[sizeof(buf) + 1], h;
+  size_t i, j;
+
+  for (i = 0; i < sizeof(buf); i++) {
+    buf[i] = i * 7;
+  }
+
+  // every length of the buffer gives a different hash
+  for (i = 0; i <= sizeof(buf); i++) {
+    hashes[i] = parsebgp_hash64(buf, i, 0);
+    CHECK(parsebgp_hash64(buf, i, 0) == hashes[i]);
+    for (j = 0; j < i; j++) {
+      CHECK(hashes[j] != hashes[i]);
+    }
+  }
+
+  // as does every single bit flip, and a different seed
+  for (i = 0; i < sizeof(buf) * 8; i++) {
+    buf[i / 8] ^= 1 << (i % 8);
+    h = parsebgp_hash64(buf, sizeof(buf), 0);
+    buf[i / 8] ^= 1 << (i % 8);
+    CHECK(h != hashes[sizeof(buf)]);
+  }
+  CHECK(parsebgp_hash64(buf, sizeof(buf), 1) != hashes[sizeof(buf)]);
+  return 0;
+}
+
+static int test_equal_data(void)
+{
+  uint32_t path[] = {65001, 65002};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_path_attrs_t *pa;
+  parsebgp_bgp_update_fingerprints_t fps;
+  uint64_t comm_fp;
+  test_buf_t attrs;
+
+  tb_init(&attrs);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+
+  // nothing is computed unless asked for
+  build_attrs(&attrs, 1, path, 2, 0xfde90064);
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  CHECK(!pa->fingerprints.valid);
+
+  opts.bgp.fingerprint = 1;
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  CHECK(pa->fingerprints.valid);
+  CHECK(pa->fingerprints.attrs != 0);
+  CHECK(pa->fingerprints.as_path != 0);
+  CHECK(pa->fingerprints.communities != 0);
+  fps = pa->fingerprints;
+  comm_fp = pa->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].fingerprint;
+
+  // the same data in another message gives the same fingerprints
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  CHECK(pa->fingerprints.attrs == fps.attrs);
+  CHECK(pa->fingerprints.as_path == fps.as_path);
+  CHECK(pa->fingerprints.communities == fps.communities);
+  CHECK(pa->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].fingerprint ==
+        comm_fp);
+
+  // a different community only changes the fingerprints that cover it
+  build_attrs(&attrs, 1, path, 2, 0xfde90065);
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  CHECK(pa->fingerprints.attrs != fps.attrs);
+  CHECK(pa->fingerprints.as_path == fps.as_path);
+  CHECK(pa->fingerprints.communities != fps.communities);
+  CHECK(pa->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].fingerprint !=
+        comm_fp);
+
+  // and a different path only changes those that cover it
+  path[1] = 65003;
+  build_attrs(&attrs, 1, path, 2, 0xfde90064);
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  CHECK(pa->fingerprints.attrs != fps.attrs);
+  CHECK(pa->fingerprints.as_path != fps.as_path);
+  CHECK(pa->fingerprints.communities == fps.communities);
+
+  // missing attributes have zero fingerprints
+  tb_reset(&attrs);
+  tb_attr_origin(&attrs, 0);
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  CHECK(pa->fingerprints.valid);
+  CHECK(pa->fingerprints.as_path == 0);
+  CHECK(pa->fingerprints.communities == 0);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&attrs);
+  return 0;
+}
+
+static int test_as_path_encoding(void)
+{
+  uint32_t path[] = {65001, 65002};
+  uint32_t path4[] = {65001, 4200000001U};
+  uint32_t path2[] = {65001, 23456};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_path_attrs_t *pa;
+  uint64_t as_path_fp, attrs_fp;
+  test_buf_t attrs;
+
+  tb_init(&attrs);
+  parsebgp_opts_init(&opts);
+  opts.bgp.fingerprint = 1;
+  opts.bgp.asn_4_byte_negotiated = 1;
+
+  // the same path gives the same fingerprint from 2- and 4-byte speakers
+  opts.bgp.asn_4_byte = 1;
+  build_attrs(&attrs, 1, path, 2, 0);
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  as_path_fp = pa->fingerprints.as_path;
+  attrs_fp = pa->fingerprints.attrs;
+  opts.bgp.asn_4_byte = 0;
+  build_attrs(&attrs, 0, path, 2, 0);
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  CHECK(pa->fingerprints.as_path == as_path_fp);
+  CHECK(pa->fingerprints.attrs != attrs_fp);
+
+  // and with as_path_merge, the effective path is used
+  opts.bgp.asn_4_byte = 1;
+  build_attrs(&attrs, 1, path4, 2, 0);
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  as_path_fp = pa->fingerprints.as_path;
+  opts.bgp.asn_4_byte = 0;
+  opts.bgp.as_path_merge = 1;
+  build_attrs(&attrs, 0, path2, 2, 0);
+  tb_attr_as_path(&attrs, 17, 1, &path4[1], 1);
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  CHECK(pa->fingerprints.as_path == as_path_fp);
+  opts.bgp.as_path_merge = 0;
+  CHECK((pa = decode_attrs(msg, &opts, &attrs)) != NULL);
+  CHECK(pa->fingerprints.as_path != as_path_fp);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&attrs);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_hash64),
+    TEST(test_equal_data),
+    TEST(test_as_path_encoding),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Tests for the interning store */
+
+/* Build an UPDATE with the given AS path and communities (if any) */
+static void build_update(test_buf_t *tb, int asn_4_byte, const uint32_t *path,
+                         int path_cnt, const uint32_t *comms, int comms_cnt)
+{
+  test_buf_t attrs, nlri;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_attr_origin(&attrs, 0);
+  if (path_cnt > 0) {
+    tb_attr_as_path(&attrs, 2, asn_4_byte, path, path_cnt);
+  }
+  tb_attr_next_hop(&attrs, "192.0.2.1");
+  if (comms_cnt > 0) {
+    tb_attr_communities(&attrs, comms, comms_cnt);
+  }
+  tb_prefix(&nlri, "10.0.0.0/8");
+  tb_reset(tb);
+  tb_bgp_update(tb, NULL, &attrs, &nlri);
+  tb_free(&attrs);
+  tb_free(&nlri);
+}
+
+/* Decode an UPDATE and return its IDs */
+static int decode_ids(parsebgp_opts_t *opts, parsebgp_msg_t *msg,
+                      const test_buf_t *tb,
+                      parsebgp_bgp_update_intern_ids_t *ids)
+{
+  parsebgp_bgp_update_t *update;
+
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(opts, PARSEBGP_MSG_TYPE_BGP, msg, tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->path_attrs.intern_ids.valid);
+  *ids = update->path_attrs.intern_ids;
+  return 0;
+}
+
+static int test_api(void)
+{
+  parsebgp_intern_t *store;
+  const uint8_t *val;
+  size_t len;
+  uint32_t id;
+
+  CHECK((store = parsebgp_intern_create()) != NULL);
+  CHECK(parsebgp_intern_count(store, PARSEBGP_INTERN_AS_PATH) == 0);
+  CHECK(parsebgp_intern_find(store, PARSEBGP_INTERN_AS_PATH, "a", 1) == 0);
+
+  // IDs start at 1 and are allocated in order
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_intern(store, PARSEBGP_INTERN_AS_PATH, "abc", 3, &id));
+  CHECK(id == 1);
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_intern(store, PARSEBGP_INTERN_AS_PATH, "abcd", 4, &id));
+  CHECK(id == 2);
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_intern(store, PARSEBGP_INTERN_AS_PATH, "abc", 3, &id));
+  CHECK(id == 1);
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_intern(store, PARSEBGP_INTERN_AS_PATH, "", 0, &id));
+  CHECK(id == 3);
+  CHECK(parsebgp_intern_count(store, PARSEBGP_INTERN_AS_PATH) == 3);
+
+  // each kind has its own IDs
+  CHECK(parsebgp_intern_find(store, PARSEBGP_INTERN_COMMUNITIES, "abc", 3) ==
+        0);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_intern(store, PARSEBGP_INTERN_COMMUNITIES,
+                                         "abcd", 4, &id));
+  CHECK(id == 1);
+  CHECK(parsebgp_intern_count(store, PARSEBGP_INTERN_COMMUNITIES) == 1);
+  CHECK(parsebgp_intern_count(store, PARSEBGP_INTERN_ATTRS) == 0);
+
+  CHECK(parsebgp_intern_find(store, PARSEBGP_INTERN_AS_PATH, "abcd", 4) == 2);
+  CHECK(parsebgp_intern_find(store, PARSEBGP_INTERN_AS_PATH, "abd", 3) == 0);
+  CHECK((val = parsebgp_intern_get(store, PARSEBGP_INTERN_AS_PATH, 2, &len)) !=
+        NULL);
+  CHECK(len == 4 && memcmp(val, "abcd", 4) == 0);
+  CHECK((val = parsebgp_intern_get(store, PARSEBGP_INTERN_AS_PATH, 3, &len)) !=
+          NULL &&
+        len == 0);
+
+  // invalid IDs
+  CHECK(parsebgp_intern_get(store, PARSEBGP_INTERN_AS_PATH, 0, &len) == NULL);
+  CHECK(parsebgp_intern_get(store, PARSEBGP_INTERN_AS_PATH, 4, &len) == NULL);
+  CHECK(parsebgp_intern_get(store, PARSEBGP_INTERN_ATTRS, 1, &len) == NULL);
+
+  parsebgp_intern_destroy(store);
+  return 0;
+}
+
+static int test_many(void)
+{
+  parsebgp_intern_t *store;
+  const uint8_t *val;
+  uint8_t data[300];
+  size_t len;
+  uint32_t i, id;
+
+  // enough values (some of them large) to grow the hash table, the arena and
+  // the entry directory
+  CHECK((store = parsebgp_intern_create()) != NULL);
+  memset(data, 0x5a, sizeof(data));
+  for (i = 0; i < 100000; i++) {
+    memcpy(data, &i, sizeof(i));
+    len = (i % 1000 == 0) ? sizeof(data) : sizeof(i);
+    CHECK_ERR(PARSEBGP_OK,
+              parsebgp_intern(store, PARSEBGP_INTERN_ATTRS, data, len, &id));
+    CHECK(id == i + 1);
+  }
+  CHECK(parsebgp_intern_count(store, PARSEBGP_INTERN_ATTRS) == 100000);
+  for (i = 0; i < 100000; i++) {
+    memcpy(data, &i, sizeof(i));
+    len = (i % 1000 == 0) ? sizeof(data) : sizeof(i);
+    CHECK(parsebgp_intern_find(store, PARSEBGP_INTERN_ATTRS, data, len) ==
+          i + 1);
+    CHECK((val = parsebgp_intern_get(store, PARSEBGP_INTERN_ATTRS, i + 1,
+                                     &len)) != NULL);
+    CHECK(len == ((i % 1000 == 0) ? sizeof(data) : sizeof(i)) &&
+          memcmp(val, data, len) == 0);
+  }
+
+  parsebgp_intern_destroy(store);
+  return 0;
+}
+
+static int test_save_load(void)
+{
+  static const char *bad[] = {"", "PBGPINT", "PBGPINT2\0\0\0\3",
+                              "PBGPINT1\0\0\0\2", "PBGPINT1\0\0\0\3\0\0\0\1"};
+  static const size_t bad_lens[] = {0, 7, 12, 12, 16};
+  parsebgp_intern_t *store, *loaded;
+  const uint8_t *val;
+  size_t len;
+  uint32_t id;
+  FILE *f;
+  unsigned int i;
+
+  CHECK((store = parsebgp_intern_create()) != NULL);
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_intern(store, PARSEBGP_INTERN_AS_PATH, "p1", 2, &id));
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_intern(store, PARSEBGP_INTERN_AS_PATH, "p2", 2, &id));
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_intern(store, PARSEBGP_INTERN_ATTRS, "", 0, &id));
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_intern(store, PARSEBGP_INTERN_ATTRS, "a1", 2, &id));
+
+  CHECK((f = tmpfile()) != NULL);
+  CHECK(parsebgp_intern_save(store, f) == 0);
+  rewind(f);
+  CHECK((loaded = parsebgp_intern_load(f)) != NULL);
+  fclose(f);
+
+  // the IDs are preserved, and new values follow on from them
+  CHECK(parsebgp_intern_count(loaded, PARSEBGP_INTERN_AS_PATH) == 2);
+  CHECK(parsebgp_intern_count(loaded, PARSEBGP_INTERN_COMMUNITIES) == 0);
+  CHECK(parsebgp_intern_count(loaded, PARSEBGP_INTERN_ATTRS) == 2);
+  CHECK(parsebgp_intern_find(loaded, PARSEBGP_INTERN_AS_PATH, "p2", 2) == 2);
+  CHECK(parsebgp_intern_find(loaded, PARSEBGP_INTERN_ATTRS, "", 0) == 1);
+  CHECK((val = parsebgp_intern_get(loaded, PARSEBGP_INTERN_ATTRS, 2, &len)) !=
+          NULL &&
+        len == 2 && memcmp(val, "a1", 2) == 0);
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_intern(loaded, PARSEBGP_INTERN_AS_PATH, "p3", 2, &id));
+  CHECK(id == 3);
+  parsebgp_intern_destroy(loaded);
+  parsebgp_intern_destroy(store);
+
+  // empty, truncated and foreign files are rejected
+  for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    CHECK((f = tmpfile()) != NULL);
+    CHECK(bad_lens[i] == 0 || fwrite(bad[i], bad_lens[i], 1, f) == 1);
+    rewind(f);
+    CHECK(parsebgp_intern_load(f) == NULL);
+    fclose(f);
+  }
+
+  return 0;
+}
+
+static int test_decode_ids(void)
+{
+  static const uint32_t path[] = {65001, 65002};
+  static const uint8_t canonical_path[] = {2, 2, 0, 0, 0xfd, 0xe9,
+                                           0, 0, 0xfd, 0xea};
+  static const uint32_t comms1[] = {0xfde90002, 0xfde90001, 0xfde90002};
+  static const uint32_t comms2[] = {0xfde90001, 0xfde90002};
+  static const uint8_t canonical_comms[] = {8,    0,    2,    0xfd, 0xe9, 0,
+                                            1,    0xfd, 0xe9, 0,    2};
+  parsebgp_bgp_update_intern_ids_t ids1, ids2;
+  parsebgp_intern_t *store;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  const uint8_t *val;
+  size_t len;
+  test_buf_t tb;
+
+  CHECK((store = parsebgp_intern_create()) != NULL);
+  parsebgp_opts_init(&opts);
+  opts.intern = store;
+  tb_init(&tb);
+
+  // community sets are compared sorted and de-duplicated, but the attribute
+  // blocks are not
+  opts.bgp.asn_4_byte = 1;
+  build_update(&tb, 1, path, 2, comms1, 3);
+  CHECK(decode_ids(&opts, msg, &tb, &ids1) == 0);
+  build_update(&tb, 1, path, 2, comms2, 2);
+  CHECK(decode_ids(&opts, msg, &tb, &ids2) == 0);
+  CHECK(ids1.communities != 0 && ids1.communities == ids2.communities);
+  CHECK(ids1.as_path != 0 && ids1.as_path == ids2.as_path);
+  CHECK(ids1.attrs != ids2.attrs);
+  CHECK((val = parsebgp_intern_get(store, PARSEBGP_INTERN_COMMUNITIES,
+                                   ids1.communities, &len)) != NULL);
+  CHECK(len == sizeof(canonical_comms) &&
+        memcmp(val, canonical_comms, len) == 0);
+
+  // 2 and 4-byte AS paths have the same canonical form
+  opts.bgp.asn_4_byte = 0;
+  build_update(&tb, 0, path, 2, comms1, 3);
+  CHECK(decode_ids(&opts, msg, &tb, &ids2) == 0);
+  CHECK(ids2.as_path == ids1.as_path);
+  CHECK(ids2.communities == ids1.communities);
+  CHECK((val = parsebgp_intern_get(store, PARSEBGP_INTERN_AS_PATH,
+                                   ids1.as_path, &len)) != NULL);
+  CHECK(len == sizeof(canonical_path) &&
+        memcmp(val, canonical_path, len) == 0);
+
+  // missing attributes have no ID
+  build_update(&tb, 0, NULL, 0, NULL, 0);
+  CHECK(decode_ids(&opts, msg, &tb, &ids2) == 0);
+  CHECK(ids2.as_path == 0 && ids2.communities == 0 && ids2.attrs != 0);
+  CHECK(parsebgp_intern_count(store, PARSEBGP_INTERN_AS_PATH) == 1);
+  CHECK(parsebgp_intern_count(store, PARSEBGP_INTERN_COMMUNITIES) == 1);
+  CHECK(parsebgp_intern_count(store, PARSEBGP_INTERN_ATTRS) == 4);
+
+  // without a store, no IDs are set
+  opts.intern = NULL;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK(!test_update(msg)->path_attrs.intern_ids.valid);
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  parsebgp_intern_destroy(store);
+  return 0;
+}
+
+#define THREADS_CNT 4
+#define THREAD_VALUES_CNT 20000
+
+typedef struct thread_arg {
+  parsebgp_intern_t *store;
+  int offset;
+  uint32_t ids[THREAD_VALUES_CNT];
+  int err;
+} thread_arg_t;
+
+/* Intern values that overlap with those of the other threads */
+static void *intern_thread(void *user)
+{
+  thread_arg_t *arg = user;
+  uint32_t i, val;
+
+  for (i = 0; i < THREAD_VALUES_CNT; i++) {
+    val = (i + arg->offset) % THREAD_VALUES_CNT;
+    if (parsebgp_intern(arg->store, PARSEBGP_INTERN_ATTRS, &val, sizeof(val),
+                        &arg->ids[val]) != PARSEBGP_OK) {
+      arg->err = 1;
+    }
+  }
+  return NULL;
+}
+
+static int test_concurrent(void)
+{
+  static thread_arg_t args[THREADS_CNT];
+  pthread_t threads[THREADS_CNT];
+  parsebgp_intern_t *store;
+  const uint8_t *data;
+  size_t len;
+  uint32_t i, val;
+  int t;
+
+  CHECK((store = parsebgp_intern_create()) != NULL);
+  for (t = 0; t < THREADS_CNT; t++) {
+    args[t].store = store;
+    args[t].offset = t * (THREAD_VALUES_CNT / THREADS_CNT);
+    args[t].err = 0;
+    CHECK(pthread_create(&threads[t], NULL, intern_thread, &args[t]) == 0);
+  }
+  for (t = 0; t < THREADS_CNT; t++) {
+    CHECK(pthread_join(threads[t], NULL) == 0);
+    CHECK(!args[t].err);
+  }
+
+  // every thread got the same ID for each value, and the IDs are dense
+  CHECK(parsebgp_intern_count(store, PARSEBGP_INTERN_ATTRS) ==
+        THREAD_VALUES_CNT);
+  for (val = 0; val < THREAD_VALUES_CNT; val++) {
+    for (t = 1; t < THREADS_CNT; t++) {
+      CHECK(args[t].ids[val] == args[0].ids[val]);
+    }
+    CHECK((data = parsebgp_intern_get(store, PARSEBGP_INTERN_ATTRS,
+                                      args[0].ids[val], &len)) != NULL);
+    memcpy(&i, data, sizeof(i));
+    CHECK(len == sizeof(val) && i == val);
+  }
+
+  parsebgp_intern_destroy(store);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_api),
+    TEST(test_many),
+    TEST(test_save_load),
+    TEST(test_decode_ids),
+    TEST(test_concurrent),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Tests for MP_REACH_NLRI/MP_UNREACH_NLRI decoding, and for the clearing of
+   decoded attributes between messages */
+
+/* Build an UPDATE whose only NLRI are in an MP_REACH_NLRI (or, if withdrawn is
+   set, an MP_UNREACH_NLRI) attribute for the given AFI/SAFI */
+static void build_update(test_buf_t *tb, int withdrawn, uint16_t afi,
+                         uint8_t safi, const char *prefix)
+{
+  test_buf_t attrs, nh, nlri;
+
+  tb_init(&attrs);
+  tb_init(&nh);
+  tb_init(&nlri);
+  if (afi == PARSEBGP_BGP_AFI_IPV6 && safi == PARSEBGP_BGP_SAFI_UNICAST) {
+    tb_ip6(&nh, "2001:db8::1");
+    tb_prefix(&nlri, prefix);
+  } else {
+    // contents that we do not decode
+    tb_ip4(&nh, "192.0.2.1");
+    tb_u32(&nlri, 0xdeadbeef);
+  }
+  if (withdrawn) {
+    tb_attr_mp_unreach(&attrs, afi, safi, &nlri);
+  } else {
+    tb_basic_attrs(&attrs, 0);
+    tb_attr_mp_reach(&attrs, afi, safi, &nh, &nlri);
+  }
+  tb_reset(tb);
+  tb_bgp_update(tb, NULL, &attrs, NULL);
+  tb_free(&attrs);
+  tb_free(&nh);
+  tb_free(&nlri);
+}
+
+/* Decode an UPDATE built by build_update into msg (after clearing it) */
+static int decode_update(parsebgp_opts_t *opts, parsebgp_msg_t *msg,
+                         int withdrawn, uint16_t afi, uint8_t safi,
+                         const char *prefix)
+{
+  test_buf_t tb;
+
+  tb_init(&tb);
+  build_update(&tb, withdrawn, afi, safi, prefix);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  tb_free(&tb);
+  CHECK(test_update(msg) != NULL);
+  return 0;
+}
+
+static int test_reach(void)
+{
+  parsebgp_bgp_update_path_attrs_t *pa;
+  parsebgp_bgp_update_mp_reach_t *mp;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  test_buf_t tb;
+  char buf[64];
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.ignore_not_implemented = 1;
+  opts.silence_not_implemented = 1;
+
+  CHECK(decode_update(&opts, msg, 0, PARSEBGP_BGP_AFI_IPV6,
+                      PARSEBGP_BGP_SAFI_UNICAST, "2001:db8::/32") == 0);
+  pa = &test_update(msg)->path_attrs;
+  mp = pa->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI].data.mp_reach;
+  CHECK(mp->next_hop_len == 16 && mp->nlris_cnt == 1);
+  CHECK(strcmp(test_prefix_str(&mp->nlris[0], buf), "2001:db8::/32") == 0);
+
+  // an unsupported SAFI (here, labeled unicast) must not leave the NLRI of
+  // the previous message
+  CHECK(decode_update(&opts, msg, 0, PARSEBGP_BGP_AFI_IPV6, 4, NULL) == 0);
+  mp = pa->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI].data.mp_reach;
+  CHECK(mp->afi == PARSEBGP_BGP_AFI_IPV6 && mp->safi == 4);
+  CHECK(mp->nlris_cnt == 0);
+  CHECK(mp->next_hop_len == 0);
+
+  // nor must an unsupported AFI
+  CHECK(decode_update(&opts, msg, 0, PARSEBGP_BGP_AFI_IPV6,
+                      PARSEBGP_BGP_SAFI_UNICAST, "2001:db8::/32") == 0);
+  CHECK(mp->nlris_cnt == 1);
+  CHECK(decode_update(&opts, msg, 0, 25, 65, NULL) == 0);
+  CHECK(mp->afi == 25 && mp->nlris_cnt == 0 && mp->next_hop_len == 0);
+
+  // unless asked to skip them, unsupported AFI/SAFIs are an error
+  opts.ignore_not_implemented = 0;
+  tb_init(&tb);
+  build_update(&tb, 0, PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_MPLS, NULL);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_NOT_IMPLEMENTED,
+            test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+static int test_unreach(void)
+{
+  parsebgp_bgp_update_mp_unreach_t *mp;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  char buf[64];
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.ignore_not_implemented = 1;
+  opts.silence_not_implemented = 1;
+
+  CHECK(decode_update(&opts, msg, 1, PARSEBGP_BGP_AFI_IPV6,
+                      PARSEBGP_BGP_SAFI_UNICAST, "2001:db8::/32") == 0);
+  mp = test_update(msg)
+         ->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI]
+         .data.mp_unreach;
+  CHECK(mp->withdrawn_nlris_cnt == 1);
+  CHECK(strcmp(test_prefix_str(&mp->withdrawn_nlris[0], buf),
+               "2001:db8::/32") == 0);
+
+  CHECK(decode_update(&opts, msg, 1, PARSEBGP_BGP_AFI_IPV6,
+                      PARSEBGP_BGP_SAFI_MPLS, NULL) == 0);
+  CHECK(mp->safi == PARSEBGP_BGP_SAFI_MPLS && mp->withdrawn_nlris_cnt == 0);
+
+  CHECK(decode_update(&opts, msg, 1, PARSEBGP_BGP_AFI_IPV6,
+                      PARSEBGP_BGP_SAFI_UNICAST, "2001:db8::/32") == 0);
+  CHECK(mp->withdrawn_nlris_cnt == 1);
+  CHECK(decode_update(&opts, msg, 1, 25, 65, NULL) == 0);
+  CHECK(mp->afi == 25 && mp->withdrawn_nlris_cnt == 0);
+
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+/* Append a RIB record with an entry for each of the given communities (or
+   without the COMMUNITIES attribute if the community is 0) */
+static void build_rib(test_buf_t *tb, const uint32_t *comms, int comms_cnt)
+{
+  test_buf_t attrs;
+  size_t off;
+  int i;
+
+  tb_init(&attrs);
+  tb_reset(tb);
+  off = tb_rib_begin(tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST, 0,
+                     "10.0.0.0/8", comms_cnt);
+  for (i = 0; i < comms_cnt; i++) {
+    tb_reset(&attrs);
+    tb_basic_attrs(&attrs, 1);
+    if (comms[i] != 0) {
+      tb_attr_communities(&attrs, &comms[i], 1);
+    }
+    tb_rib_entry(tb, i, 0, 0, &attrs);
+  }
+  tb_mrt_end(tb, off);
+  tb_free(&attrs);
+}
+
+/* Check the communities of the entries of the decoded RIB record */
+static int check_rib(parsebgp_msg_t *msg, const uint32_t *comms, int comms_cnt)
+{
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib;
+  parsebgp_bgp_update_path_attr_t *attr;
+  int i;
+
+  CHECK((rib = test_rib(msg)) != NULL);
+  CHECK(rib->entry_count == comms_cnt);
+  for (i = 0; i < comms_cnt; i++) {
+    CHECK(rib->entries[i].peer_index == i);
+    attr = &rib->entries[i]
+              .path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES];
+    if (comms[i] == 0) {
+      CHECK(attr->type == 0);
+      CHECK(rib->entries[i].path_attrs.attrs_cnt == 3);
+    } else {
+      CHECK(attr->type == PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES);
+      CHECK(attr->data.communities->communities_cnt == 1 &&
+            attr->data.communities->communities[0] == comms[i]);
+      CHECK(rib->entries[i].path_attrs.attrs_cnt == 4);
+    }
+  }
+  return 0;
+}
+
+static int test_rib_clear(void)
+{
+  static const uint32_t comms1[] = {100, 200, 300};
+  static const uint32_t comms2[] = {0, 400};
+  static const uint32_t comms3[] = {500, 0, 0};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  test_buf_t tb;
+
+  // the entries of a RIB record are cleared lazily, so a smaller record must
+  // not see the attributes of a larger earlier one, and a later larger record
+  // must not see those of the entries beyond the smaller one
+  parsebgp_opts_init(&opts);
+  tb_init(&tb);
+  build_rib(&tb, comms1, 3);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(check_rib(msg, comms1, 3) == 0);
+
+  build_rib(&tb, comms2, 2);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(check_rib(msg, comms2, 2) == 0);
+
+  build_rib(&tb, comms3, 3);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(check_rib(msg, comms3, 3) == 0);
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_reach),
+    TEST(test_unreach),
+    TEST(test_rib_clear),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
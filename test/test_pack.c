@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include "parsebgp_pack.h"
+#include <string.h>
+
+/* Tests for packing messages into relocatable blocks */
+
+#define PEER_IP "192.0.2.1"
+#define PEER_ASN 65001
+
+/* Append the path attributes shared by the tests */
+static void build_attrs(test_buf_t *attrs, uint32_t comm)
+{
+  static const uint8_t med[] = {0, 0, 0, 50};
+  static const uint8_t local_pref[] = {0, 0, 0, 200};
+  static const uint8_t large[] = {0, 0, 0xfd, 0xe9, 0, 0, 0, 1, 0, 0, 0, 2};
+  uint32_t path[] = {PEER_ASN, 65002, 65003};
+
+  tb_attr_origin(attrs, 1);
+  tb_attr_as_path(attrs, 2, 1, path, 3);
+  tb_attr_next_hop(attrs, PEER_IP);
+  tb_attr(attrs, 0x80, PARSEBGP_BGP_PATH_ATTR_TYPE_MED, med, sizeof(med));
+  tb_attr(attrs, 0x40, PARSEBGP_BGP_PATH_ATTR_TYPE_LOCAL_PREF, local_pref,
+          sizeof(local_pref));
+  tb_attr_communities(attrs, &comm, 1);
+  tb_attr(attrs, 0xc0, PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES, large,
+          sizeof(large));
+}
+
+/* Check the packed attributes built by build_attrs */
+static int check_attrs(const parsebgp_msg_packed_t *packed,
+                       const parsebgp_packed_attrs_t *attrs, uint32_t comm)
+{
+  const parsebgp_packed_as_path_seg_t *segs;
+  const parsebgp_bgp_update_large_community_t *large;
+  const uint32_t *asns;
+
+  CHECK(attrs != NULL);
+  CHECK(parsebgp_packed_attrs_has(attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN) &&
+        attrs->origin == 1);
+  CHECK(parsebgp_packed_attrs_has(attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_MED) &&
+        attrs->med == 50);
+  CHECK(attrs->local_pref == 200);
+  CHECK(
+    !parsebgp_packed_attrs_has(attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR));
+  CHECK(attrs->as_path_segs_cnt == 1);
+  segs = parsebgp_msg_packed_as_path(packed, attrs);
+  CHECK(segs[0].type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ &&
+        segs[0].asns_cnt == 3);
+  asns = parsebgp_msg_packed_seg_asns(packed, &segs[0]);
+  CHECK(asns[0] == PEER_ASN && asns[1] == 65002 && asns[2] == 65003);
+  CHECK(attrs->communities_cnt == 1);
+  CHECK(parsebgp_msg_packed_communities(packed, attrs)[0] == comm);
+  CHECK(attrs->large_communities_cnt == 1);
+  large = parsebgp_msg_packed_large_communities(packed, attrs);
+  CHECK(large[0].global_admin == PEER_ASN && large[0].local_1 == 1 &&
+        large[0].local_2 == 2);
+  CHECK(attrs->ext_communities_cnt == 0 && attrs->cluster_ids_cnt == 0);
+  return 0;
+}
+
+/* Check that a packed element is a copy of the given element */
+static int check_elem(const parsebgp_packed_elem_t *pe,
+                      const parsebgp_elem_t *elem)
+{
+  CHECK(pe->type == elem->type);
+  CHECK(pe->timestamp_sec == elem->timestamp_sec &&
+        pe->timestamp_usec == elem->timestamp_usec);
+  CHECK(pe->peer_afi == elem->peer_afi && pe->peer_asn == elem->peer_asn);
+  CHECK(elem->peer_ip == NULL ||
+        memcmp(pe->peer_ip, elem->peer_ip,
+               elem->peer_afi == PARSEBGP_BGP_AFI_IPV6 ? 16 : 4) == 0);
+  if (elem->prefix != NULL) {
+    CHECK(pe->prefix.afi == elem->prefix->afi &&
+          pe->prefix.len == elem->prefix->len);
+    CHECK(memcmp(pe->prefix.addr, elem->prefix->addr, 16) == 0);
+    CHECK(pe->prefix.path_id_valid == elem->prefix->path_id_valid);
+  }
+  CHECK(pe->next_hop_afi == elem->next_hop_afi);
+  CHECK(elem->next_hop == NULL ||
+        memcmp(pe->next_hop, elem->next_hop,
+               elem->next_hop_afi == PARSEBGP_BGP_AFI_IPV6 ? 16 : 4) == 0);
+  CHECK((pe->attrs_idx == PARSEBGP_PACKED_NO_ATTRS) ==
+        (elem->path_attrs == NULL));
+  CHECK(pe->old_state == elem->old_state && pe->new_state == elem->new_state);
+  return 0;
+}
+
+/* Check that the packed message has the elements of the message */
+static int check_packed(const parsebgp_msg_packed_t *packed,
+                        const parsebgp_msg_t *msg)
+{
+  parsebgp_elem_iter_t iter;
+  const parsebgp_elem_t *elem;
+  uint32_t i = 0;
+
+  CHECK(parsebgp_msg_packed_type(packed) == msg->type);
+  parsebgp_elem_iter_init(&iter, msg, NULL);
+  while ((elem = parsebgp_elem_iter_next(&iter)) != NULL) {
+    CHECK(i < parsebgp_msg_packed_elems_cnt(packed));
+    CHECK(check_elem(parsebgp_msg_packed_elem(packed, i), elem) == 0);
+    i++;
+  }
+  CHECK(i == parsebgp_msg_packed_elems_cnt(packed));
+  return 0;
+}
+
+static int test_pack_update(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_msg_packed_t *packed;
+  const parsebgp_packed_elem_t *pe;
+  uint64_t *moved;
+  test_buf_t tb, attrs, wd, nlri;
+  size_t len;
+  size_t off;
+
+  parsebgp_opts_init(&opts);
+  tb_init(&tb);
+  tb_init(&attrs);
+  tb_init(&wd);
+  tb_init(&nlri);
+  build_attrs(&attrs, 100);
+  tb_prefix(&wd, "10.9.0.0/16");
+  tb_prefix(&nlri, "10.1.0.0/16");
+  tb_prefix(&nlri, "10.2.0.0/16");
+  off = tb_bgp4mp_begin(&tb, 2000, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4, PEER_ASN,
+                        PEER_IP);
+  tb_bgp_update(&tb, &wd, &attrs, &nlri);
+  tb_mrt_end(&tb, off);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+
+  CHECK((packed = parsebgp_msg_pack(msg, NULL)) != NULL);
+  len = parsebgp_msg_packed_len(packed);
+  CHECK(len == parsebgp_msg_pack_size(msg, NULL));
+  CHECK(check_packed(packed, msg) == 0);
+  CHECK(parsebgp_msg_packed_elems_cnt(packed) == 3);
+
+  // the attributes are shared by the announcements
+  pe = parsebgp_msg_packed_elem(packed, 0);
+  CHECK(pe->type == PARSEBGP_ELEM_TYPE_WITHDRAWAL);
+  CHECK(parsebgp_msg_packed_attrs(packed, pe) == NULL);
+  CHECK(parsebgp_msg_packed_elem(packed, 1)->attrs_idx ==
+        parsebgp_msg_packed_elem(packed, 2)->attrs_idx);
+  pe = parsebgp_msg_packed_elem(packed, 1);
+  CHECK(check_attrs(packed, parsebgp_msg_packed_attrs(packed, pe), 100) == 0);
+
+  // the block can be moved, and outlives the message
+  parsebgp_destroy_msg(msg);
+  CHECK((moved = malloc(len)) != NULL);
+  memcpy(moved, packed, len);
+  memset(packed, 0xff, len);
+  free(packed);
+  packed = (parsebgp_msg_packed_t *)moved;
+  CHECK(parsebgp_msg_packed_elems_cnt(packed) == 3);
+  pe = parsebgp_msg_packed_elem(packed, 2);
+  CHECK(pe->timestamp_sec == 2000 && pe->peer_asn == PEER_ASN);
+  CHECK(check_attrs(packed, parsebgp_msg_packed_attrs(packed, pe), 100) == 0);
+  free(packed);
+
+  tb_free(&tb);
+  tb_free(&attrs);
+  tb_free(&wd);
+  tb_free(&nlri);
+  return 0;
+}
+
+static int test_pack_into(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  uint64_t buf[256];
+  test_buf_t tb;
+  size_t len;
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  tb_init(&tb);
+  tb_simple_update(&tb, 1, PEER_ASN, "10.0.0.0/8");
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+
+  // the size is exact
+  len = parsebgp_msg_pack_size(msg, NULL);
+  CHECK(len > 0 && len <= sizeof(buf));
+  CHECK(parsebgp_msg_pack_into(msg, NULL, buf, len - 1) == 0);
+  CHECK(parsebgp_msg_pack_into(msg, NULL, buf, sizeof(buf)) == len);
+  CHECK(parsebgp_msg_packed_len((parsebgp_msg_packed_t *)buf) == len);
+  CHECK(check_packed((parsebgp_msg_packed_t *)buf, msg) == 0);
+
+  // a message without elements still packs
+  tb_reset(&tb);
+  tb_bgp_open(&tb, PEER_ASN, 1, 0);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  len = parsebgp_msg_pack_size(msg, NULL);
+  CHECK(parsebgp_msg_pack_into(msg, NULL, buf, sizeof(buf)) == len);
+  CHECK(parsebgp_msg_packed_elems_cnt((parsebgp_msg_packed_t *)buf) == 0);
+
+  tb_free(&tb);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+static int test_pack_rib(void)
+{
+  static const char *ips[] = {"192.0.2.1", "192.0.2.2"};
+  static const uint32_t asns[] = {65001, 65002};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_msg_packed_t *packed;
+  const parsebgp_packed_elem_t *pe0, *pe1;
+  test_buf_t tb, attrs;
+  size_t off;
+
+  parsebgp_opts_init(&opts);
+  tb_init(&tb);
+  tb_init(&attrs);
+  tb_peer_index(&tb, 2, ips, asns);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+
+  // each RIB entry has its own attributes
+  tb_reset(&tb);
+  off = tb_rib_begin(&tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST, 0,
+                     "10.0.0.0/8", 2);
+  build_attrs(&attrs, 100);
+  tb_rib_entry(&tb, 1, 0, 0, &attrs);
+  tb_reset(&attrs);
+  build_attrs(&attrs, 200);
+  tb_rib_entry(&tb, 0, 0, 0, &attrs);
+  tb_mrt_end(&tb, off);
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+
+  CHECK((packed = parsebgp_msg_pack(msg, NULL)) != NULL);
+  CHECK(check_packed(packed, msg) == 0);
+  CHECK(parsebgp_msg_packed_elems_cnt(packed) == 2);
+  pe0 = parsebgp_msg_packed_elem(packed, 0);
+  pe1 = parsebgp_msg_packed_elem(packed, 1);
+  CHECK(pe0->type == PARSEBGP_ELEM_TYPE_RIB && pe0->peer_asn == 65002);
+  CHECK(pe1->peer_asn == 65001);
+  CHECK(pe0->attrs_idx != pe1->attrs_idx);
+  CHECK(check_attrs(packed, parsebgp_msg_packed_attrs(packed, pe0), 100) == 0);
+  CHECK(check_attrs(packed, parsebgp_msg_packed_attrs(packed, pe1), 200) == 0);
+  free(packed);
+
+  tb_free(&tb);
+  tb_free(&attrs);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+static int test_merged_as_path(void)
+{
+  uint32_t path2[] = {PEER_ASN, 23456};
+  uint32_t path4[] = {PEER_ASN, 4200000000U};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_msg_packed_t *packed;
+  const parsebgp_packed_attrs_t *attrs;
+  const parsebgp_packed_as_path_seg_t *segs;
+  test_buf_t tb, pa, nlri;
+  int merge;
+
+  tb_init(&tb);
+  tb_init(&pa);
+  tb_init(&nlri);
+  tb_attr_origin(&pa, 0);
+  tb_attr_as_path(&pa, 2, 0, path2, 2);
+  tb_attr_next_hop(&pa, PEER_IP);
+  tb_attr_as_path(&pa, 17, 1, path4, 2);
+  tb_prefix(&nlri, "10.0.0.0/8");
+  tb_bgp_update(&tb, NULL, &pa, &nlri);
+
+  // the packed AS path is the merged path only if merging is enabled
+  for (merge = 0; merge < 2; merge++) {
+    parsebgp_opts_init(&opts);
+    opts.bgp.as_path_merge = merge;
+    parsebgp_clear_msg(msg);
+    CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+    CHECK((packed = parsebgp_msg_pack(msg, NULL)) != NULL);
+    attrs = parsebgp_msg_packed_attrs(packed,
+                                      parsebgp_msg_packed_elem(packed, 0));
+    CHECK(attrs != NULL && attrs->as_path_segs_cnt == 1);
+    segs = parsebgp_msg_packed_as_path(packed, attrs);
+    CHECK(segs[0].asns_cnt == 2);
+    CHECK(parsebgp_msg_packed_seg_asns(packed, &segs[0])[1] ==
+          (merge ? 4200000000U : 23456));
+    free(packed);
+  }
+
+  tb_free(&tb);
+  tb_free(&pa);
+  tb_free(&nlri);
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_pack_update),
+    TEST(test_pack_into),
+    TEST(test_pack_rib),
+    TEST(test_merged_as_path),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
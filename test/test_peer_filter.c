@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <arpa/inet.h>
+#include <string.h>
+
+/* Tests for the TABLE_DUMP_V2 peer filter */
+
+/* Check that the RIB record in msg holds entries for exactly the given
+   peers */
+static int check_rib_peers(parsebgp_msg_t *msg, const uint16_t *peers,
+                           int peers_cnt)
+{
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib;
+  int i;
+
+  CHECK((rib = test_rib(msg)) != NULL);
+  CHECK(rib->entry_count == peers_cnt);
+  for (i = 0; i < peers_cnt; i++) {
+    CHECK(rib->entries[i].peer_index == peers[i]);
+    CHECK(rib->entries[i].path_attrs.attrs_cnt == 2);
+  }
+  return 0;
+}
+
+static int test_by_index(void)
+{
+  uint16_t all[] = {0, 1, 2, 3}, kept[] = {1, 3}, none[] = {0, 2};
+  parsebgp_mrt_peer_filter_t *filter;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  test_buf_t tb;
+  size_t len;
+
+  tb_init(&tb);
+  CHECK((filter = parsebgp_mrt_peer_filter_create()) != NULL);
+  parsebgp_mrt_peer_filter_add_index(filter, 1);
+  parsebgp_mrt_peer_filter_add_index(filter, 3);
+  CHECK(parsebgp_mrt_peer_filter_match(filter, NULL, 1));
+  CHECK(!parsebgp_mrt_peer_filter_match(filter, NULL, 2));
+
+  // peers given by index do not need a PEER_INDEX_TABLE
+  parsebgp_opts_init(&opts);
+  opts.mrt_peer_filter = filter;
+  tb_basic_rib(&tb, 0, 4, all, 4);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(check_rib_peers(msg, kept, 2) == 0);
+
+  // a record without any of the peers is skipped
+  tb_reset(&tb);
+  tb_basic_rib(&tb, 0, 2, none, 2);
+  parsebgp_clear_msg(msg);
+  len = tb.len;
+  CHECK_ERR(PARSEBGP_FILTERED_OUT,
+            parsebgp_decode(opts, PARSEBGP_MSG_TYPE_MRT, msg, tb.buf, &len));
+  CHECK(len == tb.len);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_mrt_peer_filter_destroy(filter);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_by_asn_and_ip(void)
+{
+  const char *ips[] = {"192.0.2.1", "192.0.2.2", "192.0.2.3", "192.0.2.4"};
+  uint32_t asns[] = {65001, 65002, 65003, 65002};
+  uint16_t all[] = {0, 1, 2, 3}, kept[] = {1, 2, 3};
+  parsebgp_mrt_peer_filter_t *filter;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  uint8_t ip[4];
+  test_buf_t pi, tb;
+
+  tb_init(&pi);
+  tb_init(&tb);
+  tb_peer_index(&pi, 4, ips, asns);
+  tb_basic_rib(&tb, 0, 4, all, 4);
+
+  CHECK((filter = parsebgp_mrt_peer_filter_create()) != NULL);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_mrt_peer_filter_add_asn(filter, 65002));
+  inet_pton(AF_INET, "192.0.2.3", ip);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_mrt_peer_filter_add_ip(
+                           filter, PARSEBGP_BGP_AFI_IPV4, ip));
+  parsebgp_opts_init(&opts);
+  opts.mrt_peer_filter = filter;
+
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &pi));
+  CHECK(parsebgp_mrt_peer_filter_match(filter, test_peer_index(msg), 1));
+  CHECK(parsebgp_mrt_peer_filter_match(filter, test_peer_index(msg), 2));
+  CHECK(!parsebgp_mrt_peer_filter_match(filter, test_peer_index(msg), 0));
+  CHECK(!parsebgp_mrt_peer_filter_match(filter, test_peer_index(msg), 9));
+
+  // the peer index table is kept when the message is cleared
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(check_rib_peers(msg, kept, 3) == 0);
+
+  // decoding does not change the filter itself
+  CHECK(!parsebgp_mrt_peer_filter_match(filter, NULL, 1));
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_mrt_peer_filter_destroy(filter);
+  tb_free(&pi);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_shared(void)
+{
+  // the same peer has a different index in each file
+  const char *ips1[] = {"192.0.2.1", "192.0.2.2", "192.0.2.3"};
+  uint32_t asns1[] = {65001, 65002, 65003};
+  const char *ips2[] = {"192.0.2.3", "192.0.2.1", "192.0.2.2"};
+  uint32_t asns2[] = {65003, 65001, 65002};
+  uint16_t all[] = {0, 1, 2}, kept1[] = {1}, kept2[] = {2};
+  parsebgp_mrt_peer_filter_t *filter;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg1 = parsebgp_create_msg();
+  parsebgp_msg_t *msg2 = parsebgp_create_msg();
+  test_buf_t pi1, pi2, tb;
+
+  tb_init(&pi1);
+  tb_init(&pi2);
+  tb_init(&tb);
+  tb_peer_index(&pi1, 3, ips1, asns1);
+  tb_peer_index(&pi2, 3, ips2, asns2);
+  tb_basic_rib(&tb, 0, 3, all, 3);
+
+  CHECK((filter = parsebgp_mrt_peer_filter_create()) != NULL);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_mrt_peer_filter_add_asn(filter, 65002));
+  parsebgp_opts_init(&opts);
+  opts.mrt_peer_filter = filter;
+
+  // interleave the decoding of the two "files" using a single filter
+  CHECK_ERR(PARSEBGP_OK,
+            test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg1, &pi1));
+  CHECK_ERR(PARSEBGP_OK,
+            test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg2, &pi2));
+  parsebgp_clear_msg(msg1);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg1, &tb));
+  CHECK(check_rib_peers(msg1, kept1, 1) == 0);
+  parsebgp_clear_msg(msg2);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg2, &tb));
+  CHECK(check_rib_peers(msg2, kept2, 1) == 0);
+
+  parsebgp_destroy_msg(msg1);
+  parsebgp_destroy_msg(msg2);
+  parsebgp_mrt_peer_filter_destroy(filter);
+  tb_free(&pi1);
+  tb_free(&pi2);
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_by_index),
+    TEST(test_by_asn_and_ip),
+    TEST(test_shared),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
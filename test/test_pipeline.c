@@ -0,0 +1,563 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include "parsebgp_pipeline.h"
+#include <pthread.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/* Tests for the concurrent parse pipeline */
+
+#define MSGS_CNT 200
+
+/* What the output callback saw */
+typedef struct run_state {
+
+  /** Number of times each sequence number was output */
+  int outputs[MSGS_CNT];
+
+  /** Number of messages output */
+  int cnt;
+
+  /** Number of messages that were output out of order, or not as expected */
+  int unordered;
+  int bad;
+
+  /** Number of messages decoded (by the workers) */
+  int decoded;
+
+  /** Delay (in us) of the workers for every Nth message (or PEER_INDEX_TABLE
+      if negative) */
+  int delay_every;
+
+  /** Sequence number to stop the pipeline at (-1 for none) */
+  int stop_at;
+
+} run_state_t;
+
+static void run_state_init(run_state_t *st)
+{
+  memset(st, 0, sizeof(*st));
+  st->stop_at = -1;
+}
+
+static int is_peer_index(const parsebgp_msg_t *msg)
+{
+  return msg->type == PARSEBGP_MSG_TYPE_MRT &&
+         msg->types.mrt->type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 &&
+         msg->types.mrt->subtype == PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE;
+}
+
+static void decoded_cb(uint64_t seq, parsebgp_error_t err, parsebgp_msg_t *msg,
+                       void *user)
+{
+  run_state_t *st = user;
+
+  // slow some messages down so that the workers finish out of order
+  if ((st->delay_every > 0 && seq % st->delay_every == 0) ||
+      (st->delay_every < 0 && is_peer_index(msg))) {
+    usleep(2000);
+  }
+  __atomic_fetch_add(&st->decoded, 1, __ATOMIC_RELAXED);
+}
+
+/* Check that the message is the BGP4MP message built for its sequence number
+   by build_updates */
+static parsebgp_error_t
+updates_output_cb(uint64_t seq, parsebgp_error_t err, parsebgp_msg_t *msg,
+                  const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index,
+                  void *user)
+{
+  run_state_t *st = user;
+
+  if (seq < MSGS_CNT) {
+    st->outputs[seq]++;
+  }
+  if (seq != (uint64_t)st->cnt) {
+    st->unordered++;
+  }
+  if (err != PARSEBGP_OK || msg->type != PARSEBGP_MSG_TYPE_MRT ||
+      msg->types.mrt->types.bgp4mp->peer_asn != 65000 + seq ||
+      test_update(msg) == NULL) {
+    st->bad++;
+  }
+  st->cnt++;
+  return (int)seq == st->stop_at ? PARSEBGP_INVALID_MSG : PARSEBGP_OK;
+}
+
+/* Build a stream of BGP4MP UPDATEs, each from a different peer */
+static void build_updates(test_buf_t *tb, int cnt)
+{
+  char prefix[32];
+  size_t off;
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    off = tb_bgp4mp_begin(tb, 1000 + i, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4,
+                          65000 + i, "192.0.2.1");
+    snprintf(prefix, sizeof(prefix), "10.%d.%d.0/24", i / 256, i % 256);
+    tb_simple_update(tb, 1, 65000 + i, prefix);
+    tb_mrt_end(tb, off);
+  }
+}
+
+/* Write the given data to a temporary file, ready to be read */
+static FILE *stream_file(const test_buf_t *tb, size_t len)
+{
+  FILE *fp;
+
+  if ((fp = tmpfile()) == NULL) {
+    return NULL;
+  }
+  if (len > 0 && fwrite(tb->buf, len, 1, fp) != 1) {
+    fclose(fp);
+    return NULL;
+  }
+  rewind(fp);
+  return fp;
+}
+
+/* Run the pipeline over the whole of tb */
+static parsebgp_error_t run(parsebgp_pipeline_t *pipeline,
+                            parsebgp_msg_type_t type, const test_buf_t *tb,
+                            size_t len)
+{
+  parsebgp_error_t err;
+  FILE *fp;
+
+  if ((fp = stream_file(tb, len)) == NULL) {
+    return PARSEBGP_INVALID_MSG;
+  }
+  err = parsebgp_pipeline_run(pipeline, type, fp);
+  fclose(fp);
+  return err;
+}
+
+static int test_ordered(void)
+{
+  parsebgp_pipeline_config_t config;
+  parsebgp_pipeline_t *pipeline;
+  run_state_t st;
+  test_buf_t tb;
+  int i, pass;
+
+  tb_init(&tb);
+  build_updates(&tb, MSGS_CNT);
+  parsebgp_pipeline_config_init(&config);
+  config.workers = 4;
+  config.window = 16;
+  config.decoded_cb = decoded_cb;
+  config.output_cb = updates_output_cb;
+  config.user = &st;
+  CHECK((pipeline = parsebgp_pipeline_create(&config)) != NULL);
+
+  // messages come out in order even though the workers finish out of order,
+  // and the pipeline can be used for several streams
+  for (pass = 0; pass < 2; pass++) {
+    run_state_init(&st);
+    st.delay_every = 7;
+    CHECK_ERR(PARSEBGP_OK,
+              run(pipeline, PARSEBGP_MSG_TYPE_MRT, &tb, tb.len));
+    CHECK(st.cnt == MSGS_CNT && st.decoded == MSGS_CNT);
+    CHECK(st.unordered == 0 && st.bad == 0);
+  }
+
+  parsebgp_pipeline_destroy(pipeline);
+
+  // without ordering, every message is still output exactly once
+  config.ordered = 0;
+  CHECK((pipeline = parsebgp_pipeline_create(&config)) != NULL);
+  run_state_init(&st);
+  st.delay_every = 7;
+  CHECK_ERR(PARSEBGP_OK, run(pipeline, PARSEBGP_MSG_TYPE_MRT, &tb, tb.len));
+  CHECK(st.cnt == MSGS_CNT && st.bad == 0);
+  for (i = 0; i < MSGS_CNT; i++) {
+    CHECK(st.outputs[i] == 1);
+  }
+  parsebgp_pipeline_destroy(pipeline);
+
+  tb_free(&tb);
+  return 0;
+}
+
+static long context_switches(void)
+{
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+static int test_idle(void)
+{
+  parsebgp_pipeline_config_t config;
+  parsebgp_pipeline_t *pipeline;
+  run_state_t st;
+  test_buf_t tb;
+  long before;
+  int pass;
+
+  tb_init(&tb);
+  build_updates(&tb, MSGS_CNT);
+  parsebgp_pipeline_config_init(&config);
+  config.workers = 4;
+  config.window = 16;
+  config.output_cb = updates_output_cb;
+  config.user = &st;
+  CHECK((pipeline = parsebgp_pipeline_create(&config)) != NULL);
+
+  for (pass = 0; pass < 2; pass++) {
+    // idle workers park rather than waking up to poll
+    usleep(50000);
+    before = context_switches();
+    usleep(200000);
+    CHECK(context_switches() - before < 50);
+
+    // and are woken by the next stream
+    run_state_init(&st);
+    CHECK_ERR(PARSEBGP_OK,
+              run(pipeline, PARSEBGP_MSG_TYPE_MRT, &tb, tb.len));
+    CHECK(st.cnt == MSGS_CNT && st.unordered == 0 && st.bad == 0);
+  }
+
+  parsebgp_pipeline_destroy(pipeline);
+  tb_free(&tb);
+  return 0;
+}
+
+/* Check that each RIB record is output with the table of its own dump (the
+   sequence number of the record is the index of the dump) */
+static parsebgp_error_t
+rib_output_cb(uint64_t seq, parsebgp_error_t err, parsebgp_msg_t *msg,
+              const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index,
+              void *user)
+{
+  run_state_t *st = user;
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib;
+
+  st->cnt++;
+  if (err != PARSEBGP_OK) {
+    st->bad++;
+  } else if ((rib = test_rib(msg)) != NULL &&
+             (peer_index == NULL || peer_index->peer_count != 1 ||
+              peer_index->peer_entries[0].asn != 65000 + rib->sequence)) {
+    st->bad++;
+  }
+  return PARSEBGP_OK;
+}
+
+static int test_peer_index_order(void)
+{
+  static const char *ips[] = {"192.0.2.1"};
+  parsebgp_pipeline_config_t config;
+  parsebgp_pipeline_t *pipeline;
+  run_state_t st;
+  test_buf_t tb, attrs;
+  uint32_t asn;
+  size_t off;
+  int dump, i, ordered;
+
+  tb_init(&tb);
+  tb_init(&attrs);
+  tb_attr_origin(&attrs, 0);
+  tb_attr_next_hop(&attrs, "192.0.2.1");
+  for (dump = 0; dump < 3; dump++) {
+    asn = 65000 + dump;
+    tb_peer_index(&tb, 1, ips, &asn);
+    for (i = 0; i < 30; i++) {
+      off = tb_rib_begin(&tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST,
+                         dump, "10.0.0.0/8", 1);
+      tb_rib_entry(&tb, 0, 0, 0, &attrs);
+      tb_mrt_end(&tb, off);
+    }
+  }
+
+  // the tables are slow to decode, so without special care the RIB records
+  // after them would be output first
+  for (ordered = 0; ordered < 2; ordered++) {
+    parsebgp_pipeline_config_init(&config);
+    config.workers = 4;
+    config.ordered = ordered;
+    config.decoded_cb = decoded_cb;
+    config.output_cb = rib_output_cb;
+    config.user = &st;
+    CHECK((pipeline = parsebgp_pipeline_create(&config)) != NULL);
+    run_state_init(&st);
+    st.delay_every = -1;
+    CHECK_ERR(PARSEBGP_OK, run(pipeline, PARSEBGP_MSG_TYPE_MRT, &tb, tb.len));
+    CHECK(st.cnt == 3 * 31);
+    CHECK(st.bad == 0);
+    parsebgp_pipeline_destroy(pipeline);
+  }
+
+  tb_free(&tb);
+  tb_free(&attrs);
+  return 0;
+}
+
+static int test_errors(void)
+{
+  parsebgp_pipeline_config_t config;
+  parsebgp_pipeline_t *pipeline;
+  run_state_t st;
+  test_buf_t tb;
+  int ordered;
+
+  tb_init(&tb);
+  build_updates(&tb, MSGS_CNT);
+  parsebgp_pipeline_config_init(&config);
+  config.workers = 4;
+  config.output_cb = updates_output_cb;
+  config.user = &st;
+
+  for (ordered = 0; ordered < 2; ordered++) {
+    config.ordered = ordered;
+    CHECK((pipeline = parsebgp_pipeline_create(&config)) != NULL);
+
+    // the output callback can stop the pipeline
+    run_state_init(&st);
+    st.stop_at = 5;
+    CHECK_ERR(PARSEBGP_INVALID_MSG,
+              run(pipeline, PARSEBGP_MSG_TYPE_MRT, &tb, tb.len));
+    CHECK(st.cnt <= MSGS_CNT && st.outputs[5] == 1);
+    if (ordered) {
+      CHECK(st.cnt == 6);
+    }
+
+    // a truncated stream is an error, once its messages have been output
+    run_state_init(&st);
+    CHECK_ERR(PARSEBGP_PARTIAL_MSG,
+              run(pipeline, PARSEBGP_MSG_TYPE_MRT, &tb, tb.len - 1));
+    CHECK(st.cnt == MSGS_CNT - 1 && st.bad == 0);
+
+    // as is an empty one
+    run_state_init(&st);
+    CHECK_ERR(PARSEBGP_OK, run(pipeline, PARSEBGP_MSG_TYPE_MRT, &tb, 0));
+    CHECK(st.cnt == 0);
+
+    parsebgp_pipeline_destroy(pipeline);
+  }
+
+  // options that are not thread-safe need a single worker
+  CHECK((config.opts.attr_cache = parsebgp_attr_cache_create(4)) != NULL);
+  CHECK(parsebgp_pipeline_create(&config) == NULL);
+  config.workers = 1;
+  CHECK((pipeline = parsebgp_pipeline_create(&config)) != NULL);
+  parsebgp_pipeline_destroy(pipeline);
+  parsebgp_attr_cache_destroy(config.opts.attr_cache);
+
+  config.output_cb = NULL;
+  CHECK(parsebgp_pipeline_create(&config) == NULL);
+
+  tb_free(&tb);
+  return 0;
+}
+
+#define PEERS_CNT 8
+
+/* What the workers saw of a sharded BMP stream */
+typedef struct shard_state {
+
+  pthread_mutex_t lock;
+
+  /** Sequence number of the last message decoded for each peer (plus one) */
+  uint64_t last_seq[PEERS_CNT];
+
+  /** Worker that decoded the messages of each peer */
+  pthread_t worker[PEERS_CNT];
+
+  /** Number of messages decoded */
+  uint64_t decoded;
+
+  /** Sequence number of the last message decoded on its own (Initiation,
+      Termination or one whose peer header cannot be decoded) */
+  uint64_t barrier;
+
+  /** Number of messages that could not be decoded */
+  int invalid;
+
+  /** Number of messages output */
+  uint64_t output;
+
+  /** Number of problems seen */
+  int bad;
+
+} shard_state_t;
+
+static void shard_decoded_cb(uint64_t seq, parsebgp_error_t err,
+                             parsebgp_msg_t *msg, void *user)
+{
+  shard_state_t *st = user;
+  parsebgp_bmp_msg_t *bmp = msg->types.bmp;
+  int peer;
+
+  // give the other workers a chance to get ahead
+  if (seq % 5 == 0) {
+    usleep(500);
+  }
+
+  pthread_mutex_lock(&st->lock);
+  if (err != PARSEBGP_OK || bmp->type == PARSEBGP_BMP_TYPE_INIT_MSG ||
+      bmp->type == PARSEBGP_BMP_TYPE_TERM_MSG) {
+    // decoded after all earlier messages
+    if (st->decoded != seq) {
+      st->bad++;
+    }
+    st->barrier = seq;
+    if (err != PARSEBGP_OK) {
+      st->invalid++;
+    }
+  } else {
+    // decoded after the last barrier, in order and by one worker per peer
+    peer = bmp->peer_hdr.asn - 65000;
+    if (seq < st->barrier || st->last_seq[peer] > seq ||
+        (st->last_seq[peer] != 0 &&
+         !pthread_equal(st->worker[peer], pthread_self()))) {
+      st->bad++;
+    }
+    st->last_seq[peer] = seq + 1;
+    st->worker[peer] = pthread_self();
+  }
+  st->decoded++;
+  pthread_mutex_unlock(&st->lock);
+}
+
+static parsebgp_error_t
+shard_output_cb(uint64_t seq, parsebgp_error_t err, parsebgp_msg_t *msg,
+                const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index,
+                void *user)
+{
+  shard_state_t *st = user;
+
+  if (seq != st->output++) {
+    st->bad++;
+  }
+  return PARSEBGP_OK;
+}
+
+/* Append a BMP Initiation (or Termination) message */
+static void build_init_term(test_buf_t *tb, int term)
+{
+  size_t off = tb_bmp_begin(tb, term ? PARSEBGP_BMP_TYPE_TERM_MSG
+                                     : PARSEBGP_BMP_TYPE_INIT_MSG);
+
+  if (term) {
+    tb_u16(tb, PARSEBGP_BMP_TERM_INFO_TYPE_REASON);
+    tb_u16(tb, 2);
+    tb_u16(tb, 0);
+  } else {
+    tb_u16(tb, 2); // sysName
+    tb_u16(tb, 4);
+    tb_bytes(tb, "test", 4);
+  }
+  tb_bmp_end(tb, off);
+}
+
+/* Append a Route Monitoring message too short to hold a peer header */
+static void build_bad_peer_hdr(test_buf_t *tb)
+{
+  size_t off = tb_bmp_begin(tb, PARSEBGP_BMP_TYPE_ROUTE_MON);
+
+  tb_u8(tb, 0); // global instance peer
+  tb_u8(tb, 0);
+  tb_bmp_end(tb, off);
+}
+
+/* Append Route Monitoring messages from a mix of peers */
+static void build_route_mons(test_buf_t *tb, int cnt)
+{
+  char ip[32], prefix[32];
+  size_t off;
+  int i, peer;
+
+  for (i = 0; i < cnt; i++) {
+    peer = (i * 5 + i / 3) % PEERS_CNT;
+    snprintf(ip, sizeof(ip), "192.0.2.%d", peer + 1);
+    snprintf(prefix, sizeof(prefix), "10.%d.0.0/16", i);
+    off = tb_bmp_begin(tb, PARSEBGP_BMP_TYPE_ROUTE_MON);
+    // pre- and post-policy messages are from the same peer
+    tb_bmp_peer_hdr(tb, (i % 2) ? PARSEBGP_BMP_PEER_FLAG_POST_POLICY : 0, ip,
+                    65000 + peer);
+    tb_simple_update(tb, 1, 65000 + peer, prefix);
+    tb_bmp_end(tb, off);
+  }
+}
+
+static int test_shard_bmp_peers(void)
+{
+  parsebgp_pipeline_config_t config;
+  parsebgp_pipeline_t *pipeline;
+  shard_state_t st;
+  test_buf_t tb;
+  FILE *fp;
+
+  tb_init(&tb);
+  build_init_term(&tb, 0);
+  build_route_mons(&tb, 100);
+  build_init_term(&tb, 1);
+  build_route_mons(&tb, 100);
+  build_bad_peer_hdr(&tb);
+  build_route_mons(&tb, 100);
+  build_init_term(&tb, 1);
+
+  parsebgp_pipeline_config_init(&config);
+  config.workers = 4;
+  config.window = 32;
+  config.shard_bmp_peers = 1;
+  config.decoded_cb = shard_decoded_cb;
+  config.output_cb = shard_output_cb;
+  config.user = &st;
+  CHECK((pipeline = parsebgp_pipeline_create(&config)) != NULL);
+
+  memset(&st, 0, sizeof(st));
+  pthread_mutex_init(&st.lock, NULL);
+  CHECK((fp = stream_file(&tb, tb.len)) != NULL);
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_pipeline_run(pipeline, PARSEBGP_MSG_TYPE_BMP, fp));
+  fclose(fp);
+  CHECK(st.decoded == 304 && st.output == 304);
+  CHECK(st.barrier == 303 && st.invalid == 1);
+  CHECK(st.bad == 0);
+  pthread_mutex_destroy(&st.lock);
+
+  parsebgp_pipeline_destroy(pipeline);
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_ordered),
+    TEST(test_idle),
+    TEST(test_peer_index_order),
+    TEST(test_errors),
+    TEST(test_shard_bmp_peers),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
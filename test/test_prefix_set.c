@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <arpa/inet.h>
+#include <string.h>
+
+/* Tests for prefix sets */
+
+static int match_str(const parsebgp_prefix_set_t *set,
+                     parsebgp_prefix_set_match_t match, const char *prefix)
+{
+  char addr[INET6_ADDRSTRLEN];
+  uint8_t buf[16];
+  const char *slash = strchr(prefix, '/');
+  int v6 = strchr(prefix, ':') != NULL;
+
+  memcpy(addr, prefix, slash - prefix);
+  addr[slash - prefix] = '\0';
+  inet_pton(v6 ? AF_INET6 : AF_INET, addr, buf);
+  return parsebgp_prefix_set_match(
+    set, match, v6 ? PARSEBGP_BGP_AFI_IPV6 : PARSEBGP_BGP_AFI_IPV4, buf,
+    atoi(slash + 1));
+}
+
+static int test_add(void)
+{
+  const char *bad[] = {"10.0.0.0/33", "10.0.0.0", "foo/8", "10.0.0.0/x",
+                       "2001:db8::/129", "/8", "10.0.0.0/-1"};
+  parsebgp_prefix_set_t *set;
+  uint8_t addr[16] = {10};
+  size_t i;
+
+  CHECK((set = parsebgp_prefix_set_create()) != NULL);
+  CHECK(parsebgp_prefix_set_size(set) == 0);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "10.0.0.0/8"));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "2001:db8::/32"));
+  CHECK(parsebgp_prefix_set_size(set) == 2);
+
+  // duplicates (including ones that differ only in their host bits)
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "10.0.0.0/8"));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "10.1.2.3/8"));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add(set, PARSEBGP_BGP_AFI_IPV4,
+                                                 addr, 8));
+  CHECK(parsebgp_prefix_set_size(set) == 2);
+  CHECK(match_str(set, PARSEBGP_PREFIX_SET_MATCH_EXACT, "10.0.0.0/8"));
+
+  for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    if (parsebgp_prefix_set_add_str(set, bad[i]) != PARSEBGP_INVALID_MSG) {
+      fprintf(stderr, "'%s' was accepted\n", bad[i]);
+      return -1;
+    }
+  }
+  CHECK_ERR(PARSEBGP_INVALID_MSG, parsebgp_prefix_set_add(set, 3, addr, 8));
+  CHECK_ERR(PARSEBGP_INVALID_MSG,
+            parsebgp_prefix_set_add(set, PARSEBGP_BGP_AFI_IPV4, addr, 33));
+  CHECK(parsebgp_prefix_set_size(set) == 2);
+
+  parsebgp_prefix_set_destroy(set);
+  return 0;
+}
+
+static int test_match(void)
+{
+  parsebgp_prefix_set_t *set;
+
+  CHECK((set = parsebgp_prefix_set_create()) != NULL);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "10.0.0.0/8"));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "10.128.0.0/9"));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "10.0.0.0/16"));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "192.0.2.1/32"));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "2001:db8::/32"));
+
+  CHECK(match_str(set, PARSEBGP_PREFIX_SET_MATCH_EXACT, "10.128.0.0/9"));
+  CHECK(!match_str(set, PARSEBGP_PREFIX_SET_MATCH_EXACT, "10.64.0.0/10"));
+  CHECK(!match_str(set, PARSEBGP_PREFIX_SET_MATCH_EXACT, "10.0.0.0/9"));
+  CHECK(!match_str(set, PARSEBGP_PREFIX_SET_MATCH_EXACT, "192.0.2.0/24"));
+
+  CHECK(match_str(set, PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC,
+                  "10.64.0.0/10"));
+  CHECK(match_str(set, PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC,
+                  "10.0.0.0/8"));
+  CHECK(!match_str(set, PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC,
+                   "11.0.0.0/8"));
+  CHECK(!match_str(set, PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC,
+                   "10.0.0.0/7"));
+
+  CHECK(match_str(set, PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC, "10.0.0.0/7"));
+  CHECK(match_str(set, PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC, "0.0.0.0/0"));
+  CHECK(match_str(set, PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC,
+                  "192.0.2.0/24"));
+  CHECK(!match_str(set, PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC,
+                   "10.64.0.0/10"));
+  CHECK(!match_str(set, PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC,
+                   "192.0.3.0/24"));
+
+  // address families are kept apart
+  CHECK(match_str(set, PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC,
+                  "2001:db8:1::/48"));
+  CHECK(!match_str(set, PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC,
+                   "2001:db9::/32"));
+  CHECK(match_str(set, PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC, "::/0"));
+  CHECK(!match_str(set, PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC,
+                   "::ffff:10.0.0.0/104"));
+
+  parsebgp_prefix_set_destroy(set);
+  return 0;
+}
+
+/* Does a (of length alen) cover b (of length blen)? */
+static int covers(const uint8_t *a, int alen, const uint8_t *b, int blen)
+{
+  int i;
+  if (alen > blen) {
+    return 0;
+  }
+  for (i = 0; i < alen; i++) {
+    if (((a[i / 8] >> (7 - i % 8)) & 1) != ((b[i / 8] >> (7 - i % 8)) & 1)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int test_match_exhaustive(void)
+{
+  // prefixes are drawn from a small space so that they often overlap
+#define MEMBERS 64
+#define PROBES 2000
+  uint8_t members[MEMBERS][16];
+  int members_len[MEMBERS];
+  uint8_t probe[16];
+  int probe_len;
+  uint32_t r = 42;
+  parsebgp_prefix_set_t *set;
+  int i, j, m, expected;
+
+  CHECK((set = parsebgp_prefix_set_create()) != NULL);
+  memset(members, 0, sizeof(members));
+  for (i = 0; i < MEMBERS; i++) {
+    r = r * 1103515245 + 12345;
+    members[i][0] = 10;
+    members[i][1] = (r >> 16) & 0xf0;
+    members[i][2] = (r >> 8) & 0xc0;
+    members_len[i] = 8 + (r >> 24) % 12;
+    CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add(set, PARSEBGP_BGP_AFI_IPV4,
+                                                   members[i], members_len[i]));
+  }
+
+  for (j = 0; j < PROBES; j++) {
+    r = r * 1103515245 + 12345;
+    memset(probe, 0, sizeof(probe));
+    probe[0] = 10;
+    probe[1] = (r >> 16) & 0xf0;
+    probe[2] = (r >> 8) & 0xc0;
+    probe_len = 6 + (r >> 24) % 16;
+    // host bits are ignored, so compare using only the network bits
+    for (m = PARSEBGP_PREFIX_SET_MATCH_EXACT;
+         m <= PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC; m++) {
+      expected = 0;
+      for (i = 0; i < MEMBERS && !expected; i++) {
+        switch (m) {
+        case PARSEBGP_PREFIX_SET_MATCH_EXACT:
+          expected = members_len[i] == probe_len &&
+                     covers(members[i], members_len[i], probe, probe_len);
+          break;
+        case PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC:
+          expected = covers(members[i], members_len[i], probe, probe_len);
+          break;
+        case PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC:
+          expected = covers(probe, probe_len, members[i], members_len[i]);
+          break;
+        }
+      }
+      if (parsebgp_prefix_set_match(set, m, PARSEBGP_BGP_AFI_IPV4, probe,
+                                    probe_len) != expected) {
+        fprintf(stderr, "probe %d.%d.%d.0/%d mode %d: expected %d\n", probe[0],
+                probe[1], probe[2], probe_len, m, expected);
+        return -1;
+      }
+    }
+  }
+  parsebgp_prefix_set_destroy(set);
+  return 0;
+}
+
+static int test_decode_update(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_prefix_set_t *set;
+  parsebgp_bgp_update_t *update;
+  test_buf_t withdrawn, attrs, nlri, nh, mp_nlri, tb;
+  char buf[64];
+  size_t len;
+
+  tb_init(&withdrawn);
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&nh);
+  tb_init(&mp_nlri);
+  tb_init(&tb);
+  tb_prefix(&withdrawn, "10.9.0.0/16");
+  tb_prefix(&withdrawn, "172.16.0.0/12");
+  tb_basic_attrs(&attrs, 1);
+  tb_ip6(&nh, "2001:db8::1");
+  tb_prefix(&mp_nlri, "2001:db8:1::/48");
+  tb_prefix(&mp_nlri, "2001:db9::/32");
+  tb_attr_mp_reach(&attrs, PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_UNICAST, &nh,
+                   &mp_nlri);
+  tb_prefix(&nlri, "192.168.0.0/16");
+  tb_prefix(&nlri, "10.1.0.0/16");
+  tb_prefix(&nlri, "10.2.0.0/16");
+  tb_bgp_update(&tb, &withdrawn, &attrs, &nlri);
+
+  CHECK((set = parsebgp_prefix_set_create()) != NULL);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "10.0.0.0/8"));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "2001:db8::/32"));
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.prefix_set = set;
+  opts.prefix_set_match = PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC;
+
+  // only the matching prefixes are kept, in their original order
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->withdrawn_nlris.prefixes_cnt == 1);
+  CHECK(strcmp(test_prefix_str(&update->withdrawn_nlris.prefixes[0], buf),
+               "10.9.0.0/16") == 0);
+  CHECK(update->announced_nlris.prefixes_cnt == 2);
+  CHECK(strcmp(test_prefix_str(&update->announced_nlris.prefixes[0], buf),
+               "10.1.0.0/16") == 0);
+  CHECK(strcmp(test_prefix_str(&update->announced_nlris.prefixes[1], buf),
+               "10.2.0.0/16") == 0);
+  CHECK(update->path_attrs.attrs[14].data.mp_reach->nlris_cnt == 1);
+  CHECK(strcmp(test_prefix_str(
+                 &update->path_attrs.attrs[14].data.mp_reach->nlris[0], buf),
+               "2001:db8:1::/48") == 0);
+
+  // an UPDATE with no matching prefixes is skipped
+  parsebgp_clear_msg(msg);
+  parsebgp_prefix_set_destroy(set);
+  CHECK((set = parsebgp_prefix_set_create()) != NULL);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "203.0.113.0/24"));
+  opts.prefix_set = set;
+  len = tb.len;
+  CHECK_ERR(PARSEBGP_FILTERED_OUT,
+            parsebgp_decode(opts, PARSEBGP_MSG_TYPE_BGP, msg, tb.buf, &len));
+  CHECK(len == tb.len);
+
+  // but other messages are not affected
+  parsebgp_clear_msg(msg);
+  tb_reset(&tb);
+  tb_bgp_open(&tb, 65001, 1, 0);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_prefix_set_destroy(set);
+  tb_free(&withdrawn);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&nh);
+  tb_free(&mp_nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_decode_rib(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_prefix_set_t *set;
+  uint16_t peer = 0;
+  test_buf_t tb;
+  size_t len;
+
+  tb_init(&tb);
+  tb_basic_rib(&tb, 0, 1, &peer, 1);
+
+  CHECK((set = parsebgp_prefix_set_create()) != NULL);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_prefix_set_add_str(set, "10.0.0.0/16"));
+  parsebgp_opts_init(&opts);
+  opts.prefix_set = set;
+
+  opts.prefix_set_match = PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC;
+  len = tb.len;
+  CHECK_ERR(PARSEBGP_FILTERED_OUT,
+            parsebgp_decode(opts, PARSEBGP_MSG_TYPE_MRT, msg, tb.buf, &len));
+  CHECK(len == tb.len);
+
+  opts.prefix_set_match = PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(test_rib(msg)->entry_count == 1);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_prefix_set_destroy(set);
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_add),
+    TEST(test_match),
+    TEST(test_match_exhaustive),
+    TEST(test_decode_update),
+    TEST(test_decode_rib),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
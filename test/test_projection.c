@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Tests for the projection option */
+
+/* An UPDATE with two withdrawn prefixes, an MP_REACH_NLRI with one IPv6
+   prefix, and one announced prefix */
+static void build_update(test_buf_t *tb)
+{
+  test_buf_t withdrawn, attrs, nlri, nh, mp_nlri;
+
+  tb_init(&withdrawn);
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&nh);
+  tb_init(&mp_nlri);
+  tb_prefix(&withdrawn, "198.51.100.0/24");
+  tb_prefix(&withdrawn, "198.51.101.0/24");
+  tb_basic_attrs(&attrs, 1);
+  tb_ip6(&nh, "2001:db8::1");
+  tb_prefix(&mp_nlri, "2001:db8:1::/48");
+  tb_attr_mp_reach(&attrs, PARSEBGP_BGP_AFI_IPV6, PARSEBGP_BGP_SAFI_UNICAST, &nh,
+                   &mp_nlri);
+  tb_prefix(&nlri, "10.0.0.0/8");
+  tb_bgp_update(tb, &withdrawn, &attrs, &nlri);
+  tb_free(&withdrawn);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&nh);
+  tb_free(&mp_nlri);
+}
+
+static int test_bgp_sections(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_t *update;
+  test_buf_t tb;
+
+  tb_init(&tb);
+  build_update(&tb);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+
+  // everything (a projection is ignored unless it is enabled)
+  opts.projection = 0;
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->withdrawn_nlris.prefixes_cnt == 2);
+  CHECK(update->path_attrs.attrs_cnt == 4);
+  CHECK(update->path_attrs.attrs[14].data.mp_reach->nlris_cnt == 1);
+  CHECK(update->announced_nlris.prefixes_cnt == 1);
+
+  // only the announced prefixes (reusing the message)
+  opts.projection_enabled = 1;
+  opts.projection = PARSEBGP_PROJ_BGP_ANNOUNCED;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->withdrawn_nlris.prefixes_cnt == 0);
+  CHECK(update->withdrawn_nlris.len == 8);
+  CHECK(update->path_attrs.attrs_cnt == 0);
+  CHECK(update->announced_nlris.prefixes_cnt == 1);
+
+  // only the path attributes: MP_REACH_NLRI is decoded, but not its prefixes
+  opts.projection = PARSEBGP_PROJ_BGP_PATH_ATTRS;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->withdrawn_nlris.prefixes_cnt == 0);
+  CHECK(update->path_attrs.attrs_cnt == 4);
+  CHECK(update->path_attrs.attrs[14].data.mp_reach->afi ==
+        PARSEBGP_BGP_AFI_IPV6);
+  CHECK(update->path_attrs.attrs[14].data.mp_reach->nlris_cnt == 0);
+  CHECK(update->announced_nlris.prefixes_cnt == 0);
+
+  // nothing but the headers
+  opts.projection = 0;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->withdrawn_nlris.prefixes_cnt == 0);
+  CHECK(update->path_attrs.attrs_cnt == 0);
+  CHECK(update->announced_nlris.prefixes_cnt == 0);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_skipped_sections_checked(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  test_buf_t tb;
+  size_t len;
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.projection_enabled = 1;
+  opts.projection = PARSEBGP_PROJ_BGP_ANNOUNCED;
+  opts.silence_invalid = 1;
+
+  // a skipped section must still fit in the message
+  tb_init(&tb);
+  build_update(&tb);
+  tb_put16(&tb, 19, 1000);
+  len = tb.len;
+  CHECK(parsebgp_decode(opts, PARSEBGP_MSG_TYPE_BGP, msg, tb.buf, &len) !=
+        PARSEBGP_OK);
+
+  // and a truncated message is still partial
+  parsebgp_clear_msg(msg);
+  tb_reset(&tb);
+  build_update(&tb);
+  len = tb.len - 5;
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG,
+            parsebgp_decode(opts, PARSEBGP_MSG_TYPE_BGP, msg, tb.buf, &len));
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_bmp_bodies(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  test_buf_t tb;
+  size_t off;
+
+  tb_init(&tb);
+  off = tb_bmp_begin(&tb, PARSEBGP_BMP_TYPE_ROUTE_MON);
+  tb_bmp_peer_hdr(&tb, 0, "192.0.2.1", 65001);
+  build_update(&tb);
+  tb_bmp_end(&tb, off);
+
+  parsebgp_opts_init(&opts);
+  opts.projection_enabled = 1;
+  opts.projection = PARSEBGP_PROJ_ALL & ~PARSEBGP_PROJ_BMP_ROUTE_MON;
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BMP, msg, &tb));
+  CHECK(msg->types.bmp->types_valid == 0);
+  CHECK(msg->types.bmp->peer_hdr.asn == 65001);
+  CHECK(test_update(msg) == NULL ||
+        test_update(msg)->announced_nlris.prefixes_cnt == 0);
+
+  opts.projection = PARSEBGP_PROJ_ALL;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BMP, msg, &tb));
+  CHECK(msg->types.bmp->types_valid == 1);
+  CHECK(test_update(msg)->announced_nlris.prefixes_cnt == 1);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_mrt_sections(void)
+{
+  const char *ips[] = {"192.0.2.1", "192.0.2.2"};
+  uint32_t asns[] = {65001, 65002};
+  uint16_t peers[] = {0, 1};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib;
+  test_buf_t pi, tb;
+
+  tb_init(&pi);
+  tb_init(&tb);
+  tb_peer_index(&pi, 2, ips, asns);
+  tb_basic_rib(&tb, 5, 2, peers, 2);
+
+  parsebgp_opts_init(&opts);
+  opts.projection_enabled = 1;
+  opts.projection = PARSEBGP_PROJ_ALL & ~PARSEBGP_PROJ_MRT_PEER_INDEX &
+                    ~PARSEBGP_PROJ_MRT_RIB_ENTRIES;
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &pi));
+  CHECK(test_peer_index(msg)->peer_count == 0);
+
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((rib = test_rib(msg)) != NULL);
+  CHECK(rib->sequence == 5 && rib->prefix_len == 8 && rib->prefix[0] == 10);
+  CHECK(rib->entry_count == 0);
+
+  // RIB entries without their path attributes
+  opts.projection = PARSEBGP_PROJ_ALL & ~PARSEBGP_PROJ_BGP_PATH_ATTRS;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((rib = test_rib(msg)) != NULL);
+  CHECK(rib->entry_count == 2);
+  CHECK(rib->entries[1].peer_index == 1);
+  CHECK(rib->entries[0].path_attrs.attrs_cnt == 0);
+  CHECK(rib->entries[1].path_attrs.attrs_cnt == 0);
+
+  opts.projection = PARSEBGP_PROJ_ALL;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(test_rib(msg)->entries[1].path_attrs.attrs_cnt == 2);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&pi);
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_bgp_sections),
+    TEST(test_skipped_sections_checked),
+    TEST(test_bmp_bodies),
+    TEST(test_mrt_sections),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
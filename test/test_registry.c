@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Tests for the Path Attribute handler registry */
+
+static int otc_clears;
+static int otc_destroys;
+static int comm_decodes;
+
+static parsebgp_error_t otc_decode(parsebgp_opts_t *opts,
+                                   parsebgp_bgp_update_path_attr_t *attr,
+                                   const uint8_t *buf, size_t *lenp,
+                                   size_t remain)
+{
+  if (remain != 4 || *lenp < 4) {
+    return PARSEBGP_INVALID_MSG;
+  }
+  attr->data.user = (void *)(uintptr_t)(((uint32_t)buf[0] << 24) |
+                                         (buf[1] << 16) | (buf[2] << 8) |
+                                         buf[3]);
+  *lenp = 4;
+  return PARSEBGP_OK;
+}
+
+static void otc_clear(parsebgp_bgp_update_path_attr_t *attr)
+{
+  otc_clears++;
+}
+
+static void otc_destroy(parsebgp_bgp_update_path_attr_t *attr)
+{
+  otc_destroys++;
+}
+
+static parsebgp_error_t raw_decode(parsebgp_opts_t *opts,
+                                   parsebgp_bgp_update_path_attr_t *attr,
+                                   const uint8_t *buf, size_t *lenp,
+                                   size_t remain)
+{
+  attr->data.user = (void *)buf;
+  *lenp = remain;
+  return PARSEBGP_OK;
+}
+
+static parsebgp_error_t comm_decode(parsebgp_opts_t *opts,
+                                    parsebgp_bgp_update_path_attr_t *attr,
+                                    const uint8_t *buf, size_t *lenp,
+                                    size_t remain)
+{
+  const parsebgp_bgp_update_path_attr_handler_t *builtin =
+    parsebgp_bgp_update_path_attr_handler_get(NULL, attr->type);
+  comm_decodes++;
+  return builtin->decode(opts, attr, buf, lenp, remain);
+}
+
+/* An UPDATE with COMMUNITIES, an OTC (35) and an unassigned (200) attribute */
+static void build_update(test_buf_t *tb)
+{
+  test_buf_t attrs, nlri;
+  uint32_t comm = 0xfde80064;
+  uint8_t otc[4] = {0, 0, 0xfd, 0xe9};
+  uint8_t unknown[3] = {1, 2, 3};
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_basic_attrs(&attrs, 1);
+  tb_attr_communities(&attrs, &comm, 1);
+  tb_attr(&attrs, 0xc0, 35, otc, sizeof(otc));
+  tb_attr(&attrs, 0xc0, 200, unknown, sizeof(unknown));
+  tb_prefix(&nlri, "10.0.0.0/8");
+  tb_bgp_update(tb, NULL, &attrs, &nlri);
+  tb_free(&attrs);
+  tb_free(&nlri);
+}
+
+static int test_builtin_only(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_t *update;
+  test_buf_t tb;
+
+  tb_init(&tb);
+  build_update(&tb);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.ignore_not_implemented = 1;
+  opts.silence_not_implemented = 1;
+
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  // the built-in handlers decode COMMUNITIES but not the others
+  CHECK(update->path_attrs.attrs[8].type == 8);
+  CHECK(update->path_attrs.attrs[8].data.communities->communities_cnt == 1);
+  CHECK(parsebgp_bgp_update_path_attr_get(&update->path_attrs, 35) == NULL);
+  CHECK(parsebgp_bgp_update_path_attr_get(&update->path_attrs, 200) == NULL);
+
+  // without ignore_not_implemented, the unknown attributes are an error
+  opts.ignore_not_implemented = 0;
+  parsebgp_clear_msg(msg);
+  CHECK(test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb) ==
+        PARSEBGP_NOT_IMPLEMENTED);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_custom_handlers(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_path_attr_registry_t *reg;
+  parsebgp_bgp_update_path_attr_handler_t otc = {otc_decode, otc_clear,
+                                                 otc_destroy, NULL};
+  parsebgp_bgp_update_path_attr_handler_t raw = {raw_decode, NULL, NULL, NULL};
+  const parsebgp_bgp_update_path_attr_t *attr;
+  parsebgp_bgp_update_t *update;
+  test_buf_t tb;
+
+  tb_init(&tb);
+  build_update(&tb);
+  CHECK((reg = parsebgp_bgp_update_path_attr_registry_create()) != NULL);
+  parsebgp_bgp_update_path_attr_register(reg, 35, &otc);
+  parsebgp_bgp_update_path_attr_register(reg, 200, &raw);
+  CHECK(parsebgp_bgp_update_path_attr_handler_get(reg, 35)->decode ==
+        otc_decode);
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.bgp.path_attr_registry = reg;
+  otc_clears = otc_destroys = 0;
+
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->path_attrs.attrs_cnt == 6);
+  CHECK((attr = parsebgp_bgp_update_path_attr_get(&update->path_attrs, 35)) !=
+        NULL);
+  // types beyond the attrs array live in attrs_ext
+  CHECK(attr->type == 35 && attr->len == 4);
+  CHECK((uintptr_t)attr->data.user == 65001);
+  CHECK((attr = parsebgp_bgp_update_path_attr_get(&update->path_attrs,
+                                                  200)) != NULL);
+  CHECK(attr->type == 200 && attr->len == 3);
+  CHECK(((const uint8_t *)attr->data.user)[2] == 3);
+  CHECK(update->path_attrs.attrs[8].data.communities->communities_cnt == 1);
+
+  // the message remembers the registry it was decoded with, so clearing and
+  // destroying it call our handlers
+  parsebgp_clear_msg(msg);
+  CHECK(otc_clears == 1);
+  CHECK(parsebgp_bgp_update_path_attr_get(&update->path_attrs, 35) == NULL);
+
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  parsebgp_destroy_msg(msg);
+  CHECK(otc_destroys >= 1);
+
+  parsebgp_bgp_update_path_attr_registry_destroy(reg);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_wrap_and_remove_builtin(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_path_attr_registry_t *reg;
+  parsebgp_bgp_update_path_attr_handler_t comm =
+    *parsebgp_bgp_update_path_attr_handler_get(NULL, 8);
+  parsebgp_bgp_update_t *update;
+  test_buf_t tb;
+
+  tb_init(&tb);
+  build_update(&tb);
+  CHECK((reg = parsebgp_bgp_update_path_attr_registry_create()) != NULL);
+  comm.decode = comm_decode;
+  parsebgp_bgp_update_path_attr_register(reg, 8, &comm);
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.bgp.path_attr_registry = reg;
+  opts.ignore_not_implemented = 1;
+  opts.silence_not_implemented = 1;
+  comm_decodes = 0;
+
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK(comm_decodes == 1);
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->path_attrs.attrs[8].data.communities->communities_cnt == 1);
+  CHECK(update->path_attrs.attrs[8].data.communities->communities[0] ==
+        0xfde80064);
+
+  // removing the handler makes COMMUNITIES unsupported: the attribute header
+  // is still recorded, but its data is not decoded (the registry must not be
+  // changed while a message decoded using it is still around)
+  parsebgp_destroy_msg(msg);
+  msg = parsebgp_create_msg();
+  parsebgp_bgp_update_path_attr_register(reg, 8, NULL);
+  CHECK(parsebgp_bgp_update_path_attr_handler_get(reg, 8)->decode == NULL);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+  CHECK(comm_decodes == 1);
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->path_attrs.attrs[8].type == 8);
+  CHECK(update->path_attrs.attrs[8].len == 4);
+  CHECK(parsebgp_bgp_update_path_attr_get(&update->path_attrs, 1) != NULL);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_bgp_update_path_attr_registry_destroy(reg);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_handler_error(void)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_path_attr_registry_t *reg;
+  parsebgp_bgp_update_path_attr_handler_t otc = {otc_decode, NULL, NULL, NULL};
+  test_buf_t attrs, tb;
+  uint8_t bad[2] = {0, 1};
+
+  // a handler's error is returned by the decoder
+  tb_init(&attrs);
+  tb_init(&tb);
+  tb_attr_origin(&attrs, 0);
+  tb_attr(&attrs, 0xc0, 35, bad, sizeof(bad));
+  tb_bgp_update(&tb, NULL, &attrs, NULL);
+  CHECK((reg = parsebgp_bgp_update_path_attr_registry_create()) != NULL);
+  parsebgp_bgp_update_path_attr_register(reg, 35, &otc);
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.path_attr_registry = reg;
+  opts.silence_invalid = 1;
+  CHECK_ERR(PARSEBGP_INVALID_MSG,
+            test_decode(&opts, PARSEBGP_MSG_TYPE_BGP, msg, &tb));
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_bgp_update_path_attr_registry_destroy(reg);
+  tb_free(&attrs);
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_builtin_only),
+    TEST(test_custom_handlers),
+    TEST(test_wrap_and_remove_builtin),
+    TEST(test_handler_error),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
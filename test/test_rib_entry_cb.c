@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Tests for streaming TABLE_DUMP_V2 RIB entries to a callback */
+
+typedef struct cb_state {
+  int calls;
+  int fail_at;
+  int bad_count;
+  uint16_t peers[8];
+} cb_state_t;
+
+static parsebgp_error_t
+entry_cb(const parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib,
+         const parsebgp_mrt_table_dump_v2_rib_entry_t *entry, void *user)
+{
+  cb_state_t *state = user;
+
+  // the record appears to hold just the current entry
+  if (rib->entry_count != 1 || entry != &rib->entries[0] ||
+      entry->path_attrs.attrs_cnt != 2) {
+    state->bad_count++;
+  }
+  state->peers[state->calls++] = entry->peer_index;
+  return state->calls == state->fail_at ? PARSEBGP_INVALID_MSG : PARSEBGP_OK;
+}
+
+static int test_streamed(void)
+{
+  uint16_t peers[] = {0, 1, 2};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  cb_state_t state;
+  test_buf_t tb;
+
+  tb_init(&tb);
+  tb_basic_rib(&tb, 0, 3, peers, 3);
+  memset(&state, 0, sizeof(state));
+  parsebgp_opts_init(&opts);
+  opts.mrt_rib_entry_cb = entry_cb;
+  opts.mrt_rib_entry_cb_user = &state;
+
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(state.calls == 3);
+  CHECK(state.bad_count == 0);
+  CHECK(memcmp(state.peers, peers, sizeof(peers)) == 0);
+  CHECK(test_rib(msg)->entry_count == 0);
+
+  // the same message can then be used to collect the entries
+  opts.mrt_rib_entry_cb = NULL;
+  parsebgp_clear_msg(msg);
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(test_rib(msg)->entry_count == 3);
+  CHECK(test_rib(msg)->entries[2].peer_index == 2);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_errors(void)
+{
+  uint16_t peers[] = {0, 1, 2};
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  cb_state_t state;
+  test_buf_t tb;
+  size_t len;
+
+  tb_init(&tb);
+  tb_basic_rib(&tb, 0, 3, peers, 3);
+  memset(&state, 0, sizeof(state));
+  parsebgp_opts_init(&opts);
+  opts.mrt_rib_entry_cb = entry_cb;
+  opts.mrt_rib_entry_cb_user = &state;
+
+  // an error from the callback stops decoding, and no entries are left behind
+  state.fail_at = 2;
+  len = tb.len;
+  CHECK_ERR(PARSEBGP_INVALID_MSG,
+            parsebgp_decode(opts, PARSEBGP_MSG_TYPE_MRT, msg, tb.buf, &len));
+  CHECK(state.calls == 2);
+  CHECK(test_rib(msg)->entry_count == 0);
+
+  // as is the case if an entry is missing
+  tb_reset(&tb);
+  tb_basic_rib(&tb, 0, 3, peers, 2);
+  memset(&state, 0, sizeof(state));
+  parsebgp_clear_msg(msg);
+  len = tb.len;
+  CHECK(parsebgp_decode(opts, PARSEBGP_MSG_TYPE_MRT, msg, tb.buf, &len) !=
+        PARSEBGP_OK);
+  CHECK(state.calls == 2);
+  CHECK(test_rib(msg)->entry_count == 0);
+
+  parsebgp_destroy_msg(msg);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_peer_filter(void)
+{
+  uint16_t peers[] = {0, 1, 2, 3};
+  parsebgp_mrt_peer_filter_t *filter;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  cb_state_t state;
+  test_buf_t tb;
+
+  tb_init(&tb);
+  tb_basic_rib(&tb, 0, 4, peers, 4);
+  memset(&state, 0, sizeof(state));
+  CHECK((filter = parsebgp_mrt_peer_filter_create()) != NULL);
+  parsebgp_mrt_peer_filter_add_index(filter, 1);
+  parsebgp_mrt_peer_filter_add_index(filter, 3);
+  parsebgp_opts_init(&opts);
+  opts.mrt_rib_entry_cb = entry_cb;
+  opts.mrt_rib_entry_cb_user = &state;
+  opts.mrt_peer_filter = filter;
+
+  // only the entries of the selected peers are passed to the callback
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(state.calls == 2);
+  CHECK(state.bad_count == 0);
+  CHECK(state.peers[0] == 1 && state.peers[1] == 3);
+  CHECK(test_rib(msg)->entry_count == 0);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_mrt_peer_filter_destroy(filter);
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_streamed),
+    TEST(test_errors),
+    TEST(test_peer_filter),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
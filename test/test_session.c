@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Tests for the session table */
+
+#define PEER_IP "192.0.2.1"
+#define PEER_ASN 65001
+
+/* Decode each of the messages in the buffer in turn (leaving the last one in
+   msg) */
+static parsebgp_error_t decode_all(parsebgp_opts_t *opts,
+                                   parsebgp_msg_type_t type,
+                                   parsebgp_msg_t *msg, const test_buf_t *tb)
+{
+  size_t off = 0, len;
+  parsebgp_error_t err;
+
+  while (off < tb->len) {
+    parsebgp_clear_msg(msg);
+    len = tb->len - off;
+    if ((err = parsebgp_decode(*opts, type, msg, tb->buf + off, &len)) !=
+        PARSEBGP_OK) {
+      return err;
+    }
+    off += len;
+  }
+  return PARSEBGP_OK;
+}
+
+/* Append BGP4MP records holding the OPEN messages of both sides */
+static void build_bgp4mp_opens(test_buf_t *tb, int asn_4_byte, int add_path)
+{
+  size_t off;
+
+  off = tb_bgp4mp_begin(tb, 0, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL, PEER_ASN,
+                        PEER_IP);
+  tb_bgp_open(tb, 65000, asn_4_byte, add_path);
+  tb_mrt_end(tb, off);
+  off = tb_bgp4mp_begin(tb, 0, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4, PEER_ASN,
+                        PEER_IP);
+  tb_bgp_open(tb, PEER_ASN, asn_4_byte, add_path);
+  tb_mrt_end(tb, off);
+}
+
+/* Append a BGP4MP record holding an UPDATE from the peer */
+static void build_bgp4mp_update(test_buf_t *tb, uint16_t subtype,
+                                const test_buf_t *attrs, const test_buf_t *nlri)
+{
+  size_t off = tb_bgp4mp_begin(tb, 0, subtype, PEER_ASN, PEER_IP);
+  tb_bgp_update(tb, NULL, attrs, nlri);
+  tb_mrt_end(tb, off);
+}
+
+/* Append a BMP Peer Up message whose OPENs have the given capabilities */
+static void build_peer_up(test_buf_t *tb, int asn_4_byte, int add_path)
+{
+  uint8_t pad[12];
+  size_t off = tb_bmp_begin(tb, PARSEBGP_BMP_TYPE_PEER_UP);
+
+  memset(pad, 0, sizeof(pad));
+  tb_bmp_peer_hdr(tb, 0, PEER_IP, PEER_ASN);
+  tb_bytes(tb, pad, sizeof(pad));
+  tb_ip4(tb, "192.0.2.254");
+  tb_u16(tb, 179);
+  tb_u16(tb, 33000);
+  tb_bgp_open(tb, 65000, asn_4_byte, add_path);
+  tb_bgp_open(tb, PEER_ASN, asn_4_byte, add_path);
+  tb_bmp_end(tb, off);
+}
+
+/* Append a BMP Route Monitoring message holding an UPDATE */
+static void build_route_mon(test_buf_t *tb, uint8_t flags,
+                            const test_buf_t *attrs, const test_buf_t *nlri)
+{
+  size_t off = tb_bmp_begin(tb, PARSEBGP_BMP_TYPE_ROUTE_MON);
+
+  tb_bmp_peer_hdr(tb, flags, PEER_IP, PEER_ASN);
+  tb_bgp_update(tb, NULL, attrs, nlri);
+  tb_bmp_end(tb, off);
+}
+
+/* Build the path attributes of an UPDATE with the given AS_PATH */
+static void build_attrs(test_buf_t *attrs, int asn_4_byte,
+                        const uint32_t *asns, int asns_cnt)
+{
+  tb_attr_origin(attrs, 0);
+  tb_attr_as_path(attrs, 2, asn_4_byte, asns, asns_cnt);
+  tb_attr_next_hop(attrs, PEER_IP);
+}
+
+/* Check the ASNs of the (single segment) AS_PATH of the decoded UPDATE */
+static int check_as_path(parsebgp_msg_t *msg, const uint32_t *asns,
+                         int asns_cnt)
+{
+  parsebgp_bgp_update_t *update;
+  parsebgp_bgp_update_as_path_t *as_path;
+
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH].type ==
+        PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH);
+  as_path =
+    update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH].data.as_path;
+  CHECK(as_path->segs_cnt == 1);
+  CHECK(as_path->segs[0].asns_cnt == asns_cnt);
+  CHECK(memcmp(as_path->segs[0].asns, asns, sizeof(*asns) * asns_cnt) == 0);
+  return 0;
+}
+
+static int test_bgp4mp_add_path(void)
+{
+  uint32_t asn = PEER_ASN;
+  parsebgp_session_table_t *sessions;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_t *update;
+  test_buf_t attrs, nlri, tb;
+  size_t off;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&tb);
+  build_attrs(&attrs, 1, &asn, 1);
+  tb_prefix_ap(&nlri, 7, "10.0.0.0/8");
+
+  CHECK((sessions = parsebgp_session_table_create()) != NULL);
+  parsebgp_opts_init(&opts);
+  opts.sessions = sessions;
+  build_bgp4mp_opens(&tb, 1, 3);
+  CHECK_ERR(PARSEBGP_OK, decode_all(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(parsebgp_session_table_size(sessions) == 1);
+
+  // the subtype does not say that Path Identifiers are present, but the
+  // session does
+  tb_reset(&tb);
+  build_bgp4mp_update(&tb, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4, &attrs, &nlri);
+  CHECK_ERR(PARSEBGP_OK, decode_all(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->announced_nlris.prefixes_cnt == 1);
+  CHECK(update->announced_nlris.prefixes[0].path_id_valid);
+  CHECK(update->announced_nlris.prefixes[0].path_id == 7);
+
+  // the session is forgotten when it goes down
+  tb_reset(&tb);
+  off = tb_bgp4mp_begin(&tb, 0, PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4, PEER_ASN,
+                        PEER_IP);
+  tb_u16(&tb, PARSEBGP_MRT_FSM_CODE_ESTABLISHED);
+  tb_u16(&tb, PARSEBGP_MRT_FSM_CODE_IDLE);
+  tb_mrt_end(&tb, off);
+  CHECK_ERR(PARSEBGP_OK, decode_all(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(parsebgp_session_table_size(sessions) == 0);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_session_table_destroy(sessions);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_bgp4mp_subtype_asn(void)
+{
+  uint32_t asns[] = {PEER_ASN, 4200000000U};
+  parsebgp_session_table_t *sessions;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  test_buf_t attrs, nlri, tb;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&tb);
+  build_attrs(&attrs, 1, asns, 2);
+  tb_prefix(&nlri, "10.0.0.0/8");
+
+  // neither side of the session claims to support 4-byte AS numbers, but the
+  // AS4 subtype says that they are used
+  CHECK((sessions = parsebgp_session_table_create()) != NULL);
+  parsebgp_opts_init(&opts);
+  opts.sessions = sessions;
+  build_bgp4mp_opens(&tb, 0, 0);
+  build_bgp4mp_update(&tb, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4, &attrs, &nlri);
+  CHECK_ERR(PARSEBGP_OK, decode_all(&opts, PARSEBGP_MSG_TYPE_MRT, msg, &tb));
+  CHECK(check_as_path(msg, asns, 2) == 0);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_session_table_destroy(sessions);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_bmp(void)
+{
+  uint32_t asns[] = {PEER_ASN, 65002};
+  parsebgp_session_table_t *sessions;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  parsebgp_bgp_update_t *update;
+  test_buf_t attrs, nlri, tb;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&tb);
+  build_attrs(&attrs, 0, asns, 2);
+  tb_prefix_ap(&nlri, 7, "10.0.0.0/8");
+
+  CHECK((sessions = parsebgp_session_table_create()) != NULL);
+  parsebgp_opts_init(&opts);
+  opts.sessions = sessions;
+  build_peer_up(&tb, 1, 3);
+  CHECK_ERR(PARSEBGP_OK, decode_all(&opts, PARSEBGP_MSG_TYPE_BMP, msg, &tb));
+  CHECK(parsebgp_session_table_size(sessions) == 1);
+
+  // the session says Path Identifiers are present, and the explicit 2-byte
+  // AS_PATH flag in the peer header wins over its 4-byte AS capability
+  tb_reset(&tb);
+  build_route_mon(&tb, PARSEBGP_BMP_PEER_FLAG_2_BYTE_AS_PATH, &attrs, &nlri);
+  CHECK_ERR(PARSEBGP_OK, decode_all(&opts, PARSEBGP_MSG_TYPE_BMP, msg, &tb));
+  CHECK(check_as_path(msg, asns, 2) == 0);
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->announced_nlris.prefixes_cnt == 1);
+  CHECK(update->announced_nlris.prefixes[0].path_id == 7);
+
+  // without the session, the Path Identifier is not expected
+  parsebgp_session_table_clear(sessions);
+  CHECK(parsebgp_session_table_size(sessions) == 0);
+  CHECK(decode_all(&opts, PARSEBGP_MSG_TYPE_BMP, msg, &tb) != PARSEBGP_OK ||
+        !test_update(msg)->announced_nlris.prefixes[0].path_id_valid);
+
+  parsebgp_destroy_msg(msg);
+  parsebgp_session_table_destroy(sessions);
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_bgp4mp_add_path),
+    TEST(test_bgp4mp_subtype_asn),
+    TEST(test_bmp),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include "parsebgp_stream.h"
+#include <string.h>
+
+/* Tests for the incremental decoder: messages split across chunks of every
+ * size, messages that cannot be decoded, and streams that cannot be split
+ * into messages */
+
+#define MSGS_CNT 20
+
+/* The prefix of the i'th message (of one of three lengths) */
+static void build_prefix(char *buf, size_t len, int i)
+{
+  switch (i % 3) {
+  case 0:
+    snprintf(buf, len, "%d.0.0.0/8", i + 1);
+    break;
+  case 1:
+    snprintf(buf, len, "10.%d.0.0/16", i);
+    break;
+  default:
+    snprintf(buf, len, "10.0.%d.0/24", i);
+    break;
+  }
+}
+
+/* BGP UPDATEs */
+static void build_bgp(test_buf_t *tb)
+{
+  char prefix[32];
+  int i;
+
+  for (i = 0; i < MSGS_CNT; i++) {
+    build_prefix(prefix, sizeof(prefix), i);
+    tb_simple_update(tb, 1, 65000 + i, prefix);
+  }
+}
+
+/* BMP Route Monitoring messages */
+static void build_bmp(test_buf_t *tb)
+{
+  char prefix[32];
+  size_t off;
+  int i;
+
+  for (i = 0; i < MSGS_CNT; i++) {
+    build_prefix(prefix, sizeof(prefix), i);
+    off = tb_bmp_begin(tb, PARSEBGP_BMP_TYPE_ROUTE_MON);
+    tb_bmp_peer_hdr(tb, 0, "192.0.2.1", 65000 + i);
+    tb_simple_update(tb, 1, 65000 + i, prefix);
+    tb_bmp_end(tb, off);
+  }
+}
+
+/* A BGP message header with a length that is too short */
+static void build_bad_hdr(test_buf_t *tb)
+{
+  int i;
+
+  for (i = 0; i < 16; i++) {
+    tb_u8(tb, 0xff);
+  }
+  tb_u16(tb, 5);
+  tb_u8(tb, PARSEBGP_BGP_TYPE_UPDATE);
+}
+
+/* Check that the given message is the i'th one built above */
+static int check_msg(parsebgp_msg_t *msg, int i)
+{
+  parsebgp_bgp_update_t *update;
+  char prefix[32], buf[64];
+
+  build_prefix(prefix, sizeof(prefix), i);
+  if (msg->type == PARSEBGP_MSG_TYPE_BMP) {
+    CHECK(msg->types.bmp->peer_hdr.asn == (uint32_t)(65000 + i));
+  }
+  CHECK((update = test_update(msg)) != NULL);
+  CHECK(update->announced_nlris.prefixes_cnt == 1);
+  CHECK(strcmp(test_prefix_str(&update->announced_nlris.prefixes[0], buf),
+               prefix) == 0);
+  return 0;
+}
+
+/* Feed the stream in chunks of the given length, checking each message */
+static int feed_chunks(parsebgp_stream_t *stream, const test_buf_t *tb,
+                       size_t chunk_len)
+{
+  parsebgp_msg_t *msg;
+  parsebgp_error_t err;
+  size_t off, len;
+  int cnt = 0;
+
+  for (off = 0; off < tb->len; off += len) {
+    len = (tb->len - off < chunk_len) ? tb->len - off : chunk_len;
+    CHECK_ERR(PARSEBGP_OK, parsebgp_stream_feed(stream, tb->buf + off, len));
+    while ((err = parsebgp_stream_next(stream, &msg)) != PARSEBGP_PARTIAL_MSG) {
+      CHECK_ERR(PARSEBGP_OK, err);
+      CHECK(cnt < MSGS_CNT);
+      CHECK(check_msg(msg, cnt) == 0);
+      cnt++;
+    }
+  }
+  CHECK(cnt == MSGS_CNT);
+  CHECK(parsebgp_stream_buffered(stream) == 0);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_error(stream));
+  return 0;
+}
+
+static int test_chunks(void)
+{
+  size_t chunk_lens[] = {1, 2, 3, 7, 18, 19, 20, 64, 100, 1000000};
+  parsebgp_stream_t *stream;
+  parsebgp_opts_t opts;
+  test_buf_t bgp, bmp;
+  size_t i;
+
+  tb_init(&bgp);
+  tb_init(&bmp);
+  build_bgp(&bgp);
+  build_bmp(&bmp);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+
+  for (i = 0; i < sizeof(chunk_lens) / sizeof(chunk_lens[0]); i++) {
+    CHECK((stream = parsebgp_stream_create(&opts, PARSEBGP_MSG_TYPE_BGP)) !=
+          NULL);
+    CHECK(feed_chunks(stream, &bgp, chunk_lens[i]) == 0);
+    parsebgp_stream_destroy(stream);
+
+    CHECK((stream = parsebgp_stream_create(&opts, PARSEBGP_MSG_TYPE_BMP)) !=
+          NULL);
+    CHECK(feed_chunks(stream, &bmp, chunk_lens[i]) == 0);
+    // a reset decoder starts again
+    parsebgp_stream_reset(stream);
+    CHECK(feed_chunks(stream, &bmp, chunk_lens[i] + 1) == 0);
+    parsebgp_stream_destroy(stream);
+  }
+
+  tb_free(&bgp);
+  tb_free(&bmp);
+  return 0;
+}
+
+static int test_partial(void)
+{
+  parsebgp_stream_t *stream;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg;
+  test_buf_t tb;
+
+  tb_init(&tb);
+  build_bgp(&tb);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  CHECK((stream = parsebgp_stream_create(&opts, PARSEBGP_MSG_TYPE_BGP)) !=
+        NULL);
+
+  // a chunk can only be fed once the previous one is used up
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_feed(stream, tb.buf, tb.len - 3));
+  CHECK_ERR(PARSEBGP_INVALID_MSG, parsebgp_stream_feed(stream, tb.buf, 1));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_next(stream, &msg));
+  CHECK(check_msg(msg, 0) == 0);
+  while (parsebgp_stream_next(stream, &msg) != PARSEBGP_PARTIAL_MSG) {
+  }
+
+  // the start of the last message is held until the rest arrives
+  CHECK(parsebgp_stream_buffered(stream) > 0);
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG, parsebgp_stream_next(stream, &msg));
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_stream_feed(stream, tb.buf + tb.len - 3, 3));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_next(stream, &msg));
+  CHECK(check_msg(msg, MSGS_CNT - 1) == 0);
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG, parsebgp_stream_next(stream, &msg));
+  CHECK(parsebgp_stream_buffered(stream) == 0);
+
+  // and is forgotten by a reset
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_feed(stream, tb.buf, 10));
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG, parsebgp_stream_next(stream, &msg));
+  CHECK(parsebgp_stream_buffered(stream) == 10);
+  parsebgp_stream_reset(stream);
+  CHECK(parsebgp_stream_buffered(stream) == 0);
+
+  parsebgp_stream_destroy(stream);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_unfeed(void)
+{
+  parsebgp_stream_t *stream;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg;
+  test_buf_t tb;
+  size_t unused, first_len;
+  int cnt;
+
+  tb_init(&tb);
+  build_bgp(&tb);
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  CHECK((stream = parsebgp_stream_create(&opts, PARSEBGP_MSG_TYPE_BGP)) !=
+        NULL);
+
+  // the rest of a chunk can be taken back, and fed again
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_feed(stream, tb.buf, tb.len));
+  CHECK(parsebgp_stream_unused(stream) == tb.len);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_next(stream, &msg));
+  CHECK(check_msg(msg, 0) == 0);
+  first_len = tb.len - parsebgp_stream_unused(stream);
+  CHECK((unused = parsebgp_stream_unfeed(stream)) == tb.len - first_len);
+  CHECK(parsebgp_stream_unused(stream) == 0);
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG, parsebgp_stream_next(stream, &msg));
+
+  // including when the decoder holds the start of a message
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_stream_feed(stream, tb.buf + first_len, 10));
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG, parsebgp_stream_next(stream, &msg));
+  CHECK(parsebgp_stream_unfeed(stream) == 0);
+  CHECK(parsebgp_stream_buffered(stream) == 10);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_feed(stream, tb.buf + first_len + 10,
+                                              unused - 10));
+  for (cnt = 1; parsebgp_stream_next(stream, &msg) == PARSEBGP_OK; cnt++) {
+    CHECK(check_msg(msg, cnt) == 0);
+  }
+  CHECK(cnt == MSGS_CNT);
+  CHECK(parsebgp_stream_buffered(stream) == 0);
+
+  parsebgp_stream_destroy(stream);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_invalid_msg(void)
+{
+  parsebgp_stream_t *stream;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg;
+  test_buf_t tb;
+  int i;
+
+  // an UPDATE with a withdrawn routes length that is too long, between two
+  // valid messages
+  tb_init(&tb);
+  tb_simple_update(&tb, 1, 65000, "1.0.0.0/8");
+  for (i = 0; i < 16; i++) {
+    tb_u8(&tb, 0xff);
+  }
+  tb_u16(&tb, 23);
+  tb_u8(&tb, PARSEBGP_BGP_TYPE_UPDATE);
+  tb_u16(&tb, 0xffff);
+  tb_u16(&tb, 0);
+  tb_simple_update(&tb, 1, 65001, "10.1.0.0/16");
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  opts.silence_invalid = 1;
+  CHECK((stream = parsebgp_stream_create(&opts, PARSEBGP_MSG_TYPE_BGP)) !=
+        NULL);
+
+  // the message is skipped
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_feed(stream, tb.buf, tb.len));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_next(stream, &msg));
+  CHECK(check_msg(msg, 0) == 0);
+  CHECK_ERR(PARSEBGP_INVALID_MSG, parsebgp_stream_next(stream, &msg));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_error(stream));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_next(stream, &msg));
+  CHECK(check_msg(msg, 1) == 0);
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG, parsebgp_stream_next(stream, &msg));
+
+  parsebgp_stream_destroy(stream);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_bad_stream(void)
+{
+  parsebgp_stream_t *stream;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg;
+  test_buf_t tb, good;
+  size_t split;
+
+  tb_init(&tb);
+  tb_init(&good);
+  tb_simple_update(&tb, 1, 65000, "1.0.0.0/8");
+  split = tb.len;
+  build_bad_hdr(&tb);
+  build_bgp(&good);
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  CHECK((stream = parsebgp_stream_create(&opts, PARSEBGP_MSG_TYPE_BGP)) !=
+        NULL);
+
+  // the same error is returned until the decoder is reset, whatever is fed
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_feed(stream, tb.buf, tb.len));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_next(stream, &msg));
+  CHECK(check_msg(msg, 0) == 0);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_error(stream));
+  CHECK_ERR(PARSEBGP_INVALID_MSG, parsebgp_stream_next(stream, &msg));
+  CHECK_ERR(PARSEBGP_INVALID_MSG, parsebgp_stream_error(stream));
+  CHECK_ERR(PARSEBGP_INVALID_MSG, parsebgp_stream_next(stream, &msg));
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_feed(stream, good.buf, good.len));
+  CHECK_ERR(PARSEBGP_INVALID_MSG, parsebgp_stream_next(stream, &msg));
+  parsebgp_stream_reset(stream);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_error(stream));
+  CHECK(feed_chunks(stream, &good, 50) == 0);
+
+  // a header split across chunks
+  parsebgp_stream_reset(stream);
+  CHECK_ERR(PARSEBGP_OK, parsebgp_stream_feed(stream, tb.buf + split, 10));
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG, parsebgp_stream_next(stream, &msg));
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_stream_feed(stream, tb.buf + split + 10,
+                                 tb.len - split - 10));
+  CHECK_ERR(PARSEBGP_INVALID_MSG, parsebgp_stream_next(stream, &msg));
+  CHECK_ERR(PARSEBGP_INVALID_MSG, parsebgp_stream_error(stream));
+
+  parsebgp_stream_destroy(stream);
+  tb_free(&tb);
+  tb_free(&good);
+  return 0;
+}
+
+typedef struct push_state {
+  int cnt;
+  int stop_at;
+  int bad;
+} push_state_t;
+
+static parsebgp_error_t push_cb(parsebgp_error_t err, parsebgp_msg_t *msg,
+                                void *user)
+{
+  push_state_t *st = user;
+
+  if (err != PARSEBGP_OK || check_msg(msg, st->cnt) != 0) {
+    st->bad++;
+  }
+  if (++st->cnt == st->stop_at) {
+    return PARSEBGP_FILTERED_OUT;
+  }
+  return PARSEBGP_OK;
+}
+
+static int test_push(void)
+{
+  parsebgp_stream_t *stream;
+  parsebgp_opts_t opts;
+  push_state_t st;
+  test_buf_t tb;
+  size_t off, len;
+
+  tb_init(&tb);
+  build_bmp(&tb);
+  parsebgp_opts_init(&opts);
+  CHECK((stream = parsebgp_stream_create(&opts, PARSEBGP_MSG_TYPE_BMP)) !=
+        NULL);
+
+  memset(&st, 0, sizeof(st));
+  for (off = 0; off < tb.len; off += len) {
+    len = (tb.len - off < 33) ? tb.len - off : 33;
+    CHECK_ERR(PARSEBGP_OK,
+              parsebgp_stream_push(stream, tb.buf + off, len, push_cb, &st));
+  }
+  CHECK(st.cnt == MSGS_CNT && st.bad == 0);
+
+  // the callback stops the decoder
+  parsebgp_stream_reset(stream);
+  memset(&st, 0, sizeof(st));
+  st.stop_at = 3;
+  CHECK_ERR(PARSEBGP_FILTERED_OUT,
+            parsebgp_stream_push(stream, tb.buf, tb.len, push_cb, &st));
+  CHECK(st.cnt == 3 && st.bad == 0);
+  parsebgp_stream_destroy(stream);
+
+  // the stream error is returned for every chunk
+  tb_reset(&tb);
+  tb_simple_update(&tb, 1, 65000, "1.0.0.0/8");
+  build_bad_hdr(&tb);
+  opts.bgp.asn_4_byte = 1;
+  CHECK((stream = parsebgp_stream_create(&opts, PARSEBGP_MSG_TYPE_BGP)) !=
+        NULL);
+  memset(&st, 0, sizeof(st));
+  CHECK_ERR(PARSEBGP_INVALID_MSG,
+            parsebgp_stream_push(stream, tb.buf, tb.len, push_cb, &st));
+  CHECK(st.cnt == 1 && st.bad == 0);
+  CHECK_ERR(PARSEBGP_INVALID_MSG,
+            parsebgp_stream_push(stream, tb.buf, tb.len, push_cb, &st));
+  CHECK(st.cnt == 1);
+  parsebgp_stream_destroy(stream);
+
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_chunks),
+    TEST(test_partial),
+    TEST(test_unfeed),
+    TEST(test_invalid_msg),
+    TEST(test_bad_stream),
+    TEST(test_push),
+  };
+
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include "parsebgp_stream.hpp"
+#include <coroutine>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+/* Tests for the C++ adapter for the incremental decoder: the range returned
+ * by feed(), and coroutines that await next() while chunks are pushed */
+
+#define MSGS_CNT 20
+
+/* A coroutine that runs until it first awaits, and is destroyed with the
+ * Task */
+struct Task {
+  struct promise_type {
+    Task get_return_object()
+    {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle)
+  {
+  }
+  Task(const Task &) = delete;
+  ~Task() { handle_.destroy(); }
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/* What a coroutine (or loop) saw of a stream */
+struct Seen {
+  int cnt = 0;
+  int errors = 0;
+  int bad = 0;
+};
+
+static void build_msgs(test_buf_t *tb)
+{
+  char prefix[32];
+  int i;
+
+  for (i = 0; i < MSGS_CNT; i++) {
+    snprintf(prefix, sizeof(prefix), "10.%d.0.0/16", i);
+    tb_simple_update(tb, 1, 65000 + i, prefix);
+  }
+}
+
+/* A BGP message header with a length that is too short */
+static void build_bad_hdr(test_buf_t *tb)
+{
+  int i;
+
+  for (i = 0; i < 16; i++) {
+    tb_u8(tb, 0xff);
+  }
+  tb_u16(tb, 5);
+  tb_u8(tb, PARSEBGP_BGP_TYPE_UPDATE);
+}
+
+/* Record a message from the stream built by build_msgs */
+static void see(Seen &seen, const parsebgp::Message &m)
+{
+  parsebgp_bgp_update_t *update;
+  char prefix[32], buf[64];
+
+  if (m.err != PARSEBGP_OK) {
+    // a stream error comes without a message
+    seen.errors++;
+    if (m.msg != nullptr) {
+      seen.bad++;
+    }
+    return;
+  }
+  snprintf(prefix, sizeof(prefix), "10.%d.0.0/16", seen.cnt);
+  if ((update = test_update(m.msg)) == nullptr ||
+      update->announced_nlris.prefixes_cnt != 1 ||
+      strcmp(test_prefix_str(&update->announced_nlris.prefixes[0], buf),
+             prefix) != 0) {
+    seen.bad++;
+  }
+  seen.cnt++;
+}
+
+static parsebgp_opts_t make_opts()
+{
+  parsebgp_opts_t opts;
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  return opts;
+}
+
+/* Feed the buffer in chunks of the given length, iterating over the
+ * messages */
+static void feed_chunks(parsebgp::Stream &stream, const test_buf_t &tb,
+                        size_t chunk_len, Seen &seen)
+{
+  size_t off, len;
+
+  for (off = 0; off < tb.len; off += len) {
+    len = (tb.len - off < chunk_len) ? tb.len - off : chunk_len;
+    for (const parsebgp::Message &m : stream.feed(tb.buf + off, len)) {
+      see(seen, m);
+    }
+  }
+}
+
+static int test_feed(void)
+{
+  size_t chunk_lens[] = {1, 3, 19, 50, 1000000};
+  parsebgp::Stream stream(make_opts(), PARSEBGP_MSG_TYPE_BGP);
+  test_buf_t tb;
+
+  tb_init(&tb);
+  build_msgs(&tb);
+  for (size_t chunk_len : chunk_lens) {
+    Seen seen;
+    feed_chunks(stream, tb, chunk_len, seen);
+    CHECK(seen.cnt == MSGS_CNT && seen.errors == 0 && seen.bad == 0);
+    CHECK(stream.buffered() == 0);
+  }
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_feed_bad_stream(void)
+{
+  parsebgp::Stream stream(make_opts(), PARSEBGP_MSG_TYPE_BGP);
+  test_buf_t tb, bad;
+  Seen seen;
+
+  tb_init(&tb);
+  tb_init(&bad);
+  build_msgs(&tb);
+  build_bad_hdr(&bad);
+
+  // the error ends the range, once for each chunk
+  feed_chunks(stream, bad, bad.len, seen);
+  CHECK(seen.errors == 1 && seen.bad == 0);
+  feed_chunks(stream, tb, 30, seen);
+  CHECK(seen.cnt == 0 && seen.bad == 0);
+  CHECK(seen.errors == 1 + (int)((tb.len + 29) / 30));
+
+  // until the decoder is reset
+  stream.reset();
+  seen = Seen();
+  feed_chunks(stream, tb, 30, seen);
+  CHECK(seen.cnt == MSGS_CNT && seen.errors == 0 && seen.bad == 0);
+
+  tb_free(&tb);
+  tb_free(&bad);
+  return 0;
+}
+
+static Task read_msgs(parsebgp::Stream &stream, Seen &seen)
+{
+  for (;;) {
+    see(seen, co_await stream.next());
+  }
+}
+
+/* Push the buffer in chunks of the given length */
+static void push_chunks(parsebgp::Stream &stream, const test_buf_t &tb,
+                        size_t chunk_len)
+{
+  size_t off, len;
+
+  for (off = 0; off < tb.len; off += len) {
+    len = (tb.len - off < chunk_len) ? tb.len - off : chunk_len;
+    stream.push(tb.buf + off, len);
+  }
+}
+
+static int test_push(void)
+{
+  size_t chunk_lens[] = {1, 7, 40, 1000000};
+  parsebgp::Stream stream(make_opts(), PARSEBGP_MSG_TYPE_BGP);
+  test_buf_t tb;
+
+  tb_init(&tb);
+  build_msgs(&tb);
+  for (size_t chunk_len : chunk_lens) {
+    Seen seen;
+    Task task = read_msgs(stream, seen);
+    push_chunks(stream, tb, chunk_len);
+    CHECK(seen.cnt == MSGS_CNT && seen.errors == 0 && seen.bad == 0);
+    CHECK(stream.buffered() == 0);
+  }
+  tb_free(&tb);
+  return 0;
+}
+
+static Task read_some(parsebgp::Stream &stream, Seen &seen, int cnt)
+{
+  while (cnt-- > 0) {
+    see(seen, co_await stream.next());
+  }
+}
+
+static int test_push_unawaited(void)
+{
+  parsebgp::Stream stream(make_opts(), PARSEBGP_MSG_TYPE_BGP);
+  test_buf_t tb;
+  size_t half, msg_len;
+  Seen seen;
+
+  // (the messages are all the same length)
+  tb_init(&tb);
+  build_msgs(&tb);
+  half = tb.len / 2;
+  msg_len = tb.len / MSGS_CNT;
+
+  // data pushed before anybody awaits is kept for the first await
+  push_chunks(stream, tb, 25);
+  CHECK(stream.buffered() == tb.len);
+  {
+    Task task = read_msgs(stream, seen);
+    CHECK(seen.cnt == MSGS_CNT && seen.errors == 0 && seen.bad == 0);
+    CHECK(stream.buffered() == 0);
+  }
+
+  // as is the rest of a chunk when the coroutine stops awaiting part way
+  // through it, and anything pushed after that
+  stream.reset();
+  seen = Seen();
+  {
+    Task task = read_some(stream, seen, 3);
+    stream.push(tb.buf, half);
+    CHECK(seen.cnt == 3);
+  }
+  CHECK(stream.buffered() == half - 3 * msg_len);
+  stream.push(tb.buf + half, tb.len - half);
+  CHECK(stream.buffered() == tb.len - 3 * msg_len);
+  {
+    Task task = read_some(stream, seen, 2);
+    CHECK(seen.cnt == 5);
+  }
+  CHECK(stream.buffered() == tb.len - 5 * msg_len);
+  {
+    Task task = read_msgs(stream, seen);
+    CHECK(seen.cnt == MSGS_CNT && seen.errors == 0 && seen.bad == 0);
+    CHECK(stream.buffered() == 0);
+  }
+
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_push_bad_stream(void)
+{
+  parsebgp::Stream stream(make_opts(), PARSEBGP_MSG_TYPE_BGP);
+  test_buf_t tb, bad;
+  Seen seen;
+
+  tb_init(&tb);
+  tb_init(&bad);
+  build_msgs(&tb);
+  build_bad_hdr(&bad);
+
+  {
+    Task task = read_msgs(stream, seen);
+
+    // the coroutine is given the error once for each chunk
+    push_chunks(stream, bad, bad.len);
+    CHECK(seen.errors == 1 && seen.bad == 0);
+    push_chunks(stream, tb, 30);
+    CHECK(seen.cnt == 0 && seen.bad == 0);
+    CHECK(seen.errors == 1 + (int)((tb.len + 29) / 30));
+
+    // until the decoder is reset
+    stream.reset();
+    seen = Seen();
+    push_chunks(stream, tb, 30);
+    CHECK(seen.cnt == MSGS_CNT && seen.errors == 0 && seen.bad == 0);
+  }
+
+  tb_free(&tb);
+  tb_free(&bad);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_feed),
+    TEST(test_feed_bad_stream),
+    TEST(test_push),
+    TEST(test_push_unawaited),
+    TEST(test_push_bad_stream),
+  };
+
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
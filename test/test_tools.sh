@@ -0,0 +1,91 @@
+#
+# Copyright (C) 2017 The Regents of the University of California.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+#
+# Run parsebgp with several threads (-j) on files written by make_tool_input,
+# and check that it outputs the same messages, counts and errors as a serial
+# run. parsebgp_chunked splits MRT files into small chunks, so that the chunks
+# of a file are parsed in parallel, and each must use the right Peer Index
+# Table.
+#
+
+./make_tool_input || exit 1
+files="tool_updates.mrt tool_rib.mrt tool_small.mrt tool_trunc.mrt"
+files="$files tool_peers.bmp"
+
+# the order of messages from different files (and chunks) may differ, but each
+# message must be output whole
+run() {
+    ./parsebgp_chunked "$@" $files > tools_run.out 2> tools_err.out
+    sort tools_run.out | cksum
+    grep -E '^(INFO: Read [0-9]|ERROR)' tools_err.out |
+        sed 's/ of [0-9]* bytes//' | sort
+}
+
+for opts in "" "-E" "-u"; do
+    serial=$(run $opts) || exit 1
+    for jobs in 2 4; do
+        parallel=$(run $opts -j $jobs) || exit 1
+        if [ "$serial" != "$parallel" ]; then
+            echo "parsebgp $opts -j $jobs differs from a serial run:"
+            echo "$serial"
+            echo "---"
+            echo "$parallel"
+            exit 1
+        fi
+    done
+done
+
+# and the truncated file is reported
+if ! echo "$serial" | grep -q 'corrupt'; then
+    echo "truncated file not reported"
+    exit 1
+fi
+
+# messages are split across the read buffers of a large file in different
+# places by stdio and by the read-ahead reader (-u), which parses the file in
+# one piece, or in chunks that start at record boundaries (-j with several
+# files)
+files="tool_large.mrt tool_small.mrt"
+serial=$(run -E) || exit 1
+for opts in "-u" "-u -j 3"; do
+    parallel=$(run -E $opts) || exit 1
+    if [ "$serial" != "$parallel" ]; then
+        echo "parsebgp -E $opts differs from a stdio run:"
+        echo "$serial"
+        echo "---"
+        echo "$parallel"
+        exit 1
+    fi
+    if ! grep -q '^INFO: Reading files with' tools_err.out; then
+        echo "parsebgp -E $opts did not use the reader"
+        exit 1
+    fi
+done
+if ! echo "$serial" | grep -q '^INFO: Read 40000 messages'; then
+    echo "large file not read: $serial"
+    exit 1
+fi
+exit 0
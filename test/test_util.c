@@ -0,0 +1,568 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <arpa/inet.h>
+#include <string.h>
+
+int test_run(const test_t *tests, int tests_cnt)
+{
+  int i;
+  int failed = 0;
+
+  for (i = 0; i < tests_cnt; i++) {
+    if (tests[i].func() != 0) {
+      fprintf(stdout, "FAIL: %s\n", tests[i].name);
+      failed++;
+    } else {
+      fprintf(stdout, "PASS: %s\n", tests[i].name);
+    }
+  }
+  return failed == 0 ? 0 : 1;
+}
+
+void tb_init(test_buf_t *tb)
+{
+  tb->buf = NULL;
+  tb->len = 0;
+  tb->alloc = 0;
+}
+
+void tb_free(test_buf_t *tb)
+{
+  free(tb->buf);
+  tb_init(tb);
+}
+
+void tb_reset(test_buf_t *tb)
+{
+  tb->len = 0;
+}
+
+void tb_bytes(test_buf_t *tb, const void *data, size_t len)
+{
+  if (tb->len + len > tb->alloc) {
+    size_t alloc = tb->alloc == 0 ? 1024 : tb->alloc;
+    while (alloc < tb->len + len) {
+      alloc *= 2;
+    }
+    if ((tb->buf = realloc(tb->buf, alloc)) == NULL) {
+      fprintf(stderr, "ERROR: could not grow test buffer\n");
+      abort();
+    }
+    tb->alloc = alloc;
+  }
+  if (len > 0) {
+    memcpy(tb->buf + tb->len, data, len);
+  }
+  tb->len += len;
+}
+
+void tb_u8(test_buf_t *tb, uint8_t v)
+{
+  tb_bytes(tb, &v, 1);
+}
+
+void tb_u16(test_buf_t *tb, uint16_t v)
+{
+  uint8_t b[2] = {v >> 8, v & 0xff};
+  tb_bytes(tb, b, sizeof(b));
+}
+
+void tb_u32(test_buf_t *tb, uint32_t v)
+{
+  tb_u16(tb, v >> 16);
+  tb_u16(tb, v & 0xffff);
+}
+
+void tb_u64(test_buf_t *tb, uint64_t v)
+{
+  tb_u32(tb, v >> 32);
+  tb_u32(tb, v & 0xffffffff);
+}
+
+void tb_put16(test_buf_t *tb, size_t off, uint16_t v)
+{
+  tb->buf[off] = v >> 8;
+  tb->buf[off + 1] = v & 0xff;
+}
+
+void tb_put32(test_buf_t *tb, size_t off, uint32_t v)
+{
+  tb_put16(tb, off, v >> 16);
+  tb_put16(tb, off + 2, v & 0xffff);
+}
+
+void tb_ip4(test_buf_t *tb, const char *addr)
+{
+  uint8_t b[4];
+  if (inet_pton(AF_INET, addr, b) != 1) {
+    fprintf(stderr, "ERROR: invalid IPv4 address '%s'\n", addr);
+    abort();
+  }
+  tb_bytes(tb, b, sizeof(b));
+}
+
+void tb_ip6(test_buf_t *tb, const char *addr)
+{
+  uint8_t b[16];
+  if (inet_pton(AF_INET6, addr, b) != 1) {
+    fprintf(stderr, "ERROR: invalid IPv6 address '%s'\n", addr);
+    abort();
+  }
+  tb_bytes(tb, b, sizeof(b));
+}
+
+void tb_prefix(test_buf_t *tb, const char *prefix)
+{
+  char addr[INET6_ADDRSTRLEN];
+  uint8_t b[16];
+  const char *slash = strchr(prefix, '/');
+  size_t alen;
+  int plen;
+
+  if (slash == NULL || (alen = slash - prefix) >= sizeof(addr)) {
+    fprintf(stderr, "ERROR: invalid prefix '%s'\n", prefix);
+    abort();
+  }
+  memcpy(addr, prefix, alen);
+  addr[alen] = '\0';
+  plen = atoi(slash + 1);
+  if (inet_pton(strchr(addr, ':') ? AF_INET6 : AF_INET, addr, b) != 1) {
+    fprintf(stderr, "ERROR: invalid prefix '%s'\n", prefix);
+    abort();
+  }
+  tb_u8(tb, plen);
+  tb_bytes(tb, b, (plen + 7) / 8);
+}
+
+void tb_prefix_ap(test_buf_t *tb, uint32_t path_id, const char *prefix)
+{
+  tb_u32(tb, path_id);
+  tb_prefix(tb, prefix);
+}
+
+void tb_attr(test_buf_t *tb, uint8_t flags, uint8_t type, const void *data,
+             size_t len)
+{
+  if (len > 255) {
+    tb_u8(tb, flags | 0x10);
+    tb_u8(tb, type);
+    tb_u16(tb, len);
+  } else {
+    tb_u8(tb, flags & ~0x10);
+    tb_u8(tb, type);
+    tb_u8(tb, len);
+  }
+  tb_bytes(tb, data, len);
+}
+
+void tb_attr_origin(test_buf_t *tb, uint8_t origin)
+{
+  tb_attr(tb, 0x40, 1, &origin, 1);
+}
+
+void tb_attr_as_path(test_buf_t *tb, uint8_t type, int asn_4_byte,
+                     const uint32_t *asns, int asns_cnt)
+{
+  test_buf_t seg;
+  int i;
+
+  tb_init(&seg);
+  tb_u8(&seg, 2); // AS_SEQUENCE
+  tb_u8(&seg, asns_cnt);
+  for (i = 0; i < asns_cnt; i++) {
+    if (asn_4_byte) {
+      tb_u32(&seg, asns[i]);
+    } else {
+      tb_u16(&seg, asns[i]);
+    }
+  }
+  tb_attr(tb, type == 2 ? 0x40 : 0xc0, type, seg.buf, seg.len);
+  tb_free(&seg);
+}
+
+void tb_attr_next_hop(test_buf_t *tb, const char *addr)
+{
+  test_buf_t nh;
+  tb_init(&nh);
+  tb_ip4(&nh, addr);
+  tb_attr(tb, 0x40, 3, nh.buf, nh.len);
+  tb_free(&nh);
+}
+
+void tb_attr_communities(test_buf_t *tb, const uint32_t *comms, int comms_cnt)
+{
+  test_buf_t c;
+  int i;
+
+  tb_init(&c);
+  for (i = 0; i < comms_cnt; i++) {
+    tb_u32(&c, comms[i]);
+  }
+  tb_attr(tb, 0xc0, 8, c.buf, c.len);
+  tb_free(&c);
+}
+
+void tb_attr_mp_reach(test_buf_t *tb, uint16_t afi, uint8_t safi,
+                      const test_buf_t *next_hop, const test_buf_t *nlri)
+{
+  test_buf_t mp;
+
+  tb_init(&mp);
+  tb_u16(&mp, afi);
+  tb_u8(&mp, safi);
+  tb_u8(&mp, next_hop->len);
+  tb_bytes(&mp, next_hop->buf, next_hop->len);
+  tb_u8(&mp, 0); // reserved
+  tb_bytes(&mp, nlri->buf, nlri->len);
+  tb_attr(tb, 0x80, 14, mp.buf, mp.len);
+  tb_free(&mp);
+}
+
+void tb_attr_mp_unreach(test_buf_t *tb, uint16_t afi, uint8_t safi,
+                        const test_buf_t *withdrawn)
+{
+  test_buf_t mp;
+
+  tb_init(&mp);
+  tb_u16(&mp, afi);
+  tb_u8(&mp, safi);
+  tb_bytes(&mp, withdrawn->buf, withdrawn->len);
+  tb_attr(tb, 0x80, 15, mp.buf, mp.len);
+  tb_free(&mp);
+}
+
+void tb_bgp_msg(test_buf_t *tb, uint8_t type, const test_buf_t *body)
+{
+  uint8_t marker[16];
+  size_t blen = body != NULL ? body->len : 0;
+
+  memset(marker, 0xff, sizeof(marker));
+  tb_bytes(tb, marker, sizeof(marker));
+  tb_u16(tb, 19 + blen);
+  tb_u8(tb, type);
+  if (blen > 0) {
+    tb_bytes(tb, body->buf, blen);
+  }
+}
+
+void tb_bgp_update(test_buf_t *tb, const test_buf_t *withdrawn,
+                   const test_buf_t *attrs, const test_buf_t *nlri)
+{
+  test_buf_t body;
+
+  tb_init(&body);
+  tb_u16(&body, withdrawn != NULL ? withdrawn->len : 0);
+  if (withdrawn != NULL) {
+    tb_bytes(&body, withdrawn->buf, withdrawn->len);
+  }
+  tb_u16(&body, attrs != NULL ? attrs->len : 0);
+  if (attrs != NULL) {
+    tb_bytes(&body, attrs->buf, attrs->len);
+  }
+  if (nlri != NULL) {
+    tb_bytes(&body, nlri->buf, nlri->len);
+  }
+  tb_bgp_msg(tb, 2, &body);
+  tb_free(&body);
+}
+
+void tb_bgp_open(test_buf_t *tb, uint32_t asn, int asn_4_byte, int add_path)
+{
+  test_buf_t caps, body;
+
+  tb_init(&caps);
+  // Multiprotocol: IPv4 unicast
+  tb_u8(&caps, 1);
+  tb_u8(&caps, 4);
+  tb_u16(&caps, 1);
+  tb_u8(&caps, 0);
+  tb_u8(&caps, 1);
+  if (asn_4_byte) {
+    tb_u8(&caps, 65);
+    tb_u8(&caps, 4);
+    tb_u32(&caps, asn);
+  }
+  if (add_path) {
+    tb_u8(&caps, 69);
+    tb_u8(&caps, 4);
+    tb_u16(&caps, 1);
+    tb_u8(&caps, 1);
+    tb_u8(&caps, add_path);
+  }
+
+  tb_init(&body);
+  tb_u8(&body, 4); // version
+  tb_u16(&body, asn > 0xffff ? 23456 : asn);
+  tb_u16(&body, 180); // hold time
+  tb_ip4(&body, "192.0.2.1");
+  tb_u8(&body, caps.len + 2);
+  tb_u8(&body, 2); // capabilities parameter
+  tb_u8(&body, caps.len);
+  tb_bytes(&body, caps.buf, caps.len);
+  tb_bgp_msg(tb, 1, &body);
+
+  tb_free(&caps);
+  tb_free(&body);
+}
+
+size_t tb_mrt_begin(test_buf_t *tb, uint32_t ts, uint16_t type,
+                    uint16_t subtype)
+{
+  size_t off = tb->len;
+  tb_u32(tb, ts);
+  tb_u16(tb, type);
+  tb_u16(tb, subtype);
+  tb_u32(tb, 0);
+  return off;
+}
+
+void tb_mrt_end(test_buf_t *tb, size_t off)
+{
+  tb_put32(tb, off + 8, tb->len - off - 12);
+}
+
+size_t tb_bgp4mp_begin(test_buf_t *tb, uint32_t ts, uint16_t subtype,
+                       uint32_t peer_asn, const char *peer_ip)
+{
+  size_t off = tb_mrt_begin(tb, ts, PARSEBGP_MRT_TYPE_BGP4MP, subtype);
+  int as4 = subtype == PARSEBGP_MRT_BGP4MP_MESSAGE_AS4 ||
+            subtype == PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL ||
+            subtype == PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_ADDPATH ||
+            subtype == PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH ||
+            subtype == PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4;
+  if (as4) {
+    tb_u32(tb, peer_asn);
+    tb_u32(tb, 65000);
+  } else {
+    tb_u16(tb, peer_asn);
+    tb_u16(tb, 65000);
+  }
+  tb_u16(tb, 0); // interface index
+  tb_u16(tb, PARSEBGP_BGP_AFI_IPV4);
+  tb_ip4(tb, peer_ip);
+  tb_ip4(tb, "192.0.2.254");
+  return off;
+}
+
+void tb_peer_index(test_buf_t *tb, int peers_cnt, const char *const *peer_ips,
+                   const uint32_t *peer_asns)
+{
+  size_t off = tb_mrt_begin(tb, 1000, PARSEBGP_MRT_TYPE_TABLE_DUMP_V2,
+                            PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE);
+  int i;
+
+  tb_ip4(tb, "192.0.2.250"); // collector BGP ID
+  tb_u16(tb, 4);
+  tb_bytes(tb, "test", 4);
+  tb_u16(tb, peers_cnt);
+  for (i = 0; i < peers_cnt; i++) {
+    tb_u8(tb, 0x02); // IPv4 peer, 4-byte ASN
+    tb_u32(tb, 0x01010101 * (i + 1));
+    tb_ip4(tb, peer_ips[i]);
+    tb_u32(tb, peer_asns[i]);
+  }
+  tb_mrt_end(tb, off);
+}
+
+size_t tb_rib_begin(test_buf_t *tb, uint16_t subtype, uint32_t seq,
+                    const char *prefix, uint16_t entry_count)
+{
+  size_t off =
+    tb_mrt_begin(tb, 1000, PARSEBGP_MRT_TYPE_TABLE_DUMP_V2, subtype);
+  tb_u32(tb, seq);
+  tb_prefix(tb, prefix);
+  tb_u16(tb, entry_count);
+  return off;
+}
+
+void tb_rib_entry(test_buf_t *tb, uint16_t peer_index, int add_path,
+                  uint32_t path_id, const test_buf_t *attrs)
+{
+  tb_u16(tb, peer_index);
+  tb_u32(tb, 1000); // originated time
+  if (add_path) {
+    tb_u32(tb, path_id);
+  }
+  tb_u16(tb, attrs->len);
+  tb_bytes(tb, attrs->buf, attrs->len);
+}
+
+size_t tb_bmp_begin(test_buf_t *tb, uint8_t type)
+{
+  size_t off = tb->len;
+  tb_u8(tb, 3);
+  tb_u32(tb, 0);
+  tb_u8(tb, type);
+  return off;
+}
+
+void tb_bmp_peer_hdr(test_buf_t *tb, uint8_t flags, const char *peer_ip,
+                     uint32_t peer_asn)
+{
+  uint8_t pad[12];
+
+  memset(pad, 0, sizeof(pad));
+  tb_u8(tb, 0); // global instance peer
+  tb_u8(tb, flags);
+  tb_u64(tb, 0); // distinguisher
+  tb_bytes(tb, pad, sizeof(pad));
+  tb_ip4(tb, peer_ip);
+  tb_u32(tb, peer_asn);
+  tb_ip4(tb, peer_ip); // BGP ID
+  tb_u32(tb, 3000);
+  tb_u32(tb, 0);
+}
+
+void tb_bmp_end(test_buf_t *tb, size_t off)
+{
+  tb_put32(tb, off + 1, tb->len - off);
+}
+
+void tb_simple_update(test_buf_t *tb, int asn_4_byte, uint32_t asn,
+                      const char *prefix)
+{
+  test_buf_t attrs, nlri;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_attr_origin(&attrs, 0);
+  tb_attr_as_path(&attrs, 2, asn_4_byte, &asn, 1);
+  tb_attr_next_hop(&attrs, "192.0.2.1");
+  tb_prefix(&nlri, prefix);
+  tb_bgp_update(tb, NULL, &attrs, &nlri);
+  tb_free(&attrs);
+  tb_free(&nlri);
+}
+
+void tb_basic_attrs(test_buf_t *tb, int next_hop)
+{
+  uint32_t asn = 65001;
+
+  tb_attr_origin(tb, 0);
+  tb_attr_as_path(tb, 2, 1, &asn, 1);
+  if (next_hop) {
+    tb_attr_next_hop(tb, "192.0.2.1");
+  }
+}
+
+void tb_basic_rib(test_buf_t *tb, uint32_t seq, uint16_t entry_count,
+                  const uint16_t *peers, int peers_cnt)
+{
+  test_buf_t attrs;
+  size_t off;
+  int i;
+
+  tb_init(&attrs);
+  tb_basic_attrs(&attrs, 0);
+  off = tb_rib_begin(tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST, seq,
+                     "10.0.0.0/8", entry_count);
+  for (i = 0; i < peers_cnt; i++) {
+    tb_rib_entry(tb, peers[i], 0, 0, &attrs);
+  }
+  tb_mrt_end(tb, off);
+  tb_free(&attrs);
+}
+
+parsebgp_error_t test_decode(parsebgp_opts_t *opts, parsebgp_msg_type_t type,
+                             parsebgp_msg_t *msg, const test_buf_t *tb)
+{
+  size_t len = tb->len;
+  parsebgp_error_t err;
+
+  if ((err = parsebgp_decode(*opts, type, msg, tb->buf, &len)) != PARSEBGP_OK) {
+    return err;
+  }
+  if (len != tb->len) {
+    fprintf(stderr, "ERROR: decode used %zu of %zu bytes\n", len, tb->len);
+    return PARSEBGP_INVALID_MSG;
+  }
+  return PARSEBGP_OK;
+}
+
+parsebgp_bgp_update_t *test_update(parsebgp_msg_t *msg)
+{
+  parsebgp_bgp_msg_t *bgp = NULL;
+
+  switch (msg->type) {
+  case PARSEBGP_MSG_TYPE_BGP:
+    bgp = msg->types.bgp;
+    break;
+
+  case PARSEBGP_MSG_TYPE_MRT:
+    if (msg->types.mrt->type == PARSEBGP_MRT_TYPE_BGP4MP ||
+        msg->types.mrt->type == PARSEBGP_MRT_TYPE_BGP4MP_ET) {
+      bgp = msg->types.mrt->types.bgp4mp->data.bgp_msg;
+    }
+    break;
+
+  case PARSEBGP_MSG_TYPE_BMP:
+    if (msg->types.bmp->type == PARSEBGP_BMP_TYPE_ROUTE_MON) {
+      bgp = msg->types.bmp->types.route_mon;
+    }
+    break;
+
+  default:
+    break;
+  }
+  if (bgp == NULL || bgp->type != PARSEBGP_BGP_TYPE_UPDATE) {
+    return NULL;
+  }
+  return bgp->types.update;
+}
+
+parsebgp_mrt_table_dump_v2_afi_safi_rib_t *test_rib(parsebgp_msg_t *msg)
+{
+  if (msg->type != PARSEBGP_MSG_TYPE_MRT ||
+      msg->types.mrt->type != PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 ||
+      msg->types.mrt->subtype ==
+        PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE) {
+    return NULL;
+  }
+  return &msg->types.mrt->types.table_dump_v2->afi_safi_rib;
+}
+
+parsebgp_mrt_table_dump_v2_peer_index_t *test_peer_index(parsebgp_msg_t *msg)
+{
+  if (msg->type != PARSEBGP_MSG_TYPE_MRT ||
+      msg->types.mrt->type != PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 ||
+      msg->types.mrt->subtype !=
+        PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE) {
+    return NULL;
+  }
+  return &msg->types.mrt->types.table_dump_v2->peer_index;
+}
+
+const char *test_prefix_str(const parsebgp_bgp_prefix_t *prefix, char *buf)
+{
+  char addr[INET6_ADDRSTRLEN];
+
+  inet_ntop(prefix->afi == PARSEBGP_BGP_AFI_IPV6 ? AF_INET6 : AF_INET,
+            prefix->addr, addr, sizeof(addr));
+  snprintf(buf, 64, "%s/%d", addr, prefix->len);
+  return buf;
+}
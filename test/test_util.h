@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TEST_UTIL_H
+#define __TEST_UTIL_H
+
+#include "parsebgp.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file
+ *
+ * @brief Helpers shared by the libparsebgp tests: a CHECK macro and builders
+ * for raw BGP, BMP and MRT messages.
+ */
+
+/** Fail the current test (returning -1) if the given condition is false */
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      return -1;                                                               \
+    }                                                                          \
+  } while (0)
+
+/** Fail the current test if the given expression does not equal the expected
+    error code */
+#define CHECK_ERR(expected, expr)                                              \
+  do {                                                                         \
+    parsebgp_error_t _err = (expr);                                            \
+    if (_err != (expected)) {                                                  \
+      fprintf(stderr, "%s:%d: %s returned %d (%s), expected %d\n", __FILE__,   \
+              __LINE__, #expr, _err, parsebgp_strerror(_err), (expected));     \
+      return -1;                                                               \
+    }                                                                          \
+  } while (0)
+
+/** A test case: returns 0 on success and -1 on failure */
+typedef int (*test_func_t)(void);
+
+/** An entry in a program's list of test cases */
+typedef struct test {
+  const char *name;
+  test_func_t func;
+} test_t;
+
+/** Convenience macro for filling a list of test_t */
+#define TEST(func) {#func, func}
+
+/**
+ * Run the given test cases, printing a line for each
+ *
+ * @return an exit code: 0 if all tests passed, 1 otherwise
+ */
+int test_run(const test_t *tests, int tests_cnt);
+
+/** A growable buffer that raw messages are built into */
+typedef struct test_buf {
+  uint8_t *buf;
+  size_t len;
+  size_t alloc;
+} test_buf_t;
+
+/** Initialize an empty buffer */
+void tb_init(test_buf_t *tb);
+
+/** Free the memory used by a buffer */
+void tb_free(test_buf_t *tb);
+
+/** Empty a buffer, ready for reuse */
+void tb_reset(test_buf_t *tb);
+
+/** Append raw bytes */
+void tb_bytes(test_buf_t *tb, const void *data, size_t len);
+
+/** Append network-order integers */
+void tb_u8(test_buf_t *tb, uint8_t v);
+void tb_u16(test_buf_t *tb, uint16_t v);
+void tb_u32(test_buf_t *tb, uint32_t v);
+void tb_u64(test_buf_t *tb, uint64_t v);
+
+/** Overwrite network-order integers at the given offset */
+void tb_put16(test_buf_t *tb, size_t off, uint16_t v);
+void tb_put32(test_buf_t *tb, size_t off, uint32_t v);
+
+/** Append an IPv4 or IPv6 address given in presentation format */
+void tb_ip4(test_buf_t *tb, const char *addr);
+void tb_ip6(test_buf_t *tb, const char *addr);
+
+/** Append an NLRI-encoded prefix ("10.0.0.0/8" or "2001:db8::/32"), optionally
+    preceded by an ADD-PATH Path Identifier (if path_id is non-zero) */
+void tb_prefix(test_buf_t *tb, const char *prefix);
+void tb_prefix_ap(test_buf_t *tb, uint32_t path_id, const char *prefix);
+
+/** Append a path attribute (the extended length flag is set if needed) */
+void tb_attr(test_buf_t *tb, uint8_t flags, uint8_t type, const void *data,
+             size_t len);
+
+/** Append an ORIGIN attribute */
+void tb_attr_origin(test_buf_t *tb, uint8_t origin);
+
+/** Append an AS_PATH (or AS4_PATH if type is 17) attribute with a single
+    AS_SEQUENCE segment */
+void tb_attr_as_path(test_buf_t *tb, uint8_t type, int asn_4_byte,
+                     const uint32_t *asns, int asns_cnt);
+
+/** Append a NEXT_HOP attribute */
+void tb_attr_next_hop(test_buf_t *tb, const char *addr);
+
+/** Append a COMMUNITIES attribute */
+void tb_attr_communities(test_buf_t *tb, const uint32_t *comms, int comms_cnt);
+
+/** Append an MP_REACH_NLRI attribute for the given AFI/SAFI. The next hop and
+    NLRI are given already encoded. */
+void tb_attr_mp_reach(test_buf_t *tb, uint16_t afi, uint8_t safi,
+                      const test_buf_t *next_hop, const test_buf_t *nlri);
+
+/** Append an MP_UNREACH_NLRI attribute for the given AFI/SAFI */
+void tb_attr_mp_unreach(test_buf_t *tb, uint16_t afi, uint8_t safi,
+                        const test_buf_t *withdrawn);
+
+/** Append a complete BGP message of the given type */
+void tb_bgp_msg(test_buf_t *tb, uint8_t type, const test_buf_t *body);
+
+/** Append a complete BGP UPDATE message. Any of the parts may be NULL. */
+void tb_bgp_update(test_buf_t *tb, const test_buf_t *withdrawn,
+                   const test_buf_t *attrs, const test_buf_t *nlri);
+
+/** Append a BGP OPEN message. If asn_4_byte is set, the 4-byte AS number
+    capability is included. If add_path is set, an ADD-PATH capability for IPv4
+    unicast with the given send/receive value is included. */
+void tb_bgp_open(test_buf_t *tb, uint32_t asn, int asn_4_byte, int add_path);
+
+/** Start an MRT record, returning the offset to pass to tb_mrt_end */
+size_t tb_mrt_begin(test_buf_t *tb, uint32_t ts, uint16_t type,
+                    uint16_t subtype);
+
+/** Finish an MRT record by filling in its length */
+void tb_mrt_end(test_buf_t *tb, size_t off);
+
+/** Start a BGP4MP record of the given subtype between the given IPv4 peer and
+    local addresses. The caller appends the BGP message and calls
+    tb_mrt_end. */
+size_t tb_bgp4mp_begin(test_buf_t *tb, uint32_t ts, uint16_t subtype,
+                       uint32_t peer_asn, const char *peer_ip);
+
+/** Append a TABLE_DUMP_V2 PEER_INDEX_TABLE record of IPv4 peers with 4-byte AS
+    numbers */
+void tb_peer_index(test_buf_t *tb, int peers_cnt, const char *const *peer_ips,
+                   const uint32_t *peer_asns);
+
+/** Start a TABLE_DUMP_V2 RIB record of the given subtype (the prefix must match
+    the subtype's AFI), returning the offset to pass to tb_mrt_end */
+size_t tb_rib_begin(test_buf_t *tb, uint16_t subtype, uint32_t seq,
+                    const char *prefix, uint16_t entry_count);
+
+/** Append a RIB entry to a TABLE_DUMP_V2 RIB record. If add_path is set, the
+    path_id is included. */
+void tb_rib_entry(test_buf_t *tb, uint16_t peer_index, int add_path,
+                  uint32_t path_id, const test_buf_t *attrs);
+
+/** Start a BMP v3 message, returning the offset to pass to tb_bmp_end */
+size_t tb_bmp_begin(test_buf_t *tb, uint8_t type);
+
+/** Append a BMP per-peer header for an IPv4 peer */
+void tb_bmp_peer_hdr(test_buf_t *tb, uint8_t flags, const char *peer_ip,
+                     uint32_t peer_asn);
+
+/** Finish a BMP message by filling in its length */
+void tb_bmp_end(test_buf_t *tb, size_t off);
+
+/** Append a small UPDATE (ORIGIN, AS_PATH [asn], NEXT_HOP and one NLRI) */
+void tb_simple_update(test_buf_t *tb, int asn_4_byte, uint32_t asn,
+                      const char *prefix);
+
+/** Append the attributes that most tests use: ORIGIN IGP, a 4-byte AS_PATH
+    [65001] and, if next_hop is set, NEXT_HOP 192.0.2.1 */
+void tb_basic_attrs(test_buf_t *tb, int next_hop);
+
+/** Append a RIB_IPV4_UNICAST record for 10.0.0.0/8 that claims to hold
+    entry_count entries, with one entry for each of the given peers (all
+    carrying tb_basic_attrs without NEXT_HOP) */
+void tb_basic_rib(test_buf_t *tb, uint32_t seq, uint16_t entry_count,
+                  const uint16_t *peers, int peers_cnt);
+
+/** Decode the whole buffer as a single message, checking that all of it was
+    used */
+parsebgp_error_t test_decode(parsebgp_opts_t *opts, parsebgp_msg_type_t type,
+                             parsebgp_msg_t *msg, const test_buf_t *tb);
+
+/** Return the UPDATE decoded into msg (from a BGP, BGP4MP or BMP Route
+    Monitoring message), or NULL */
+parsebgp_bgp_update_t *test_update(parsebgp_msg_t *msg);
+
+/** Return the TABLE_DUMP_V2 RIB record decoded into msg, or NULL */
+parsebgp_mrt_table_dump_v2_afi_safi_rib_t *test_rib(parsebgp_msg_t *msg);
+
+/** Return the TABLE_DUMP_V2 PEER_INDEX_TABLE decoded into msg, or NULL */
+parsebgp_mrt_table_dump_v2_peer_index_t *test_peer_index(parsebgp_msg_t *msg);
+
+/** Format a prefix as "addr/len" into buf (which must have at least 64
+    bytes) */
+const char *test_prefix_str(const parsebgp_bgp_prefix_t *prefix, char *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_UTIL_H */
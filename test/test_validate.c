@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_util.h"
+#include <string.h>
+
+/* Tests for parsebgp_validate */
+
+static int check_valid(parsebgp_msg_type_t type, const test_buf_t *tb)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = parsebgp_create_msg();
+  size_t len = tb->len;
+  size_t err_offset = 12345;
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  CHECK_ERR(PARSEBGP_OK,
+            parsebgp_validate(opts, type, tb->buf, &len, &err_offset));
+  CHECK(len == tb->len);
+  CHECK(err_offset == 12345);
+  // anything that validates must also decode
+  CHECK_ERR(PARSEBGP_OK, test_decode(&opts, type, msg, tb));
+  parsebgp_destroy_msg(msg);
+  return 0;
+}
+
+static int check_invalid(parsebgp_msg_type_t type, const test_buf_t *tb,
+                         size_t expected_offset)
+{
+  parsebgp_opts_t opts;
+  size_t len = tb->len;
+  size_t err_offset = 0;
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  CHECK_ERR(PARSEBGP_INVALID_MSG,
+            parsebgp_validate(opts, type, tb->buf, &len, &err_offset));
+  if (err_offset != expected_offset) {
+    fprintf(stderr, "error offset %zu, expected %zu\n", err_offset,
+            expected_offset);
+    return -1;
+  }
+  // validation does not need an output location
+  len = tb->len;
+  CHECK_ERR(PARSEBGP_INVALID_MSG,
+            parsebgp_validate(opts, type, tb->buf, &len, NULL));
+  return 0;
+}
+
+static int test_bgp(void)
+{
+  parsebgp_opts_t opts;
+  test_buf_t tb;
+  size_t len;
+
+  tb_init(&tb);
+  tb_simple_update(&tb, 1, 65001, "10.0.0.0/8");
+  CHECK(check_valid(PARSEBGP_MSG_TYPE_BGP, &tb) == 0);
+
+  // a message that is not all there yet
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = 1;
+  len = tb.len - 1;
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG, parsebgp_validate(opts, PARSEBGP_MSG_TYPE_BGP,
+                                                    tb.buf, &len, NULL));
+  len = 10;
+  CHECK_ERR(PARSEBGP_PARTIAL_MSG, parsebgp_validate(opts, PARSEBGP_MSG_TYPE_BGP,
+                                                    tb.buf, &len, NULL));
+
+  // trailing data after the message is not part of it
+  tb_u8(&tb, 0xff);
+  len = tb.len;
+  CHECK_ERR(PARSEBGP_OK, parsebgp_validate(opts, PARSEBGP_MSG_TYPE_BGP, tb.buf,
+                                           &len, NULL));
+  CHECK(len == tb.len - 1);
+
+  // a header length shorter than the header itself
+  tb_reset(&tb);
+  tb_simple_update(&tb, 1, 65001, "10.0.0.0/8");
+  tb_put16(&tb, 16, 5);
+  CHECK(check_invalid(PARSEBGP_MSG_TYPE_BGP, &tb, 16) == 0);
+
+  // an unknown message type
+  tb_reset(&tb);
+  tb_simple_update(&tb, 1, 65001, "10.0.0.0/8");
+  tb.buf[18] = 7;
+  CHECK(check_invalid(PARSEBGP_MSG_TYPE_BGP, &tb, 18) == 0);
+
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_bgp_update_body(void)
+{
+  test_buf_t attrs, nlri, tb;
+  size_t attr_off;
+
+  tb_init(&attrs);
+  tb_init(&nlri);
+  tb_init(&tb);
+
+  // an IPv4 prefix longer than 32 bits (the NLRI starts after the 19 byte
+  // header, 2 bytes of withdrawn length, 2 bytes of attribute length and the
+  // attributes)
+  tb_basic_attrs(&attrs, 1);
+  tb_u8(&nlri, 33);
+  tb_u32(&nlri, 0x0a000000);
+  tb_u8(&nlri, 0);
+  tb_bgp_update(&tb, NULL, &attrs, &nlri);
+  CHECK(check_invalid(PARSEBGP_MSG_TYPE_BGP, &tb, 23 + attrs.len) == 0);
+
+  // a path attribute whose length overruns the attributes (reported at the
+  // start of the attribute)
+  tb_reset(&tb);
+  tb_reset(&nlri);
+  tb_prefix(&nlri, "10.0.0.0/8");
+  attr_off = attrs.len;
+  tb_attr_origin(&attrs, 0);
+  attrs.buf[attr_off + 2] = 200;
+  tb_bgp_update(&tb, NULL, &attrs, &nlri);
+  CHECK(check_invalid(PARSEBGP_MSG_TYPE_BGP, &tb, 23 + attr_off) == 0);
+
+  // the withdrawn routes length overruns the message
+  tb_reset(&tb);
+  tb_simple_update(&tb, 1, 65001, "10.0.0.0/8");
+  tb_put16(&tb, 19, 1000);
+  CHECK(check_invalid(PARSEBGP_MSG_TYPE_BGP, &tb, 19) == 0);
+
+  tb_free(&attrs);
+  tb_free(&nlri);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_mrt(void)
+{
+  const char *ips[] = {"192.0.2.1"};
+  uint32_t asns[] = {65001};
+  test_buf_t attrs, tb;
+  size_t off, entry_off;
+
+  tb_init(&attrs);
+  tb_init(&tb);
+  tb_peer_index(&tb, 1, ips, asns);
+  CHECK(check_valid(PARSEBGP_MSG_TYPE_MRT, &tb) == 0);
+
+  tb_reset(&tb);
+  tb_basic_attrs(&attrs, 0);
+  off = tb_rib_begin(&tb, PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST, 0,
+                     "10.0.0.0/8", 1);
+  entry_off = tb.len;
+  tb_rib_entry(&tb, 0, 0, 0, &attrs);
+  tb_mrt_end(&tb, off);
+  CHECK(check_valid(PARSEBGP_MSG_TYPE_MRT, &tb) == 0);
+
+  // the RIB entry's attribute length overruns the record
+  tb_put16(&tb, entry_off + 6, attrs.len + 1);
+  CHECK(check_invalid(PARSEBGP_MSG_TYPE_MRT, &tb, entry_off + 6) == 0);
+
+  // a BGP4MP message whose BGP header is broken
+  tb_reset(&tb);
+  off = tb_bgp4mp_begin(&tb, 2000, PARSEBGP_MRT_BGP4MP_MESSAGE_AS4, 65001,
+                        "192.0.2.1");
+  entry_off = tb.len;
+  tb_simple_update(&tb, 1, 65001, "10.0.0.0/8");
+  tb_mrt_end(&tb, off);
+  CHECK(check_valid(PARSEBGP_MSG_TYPE_MRT, &tb) == 0);
+  tb_put16(&tb, entry_off + 16, 5);
+  CHECK(check_invalid(PARSEBGP_MSG_TYPE_MRT, &tb, entry_off + 16) == 0);
+
+  tb_free(&attrs);
+  tb_free(&tb);
+  return 0;
+}
+
+static int test_bmp(void)
+{
+  test_buf_t tb;
+  size_t off;
+
+  tb_init(&tb);
+  off = tb_bmp_begin(&tb, PARSEBGP_BMP_TYPE_ROUTE_MON);
+  tb_bmp_peer_hdr(&tb, 0, "192.0.2.1", 65001);
+  tb_simple_update(&tb, 1, 65001, "10.0.0.0/8");
+  tb_bmp_end(&tb, off);
+  CHECK(check_valid(PARSEBGP_MSG_TYPE_BMP, &tb) == 0);
+
+  // an unknown version
+  tb.buf[0] = 9;
+  CHECK(check_invalid(PARSEBGP_MSG_TYPE_BMP, &tb, 0) == 0);
+
+  tb_free(&tb);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  test_t tests[] = {
+    TEST(test_bgp),
+    TEST(test_bgp_update_body),
+    TEST(test_mrt),
+    TEST(test_bmp),
+  };
+  return test_run(tests, sizeof(tests) / sizeof(tests[0]));
+}
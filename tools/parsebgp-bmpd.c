@@ -0,0 +1,635 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Sample BMP collector: accepts BMP sessions from routers, decodes every
+ * message (incrementally, as it arrives), and reports per-router statistics.
+ * Raw sessions can be archived to disk (and read back with parsebgp).
+ *
+ * Each thread has its own listening socket (bound with SO_REUSEPORT so that
+ * the kernel spreads new sessions over the threads) and epoll loop, and owns
+ * the sessions that it accepts. */
+
+#define _GNU_SOURCE // for accept4
+
+#include "parsebgp.h"
+#include "config.h"
+#include "parsebgp_stream.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NAME "parsebgp-bmpd"
+
+// Read up to 256kB from a session at a time
+#define BUFLEN (256 * 1024)
+
+// Read at most this many times from a session before serving the others
+#define MAX_READS 16
+
+#define MAX_EVENTS 64
+
+#define SYSNAME_LEN 64
+
+// a BMP session from a router
+typedef struct conn {
+  int fd;
+
+  // address and port of the router
+  char addr[INET6_ADDRSTRLEN + 8];
+
+  // sysName from the Initiation message (if any)
+  char sysname[SYSNAME_LEN];
+
+  parsebgp_stream_t *stream;
+
+  // capabilities of the router's BGP sessions (if tracked)
+  parsebgp_session_table_t *sessions;
+
+  // raw copy of the session (if archiving)
+  FILE *archive;
+
+  struct timespec start;
+
+  uint64_t bytes;
+  uint64_t msgs;
+  uint64_t errors;
+  uint64_t types[PARSEBGP_BMP_TYPE_ROUTE_MIRROR_MSG + 1];
+
+  // number of messages at the last report
+  uint64_t reported_msgs;
+
+  struct conn *prev;
+  struct conn *next;
+} conn_t;
+
+// a thread with its own listening socket and event loop
+typedef struct worker {
+  int listen_fd;
+  int epoll_fd;
+  pthread_t thread;
+
+  // sessions owned by this thread
+  conn_t *conns;
+
+  uint8_t buf[BUFLEN];
+} worker_t;
+
+static parsebgp_opts_t opts;
+
+// should session capabilities be tracked (separately for each router)
+static int track_sessions = 0;
+
+// address and port to listen on
+static const char *listen_addr = NULL;
+static const char *listen_port = "5000";
+
+// directory to archive sessions in (if any)
+static const char *archive_dir = NULL;
+
+// interval between statistics reports (0 to only report closed sessions)
+static int report_interval = 0;
+
+// exit once this many sessions have closed (0 to run until interrupted)
+static uint64_t max_closed = 0;
+
+static volatile sig_atomic_t stop = 0;
+
+// totals over the sessions that have closed (updated by all threads)
+static uint64_t closed_cnt = 0;
+static uint64_t total_msgs = 0;
+static uint64_t total_bytes = 0;
+static uint64_t total_errors = 0;
+
+// time the first session was accepted (0 until then), and the last one closed
+static int64_t first_ns = 0;
+static int64_t last_ns = 0;
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void handle_signal(int sig)
+{
+  stop = 1;
+}
+
+static const char *type_strs[] = {
+  "route monitoring", // PARSEBGP_BMP_TYPE_ROUTE_MON
+  "stats",            // PARSEBGP_BMP_TYPE_STATS_REPORT
+  "peer down",        // PARSEBGP_BMP_TYPE_PEER_DOWN
+  "peer up",          // PARSEBGP_BMP_TYPE_PEER_UP
+  "init",             // PARSEBGP_BMP_TYPE_INIT_MSG
+  "term",             // PARSEBGP_BMP_TYPE_TERM_MSG
+  "route mirroring",  // PARSEBGP_BMP_TYPE_ROUTE_MIRROR_MSG
+};
+
+static void report(conn_t *conn, double secs, uint64_t msgs, const char *what)
+{
+  int i;
+
+  flockfile(stderr);
+  fprintf(stderr, "INFO: %s %s (%s): %" PRIu64 " messages (", what,
+          conn->addr, conn->sysname[0] ? conn->sysname : "-", conn->msgs);
+  for (i = 0; i <= PARSEBGP_BMP_TYPE_ROUTE_MIRROR_MSG; i++) {
+    fprintf(stderr, "%s%" PRIu64 " %s", i ? ", " : "", conn->types[i],
+            type_strs[i]);
+  }
+  fprintf(stderr,
+          "), %" PRIu64 " bytes, %" PRIu64 " errors, %.0f messages/s\n",
+          conn->bytes, conn->errors, secs > 0 ? msgs / secs : 0.0);
+  funlockfile(stderr);
+}
+
+static parsebgp_error_t count_msg(parsebgp_error_t err, parsebgp_msg_t *msg,
+                                  void *user)
+{
+  conn_t *conn = user;
+  parsebgp_bmp_msg_t *bmp = msg->types.bmp;
+  parsebgp_bmp_info_tlv_t *tlv;
+  int i, len;
+
+  conn->msgs++;
+  if (err == PARSEBGP_FILTERED_OUT) {
+    return PARSEBGP_OK;
+  }
+  if (err != PARSEBGP_OK) {
+    // the stream moves on to the next message
+    conn->errors++;
+    return PARSEBGP_OK;
+  }
+
+  if (bmp->type <= PARSEBGP_BMP_TYPE_ROUTE_MIRROR_MSG) {
+    conn->types[bmp->type]++;
+  }
+  if (bmp->type == PARSEBGP_BMP_TYPE_INIT_MSG && bmp->types_valid) {
+    for (i = 0; i < bmp->types.init_msg->tlvs_cnt; i++) {
+      tlv = &bmp->types.init_msg->tlvs[i];
+      if (tlv->type == PARSEBGP_BMP_INFO_TLV_TYPE_SYSNAME) {
+        len = tlv->len < SYSNAME_LEN - 1 ? tlv->len : SYSNAME_LEN - 1;
+        memcpy(conn->sysname, tlv->info, len);
+        conn->sysname[len] = '\0';
+      }
+    }
+  }
+  return PARSEBGP_OK;
+}
+
+static int open_archive(conn_t *conn, char *host, const char *serv)
+{
+  char path[1024];
+  size_t i;
+
+  // parsebgp treats anything before a ':' as the file type
+  for (i = 0; host[i] != '\0'; i++) {
+    if (host[i] == ':') {
+      host[i] = '.';
+    }
+  }
+  snprintf(path, sizeof(path), "%s/%s_%s-%ld.bmp", archive_dir, host, serv,
+           (long)time(NULL));
+  if ((conn->archive = fopen(path, "w")) == NULL) {
+    fprintf(stderr, "ERROR: Could not create %s (%s)\n", path,
+            strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+static void close_conn(worker_t *w, conn_t *conn)
+{
+  struct timespec end;
+  double secs;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  secs = (end.tv_sec - conn->start.tv_sec) +
+         (end.tv_nsec - conn->start.tv_nsec) / 1e9;
+  report(conn, secs, conn->msgs, "Closed");
+  if (parsebgp_stream_buffered(conn->stream) > 0) {
+    fprintf(stderr, "WARN: %s closed in the middle of a message (%zu bytes)\n",
+            conn->addr, parsebgp_stream_buffered(conn->stream));
+  }
+
+  __atomic_fetch_add(&total_msgs, conn->msgs, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&total_bytes, conn->bytes, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&total_errors, conn->errors, __ATOMIC_RELAXED);
+  __atomic_store_n(&last_ns, now_ns(), __ATOMIC_RELAXED);
+  if (__atomic_add_fetch(&closed_cnt, 1, __ATOMIC_RELAXED) == max_closed) {
+    stop = 1;
+  }
+
+  if (conn->prev != NULL) {
+    conn->prev->next = conn->next;
+  } else {
+    w->conns = conn->next;
+  }
+  if (conn->next != NULL) {
+    conn->next->prev = conn->prev;
+  }
+
+  close(conn->fd);
+  if (conn->archive != NULL) {
+    fclose(conn->archive);
+  }
+  parsebgp_stream_destroy(conn->stream);
+  parsebgp_session_table_destroy(conn->sessions);
+  free(conn);
+}
+
+static void accept_conns(worker_t *w)
+{
+  struct sockaddr_storage ss;
+  socklen_t ss_len;
+  struct epoll_event ev;
+  parsebgp_opts_t conn_opts = opts;
+  char host[INET6_ADDRSTRLEN] = "", serv[8] = "";
+  int64_t zero = 0;
+  conn_t *conn;
+  int fd;
+
+  for (;;) {
+    ss_len = sizeof(ss);
+    if ((fd = accept4(w->listen_fd, (struct sockaddr *)&ss, &ss_len,
+                      SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        fprintf(stderr, "WARN: accept failed (%s)\n", strerror(errno));
+      }
+      return;
+    }
+
+    if ((conn = calloc(1, sizeof(conn_t))) == NULL ||
+        (track_sessions &&
+         (conn->sessions = parsebgp_session_table_create()) == NULL) ||
+        (conn_opts.sessions = conn->sessions,
+         (conn->stream = parsebgp_stream_create(
+            &conn_opts, PARSEBGP_MSG_TYPE_BMP)) == NULL)) {
+      fprintf(stderr, "ERROR: Failed to create session state\n");
+      if (conn != NULL) {
+        parsebgp_session_table_destroy(conn->sessions);
+      }
+      free(conn);
+      close(fd);
+      continue;
+    }
+    conn->fd = fd;
+    clock_gettime(CLOCK_MONOTONIC, &conn->start);
+    __atomic_compare_exchange_n(&first_ns, &zero, now_ns(), 0,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    zero = 0;
+    if (getnameinfo((struct sockaddr *)&ss, ss_len, host, sizeof(host), serv,
+                    sizeof(serv), NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
+      snprintf(conn->addr, sizeof(conn->addr),
+               ss.ss_family == AF_INET6 ? "[%s]:%s" : "%s:%s", host, serv);
+    }
+
+    conn->next = w->conns;
+    if (w->conns != NULL) {
+      w->conns->prev = conn;
+    }
+    w->conns = conn;
+
+    if (archive_dir != NULL && open_archive(conn, host, serv) != 0) {
+      close_conn(w, conn);
+      continue;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+    if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      fprintf(stderr, "WARN: Could not watch %s (%s)\n", conn->addr,
+              strerror(errno));
+      close_conn(w, conn);
+      continue;
+    }
+    fprintf(stderr, "INFO: Accepted %s\n", conn->addr);
+  }
+}
+
+static void read_conn(worker_t *w, conn_t *conn)
+{
+  parsebgp_error_t err;
+  ssize_t len;
+  int i;
+
+  for (i = 0; i < MAX_READS; i++) {
+    if ((len = read(conn->fd, w->buf, BUFLEN)) < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return;
+      }
+      fprintf(stderr, "WARN: Read from %s failed (%s)\n", conn->addr,
+              strerror(errno));
+      close_conn(w, conn);
+      return;
+    }
+    if (len == 0) {
+      close_conn(w, conn);
+      return;
+    }
+
+    conn->bytes += len;
+    if (conn->archive != NULL &&
+        fwrite(w->buf, 1, len, conn->archive) != (size_t)len) {
+      fprintf(stderr, "ERROR: Failed to archive %s (%s)\n", conn->addr,
+              strerror(errno));
+      fclose(conn->archive);
+      conn->archive = NULL;
+    }
+
+    if ((err = parsebgp_stream_push(conn->stream, w->buf, len, count_msg,
+                                    conn)) != PARSEBGP_OK) {
+      // the stream can no longer be split into messages
+      fprintf(stderr, "ERROR: Invalid BMP stream from %s (%d:%s)\n",
+              conn->addr, err, parsebgp_strerror(err));
+      close_conn(w, conn);
+      return;
+    }
+    if (len < BUFLEN) {
+      // nothing more to read for now
+      return;
+    }
+  }
+}
+
+static void *worker_main(void *arg)
+{
+  worker_t *w = arg;
+  struct epoll_event events[MAX_EVENTS];
+  int64_t next_report = now_ns() + (int64_t)report_interval * 1000000000;
+  conn_t *conn;
+  int i, n;
+
+  while (!stop) {
+    if ((n = epoll_wait(w->epoll_fd, events, MAX_EVENTS, 1000)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "ERROR: epoll_wait failed (%s)\n", strerror(errno));
+      stop = 1;
+      break;
+    }
+    for (i = 0; i < n; i++) {
+      if (events[i].data.ptr == NULL) {
+        accept_conns(w);
+      } else {
+        read_conn(w, events[i].data.ptr);
+      }
+    }
+
+    if (report_interval > 0 && now_ns() >= next_report) {
+      for (conn = w->conns; conn != NULL; conn = conn->next) {
+        report(conn, report_interval, conn->msgs - conn->reported_msgs,
+               "Session");
+        conn->reported_msgs = conn->msgs;
+      }
+      next_report += (int64_t)report_interval * 1000000000;
+    }
+  }
+
+  while (w->conns != NULL) {
+    close_conn(w, w->conns);
+  }
+  return NULL;
+}
+
+static int open_listener(worker_t *w)
+{
+  struct addrinfo hints, *ai = NULL;
+  struct epoll_event ev;
+  int on = 1, err;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  if ((err = getaddrinfo(listen_addr, listen_port, &hints, &ai)) != 0) {
+    fprintf(stderr, "ERROR: Invalid address %s:%s (%s)\n",
+            listen_addr ? listen_addr : "*", listen_port, gai_strerror(err));
+    return -1;
+  }
+
+  if ((w->listen_fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK |
+                                              SOCK_CLOEXEC,
+                             ai->ai_protocol)) < 0 ||
+      setsockopt(w->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) !=
+        0 ||
+      setsockopt(w->listen_fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) !=
+        0 ||
+      bind(w->listen_fd, ai->ai_addr, ai->ai_addrlen) != 0 ||
+      listen(w->listen_fd, SOMAXCONN) != 0) {
+    fprintf(stderr, "ERROR: Could not listen on %s:%s (%s)\n",
+            listen_addr ? listen_addr : "*", listen_port, strerror(errno));
+    freeaddrinfo(ai);
+    return -1;
+  }
+  freeaddrinfo(ai);
+
+  if ((w->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    fprintf(stderr, "ERROR: epoll_create1 failed (%s)\n", strerror(errno));
+    return -1;
+  }
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, w->listen_fd, &ev) != 0) {
+    fprintf(stderr, "ERROR: epoll_ctl failed (%s)\n", strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+static void usage(void)
+{
+  fprintf(
+    stderr,
+    "usage: %s [options]\n"
+    "       -l <addr>          Address to listen on (default: all)\n"
+    "       -p <port>          Port to listen on (default: 5000)\n"
+    "       -t <threads>       Number of threads (default: 1)\n"
+    "       -w <dir>           Archive each session to a file in the\n"
+    "                            given directory\n"
+    "       -r <secs>          Report statistics for each session at\n"
+    "                            the given interval (default: only when\n"
+    "                            sessions close)\n"
+    "       -n <sessions>      Exit once the given number of sessions\n"
+    "                            have closed\n"
+    "       -4                 Force 4-byte ASN parsing\n"
+    "       -a                 Assume NLRI carry ADD-PATH Path Identifiers\n"
+    "       -b                 Perform shallow BMP parsing\n"
+    "       -i                 Ignore invalid messages and attributes\n"
+    "                            (use multiple times to silence warnings)\n"
+    "       -S                 Track session capabilities (from Peer Up\n"
+    "                            messages)\n"
+    "       -s                 Skip unknown messages and attributes\n"
+    "                            (use multiple times to silence warnings)\n"
+    "       -h                 Show this help message\n",
+    NAME);
+}
+
+int main(int argc, char **argv)
+{
+  worker_t *workers = NULL;
+  struct sigaction sa;
+  int threads = 1, started = 0, i, opt;
+  double secs;
+
+  parsebgp_opts_init(&opts);
+
+  while ((opt = getopt(argc, argv, "l:p:t:w:r:n:4abiSsh?")) >= 0) {
+    switch (opt) {
+    case 'l':
+      listen_addr = optarg;
+      break;
+
+    case 'p':
+      listen_port = optarg;
+      break;
+
+    case 't':
+      if ((threads = atoi(optarg)) < 1) {
+        fprintf(stderr, "ERROR: Invalid number of threads '%s'\n", optarg);
+        usage();
+        return -1;
+      }
+      break;
+
+    case 'w':
+      archive_dir = optarg;
+      break;
+
+    case 'r':
+      report_interval = atoi(optarg);
+      break;
+
+    case 'n':
+      max_closed = strtoull(optarg, NULL, 0);
+      break;
+
+    case '4':
+      opts.bgp.asn_4_byte = 1;
+      break;
+
+    case 'a':
+      opts.bgp.add_path = PARSEBGP_BGP_ADD_PATH_ALL;
+      break;
+
+    case 'b':
+      opts.bmp.parse_headers_only = 1;
+      break;
+
+    case 'i':
+      // if this is the second (or more) time, silence the warnings
+      if (opts.ignore_invalid) {
+        opts.silence_invalid = 1;
+      }
+      opts.ignore_invalid = 1;
+      break;
+
+    case 'S':
+      track_sessions = 1;
+      break;
+
+    case 's':
+      // if this is the second (or more) time, silence the warnings
+      if (opts.ignore_not_implemented) {
+        opts.silence_not_implemented = 1;
+      }
+      opts.ignore_not_implemented = 1;
+      break;
+
+    case 'h':
+    case '?':
+    default:
+      usage();
+      return (opt == 'h') ? 0 : -1;
+    }
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handle_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  if ((workers = calloc(threads, sizeof(worker_t))) == NULL) {
+    fprintf(stderr, "ERROR: Failed to allocate threads\n");
+    return -1;
+  }
+  for (i = 0; i < threads; i++) {
+    workers[i].listen_fd = workers[i].epoll_fd = -1;
+  }
+  for (i = 0; i < threads; i++) {
+    if (open_listener(&workers[i]) != 0) {
+      goto out;
+    }
+  }
+  fprintf(stderr, "INFO: Listening on %s:%s with %d thread(s)\n",
+          listen_addr ? listen_addr : "*", listen_port, threads);
+
+  for (i = 0; i < threads; i++) {
+    if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) !=
+        0) {
+      fprintf(stderr, "ERROR: Failed to start thread\n");
+      stop = 1;
+      break;
+    }
+    started++;
+  }
+
+out:
+  for (i = 0; i < started; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+  for (i = 0; i < threads; i++) {
+    if (workers[i].listen_fd >= 0) {
+      close(workers[i].listen_fd);
+    }
+    if (workers[i].epoll_fd >= 0) {
+      close(workers[i].epoll_fd);
+    }
+  }
+  free(workers);
+
+  secs = first_ns ? (last_ns - first_ns) / 1e9 : 0;
+  fprintf(stderr,
+          "INFO: %" PRIu64 " sessions: %" PRIu64 " messages, %" PRIu64
+          " bytes, %" PRIu64 " errors in %.3fs (%.0f messages/s, %.1f MB/s)\n",
+          closed_cnt, total_msgs, total_bytes, total_errors, secs,
+          secs > 0 ? total_msgs / secs : 0.0,
+          secs > 0 ? total_bytes / secs / 1e6 : 0.0);
+  return (started == threads) ? 0 : -1;
+}
@@ -0,0 +1,788 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* BMP load generator: replays BMP messages to a collector over many
+ * concurrent TCP sessions, optionally rate-limited, and reports the achieved
+ * throughput.
+ *
+ * BMP files are replayed as they are. BGP4MP UPDATE messages from MRT files
+ * are wrapped in BMP Route Monitoring messages with a per-peer header
+ * synthesised from the BGP4MP peer fields (and the session starts with an
+ * Initiation message). All input is loaded into memory up front, so that
+ * reading and converting it does not slow down the replay. */
+
+#include "parsebgp.h"
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NAME "parsebgp-bmpreplay"
+
+// Read 1MB of the file at a time
+#define BUFLEN (1024 * 1024)
+
+#define BMP_VERSION 3
+#define BMP_HDR_LEN 6
+#define BMP_PEER_HDR_LEN 42
+#define BMP_INFO_TLV_SYSNAME 2
+
+// the messages to replay, back to back
+typedef struct trace {
+  uint8_t *buf;
+  size_t len;
+  size_t alloc;
+
+  // offset of each message in buf (plus a final offset of len)
+  size_t *offs;
+  size_t cnt;
+  size_t offs_alloc;
+
+  // index of the first message that is repeated when looping (i.e., after
+  // any synthesised Initiation message)
+  size_t loop_msg;
+} trace_t;
+
+// a session to the collector
+typedef struct conn {
+  int fd;
+
+  // next message to be released for sending
+  size_t msg;
+
+  // bytes of the trace that have been sent, and that may be sent
+  size_t pos;
+  size_t limit;
+
+  // number of messages between pos and limit
+  size_t released;
+
+  // number of times that the trace has been sent in full
+  uint64_t loops;
+
+  // messages that may be released now (if rate-limited), and when that was
+  // last computed
+  double tokens;
+  int64_t tokens_ns;
+
+  int done;
+} conn_t;
+
+// a thread that drives a share of the sessions
+typedef struct worker {
+  pthread_t thread;
+
+  conn_t *conns;
+  int conns_cnt;
+
+  // totals over this thread's sessions (only written by the thread)
+  uint64_t msgs;
+  uint64_t bytes;
+  uint64_t failed;
+} worker_t;
+
+static trace_t trace;
+
+// address and port of the collector
+static const char *host = "localhost";
+static const char *port = "5000";
+
+// number of times to send the trace (0 to send until interrupted)
+static uint64_t max_loops = 1;
+
+// messages per second, for each session (0 for no limit)
+static double conn_rate = 0;
+
+// maximum number of messages that a session sends back to back when
+// rate-limited (0 to derive it from the rate)
+static double burst = 0;
+
+// stop after this many seconds (0 to run until all sessions are done)
+static int duration = 0;
+
+// interval between throughput reports (0 to only report at the end)
+static int report_interval = 0;
+
+static volatile sig_atomic_t stop = 0;
+
+// number of threads that are still sending
+static int running = 0;
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void handle_signal(int sig)
+{
+  stop = 1;
+}
+
+static const char *type_strs[] = {
+  NULL,  // PARSEBGP_MSG_TYPE_INVALID
+  "bgp", // PARSEBGP_MSG_TYPE_BGP
+  "bmp", // PARSEBGP_MSG_TYPE_BMP
+  "mrt", // PARSEBGP_MSG_TYPE_MRT
+};
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+// Make room for a message of the given length at the end of the trace, and
+// return a pointer to it
+static uint8_t *trace_append(size_t len)
+{
+  uint8_t *tmp;
+  size_t *otmp;
+  size_t alloc;
+
+  if (trace.len + len > trace.alloc) {
+    alloc = trace.alloc ? trace.alloc : BUFLEN;
+    while (alloc < trace.len + len) {
+      alloc *= 2;
+    }
+    if ((tmp = realloc(trace.buf, alloc)) == NULL) {
+      return NULL;
+    }
+    trace.buf = tmp;
+    trace.alloc = alloc;
+  }
+  if (trace.cnt + 2 > trace.offs_alloc) {
+    alloc = trace.offs_alloc ? trace.offs_alloc * 2 : 1024;
+    if ((otmp = realloc(trace.offs, alloc * sizeof(size_t))) == NULL) {
+      return NULL;
+    }
+    trace.offs = otmp;
+    trace.offs_alloc = alloc;
+  }
+
+  tmp = trace.buf + trace.len;
+  trace.offs[trace.cnt++] = trace.len;
+  trace.len += len;
+  trace.offs[trace.cnt] = trace.len;
+  return tmp;
+}
+
+static int add_init_msg(void)
+{
+  static const char sysname[] = NAME;
+  size_t len = BMP_HDR_LEN + 4 + sizeof(sysname) - 1;
+  uint8_t *p;
+
+  if ((p = trace_append(len)) == NULL) {
+    return -1;
+  }
+  p[0] = BMP_VERSION;
+  put_u32(p + 1, len);
+  p[5] = PARSEBGP_BMP_TYPE_INIT_MSG;
+  put_u16(p + 6, BMP_INFO_TLV_SYSNAME);
+  put_u16(p + 8, sizeof(sysname) - 1);
+  memcpy(p + 10, sysname, sizeof(sysname) - 1);
+  return 0;
+}
+
+// Wrap the BGP message at the end of the given BGP4MP record in a Route
+// Monitoring message
+static int add_route_mon(parsebgp_mrt_msg_t *mrt, const uint8_t *rec,
+                         size_t rec_len)
+{
+  parsebgp_mrt_bgp4mp_t *bgp4mp = mrt->types.bgp4mp;
+  parsebgp_bgp_msg_t *bgp = bgp4mp->data.bgp_msg;
+  size_t len = BMP_HDR_LEN + BMP_PEER_HDR_LEN + bgp->len;
+  uint8_t *p;
+
+  if ((p = trace_append(len)) == NULL) {
+    return -1;
+  }
+  memset(p, 0, BMP_HDR_LEN + BMP_PEER_HDR_LEN);
+  p[0] = BMP_VERSION;
+  put_u32(p + 1, len);
+  p[5] = PARSEBGP_BMP_TYPE_ROUTE_MON;
+  p += BMP_HDR_LEN;
+
+  // peer type (global instance) and distinguisher are left as zero
+  if (bgp4mp->afi == PARSEBGP_BGP_AFI_IPV6) {
+    p[1] |= PARSEBGP_BMP_PEER_FLAG_IPV6;
+    memcpy(p + 10, bgp4mp->peer_ip, 16);
+    // there is no BGP ID in the record, so use the end of the address
+    memcpy(p + 30, bgp4mp->peer_ip + 12, 4);
+  } else {
+    memcpy(p + 22, bgp4mp->peer_ip, 4);
+    memcpy(p + 30, bgp4mp->peer_ip, 4);
+  }
+  if (mrt->subtype == PARSEBGP_MRT_BGP4MP_MESSAGE) {
+    p[1] |= PARSEBGP_BMP_PEER_FLAG_2_BYTE_AS_PATH;
+  }
+  put_u32(p + 26, bgp4mp->peer_asn);
+  put_u32(p + 34, mrt->timestamp_sec);
+  put_u32(p + 38, mrt->timestamp_usec);
+  p += BMP_PEER_HDR_LEN;
+
+  // the BGP message is the last part of the record
+  memcpy(p, rec + rec_len - bgp->len, bgp->len);
+  return 0;
+}
+
+static int load_file(parsebgp_msg_type_t type, const char *fname)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg = NULL;
+  parsebgp_error_t err;
+  uint8_t *buf = NULL, *tmp;
+  size_t len = 0, alloc = 0, off = 0, msg_len, dec_len;
+  size_t cnt = 0, skipped = 0;
+  size_t n;
+  FILE *fp;
+  int ret = -1;
+
+  if ((fp = fopen(fname, "r")) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s (%s)\n", fname,
+            strerror(errno));
+    return -1;
+  }
+  do {
+    if (len == alloc) {
+      alloc += BUFLEN;
+      if ((tmp = realloc(buf, alloc)) == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate file buffer\n");
+        goto out;
+      }
+      buf = tmp;
+    }
+    len += (n = fread(buf + len, 1, alloc - len, fp));
+  } while (n > 0);
+  if (ferror(fp)) {
+    fprintf(stderr, "ERROR: Failed to read %s\n", fname);
+    goto out;
+  }
+
+  // only the BGP4MP fields and BGP header are needed to wrap UPDATEs
+  parsebgp_opts_init(&opts);
+  opts.ignore_not_implemented = opts.silence_not_implemented = 1;
+  opts.ignore_invalid = opts.silence_invalid = 1;
+  opts.projection_enabled = 1;
+  opts.projection = 0;
+  if ((msg = parsebgp_create_msg()) == NULL) {
+    fprintf(stderr, "ERROR: Failed to create message structure\n");
+    goto out;
+  }
+  if (type == PARSEBGP_MSG_TYPE_MRT && trace.cnt == 0) {
+    if (add_init_msg() != 0) {
+      fprintf(stderr, "ERROR: Failed to allocate trace\n");
+      goto out;
+    }
+    trace.loop_msg = 1;
+  }
+
+  while (off < len) {
+    if ((err = parsebgp_msg_len(opts, type, buf + off, len - off,
+                                &msg_len)) != PARSEBGP_OK ||
+        msg_len > len - off) {
+      fprintf(stderr, "WARN: Ignoring %zu trailing bytes of %s (%d:%s)\n",
+              len - off, fname, err,
+              parsebgp_strerror(err == PARSEBGP_OK ? PARSEBGP_PARTIAL_MSG
+                                                    : err));
+      break;
+    }
+
+    if (type == PARSEBGP_MSG_TYPE_BMP) {
+      if ((tmp = trace_append(msg_len)) == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate trace\n");
+        goto out;
+      }
+      memcpy(tmp, buf + off, msg_len);
+      cnt++;
+      off += msg_len;
+      continue;
+    }
+
+    parsebgp_clear_msg(msg);
+    dec_len = msg_len;
+    if (parsebgp_decode(opts, type, msg, buf + off, &dec_len) == PARSEBGP_OK &&
+        (msg->types.mrt->type == PARSEBGP_MRT_TYPE_BGP4MP ||
+         msg->types.mrt->type == PARSEBGP_MRT_TYPE_BGP4MP_ET) &&
+        (msg->types.mrt->subtype == PARSEBGP_MRT_BGP4MP_MESSAGE ||
+         msg->types.mrt->subtype == PARSEBGP_MRT_BGP4MP_MESSAGE_AS4) &&
+        msg->types.mrt->types.bgp4mp->afi != 0 &&
+        msg->types.mrt->types.bgp4mp->data.bgp_msg != NULL &&
+        msg->types.mrt->types.bgp4mp->data.bgp_msg->type ==
+          PARSEBGP_BGP_TYPE_UPDATE &&
+        msg->types.mrt->types.bgp4mp->data.bgp_msg->len <= msg_len) {
+      if (add_route_mon(msg->types.mrt, buf + off, msg_len) != 0) {
+        fprintf(stderr, "ERROR: Failed to allocate trace\n");
+        goto out;
+      }
+      cnt++;
+    } else {
+      skipped++;
+    }
+    off += msg_len;
+  }
+
+  fprintf(stderr,
+          "INFO: Loaded %zu messages from %s (Type: %s)", cnt, fname,
+          type_strs[type]);
+  if (skipped > 0) {
+    fprintf(stderr, ", skipped %zu records that are not BGP4MP UPDATEs",
+            skipped);
+  }
+  fprintf(stderr, "\n");
+  ret = 0;
+
+out:
+  parsebgp_destroy_msg(msg);
+  free(buf);
+  fclose(fp);
+  return ret;
+}
+
+// Move on to the next messages of the trace, if the current ones are sent
+static void release(conn_t *conn, int64_t now)
+{
+  size_t n;
+
+  if (conn->pos < conn->limit) {
+    return;
+  }
+  if (conn->msg == trace.cnt) {
+    conn->loops++;
+    if (conn->loops == max_loops) {
+      conn->done = 1;
+      return;
+    }
+    conn->msg = trace.loop_msg;
+    conn->pos = conn->limit = trace.offs[conn->msg];
+  }
+
+  n = trace.cnt - conn->msg;
+  if (conn_rate > 0) {
+    conn->tokens += (now - conn->tokens_ns) / 1e9 * conn_rate;
+    if (conn->tokens > burst) {
+      conn->tokens = burst;
+    }
+    conn->tokens_ns = now;
+    if (n > conn->tokens) {
+      n = conn->tokens;
+    }
+    conn->tokens -= n;
+  }
+  conn->msg += n;
+  conn->limit = trace.offs[conn->msg];
+  conn->released = n;
+}
+
+static void *worker_main(void *arg)
+{
+  worker_t *w = arg;
+  struct pollfd *fds = NULL;
+  conn_t **polled = NULL;
+  int64_t now, wait_ns;
+  ssize_t len;
+  int active = w->conns_cnt, nfds, timeout, i, j;
+  conn_t *conn;
+
+  if ((fds = malloc(w->conns_cnt * sizeof(struct pollfd))) == NULL ||
+      (polled = malloc(w->conns_cnt * sizeof(conn_t *))) == NULL) {
+    fprintf(stderr, "ERROR: Failed to allocate poll set\n");
+    __atomic_store_n(&w->failed, w->conns_cnt, __ATOMIC_RELAXED);
+    goto done;
+  }
+
+  // sessions start with a full burst
+  now = now_ns();
+  for (i = 0; i < w->conns_cnt; i++) {
+    w->conns[i].tokens = burst;
+    w->conns[i].tokens_ns = now;
+  }
+
+  while (!stop && active > 0) {
+    now = now_ns();
+    nfds = 0;
+    timeout = -1;
+    for (i = 0; i < w->conns_cnt; i++) {
+      conn = &w->conns[i];
+      if (conn->done) {
+        continue;
+      }
+      release(conn, now);
+      if (conn->done) {
+        close(conn->fd);
+        active--;
+        continue;
+      }
+      if (conn->pos < conn->limit) {
+        fds[nfds].fd = conn->fd;
+        fds[nfds].events = POLLOUT;
+        polled[nfds++] = conn;
+      } else {
+        // wait until the session may send another message
+        wait_ns = (1 - conn->tokens) / conn_rate * 1e9;
+        j = wait_ns / 1000000 + 1;
+        if (timeout < 0 || j < timeout) {
+          timeout = j;
+        }
+      }
+    }
+    if (active == 0) {
+      break;
+    }
+    if (timeout < 0 || timeout > 100) {
+      // check for stop regularly
+      timeout = 100;
+    }
+
+    if ((nfds = poll(fds, nfds, timeout)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "ERROR: poll failed (%s)\n", strerror(errno));
+      break;
+    }
+    for (i = 0; nfds > 0; i++) {
+      if (fds[i].revents == 0) {
+        continue;
+      }
+      nfds--;
+      conn = polled[i];
+      if ((len = send(conn->fd, trace.buf + conn->pos,
+                      conn->limit - conn->pos, MSG_NOSIGNAL | MSG_DONTWAIT)) <
+          0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+          continue;
+        }
+        fprintf(stderr, "WARN: Session failed (%s)\n", strerror(errno));
+        close(conn->fd);
+        conn->done = 1;
+        active--;
+        __atomic_store_n(&w->failed, w->failed + 1, __ATOMIC_RELAXED);
+        continue;
+      }
+      conn->pos += len;
+      __atomic_store_n(&w->bytes, w->bytes + len, __ATOMIC_RELAXED);
+      if (conn->pos == conn->limit) {
+        __atomic_store_n(&w->msgs, w->msgs + conn->released,
+                         __ATOMIC_RELAXED);
+        conn->released = 0;
+      }
+    }
+  }
+
+done:
+  for (i = 0; i < w->conns_cnt; i++) {
+    if (!w->conns[i].done) {
+      close(w->conns[i].fd);
+    }
+  }
+  free(fds);
+  free(polled);
+  __atomic_sub_fetch(&running, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static int connect_conn(conn_t *conn, struct addrinfo *ai)
+{
+  int flags;
+
+  for (; ai != NULL; ai = ai->ai_next) {
+    if ((conn->fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                           ai->ai_protocol)) < 0) {
+      continue;
+    }
+    if (connect(conn->fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+        (flags = fcntl(conn->fd, F_GETFL)) >= 0 &&
+        fcntl(conn->fd, F_SETFL, flags | O_NONBLOCK) == 0) {
+      return 0;
+    }
+    close(conn->fd);
+  }
+  fprintf(stderr, "ERROR: Could not connect to %s:%s (%s)\n", host, port,
+          strerror(errno));
+  return -1;
+}
+
+static void report(worker_t *workers, int threads, double secs,
+                   const char *what)
+{
+  uint64_t msgs = 0, bytes = 0, failed = 0;
+  int i;
+
+  for (i = 0; i < threads; i++) {
+    msgs += __atomic_load_n(&workers[i].msgs, __ATOMIC_RELAXED);
+    bytes += __atomic_load_n(&workers[i].bytes, __ATOMIC_RELAXED);
+    failed += __atomic_load_n(&workers[i].failed, __ATOMIC_RELAXED);
+  }
+  fprintf(stderr,
+          "INFO: %s %" PRIu64 " messages, %" PRIu64 " bytes in %.3fs (%.0f "
+          "messages/s, %.1f MB/s), %" PRIu64 " failed sessions\n",
+          what, msgs, bytes, secs, secs > 0 ? msgs / secs : 0.0,
+          secs > 0 ? bytes / secs / 1e6 : 0.0, failed);
+}
+
+static void usage(void)
+{
+  fprintf(
+    stderr,
+    "usage: %s [options] [type:]file [[type:]file...]\n"
+    "         where 'type' is one of 'bmp' or 'mrt'\n"
+    "         (only required if using non-standard file extensions)\n"
+    "       -H <host>          Collector to connect to (default: localhost)\n"
+    "       -p <port>          Collector port (default: 5000)\n"
+    "       -c <sessions>      Number of concurrent sessions (default: 1)\n"
+    "       -t <threads>       Number of threads (default: 1)\n"
+    "       -l <loops>         Number of times each session sends the\n"
+    "                            messages (default: 1, 0 to loop until\n"
+    "                            interrupted)\n"
+    "       -r <msgs/s>        Limit the rate of messages sent (over all\n"
+    "                            sessions)\n"
+    "       -b <msgs>          Number of messages that each session may send\n"
+    "                            back to back when rate-limited (default:\n"
+    "                            10ms worth)\n"
+    "       -d <secs>          Stop after the given number of seconds\n"
+    "       -R <secs>          Report throughput at the given interval\n"
+    "       -h                 Show this help message\n",
+    NAME);
+}
+
+int main(int argc, char **argv)
+{
+  worker_t *workers = NULL;
+  conn_t *conns = NULL;
+  struct addrinfo hints, *ai = NULL;
+  struct sigaction sa;
+  double rate = 0;
+  int64_t start, next_report, end;
+  int sessions = 1, threads = 1, started = 0, connected = 0, ret = -1;
+  int i, j, opt, type, err;
+  char *fname, *tname;
+
+  while ((opt = getopt(argc, argv, "H:p:c:t:l:r:b:d:R:h?")) >= 0) {
+    switch (opt) {
+    case 'H':
+      host = optarg;
+      break;
+
+    case 'p':
+      port = optarg;
+      break;
+
+    case 'c':
+      if ((sessions = atoi(optarg)) < 1) {
+        fprintf(stderr, "ERROR: Invalid number of sessions '%s'\n", optarg);
+        usage();
+        return -1;
+      }
+      break;
+
+    case 't':
+      if ((threads = atoi(optarg)) < 1) {
+        fprintf(stderr, "ERROR: Invalid number of threads '%s'\n", optarg);
+        usage();
+        return -1;
+      }
+      break;
+
+    case 'l':
+      max_loops = strtoull(optarg, NULL, 0);
+      break;
+
+    case 'r':
+      rate = atof(optarg);
+      break;
+
+    case 'b':
+      burst = atof(optarg);
+      break;
+
+    case 'd':
+      duration = atoi(optarg);
+      break;
+
+    case 'R':
+      report_interval = atoi(optarg);
+      break;
+
+    case 'h':
+    case '?':
+    default:
+      usage();
+      return (opt == 'h') ? 0 : -1;
+    }
+  }
+
+  if (optind >= argc) {
+    fprintf(stderr, "ERROR: At least one file must be specified\n");
+    usage();
+    return -1;
+  }
+  if (threads > sessions) {
+    threads = sessions;
+  }
+  if (rate > 0) {
+    conn_rate = rate / sessions;
+    if (burst < 1) {
+      burst = conn_rate / 100 >= 1 ? conn_rate / 100 : 1;
+    }
+  }
+
+  for (i = optind; i < argc; i++) {
+    type = 0;
+    if ((fname = strchr(argv[i], ':')) != NULL) {
+      tname = argv[i];
+      *(fname++) = '\0';
+    } else {
+      fname = argv[i];
+      tname = strrchr(fname, '.') != NULL ? strrchr(fname, '.') + 1 : "";
+    }
+    PARSEBGP_FOREACH_MSG_TYPE(j)
+    {
+      if (strcmp(tname, type_strs[j]) == 0) {
+        type = j;
+        break;
+      }
+    }
+    if (type != PARSEBGP_MSG_TYPE_BMP && type != PARSEBGP_MSG_TYPE_MRT) {
+      fprintf(stderr,
+              "ERROR: Could not identify type of %s as BMP or MRT, "
+              "consider explicitly specifying type using type:file syntax\n",
+              fname);
+      usage();
+      goto out;
+    }
+    if (load_file(type, fname) != 0) {
+      goto out;
+    }
+  }
+  if (trace.cnt <= trace.loop_msg) {
+    fprintf(stderr, "ERROR: No messages to replay\n");
+    goto out;
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if ((err = getaddrinfo(host, port, &hints, &ai)) != 0) {
+    fprintf(stderr, "ERROR: Invalid address %s:%s (%s)\n", host, port,
+            gai_strerror(err));
+    goto out;
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handle_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  if ((conns = calloc(sessions, sizeof(conn_t))) == NULL ||
+      (workers = calloc(threads, sizeof(worker_t))) == NULL) {
+    fprintf(stderr, "ERROR: Failed to allocate sessions\n");
+    goto out;
+  }
+  for (connected = 0; connected < sessions; connected++) {
+    if (connect_conn(&conns[connected], ai) != 0) {
+      goto out;
+    }
+  }
+  fprintf(stderr,
+          "INFO: Replaying %zu messages (%zu bytes) to %s:%s over %d "
+          "session(s) with %d thread(s)\n",
+          trace.cnt, trace.len, host, port, sessions, threads);
+
+  // share the sessions out between the threads
+  for (i = 0, j = 0; i < threads; i++) {
+    workers[i].conns = &conns[j];
+    workers[i].conns_cnt = sessions / threads + (i < sessions % threads);
+    j += workers[i].conns_cnt;
+  }
+
+  start = now_ns();
+  next_report = start + (int64_t)report_interval * 1000000000;
+  for (i = 0; i < threads; i++) {
+    __atomic_add_fetch(&running, 1, __ATOMIC_RELAXED);
+    if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) !=
+        0) {
+      fprintf(stderr, "ERROR: Failed to start thread\n");
+      __atomic_sub_fetch(&running, 1, __ATOMIC_RELAXED);
+      stop = 1;
+      break;
+    }
+    started++;
+  }
+  // the threads now own (and will close) the sessions
+  connected = 0;
+
+  while (__atomic_load_n(&running, __ATOMIC_ACQUIRE) > 0) {
+    usleep(10000);
+    end = now_ns();
+    if (duration > 0 && end - start >= (int64_t)duration * 1000000000) {
+      stop = 1;
+    }
+    if (report_interval > 0 && end >= next_report) {
+      report(workers, started, (end - start) / 1e9, "Sent");
+      next_report += (int64_t)report_interval * 1000000000;
+    }
+  }
+  for (i = 0; i < started; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+  end = now_ns();
+  report(workers, started, (end - start) / 1e9, "Done: sent");
+  ret = (started == threads) ? 0 : -1;
+
+out:
+  for (i = 0; i < connected; i++) {
+    close(conns[i].fd);
+  }
+  if (ai != NULL) {
+    freeaddrinfo(ai);
+  }
+  free(conns);
+  free(workers);
+  free(trace.buf);
+  free(trace.offs);
+  return ret;
+}
@@ -26,12 +26,18 @@
 
 #include "parsebgp.h"
 #include "config.h"
+#include "parsebgp_pipeline.h"
+#include "reader.h"
+#include <arpa/inet.h>
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #define NAME "parsebgp"
@@ -39,6 +45,12 @@
 // Read 1MB of the file at a time
 #define BUFLEN (1024 * 1024)
 
+// When parsing several files at once, split MRT files into chunks of about
+// 64MB (the tests use a copy with smaller chunks)
+#ifndef CHUNK_LEN
+#define CHUNK_LEN (64 * 1024 * 1024)
+#endif
+
 static const char *type_strs[] = {
   NULL,  // PARSEBGP_MSG_TYPE_INVALID
   "bgp", // PARSEBGP_MSG_TYPE_BGP
@@ -53,6 +65,91 @@ static const char *type_strs[] = {
 // the printfs slowing things down.
 static int silent = 0;
 
+// should messages only be validated (not decoded)
+static int validate_only = 0;
+
+// should route elements be output instead of the message dump
+static int elems = 0;
+
+// number of threads (0 to decode in the main thread)
+static int jobs = 0;
+
+// should files be read ahead with io_uring (or pread) instead of stdio
+static int use_uring = 0;
+
+// a file given on the command line (when parsing several files at once)
+typedef struct file {
+  // copy of the argument (fname points into it)
+  char *arg;
+  char *fname;
+  parsebgp_msg_type_t type;
+  off_t size;
+
+  // copy of the options that counts RIB entries for this file
+  parsebgp_opts_t opts;
+
+  uint64_t cnt;
+  uint64_t filtered_cnt;
+  uint64_t streamed_cnt;
+
+  // number of unfinished tasks for this file
+  int tasks_left;
+  int failed;
+} file_t;
+
+// part of a file to parse
+typedef struct task {
+  file_t *file;
+
+  // offsets of the first message, and of the end of the part (-1 for the end
+  // of the file)
+  off_t start;
+  off_t end;
+
+  // TABLE_DUMP_V2 Peer Index Table that applies to the start of the part (-1
+  // if none)
+  off_t peer_index_start;
+  size_t peer_index_len;
+
+  // should the file be split into chunks (rather than parsed)
+  int split;
+} task_t;
+
+// tasks owned by one thread: the owner pushes and pops at the tail, other
+// threads steal from the head
+typedef struct task_queue {
+  pthread_mutex_t mutex;
+  task_t **tasks;
+  size_t head;
+  size_t tail;
+  size_t alloc_cnt;
+} task_queue_t;
+
+static task_queue_t *queues = NULL;
+static int queues_cnt = 0;
+
+// number of queued or running tasks
+static uint64_t tasks_pending = 0;
+
+// number of queued tasks, which idle threads wait for (along with the end of
+// the last task) on idle_cond
+static uint64_t tasks_queued = 0;
+static pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+
+// wake idle threads: either a task was queued or (all == 1) there is no more
+// work to do.  The lock orders this after an idle thread checks for work.
+static void wake_idle(int all)
+{
+  pthread_mutex_lock(&idle_mutex);
+  if (all) {
+    pthread_cond_broadcast(&idle_cond);
+  } else {
+    pthread_cond_signal(&idle_cond);
+  }
+  pthread_mutex_unlock(&idle_mutex);
+}
+
 static ssize_t refill_buffer(FILE *fp, uint8_t *buf, size_t buflen,
                              size_t remain)
 {
@@ -79,19 +176,131 @@ static ssize_t refill_buffer(FILE *fp, uint8_t *buf, size_t buflen,
   return len;
 }
 
-static int parse(parsebgp_opts_t *opts, parsebgp_msg_type_t type, char *fname)
+// read more of the file, using the reader if there is one
+static ssize_t fill_buffer(FILE *fp, reader_t *reader, uint8_t *buf,
+                           uint8_t **bufp, size_t remain)
+{
+  if (reader != NULL) {
+    return reader_refill(reader, bufp, remain);
+  }
+  *bufp = buf;
+  return refill_buffer(fp, buf, BUFLEN, remain);
+}
+
+static uint64_t streamed_cnt = 0;
+
+static parsebgp_error_t
+count_rib_entry(const parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib,
+                const parsebgp_mrt_table_dump_v2_rib_entry_t *entry, void *user)
+{
+  // may be called by several threads at once
+  __atomic_fetch_add((uint64_t *)user, 1, __ATOMIC_RELAXED);
+  return PARSEBGP_OK;
+}
+
+static const char *elem_type_strs[] = {
+  NULL, // invalid
+  "R",  // PARSEBGP_ELEM_TYPE_RIB
+  "A",  // PARSEBGP_ELEM_TYPE_ANNOUNCEMENT
+  "W",  // PARSEBGP_ELEM_TYPE_WITHDRAWAL
+  "S",  // PARSEBGP_ELEM_TYPE_PEER_STATE
+};
+
+static const char *addr_str(parsebgp_bgp_afi_t afi, const uint8_t *addr,
+                            char *buf)
+{
+  if (addr == NULL ||
+      inet_ntop(afi == PARSEBGP_BGP_AFI_IPV6 ? AF_INET6 : AF_INET, addr, buf,
+                INET6_ADDRSTRLEN) == NULL) {
+    return "";
+  }
+  return buf;
+}
+
+// print one line per route element:
+// TYPE|TIME|PEER_IP|PEER_ASN|PREFIX|PATH_ID|NEXT_HOP (or OLD|NEW for states)
+static void
+dump_elems(const parsebgp_msg_t *msg,
+           const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index)
+{
+  parsebgp_elem_iter_t iter;
+  const parsebgp_elem_t *elem;
+  char peer[INET6_ADDRSTRLEN], pfx[INET6_ADDRSTRLEN], nh[INET6_ADDRSTRLEN];
+
+  parsebgp_elem_iter_init(&iter, msg, peer_index);
+  while ((elem = parsebgp_elem_iter_next(&iter)) != NULL) {
+    printf("%s|%" PRIu32 ".%06" PRIu32 "|%s|%" PRIu32 "|",
+           elem_type_strs[elem->type], elem->timestamp_sec,
+           elem->timestamp_usec, addr_str(elem->peer_afi, elem->peer_ip, peer),
+           elem->peer_asn);
+    if (elem->type == PARSEBGP_ELEM_TYPE_PEER_STATE) {
+      printf("%d|%d\n", elem->old_state, elem->new_state);
+      continue;
+    }
+    printf("%s/%d|", addr_str(elem->prefix->afi, elem->prefix->addr, pfx),
+           elem->prefix->len);
+    if (elem->prefix->path_id_valid) {
+      printf("%" PRIu32, elem->prefix->path_id);
+    }
+    printf("|%s\n", addr_str(elem->next_hop_afi, elem->next_hop, nh));
+  }
+}
+
+static void print_stats(parsebgp_opts_t *opts, const char *fname,
+                        uint64_t cnt, uint64_t filtered_cnt)
+{
+  fprintf(stderr, "INFO: Read %" PRIu64 " messages from %s\n", cnt, fname);
+  if (opts->sessions != NULL) {
+    fprintf(stderr, "INFO: %" PRIu64 " sessions known after reading %s\n",
+            parsebgp_session_table_size(opts->sessions), fname);
+  }
+  if (opts->attr_cache != NULL) {
+    parsebgp_attr_cache_stats_t stats;
+    parsebgp_attr_cache_get_stats(opts->attr_cache, &stats);
+    fprintf(stderr,
+            "INFO: Attribute cache: %" PRIu64 " hits from %" PRIu64
+            " lookups (%.1f%%), %" PRIu64 " evictions, %" PRIu64
+            " bytes not decoded after reading %s\n",
+            stats.hits, stats.lookups,
+            stats.lookups ? 100.0 * stats.hits / stats.lookups : 0.0,
+            stats.evictions, stats.bytes_saved, fname);
+  }
+  if (opts->mrt_rib_entry_cb != NULL) {
+    uint64_t *streamed = opts->mrt_rib_entry_cb_user;
+    fprintf(stderr, "INFO: Streamed %" PRIu64 " RIB entries from %s\n",
+            *streamed, fname);
+    *streamed = 0;
+  }
+  if (opts->filter != NULL || opts->prefix_set != NULL ||
+      opts->mrt_peer_filter != NULL) {
+    fprintf(stderr, "INFO: %" PRIu64 " messages did not match the filter\n",
+            filtered_cnt);
+  }
+}
+
+// parse the messages of the given file from offset start until offset end (or
+// the end of the file if end is -1). If peer_index_start is not -1, the Peer
+// Index Table found there is decoded first (but not output). The file is read
+// using the given reader, or stdio if it is NULL.
+static int parse_range(parsebgp_opts_t *opts, parsebgp_msg_type_t type,
+                       const char *fname, off_t start, off_t end,
+                       off_t peer_index_start, size_t peer_index_len,
+                       reader_t *reader, uint64_t *cntp,
+                       uint64_t *filtered_cntp)
 {
   uint8_t buf[BUFLEN];
   FILE *fp = NULL;
 
   ssize_t fill_len = 0, remain = 0;
-  size_t dec_len = 0;
-  uint8_t *ptr;
+  size_t dec_len = 0, err_offset = 0;
+  uint8_t *data, *ptr;
+  off_t pos = start;
 
   parsebgp_msg_t *msg = NULL;
   parsebgp_error_t err = PARSEBGP_OK;
 
-  uint64_t cnt = 0;
+  uint64_t cnt = 0, filtered_cnt = 0;
+  int filtered;
 
   if ((msg = parsebgp_create_msg()) == NULL) {
     fprintf(stderr, "ERROR: Failed to create message structure\n");
@@ -105,9 +314,36 @@ static int parse(parsebgp_opts_t *opts, parsebgp_msg_type_t type, char *fname)
     goto err;
   }
 
+  if (peer_index_start >= 0 && !validate_only) {
+    dec_len = peer_index_len;
+    if (peer_index_len > BUFLEN ||
+        fseeko(fp, peer_index_start, SEEK_SET) != 0 ||
+        fread(buf, 1, peer_index_len, fp) != peer_index_len ||
+        ((err = parsebgp_decode(*opts, type, msg, buf, &dec_len)) !=
+           PARSEBGP_OK &&
+         err != PARSEBGP_FILTERED_OUT)) {
+      fprintf(stderr, "ERROR: Failed to read Peer Index Table from %s\n",
+              fname);
+      goto err;
+    }
+    // the table is kept by the message when it is cleared
+    parsebgp_clear_msg(msg);
+  }
+  if (start > 0 && fseeko(fp, start, SEEK_SET) != 0) {
+    fprintf(stderr, "ERROR: Could not seek in %s (%s)\n", fname,
+            strerror(errno));
+    goto err;
+  }
+
+  if (reader != NULL && reader_open(reader, fileno(fp), start, end) != 0) {
+    fprintf(stderr, "ERROR: Could not read %s (%s)\n", fname,
+            strerror(errno));
+    goto err;
+  }
+
   buf[0] = '\0';
 
-  while ((fill_len = refill_buffer(fp, buf, BUFLEN, remain)) > 0) {
+  while ((fill_len = fill_buffer(fp, reader, buf, &data, remain)) > 0) {
     if (fill_len == remain) {
       // failed to read anything new from the file, so give up
       fprintf(stderr,
@@ -117,21 +353,38 @@ static int parse(parsebgp_opts_t *opts, parsebgp_msg_type_t type, char *fname)
       break;
     }
     remain = fill_len;
-    ptr = buf;
+    ptr = data;
 
     while (remain > 0) {
+      if (end >= 0 && pos >= end) {
+        goto done;
+      }
       dec_len = remain;
-      if ((err = parsebgp_decode(*opts, type, msg, ptr, &dec_len)) !=
-          PARSEBGP_OK) {
+      filtered = 0;
+      if (validate_only) {
+        err = parsebgp_validate(*opts, type, ptr, &dec_len, &err_offset);
+      } else {
+        err = parsebgp_decode(*opts, type, msg, ptr, &dec_len);
+      }
+      if (err != PARSEBGP_OK) {
         if (err == PARSEBGP_PARTIAL_MSG) {
           // refill the buffer and try again
           parsebgp_clear_msg(msg);
           break;
+        } else if (err == PARSEBGP_FILTERED_OUT) {
+          // message did not match the filter, skip over it
+          filtered = 1;
+          filtered_cnt++;
         } else if (err == PARSEBGP_TRUNCATED_MSG && opts->ignore_invalid) {
           if (!(opts)->silence_invalid) {
             fprintf(stderr, "WARN: truncated message %" PRIu64 " in %s\n",
               cnt, fname);
           }
+        } else if (validate_only) {
+          fprintf(stderr,
+                  "ERROR: Invalid message %" PRIu64 " at byte %zu (%d:%s)\n",
+                  cnt, err_offset, err, parsebgp_strerror(err));
+          goto err;
         } else {
           // else: its a fatal error
           fprintf(stderr, "ERROR: Failed to parse message (%d:%s)\n", err,
@@ -143,10 +396,18 @@ static int parse(parsebgp_opts_t *opts, parsebgp_msg_type_t type, char *fname)
       assert(dec_len > 0);
       ptr += dec_len;
       remain -= dec_len;
+      pos += dec_len;
       cnt++;
 
-      if (!silent) {
-        parsebgp_dump_msg(msg);
+      if (!silent && !validate_only && !filtered) {
+        // keep the output of other threads from splitting the message
+        flockfile(stdout);
+        if (elems) {
+          dump_elems(msg, NULL);
+        } else {
+          parsebgp_dump_msg(msg);
+        }
+        funlockfile(stdout);
       }
 
       parsebgp_clear_msg(msg);
@@ -159,7 +420,9 @@ static int parse(parsebgp_opts_t *opts, parsebgp_msg_type_t type, char *fname)
     goto err;
   }
 
-  fprintf(stderr, "INFO: Read %" PRIu64 " messages from %s\n", cnt, fname);
+done:
+  *cntp = cnt;
+  *filtered_cntp = filtered_cnt;
 
   if (fp != NULL && fp != stdin) {
     fclose(fp);
@@ -177,6 +440,502 @@ err:
   return -1;
 }
 
+static int parse(parsebgp_opts_t *opts, parsebgp_msg_type_t type, char *fname,
+                 reader_t *reader)
+{
+  uint64_t cnt, filtered_cnt;
+
+  if (parse_range(opts, type, fname, 0, -1, -1, 0, reader, &cnt,
+                  &filtered_cnt) != 0) {
+    return -1;
+  }
+  print_stats(opts, fname, cnt, filtered_cnt);
+  return 0;
+}
+
+// per-file state of the output stage of the pipeline
+typedef struct pipeline_state {
+  parsebgp_opts_t *opts;
+  const char *fname;
+  uint64_t cnt;
+  uint64_t filtered_cnt;
+  int stopped;
+} pipeline_state_t;
+
+static parsebgp_error_t
+output_msg(uint64_t seq, parsebgp_error_t err, parsebgp_msg_t *msg,
+           const parsebgp_mrt_table_dump_v2_peer_index_t *peer_index,
+           void *user)
+{
+  pipeline_state_t *state = user;
+
+  if (err == PARSEBGP_FILTERED_OUT) {
+    state->filtered_cnt++;
+    state->cnt++;
+    return PARSEBGP_OK;
+  }
+  if (err == PARSEBGP_TRUNCATED_MSG && state->opts->ignore_invalid) {
+    if (!state->opts->silence_invalid) {
+      fprintf(stderr, "WARN: truncated message %" PRIu64 " in %s\n",
+              state->cnt, state->fname);
+    }
+  } else if (err != PARSEBGP_OK) {
+    fprintf(stderr, "ERROR: Failed to parse message (%d:%s)\n", err,
+            parsebgp_strerror(err));
+    state->stopped = 1;
+    return err;
+  }
+  state->cnt++;
+
+  if (!silent) {
+    if (elems) {
+      dump_elems(msg, peer_index);
+    } else {
+      parsebgp_dump_msg(msg);
+    }
+  }
+  return PARSEBGP_OK;
+}
+
+// same as parse, but messages are decoded by the pipeline's worker threads
+static int parse_pipeline(parsebgp_pipeline_t *pipeline,
+                          parsebgp_pipeline_config_t *config,
+                          parsebgp_msg_type_t type, char *fname)
+{
+  pipeline_state_t *state = config->user;
+  FILE *fp = NULL;
+  parsebgp_error_t err;
+
+  if (strcmp(fname, "-") == 0) {
+    fp = stdin;
+  } else if ((fp = fopen(fname, "r")) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s (%s)\n", fname, strerror(errno));
+    return -1;
+  }
+
+  state->fname = fname;
+  state->cnt = 0;
+  state->filtered_cnt = 0;
+  state->stopped = 0;
+
+  err = parsebgp_pipeline_run(pipeline, type, fp);
+  if (fp != stdin) {
+    fclose(fp);
+  }
+  if (err == PARSEBGP_PARTIAL_MSG) {
+    fprintf(stderr, "ERROR: Possibly corrupt file encountered. Trailing "
+                    "garbage found\n");
+  } else if (err != PARSEBGP_OK) {
+    if (!state->stopped) {
+      fprintf(stderr, "ERROR: Failed to read messages from %s (%d:%s)\n",
+              fname, err, parsebgp_strerror(err));
+    }
+    return -1;
+  }
+
+  print_stats(state->opts, fname, state->cnt, state->filtered_cnt);
+  return 0;
+}
+
+static int push_task(task_queue_t *q, task_t *task)
+{
+  task_t **tmp;
+
+  pthread_mutex_lock(&q->mutex);
+  if (q->tail == q->alloc_cnt) {
+    if (q->head > 0) {
+      memmove(q->tasks, q->tasks + q->head,
+              sizeof(task_t *) * (q->tail - q->head));
+      q->tail -= q->head;
+      q->head = 0;
+    } else {
+      if ((tmp = realloc(q->tasks, sizeof(task_t *) *
+                                     (q->alloc_cnt ? q->alloc_cnt * 2 : 16))) ==
+          NULL) {
+        pthread_mutex_unlock(&q->mutex);
+        return -1;
+      }
+      q->tasks = tmp;
+      q->alloc_cnt = q->alloc_cnt ? q->alloc_cnt * 2 : 16;
+    }
+  }
+  q->tasks[q->tail++] = task;
+  pthread_mutex_unlock(&q->mutex);
+  return 0;
+}
+
+// take the most recently queued task (from == 0), or the oldest (from == 1)
+static task_t *pop_task(task_queue_t *q, int from)
+{
+  task_t *task = NULL;
+
+  pthread_mutex_lock(&q->mutex);
+  if (q->head < q->tail) {
+    task = from ? q->tasks[q->head++] : q->tasks[--q->tail];
+    __atomic_fetch_sub(&tasks_queued, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&q->mutex);
+  return task;
+}
+
+static int queue_task(task_queue_t *q, file_t *file, off_t start, off_t end,
+                      off_t peer_index_start, size_t peer_index_len, int split)
+{
+  task_t *task;
+
+  if ((task = malloc(sizeof(task_t))) == NULL) {
+    return -1;
+  }
+  task->file = file;
+  task->start = start;
+  task->end = end;
+  task->peer_index_start = peer_index_start;
+  task->peer_index_len = peer_index_len;
+  task->split = split;
+
+  __atomic_fetch_add(&file->tasks_left, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&tasks_pending, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&tasks_queued, 1, __ATOMIC_RELAXED);
+  if (push_task(q, task) != 0) {
+    __atomic_fetch_sub(&file->tasks_left, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&tasks_pending, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&tasks_queued, 1, __ATOMIC_RELAXED);
+    free(task);
+    return -1;
+  }
+  wake_idle(0);
+  return 0;
+}
+
+// split an MRT file into chunks of about CHUNK_LEN bytes at record boundaries
+// (found by skipping from one record header to the next), and queue them
+static int split_file(file_t *file, task_queue_t *q)
+{
+  FILE *fp;
+  uint8_t hdr[12];
+  uint16_t type, subtype;
+  uint32_t len;
+  off_t off = 0, chunk_start = 0, peer_index_start = -1, chunk_pi_start = -1;
+  size_t peer_index_len = 0, chunk_pi_len = 0;
+
+  if ((fp = fopen(file->fname, "r")) != NULL) {
+    while (fread(hdr, 1, sizeof(hdr), fp) == sizeof(hdr)) {
+      memcpy(&type, hdr + 4, sizeof(type));
+      memcpy(&subtype, hdr + 6, sizeof(subtype));
+      memcpy(&len, hdr + 8, sizeof(len));
+      type = ntohs(type);
+      subtype = ntohs(subtype);
+      len = ntohl(len);
+
+      if (off - chunk_start >= CHUNK_LEN) {
+        if (queue_task(q, file, chunk_start, off, chunk_pi_start, chunk_pi_len,
+                       0) != 0) {
+          fclose(fp);
+          return -1;
+        }
+        chunk_start = off;
+        chunk_pi_start = peer_index_start;
+        chunk_pi_len = peer_index_len;
+      }
+
+      if (type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 &&
+          subtype == PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE) {
+        if (sizeof(hdr) + len > BUFLEN) {
+          // too large to be decoded by another chunk
+          break;
+        }
+        peer_index_start = off;
+        peer_index_len = sizeof(hdr) + len;
+      }
+
+      if (fseeko(fp, len, SEEK_CUR) != 0) {
+        break;
+      }
+      off += sizeof(hdr) + len;
+    }
+    fclose(fp);
+  }
+
+  // the last chunk runs to the end of the file, so that any trailing garbage
+  // (or an error opening the file) is reported by parse_range
+  return queue_task(q, file, chunk_start, -1, chunk_pi_start, chunk_pi_len, 0);
+}
+
+static void finish_file(file_t *file)
+{
+  flockfile(stderr);
+  if (file->failed) {
+    fprintf(stderr, "WARNING: Failed to parse %s\n", file->fname);
+  } else {
+    print_stats(&file->opts, file->fname, file->cnt, file->filtered_cnt);
+  }
+  funlockfile(stderr);
+}
+
+static void run_task(task_t *task, task_queue_t *q, reader_t *reader)
+{
+  file_t *file = task->file;
+  uint64_t cnt, filtered_cnt;
+
+  if (task->split) {
+    if (split_file(file, q) != 0) {
+      fprintf(stderr, "ERROR: Failed to split %s into chunks\n", file->fname);
+      __atomic_store_n(&file->failed, 1, __ATOMIC_RELAXED);
+    }
+  } else if (!__atomic_load_n(&file->failed, __ATOMIC_RELAXED)) {
+    if (parse_range(&file->opts, file->type, file->fname, task->start,
+                    task->end, task->peer_index_start, task->peer_index_len,
+                    reader, &cnt, &filtered_cnt) != 0) {
+      __atomic_store_n(&file->failed, 1, __ATOMIC_RELAXED);
+    } else {
+      __atomic_fetch_add(&file->cnt, cnt, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&file->filtered_cnt, filtered_cnt, __ATOMIC_RELAXED);
+    }
+  }
+
+  // the thread that finishes the last task of the file reports it
+  if (__atomic_sub_fetch(&file->tasks_left, 1, __ATOMIC_ACQ_REL) == 0) {
+    finish_file(file);
+  }
+  free(task);
+  if (__atomic_sub_fetch(&tasks_pending, 1, __ATOMIC_ACQ_REL) == 0) {
+    wake_idle(1);
+  }
+}
+
+static void *file_worker(void *arg)
+{
+  int idx = (int)(intptr_t)arg, i;
+  reader_t *reader = NULL;
+  task_t *task;
+
+  if (use_uring && (reader = reader_create(use_uring)) == NULL) {
+    fprintf(stderr, "WARN: Failed to create reader, using stdio\n");
+  } else if (reader != NULL && idx == 0) {
+    fprintf(stderr, "INFO: Reading files with %s\n", reader_backend(reader));
+  }
+
+  while (__atomic_load_n(&tasks_pending, __ATOMIC_ACQUIRE) > 0) {
+    // run our own tasks first, and then steal the oldest task of another
+    // thread
+    task = pop_task(&queues[idx], 0);
+    for (i = 1; task == NULL && i < queues_cnt; i++) {
+      task = pop_task(&queues[(idx + i) % queues_cnt], 1);
+    }
+    if (task == NULL) {
+      // other threads are still splitting or parsing, so wait until they
+      // queue a task or finish
+      pthread_mutex_lock(&idle_mutex);
+      while (__atomic_load_n(&tasks_queued, __ATOMIC_ACQUIRE) == 0 &&
+             __atomic_load_n(&tasks_pending, __ATOMIC_ACQUIRE) > 0) {
+        pthread_cond_wait(&idle_cond, &idle_mutex);
+      }
+      pthread_mutex_unlock(&idle_mutex);
+      continue;
+    }
+    run_task(task, &queues[idx], reader);
+  }
+  reader_destroy(reader);
+  return NULL;
+}
+
+static void free_files(file_t *files, int files_cnt)
+{
+  int i;
+
+  if (files == NULL) {
+    return;
+  }
+  for (i = 0; i < files_cnt; i++) {
+    free(files[i].arg);
+  }
+  free(files);
+}
+
+static int cmp_file_size(const void *a, const void *b)
+{
+  const file_t *fa = a, *fb = b;
+  return (fa->size < fb->size) - (fa->size > fb->size);
+}
+
+// parse several files at once using one thread per job
+static int parse_files(file_t *files, int files_cnt)
+{
+  pthread_t *threads = NULL;
+  task_t *task;
+  int i, threads_cnt = 0, ret = -1;
+
+  if ((queues = calloc(jobs, sizeof(task_queue_t))) == NULL ||
+      (threads = calloc(jobs, sizeof(pthread_t))) == NULL) {
+    goto out;
+  }
+  queues_cnt = jobs;
+  for (i = 0; i < queues_cnt; i++) {
+    pthread_mutex_init(&queues[i].mutex, NULL);
+  }
+
+  // deal out the largest files first, so that they are started early
+  qsort(files, files_cnt, sizeof(file_t), cmp_file_size);
+  for (i = 0; i < files_cnt; i++) {
+    if (queue_task(&queues[i % queues_cnt], &files[i], 0, -1, -1, 0,
+                   files[i].type == PARSEBGP_MSG_TYPE_MRT &&
+                     files[i].size > 2 * CHUNK_LEN) != 0) {
+      fprintf(stderr, "ERROR: Failed to queue %s\n", files[i].fname);
+      goto out;
+    }
+  }
+
+  for (i = 0; i < jobs; i++) {
+    if (pthread_create(&threads[i], NULL, file_worker, (void *)(intptr_t)i) !=
+        0) {
+      fprintf(stderr, "ERROR: Failed to start thread\n");
+      // the threads that did start will run all the tasks
+      break;
+    }
+    threads_cnt++;
+  }
+  if (threads_cnt > 0) {
+    ret = 0;
+  }
+
+out:
+  for (i = 0; i < threads_cnt; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  if (queues != NULL) {
+    for (i = 0; i < queues_cnt; i++) {
+      // tasks are only left over if no thread could be started
+      while ((task = pop_task(&queues[i], 0)) != NULL) {
+        free(task);
+      }
+      free(queues[i].tasks);
+      pthread_mutex_destroy(&queues[i].mutex);
+    }
+    free(queues);
+    queues = NULL;
+  }
+  return ret;
+}
+
+static parsebgp_prefix_set_t *load_prefix_set(const char *fname)
+{
+  parsebgp_prefix_set_t *set = NULL;
+  FILE *fp = NULL;
+  char line[1024], *start, *end;
+  int lineno = 0;
+
+  if ((set = parsebgp_prefix_set_create()) == NULL) {
+    fprintf(stderr, "ERROR: Failed to create prefix set\n");
+    goto err;
+  }
+
+  if ((fp = fopen(fname, "r")) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s (%s)\n", fname, strerror(errno));
+    goto err;
+  }
+
+  // one prefix per line, ignoring blank lines and '#' comments
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    lineno++;
+    if ((end = strchr(line, '#')) != NULL) {
+      *end = '\0';
+    }
+    for (start = line; isspace((unsigned char)*start); start++)
+      ;
+    for (end = start + strlen(start);
+         end > start && isspace((unsigned char)*(end - 1)); end--)
+      ;
+    *end = '\0';
+    if (*start == '\0') {
+      continue;
+    }
+    if (parsebgp_prefix_set_add_str(set, start) != PARSEBGP_OK) {
+      fprintf(stderr, "ERROR: Invalid prefix '%s' at %s:%d\n", start, fname,
+              lineno);
+      goto err;
+    }
+  }
+
+  fclose(fp);
+  fprintf(stderr, "INFO: Loaded %" PRIu64 " prefixes from %s\n",
+          parsebgp_prefix_set_size(set), fname);
+  return set;
+
+err:
+  if (fp != NULL) {
+    fclose(fp);
+  }
+  parsebgp_prefix_set_destroy(set);
+  return NULL;
+}
+
+static int add_peer(parsebgp_mrt_peer_filter_t *filter, const char *peer)
+{
+  uint8_t ip[16];
+  char *end;
+  unsigned long val;
+
+  if (strncmp(peer, "idx:", 4) == 0 || strncmp(peer, "asn:", 4) == 0) {
+    errno = 0;
+    val = strtoul(peer + 4, &end, 10);
+    if (errno != 0 || end == peer + 4 || *end != '\0') {
+      return -1;
+    }
+    if (peer[0] == 'i') {
+      if (val > UINT16_MAX) {
+        return -1;
+      }
+      parsebgp_mrt_peer_filter_add_index(filter, (uint16_t)val);
+      return 0;
+    }
+    if (val > UINT32_MAX) {
+      return -1;
+    }
+    return parsebgp_mrt_peer_filter_add_asn(filter, (uint32_t)val) ==
+               PARSEBGP_OK ? 0 : -1;
+  }
+
+  if (inet_pton(AF_INET, peer, ip) == 1) {
+    return parsebgp_mrt_peer_filter_add_ip(filter, PARSEBGP_BGP_AFI_IPV4, ip) ==
+               PARSEBGP_OK ? 0 : -1;
+  }
+  if (inet_pton(AF_INET6, peer, ip) == 1) {
+    return parsebgp_mrt_peer_filter_add_ip(filter, PARSEBGP_BGP_AFI_IPV6, ip) ==
+               PARSEBGP_OK ? 0 : -1;
+  }
+  return -1;
+}
+
+static int save_intern(const parsebgp_intern_t *intern, const char *fname)
+{
+  FILE *f;
+
+  if ((f = fopen(fname, "wb")) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s (%s)\n", fname,
+            strerror(errno));
+    return -1;
+  }
+  if (parsebgp_intern_save(intern, f) != 0) {
+    fprintf(stderr, "ERROR: Could not write %s (%s)\n", fname,
+            strerror(errno));
+    fclose(f);
+    return -1;
+  }
+  if (fclose(f) != 0) {
+    fprintf(stderr, "ERROR: Could not write %s (%s)\n", fname,
+            strerror(errno));
+    return -1;
+  }
+  fprintf(stderr,
+          "INFO: Saved %" PRIu32 " AS paths, %" PRIu32
+          " community sets and %" PRIu32 " attribute blocks to %s\n",
+          parsebgp_intern_count(intern, PARSEBGP_INTERN_AS_PATH),
+          parsebgp_intern_count(intern, PARSEBGP_INTERN_COMMUNITIES),
+          parsebgp_intern_count(intern, PARSEBGP_INTERN_ATTRS), fname);
+  return 0;
+}
+
 static void usage(void)
 {
   fprintf(
@@ -185,15 +944,51 @@ static void usage(void)
     "         where 'type' is one of 'bmp', 'bgp', or 'mrt'\n"
     "         (only required if using non-standard file extensions)\n"
     "       -4                 Force 4-byte ASN parsing\n"
+    "       -a                 Assume NLRI carry ADD-PATH Path Identifiers\n"
+    "       -A                 Merge AS4_PATH into AS_PATH (adds the effective\n"
+    "                            AS path to the output)\n"
+    "       -H                 Compute Path Attribute fingerprints (64-bit\n"
+    "                            hashes)\n"
     "       -b                 Perform shallow BMP parsing\n"
+    "       -C <entries>       Cache up to the given number of decoded Path\n"
+    "                            Attribute blocks\n"
+    "       -e                 Stream TABLE_DUMP_V2 RIB entries one at a time\n"
+    "                            (entries are counted, but not dumped)\n"
+    "       -E                 Output one line per route element instead of\n"
+    "                            dumping messages\n"
     "       -f <attr-type>     Filter to include given Path Attribute\n"
+    "       -F <expr>          Only output messages that match the given\n"
+    "                            filter expression (see parsebgp_filter.h)\n"
+    "       -I <file>          Intern AS paths, community sets and Path\n"
+    "                            Attribute blocks, and save the dictionary to\n"
+    "                            the given file\n"
+    "       -j <threads>       Use the given number of threads: a single\n"
+    "                            file is decoded by a pipeline of threads,\n"
+    "                            several files (and chunks of large MRT\n"
+    "                            files) are parsed at once (cannot be used\n"
+    "                            with -C, -R or -S if more than one)\n"
     "       -i                 Ignore invalid messages and attributes\n"
     "                            (use multiple times to silence warnings)\n"
     "       -s                 Skip unknown messages and attributes\n"
     "                            (use multiple times to silence warnings)\n"
+    "       -S                 Track session capabilities (from BMP Peer Up\n"
+    "                            and BGP4MP OPEN messages)\n"
     "       -m                 BGP messages do not include the 16-octet marker\n"
+    "       -M <mode>          How prefixes must match the prefix set, one of\n"
+    "                            'exact', 'more' (default) or 'less' specific\n"
+    "       -P <file>          Only output routes for prefixes listed in the\n"
+    "                            given file (one prefix per line)\n"
+    "       -p <sections>      Only decode the given message sections\n"
+    "                            (bitmask of parsebgp_projection_t values)\n"
     "       -h                 Show this help message\n"
     "       -q                 Do not dump parsed messages (quiet mode)\n"
+    "       -R <peer>          Only decode TABLE_DUMP_V2 RIB entries from the\n"
+    "                            given peer (idx:<index>, asn:<asn> or IP)\n"
+    "                            (may be used multiple times)\n"
+    "       -u                 Read files ahead with io_uring (or pread if it\n"
+    "                            is not available) instead of stdio (not\n"
+    "                            used by the -j pipeline for a single file)\n"
+    "       -V                 Only validate message structure (no decoding)\n"
     "       -v                 Show version of the libparsebgp library\n",
     NAME);
 }
@@ -206,8 +1001,23 @@ int main(int argc, char **argv)
 
   parsebgp_opts_t opts;
   parsebgp_opts_init(&opts);
+  parsebgp_filter_t *filter = NULL;
+  parsebgp_prefix_set_t *prefix_set = NULL;
+  parsebgp_mrt_peer_filter_t *peer_filter = NULL;
+  parsebgp_session_table_t *sessions = NULL;
+  parsebgp_attr_cache_t *attr_cache = NULL;
+  parsebgp_intern_t *intern = NULL;
+  const char *intern_file = NULL;
+  parsebgp_pipeline_t *pipeline = NULL;
+  parsebgp_pipeline_config_t pipeline_config;
+  reader_t *reader = NULL;
+  pipeline_state_t pipeline_state;
+  file_t *files = NULL;
+  int files_cnt = 0;
+  struct stat st;
+  opts.prefix_set_match = PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC;
 
-  while (prevoptind = optind, (opt = getopt(argc, argv, ":f:t:i4bsmqvh?")) >= 0) {
+  while (prevoptind = optind, (opt = getopt(argc, argv, ":C:f:F:I:j:M:p:P:R:t:i4aAbeEHmsSquvVh?")) >= 0) {
     if (optind == prevoptind + 2 && (optarg == NULL || *optarg == '-')) {
       opt = ':';
       --optind;
@@ -217,10 +1027,47 @@ int main(int argc, char **argv)
       opts.bgp.asn_4_byte = 1;
       break;
 
+    case 'a':
+      opts.bgp.add_path = PARSEBGP_BGP_ADD_PATH_ALL;
+      break;
+
+    case 'A':
+      opts.bgp.as_path_merge = 1;
+      break;
+
     case 'b':
       opts.bmp.parse_headers_only = 1;
       break;
 
+    case 'H':
+      opts.bgp.fingerprint = 1;
+      break;
+
+    case 'C':
+      if (attr_cache != NULL) {
+        fprintf(stderr, "ERROR: Only one attribute cache size may be given\n");
+        usage();
+        goto err;
+      }
+      if ((attr_cache = parsebgp_attr_cache_create(
+             (uint32_t)strtoul(optarg, NULL, 0))) == NULL) {
+        fprintf(stderr, "ERROR: Failed to create attribute cache of size "
+                        "'%s'\n",
+                optarg);
+        goto err;
+      }
+      opts.attr_cache = attr_cache;
+      break;
+
+    case 'e':
+      opts.mrt_rib_entry_cb = count_rib_entry;
+      opts.mrt_rib_entry_cb_user = &streamed_cnt;
+      break;
+
+    case 'E':
+      elems = 1;
+      break;
+
     case 'f':
       opts.bgp.path_attr_filter_enabled = 1;
       opts.bgp.path_attr_filter[(uint8_t)atoi(optarg)] = 1;
@@ -228,6 +1075,84 @@ int main(int argc, char **argv)
               (uint8_t)atoi(optarg));
       break;
 
+    case 'F':
+      if (filter != NULL) {
+        fprintf(stderr, "ERROR: Only one filter expression may be given\n");
+        usage();
+        goto err;
+      }
+      if ((filter = parsebgp_filter_create(optarg)) == NULL) {
+        usage();
+        goto err;
+      }
+      opts.filter = filter;
+      fprintf(stderr, "INFO: Filtering messages using '%s'\n", optarg);
+      break;
+
+    case 'I':
+      if (intern == NULL && (intern = parsebgp_intern_create()) == NULL) {
+        fprintf(stderr, "ERROR: Failed to create interning store\n");
+        goto err;
+      }
+      intern_file = optarg;
+      opts.intern = intern;
+      break;
+
+    case 'j':
+      if ((jobs = atoi(optarg)) < 1) {
+        fprintf(stderr, "ERROR: Invalid number of threads '%s'\n", optarg);
+        usage();
+        goto err;
+      }
+      break;
+
+    case 'M':
+      if (strcmp(optarg, "exact") == 0) {
+        opts.prefix_set_match = PARSEBGP_PREFIX_SET_MATCH_EXACT;
+      } else if (strcmp(optarg, "more") == 0) {
+        opts.prefix_set_match = PARSEBGP_PREFIX_SET_MATCH_MORE_SPECIFIC;
+      } else if (strcmp(optarg, "less") == 0) {
+        opts.prefix_set_match = PARSEBGP_PREFIX_SET_MATCH_LESS_SPECIFIC;
+      } else {
+        fprintf(stderr, "ERROR: Unknown prefix match mode '%s'\n", optarg);
+        usage();
+        goto err;
+      }
+      break;
+
+    case 'P':
+      if (prefix_set != NULL) {
+        fprintf(stderr, "ERROR: Only one prefix file may be given\n");
+        usage();
+        goto err;
+      }
+      if ((prefix_set = load_prefix_set(optarg)) == NULL) {
+        goto err;
+      }
+      opts.prefix_set = prefix_set;
+      break;
+
+    case 'R':
+      if (peer_filter == NULL &&
+          (peer_filter = parsebgp_mrt_peer_filter_create()) == NULL) {
+        fprintf(stderr, "ERROR: Failed to create peer filter\n");
+        goto err;
+      }
+      if (add_peer(peer_filter, optarg) != 0) {
+        fprintf(stderr, "ERROR: Invalid peer '%s'\n", optarg);
+        usage();
+        goto err;
+      }
+      opts.mrt_peer_filter = peer_filter;
+      break;
+
+    case 'p':
+      opts.projection_enabled = 1;
+      opts.projection |= (uint32_t)strtoul(optarg, NULL, 0);
+      fprintf(stderr, "INFO: Decoding only message sections 0x%" PRIx32 "\n",
+              opts.projection);
+      break;
+
     case 'i':
       // if this is the second (or more) time, silence the warnings
       if (opts.ignore_invalid) {
@@ -252,9 +1177,34 @@ int main(int argc, char **argv)
       silent = 1;
       break;
 
+    case 'S':
+      if (sessions == NULL &&
+          (sessions = parsebgp_session_table_create()) == NULL) {
+        fprintf(stderr, "ERROR: Failed to create session table\n");
+        goto err;
+      }
+      opts.sessions = sessions;
+      break;
+
+    case 'u':
+      use_uring = 1;
+      break;
+
+    case 'V':
+      validate_only = 1;
+      break;
+
     case 'h':
     case '?':
       usage();
+      parsebgp_filter_destroy(filter);
+      parsebgp_prefix_set_destroy(prefix_set);
+      parsebgp_mrt_peer_filter_destroy(peer_filter);
+      parsebgp_session_table_destroy(sessions);
+      parsebgp_attr_cache_destroy(attr_cache);
+      parsebgp_intern_destroy(intern);
+      parsebgp_pipeline_destroy(pipeline);
+      reader_destroy(reader);
       return 0;
       break;
 
@@ -266,14 +1216,46 @@ int main(int argc, char **argv)
 
     default:
       usage();
-      return -1;
+      goto err;
       break;
     }
   }
 
   if (optind >= argc) {
     usage();
-    return -1;
+    goto err;
+  }
+
+  if (jobs > 1 &&
+      (sessions != NULL || attr_cache != NULL || peer_filter != NULL)) {
+    fprintf(stderr, "ERROR: -C, -R and -S cannot be used with -j > 1\n");
+    usage();
+    goto err;
+  }
+
+  if (jobs > 1 && argc - optind > 1) {
+    // several files are parsed at once, each using the main thread's code
+    if ((files = calloc(argc - optind, sizeof(file_t))) == NULL) {
+      fprintf(stderr, "ERROR: Failed to allocate file list\n");
+      goto err;
+    }
+  } else if (jobs > 0 && !validate_only) {
+    parsebgp_pipeline_config_init(&pipeline_config);
+    pipeline_config.opts = opts;
+    pipeline_config.workers = jobs;
+    pipeline_config.output_cb = output_msg;
+    pipeline_config.user = &pipeline_state;
+    pipeline_state.opts = &opts;
+    if ((pipeline = parsebgp_pipeline_create(&pipeline_config)) == NULL) {
+      fprintf(stderr, "ERROR: Failed to create parse pipeline\n");
+      goto err;
+    }
+  } else if (use_uring) {
+    if ((reader = reader_create(use_uring)) == NULL) {
+      fprintf(stderr, "ERROR: Failed to create reader\n");
+      goto err;
+    }
+    fprintf(stderr, "INFO: Reading files with %s\n", reader_backend(reader));
   }
 
   int i, j;
@@ -313,17 +1295,62 @@ int main(int argc, char **argv)
               argv[i]);
       usage();
       free(freeme);
-      return -1;
+      goto err;
     }
 
     fprintf(stderr, "INFO: Parsing %s (Type: %s)\n", fname, type_strs[type]);
 
-    if (parse(&opts, type, fname) != 0) {
+    if (files != NULL) {
+      file_t *file = &files[files_cnt++];
+      file->fname = fname;
+      file->type = type;
+      file->size = (stat(fname, &st) == 0) ? st.st_size : 0;
+      file->opts = opts;
+      file->opts.mrt_rib_entry_cb_user = &file->streamed_cnt;
+      file->arg = freeme;
+      continue;
+    }
+
+    if ((pipeline != NULL
+           ? parse_pipeline(pipeline, &pipeline_config, type, fname)
+           : parse(&opts, type, fname, reader)) != 0) {
       fprintf(stderr, "WARNING: Failed to parse %s%s\n", fname,
               (i == argc - 1) ? "" : ", moving on");
     }
     free(freeme);
   }
 
+  if (files != NULL) {
+    if (parse_files(files, files_cnt) != 0) {
+      goto err;
+    }
+    free_files(files, files_cnt);
+    files = NULL;
+  }
+
+  if (intern != NULL && save_intern(intern, intern_file) != 0) {
+    goto err;
+  }
+
+  parsebgp_filter_destroy(filter);
+  parsebgp_prefix_set_destroy(prefix_set);
+  parsebgp_mrt_peer_filter_destroy(peer_filter);
+  parsebgp_session_table_destroy(sessions);
+  parsebgp_attr_cache_destroy(attr_cache);
+  parsebgp_intern_destroy(intern);
+  parsebgp_pipeline_destroy(pipeline);
+  reader_destroy(reader);
   return 0;
+
+err:
+  parsebgp_filter_destroy(filter);
+  parsebgp_prefix_set_destroy(prefix_set);
+  parsebgp_mrt_peer_filter_destroy(peer_filter);
+  parsebgp_session_table_destroy(sessions);
+  parsebgp_attr_cache_destroy(attr_cache);
+  parsebgp_intern_destroy(intern);
+  parsebgp_pipeline_destroy(pipeline);
+  reader_destroy(reader);
+  free_files(files, files_cnt);
+  return -1;
 }
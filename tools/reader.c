@@ -0,0 +1,514 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "reader.h"
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+// io_uring is used through the raw system calls, so it is available whenever
+// the kernel headers are (no need for liburing)
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup)
+#define USE_IO_URING
+#endif
+
+// Read 1MB of the file at a time
+#define READ_LEN (1024 * 1024)
+
+// Data that the parser has not used is moved in front of the next buffer, so
+// (as with the buffer of refill_buffer) messages may be up to 1MB long
+#define HEADROOM (1024 * 1024)
+
+// Number of buffers: one is being parsed while the others are read into
+#define SLOTS 8
+
+enum {
+  SLOT_FREE,
+  SLOT_READING,
+  SLOT_DONE,
+};
+
+typedef struct slot {
+
+  /** HEADROOM bytes, followed by READ_LEN bytes of data */
+  uint8_t *mem;
+
+  /** Offset in the file of the data */
+  off_t off;
+
+  /** Number of bytes requested (and then read) */
+  size_t len;
+
+  /** Result of the asynchronous read (bytes read or -errno) */
+  int res;
+
+  int state;
+
+} slot_t;
+
+#ifdef USE_IO_URING
+typedef struct uring {
+  int fd;
+
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  void *sq_ring;
+  size_t sq_ring_len;
+  void *cq_ring;
+  size_t cq_ring_len;
+  size_t sqes_len;
+
+  /** Are the slot buffers registered (so that reads use READ_FIXED) */
+  int fixed;
+
+  /** Number of reads queued, but not yet passed to the kernel */
+  unsigned unsubmitted;
+
+  /** Number of reads that have not completed */
+  unsigned inflight;
+} uring_t;
+#endif
+
+struct reader {
+
+  slot_t slots[SLOTS];
+
+  int fd;
+
+  /** Offset of the next read to queue */
+  off_t next_off;
+
+  /** End of the range, or -1 if it is unknown (the file is read using read()
+      until it returns 0) */
+  off_t end;
+
+  /** Sequence numbers of the next slot to hand out and to read into (the
+      slot index is the sequence number modulo SLOTS) */
+  uint64_t head;
+  uint64_t tail;
+
+  /** Buffer that was last handed out (NULL if none) */
+  uint8_t *cur;
+  size_t cur_len;
+
+  /** Has the end of the file been reached */
+  int eof;
+
+  /** Is io_uring used (for this range) */
+  int use_uring;
+  int uring_range;
+
+#ifdef USE_IO_URING
+  uring_t ring;
+#endif
+};
+
+#ifdef USE_IO_URING
+static int uring_init(uring_t *ring, slot_t *slots)
+{
+  struct io_uring_params p;
+  struct iovec iovs[SLOTS];
+  int i;
+
+  memset(ring, 0, sizeof(*ring));
+  memset(&p, 0, sizeof(p));
+  if ((ring->fd = syscall(__NR_io_uring_setup, SLOTS, &p)) < 0) {
+    return -1;
+  }
+
+  ring->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  ring->cq_ring_len =
+    p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_ring_len > ring->sq_ring_len) {
+      ring->sq_ring_len = ring->cq_ring_len;
+    }
+    ring->cq_ring_len = 0;
+  }
+  ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  if ((ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_SQ_RING)) == MAP_FAILED) {
+    ring->sq_ring = NULL;
+    return -1;
+  }
+  if (ring->cq_ring_len == 0) {
+    ring->cq_ring = ring->sq_ring;
+  } else if ((ring->cq_ring = mmap(NULL, ring->cq_ring_len,
+                                   PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_POPULATE, ring->fd,
+                                   IORING_OFF_CQ_RING)) == MAP_FAILED) {
+    ring->cq_ring = NULL;
+    return -1;
+  }
+  if ((ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQES)) == MAP_FAILED) {
+    ring->sqes = NULL;
+    return -1;
+  }
+
+  ring->sq_tail = (unsigned *)((uint8_t *)ring->sq_ring + p.sq_off.tail);
+  ring->sq_mask = (unsigned *)((uint8_t *)ring->sq_ring + p.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)((uint8_t *)ring->sq_ring + p.sq_off.array);
+  ring->cq_head = (unsigned *)((uint8_t *)ring->cq_ring + p.cq_off.head);
+  ring->cq_tail = (unsigned *)((uint8_t *)ring->cq_ring + p.cq_off.tail);
+  ring->cq_mask = (unsigned *)((uint8_t *)ring->cq_ring + p.cq_off.ring_mask);
+  ring->cqes =
+    (struct io_uring_cqe *)((uint8_t *)ring->cq_ring + p.cq_off.cqes);
+
+  // registered buffers count towards the locked memory limit, so reads fall
+  // back to plain (unregistered) buffers if this fails
+  for (i = 0; i < SLOTS; i++) {
+    iovs[i].iov_base = slots[i].mem + HEADROOM;
+    iovs[i].iov_len = READ_LEN;
+  }
+  ring->fixed = syscall(__NR_io_uring_register, ring->fd,
+                        IORING_REGISTER_BUFFERS, iovs, SLOTS) == 0;
+  return 0;
+}
+
+static void uring_destroy(uring_t *ring)
+{
+  if (ring->sqes != NULL) {
+    munmap(ring->sqes, ring->sqes_len);
+  }
+  if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_len);
+  }
+  if (ring->sq_ring != NULL) {
+    munmap(ring->sq_ring, ring->sq_ring_len);
+  }
+  if (ring->fd >= 0) {
+    close(ring->fd);
+  }
+}
+
+static void uring_queue(uring_t *ring, int fd, slot_t *slot, int idx)
+{
+  unsigned tail = *ring->sq_tail;
+  unsigned sidx = tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[sidx];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = ring->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t)(slot->mem + HEADROOM);
+  sqe->len = slot->len;
+  sqe->off = slot->off;
+  sqe->buf_index = idx;
+  sqe->user_data = idx;
+  ring->sq_array[sidx] = sidx;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  ring->unsubmitted++;
+  ring->inflight++;
+}
+
+static int uring_enter(uring_t *ring, unsigned min_complete)
+{
+  int ret;
+
+  if ((ret = syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted,
+                     min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0,
+                     NULL, 0)) < 0) {
+    // try again later (unless we need to wait)
+    return (errno == EINTR || errno == EAGAIN || errno == EBUSY) &&
+               min_complete == 0
+             ? 0
+             : -1;
+  }
+  ring->unsubmitted -= ret;
+  return 0;
+}
+
+// mark the slots of the completed reads as done, and return how many there
+// were
+static int uring_reap(uring_t *ring, slot_t *slots)
+{
+  unsigned head = *ring->cq_head;
+  unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+  struct io_uring_cqe *cqe;
+  int cnt = 0;
+
+  for (; head != tail; head++, cnt++) {
+    cqe = &ring->cqes[head & *ring->cq_mask];
+    slots[cqe->user_data].res = cqe->res;
+    slots[cqe->user_data].state = SLOT_DONE;
+    ring->inflight--;
+  }
+  __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  return cnt;
+}
+
+// wait for at least one read to complete
+static int uring_wait(uring_t *ring, slot_t *slots)
+{
+  while (uring_reap(ring, slots) == 0) {
+    if (uring_enter(ring, 1) != 0 && errno != EINTR) {
+      return -1;
+    }
+  }
+  return 0;
+}
+#endif
+
+// queue reads into the free slots
+static void queue_reads(reader_t *reader)
+{
+  slot_t *slot;
+  int idx;
+
+  // the slot that was handed out last is kept until the next refill
+  while (reader->tail - reader->head < SLOTS - 1 && !reader->eof &&
+         (reader->end < 0 || reader->next_off < reader->end)) {
+    idx = reader->tail++ % SLOTS;
+    slot = &reader->slots[idx];
+    slot->off = reader->next_off;
+    slot->len = READ_LEN;
+    if (reader->end >= 0 && reader->end - slot->off < READ_LEN) {
+      slot->len = reader->end - slot->off;
+    }
+    slot->res = 0;
+    slot->state = SLOT_READING;
+    reader->next_off += slot->len;
+
+#ifdef USE_IO_URING
+    if (reader->uring_range) {
+      uring_queue(&reader->ring, reader->fd, slot, idx);
+      continue;
+    }
+#endif
+    if (reader->end >= 0) {
+      // have the kernel read ahead while the parser is busy
+      posix_fadvise(reader->fd, slot->off, slot->len, POSIX_FADV_WILLNEED);
+    }
+  }
+#ifdef USE_IO_URING
+  if (reader->uring_range && reader->ring.unsubmitted > 0) {
+    // on failure, the reads are passed on when waiting
+    uring_enter(&reader->ring, 0);
+  }
+#endif
+}
+
+// complete the read into the given slot (reading whatever io_uring did not)
+static int finish_read(reader_t *reader, slot_t *slot)
+{
+  uint8_t *data = slot->mem + HEADROOM;
+  size_t got;
+  ssize_t n;
+
+#ifdef USE_IO_URING
+  if (reader->uring_range) {
+    while (slot->state == SLOT_READING) {
+      if (uring_wait(&reader->ring, reader->slots) != 0) {
+        return -1;
+      }
+    }
+  }
+#endif
+
+  // short and failed reads are retried synchronously
+  got = slot->res > 0 ? slot->res : 0;
+  while (got < slot->len) {
+    n = reader->end < 0
+          ? read(reader->fd, data + got, slot->len - got)
+          : pread(reader->fd, data + got, slot->len - got, slot->off + got);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (n == 0) {
+      // the file ended early (or it is not a regular file)
+      reader->eof = 1;
+      break;
+    }
+    got += n;
+  }
+  slot->len = got;
+  slot->state = SLOT_DONE;
+  return 0;
+}
+
+// wait for all reads in flight (so that their buffers may be reused)
+static void drain(reader_t *reader)
+{
+#ifdef USE_IO_URING
+  if (reader->use_uring) {
+    if (reader->ring.unsubmitted > 0) {
+      // make sure that the kernel has all of the reads
+      uring_enter(&reader->ring, 0);
+    }
+    while (reader->ring.inflight > 0 &&
+           uring_wait(&reader->ring, reader->slots) == 0)
+      ;
+  }
+#endif
+  reader->head = reader->tail = 0;
+  reader->cur = NULL;
+  reader->cur_len = 0;
+}
+
+reader_t *reader_create(int use_uring)
+{
+  reader_t *reader;
+  int i;
+
+  if ((reader = calloc(1, sizeof(reader_t))) == NULL) {
+    return NULL;
+  }
+  reader->fd = -1;
+  for (i = 0; i < SLOTS; i++) {
+    if (posix_memalign((void **)&reader->slots[i].mem, 4096,
+                       HEADROOM + READ_LEN) != 0) {
+      reader->slots[i].mem = NULL;
+      reader_destroy(reader);
+      return NULL;
+    }
+  }
+
+#ifdef USE_IO_URING
+  if (use_uring && uring_init(&reader->ring, reader->slots) == 0) {
+    reader->use_uring = 1;
+  } else if (use_uring) {
+    uring_destroy(&reader->ring);
+  }
+#endif
+  return reader;
+}
+
+void reader_destroy(reader_t *reader)
+{
+  int i;
+
+  if (reader == NULL) {
+    return;
+  }
+  drain(reader);
+#ifdef USE_IO_URING
+  if (reader->use_uring) {
+    uring_destroy(&reader->ring);
+  }
+#endif
+  for (i = 0; i < SLOTS; i++) {
+    free(reader->slots[i].mem);
+  }
+  free(reader);
+}
+
+int reader_open(reader_t *reader, int fd, off_t start, off_t end)
+{
+  struct stat st;
+
+  drain(reader);
+  reader->fd = fd;
+  reader->eof = 0;
+  reader->next_off = start;
+  reader->end = end;
+
+  if (fstat(fd, &st) != 0) {
+    return -1;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    // pipes can only be read in order
+    if (start > 0) {
+      errno = ESPIPE;
+      return -1;
+    }
+    reader->end = -1;
+  } else if (end < 0 || end > st.st_size) {
+    reader->end = st.st_size;
+  }
+  reader->uring_range = reader->use_uring && reader->end >= 0;
+
+  if (reader->end >= 0) {
+    posix_fadvise(fd, start, reader->end - start, POSIX_FADV_SEQUENTIAL);
+  }
+  queue_reads(reader);
+  return 0;
+}
+
+ssize_t reader_refill(reader_t *reader, uint8_t **bufp, size_t remain)
+{
+  slot_t *slot = &reader->slots[reader->head % SLOTS];
+  uint8_t *buf;
+
+  if (reader->cur == NULL) {
+    remain = 0;
+  }
+  if (reader->head == reader->tail || remain > HEADROOM) {
+    // no more data (or no room for it), so give back the unused data
+    *bufp = reader->cur + reader->cur_len - remain;
+    return remain;
+  }
+
+  if (finish_read(reader, slot) != 0) {
+    return -1;
+  }
+
+  // move the unused data in front of the new data
+  buf = slot->mem + HEADROOM - remain;
+  if (remain > 0) {
+    memcpy(buf, reader->cur + reader->cur_len - remain, remain);
+  }
+  reader->cur = buf;
+  reader->cur_len = remain + slot->len;
+  reader->head++;
+
+  // the previous buffer is now free
+  queue_reads(reader);
+
+  *bufp = buf;
+  return reader->cur_len;
+}
+
+const char *reader_backend(const reader_t *reader)
+{
+  return reader->use_uring ? "io_uring" : "pread";
+}
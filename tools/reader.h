@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_READER_H
+#define __PARSEBGP_READER_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/** Opaque structure representing a reader that keeps several reads of a file
+    in flight ahead of the parser */
+typedef struct reader reader_t;
+
+/**
+ * Create a reader (each thread that reads files needs its own)
+ *
+ * @param use_uring     if set, use io_uring to read files (if it is available,
+ *                      reads are done with pread() otherwise)
+ * @return pointer to the new reader, or NULL if it could not be created
+ */
+reader_t *reader_create(int use_uring);
+
+/**
+ * Destroy the given reader (waiting for any reads in flight)
+ *
+ * @param reader        pointer to the reader to destroy
+ */
+void reader_destroy(reader_t *reader);
+
+/**
+ * Start reading a range of the given file (any reads in flight for the
+ * previous range are abandoned)
+ *
+ * @param reader        pointer to the reader
+ * @param fd            file to read from (not closed by the reader)
+ * @param start         offset of the first byte to read
+ * @param end           offset to read up to, or -1 to read to the end of the
+ *                      file
+ * @return 0 if reading started, -1 otherwise
+ */
+int reader_open(reader_t *reader, int fd, off_t start, off_t end);
+
+/**
+ * Get the next buffer of data from the file, in the same way as refill_buffer
+ * in parsebgp.c: the last `remain` bytes of the previous buffer (which the
+ * parser has not used) are moved to the start of the new one.
+ *
+ * @param reader        pointer to the reader
+ * @param [out] bufp    set to the start of the buffer
+ * @param remain        number of bytes at the end of the previous buffer that
+ *                      were not used
+ * @return the length of the new buffer (which is `remain` if there is no more
+ * data, or the data did not fit), or -1 if reading failed (errno is set)
+ */
+ssize_t reader_refill(reader_t *reader, uint8_t **bufp, size_t remain);
+
+/**
+ * Get the name of the way in which the reader reads files
+ *
+ * @param reader        pointer to the reader
+ * @return "io_uring" or "pread"
+ */
+const char *reader_backend(const reader_t *reader);
+
+#endif /* __PARSEBGP_READER_H */